@@ -37,11 +37,33 @@ typedef struct {
     float Data[4];
 } ak_sim_quat;
 
+AKSIMDEF ak_sim_quat AK_Sim_Quat(float x, float y, float z, float w);
+AKSIMDEF ak_sim_quat AK_Sim_Quat_Identity(void);
+
 typedef struct {
     ak_sim_v3   Position;
     ak_sim_quat Orientation;
 } ak_sim_transform;
 
+/*Define AK_SIM_DOUBLE_PRECISION everywhere the header is included to store body positions as 
+  doubles. Float positions lose millimeter precision about 8 km from the origin. Shapes, velocities 
+  and collision functions stay in float, and each pair is collided relative to body A's position*/
+#ifdef AK_SIM_DOUBLE_PRECISION
+typedef struct {
+    double Data[3];
+} ak_sim_position;
+
+typedef struct {
+    ak_sim_position Position;
+    ak_sim_quat     Orientation;
+} ak_sim_body_transform;
+#else
+typedef ak_sim_v3 ak_sim_position;
+typedef ak_sim_transform ak_sim_body_transform;
+#endif
+
+AKSIMDEF ak_sim_position AK_Sim_Position(double x, double y, double z);
+
 typedef union {
     float     Data[9];
     ak_sim_v3 Cols[3];
@@ -58,13 +80,14 @@ typedef struct {
 } ak_sim_face;
 
 typedef struct {
-    ak_sim_v4 NormalD;
+    ak_sim_v4 NormalD; /*Outward normal in xyz, w is D so points on the plane satisfy Dot(Normal, P) + D = 0*/
 } ak_sim_plane;
 
 typedef enum {
     AK_SIM_SHAPE_TYPE_CONVEX,
     AK_SIM_SHAPE_TYPE_MESH,
     AK_SIM_SHAPE_TYPE_COMPOUND,
+    AK_SIM_SHAPE_TYPE_HEIGHTFIELD,
     AK_SIM_SHAPE_TYPE_USER
 } ak_sim_shape_type;
 
@@ -85,17 +108,33 @@ typedef struct {
 
 typedef struct {
     float Radius;
-    float HalfHeight;
+    float HalfHeight; /*Capsules are aligned to the local Y axis*/
 } ak_sim_capsule;
 
 typedef struct {
     ak_sim_v3*    Vertices;
     ak_sim_face*  Faces;
-    ak_sim_plane* Planes;
+    ak_sim_plane* Planes; /*One per face*/
     uint32_t      VtxCount;
     uint32_t      FaceCount;
+
+    /*Optional vertex adjacency built by AK_Sim_Build_Hull_Adjacency. The neighbors of vertex i are
+      AdjacentVertices[AdjacencyOffsets[i]] to AdjacentVertices[AdjacencyOffsets[i+1]-1]. Hulls with 
+      more than 16 vertices use it to hill climb support queries instead of scanning every vertex*/
+    uint32_t*     AdjacencyOffsets;
+    uint32_t*     AdjacentVertices;
 } ak_sim_hull;
 
+/*Builds the hull's vertex adjacency into Buffer and points the hull at it. Hulls with faces are 
+  built from their vertex loops in about linear time, welding vertices at the same position and 
+  matching twin edges through hash tables. A welded copy only lists the copy with the lowest index. 
+  Hulls without faces fall back to vertices sharing two planes sharing an edge, which tests every 
+  pair of vertices against every plane, so give large hulls faces. Returns the buffer size needed, 
+  so call with a NULL buffer first. The adjacency takes the first VtxCount+1+AdjacencyOffsets[VtxCount] 
+  uint32s of the buffer and the rest is scratch. Nothing is written if the buffer is too small. 
+  Returns 0 if the hull has no planes*/
+AKSIMDEF size_t AK_Sim_Build_Hull_Adjacency(ak_sim_hull* Hull, void* Buffer, size_t BufferSize);
+
 typedef struct {
     ak_sim_v3* Vertices;
     uint32_t*  Indices; /*Do we need to support 32 bit indices?*/
@@ -103,6 +142,34 @@ typedef struct {
     uint32_t   IdxCount;
 } ak_sim_triangle_mesh;
 
+typedef struct {
+    uint16_t Min;
+    uint16_t Max;
+} ak_sim_heightfield_range;
+
+/*Regular grid of quantized heights on the local XZ plane, starting at the origin. Sample (x, z) 
+  is Heights[z*SampleCountX + x] and sits at (x*CellSize, HeightOffset + Sample*HeightScale, z*CellSize). 
+  Each cell is split into two triangles along its (x, z) to (x+1, z+1) diagonal and collides from above only*/
+typedef struct {
+    uint16_t* Heights;
+    uint32_t  SampleCountX;
+    uint32_t  SampleCountZ;
+    float     CellSize;
+    float     HeightScale; /*Must be positive*/
+    float     HeightOffset;
+
+    /*Optional min/max sample ranges built by AK_Sim_Build_Heightfield_Ranges. Level 0 has one range 
+      per cell and every level above covers 2x2 ranges of the one below, up to a single range for 
+      the whole field. Queries descend the levels to skip cells that can't touch the shape*/
+    ak_sim_heightfield_range* Ranges;
+    uint32_t                  LevelCount;
+    uint32_t                  RangeCount; /*Over all levels, so the whole field's range is the last*/
+} ak_sim_heightfield;
+
+/*Builds the heightfield's range levels into Buffer and points the heightfield at them. Returns the 
+  buffer size needed, so call with a NULL buffer first. Nothing is written if the buffer is too small*/
+AKSIMDEF size_t AK_Sim_Build_Heightfield_Ranges(ak_sim_heightfield* Heightfield, void* Buffer, size_t BufferSize);
+
 typedef struct {
     ak_sim_hull* Hull;
 } ak_sim_hull_inst;
@@ -111,13 +178,26 @@ typedef struct {
     ak_sim_triangle_mesh* Mesh;
 } ak_sim_triangle_mesh_inst;
 
+typedef struct {
+    ak_sim_heightfield* Heightfield;
+} ak_sim_heightfield_inst;
+
+/*User types keep the vtable their type registered with next to their data. AK_Sim_Create_Shape 
+  fills in the vtable from the context's registrations, but compound children are used as given 
+  so they must point at it themselves*/
+typedef struct ak_sim_convex_vtable ak_sim_convex_vtable;
+typedef struct {
+    const ak_sim_convex_vtable* VTable;
+    void*                       UserData;
+} ak_sim_user_convex;
+
 typedef struct {
     ak_sim_convex_type Type;
     union {
-        ak_sim_sphere    Sphere;
-        ak_sim_capsule   Capsule;
-        ak_sim_hull_inst Hull;
-        void*            User;
+        ak_sim_sphere      Sphere;
+        ak_sim_capsule     Capsule;
+        ak_sim_hull_inst   Hull;
+        ak_sim_user_convex User;
     } Internal;
 } ak_sim_convex;
 
@@ -127,13 +207,20 @@ typedef struct {
     ak_sim_generic_shape* Shapes;
 } ak_sim_compound_shape;
 
+typedef struct ak_sim_shape_vtable ak_sim_shape_vtable;
+typedef struct {
+    const ak_sim_shape_vtable* VTable;
+    void*                      UserData;
+} ak_sim_user_shape;
+
 typedef struct {
     ak_sim_shape_type Type;
     union {
         ak_sim_convex             Convex;
         ak_sim_triangle_mesh_inst TriangleMesh;
         ak_sim_compound_shape     Compound;
-        void*                     User;
+        ak_sim_heightfield_inst   Heightfield;
+        ak_sim_user_shape         User;
     } Internal;
 } ak_sim_shape;
 
@@ -147,41 +234,202 @@ typedef struct ak_sim_collision_collector ak_sim_collision_collector;
 typedef void ak_sim_collision_func(ak_sim_collision_collector* Collector, ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA, ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB);
 
 typedef struct {
+    ak_sim_v3 Position; /*World space, midway between the two surfaces. Relative to body A's position with AK_SIM_DOUBLE_PRECISION*/
+    ak_sim_v3 Normal;   /*World space, pointing from shape A to shape B*/
+    float     Depth;    /*Penetration depth. Negative for speculative contacts that are still apart*/
+} ak_sim_contact;
 
+/*Collision functions report contacts for the pair they were called with through this*/
+AKSIMDEF void AK_Sim_Add_Contact(ak_sim_collision_collector* Collector, const ak_sim_contact* Contact);
 
-    ak_sim_collision_func* CollisionFunc;
-} ak_sim_shape_vtable;
-
+/*Volume, center of mass and the inertia tensor about the center of mass at unit density, in 
+  unscaled shape space. Meshes and heightfields have none*/
 typedef struct {
+    float     Volume;
+    ak_sim_v3 CenterOfMass;
+    ak_sim_m3 Inertia;
+} ak_sim_mass_properties;
+
+/*User shape callbacks get the shape's UserData and work in unscaled shape space*/
+
+/*Point of the shape furthest along Direction, which isn't normalized*/
+typedef ak_sim_v3 ak_sim_support_func(const void* UserData, ak_sim_v3 Direction);
+typedef void ak_sim_bounds_func(const void* UserData, ak_sim_v3* Min, ak_sim_v3* Max);
+
+/*First hit of the ray Origin + t*Direction for t in [0, MaxT]. Writes t and the outward normal, 
+  which doesn't need to be normalized, and returns nonzero on a hit*/
+typedef int ak_sim_raycast_func(const void* UserData, ak_sim_v3 Origin, ak_sim_v3 Direction, float MaxT, float* T, ak_sim_v3* Normal);
+typedef ak_sim_mass_properties ak_sim_mass_properties_func(const void* UserData);
+
+/*User convexes collide with every other shape through GJK on their support function. Only 
+  Support is required. Convexes without Bounds are bounded with six support queries, ones without 
+  Raycast are raycast with GJK and ones without MassProperties have no mass*/
+struct ak_sim_convex_vtable {
+    ak_sim_support_func*         Support;
+    ak_sim_bounds_func*          Bounds;
+    ak_sim_raycast_func*         Raycast;
+    ak_sim_mass_properties_func* MassProperties;
+};
 
-} ak_sim_convex_vtable;
+/*User shapes only collide through the functions registered for their type. Shapes without 
+  Bounds overlap everything in the broadphase and shapes without Raycast are never hit*/
+struct ak_sim_shape_vtable {
+    ak_sim_bounds_func*          Bounds;
+    ak_sim_raycast_func*         Raycast;
+    ak_sim_mass_properties_func* MassProperties;
+};
 
 typedef struct {
     ak_sim_shape_type      Type;
     ak_sim_collision_func* CollisionFunc;
 } ak_sim_collision_registration;
 
+/*Adds Type's collision functions against other types to the context's dispatch table, which is 
+  sized to the largest registered type. Types from AK_SIM_SHAPE_TYPE_USER up are user shapes and 
+  use VTable. Each order of a pair has its own function, so register both. Built in types can be 
+  registered too, to replace or add their functions, in which case VTable is ignored*/
 typedef struct {
     ak_sim_shape_type              Type;
+    ak_sim_shape_vtable            VTable;
     uint32_t                       CollisionFuncCount;
     ak_sim_collision_registration* Collisions;
 } ak_sim_shape_registration;
 
+/*User convex types start at AK_SIM_CONVEX_TYPE_USER*/
+typedef struct {
+    ak_sim_convex_type   Type;
+    ak_sim_convex_vtable VTable;
+} ak_sim_convex_registration;
+
+#define AK_SIM_DEFAULT_FIXED_TIME_STEP (1.0f/60.0f)
+#define AK_SIM_DEFAULT_SUBSTEP_COUNT 4
+#define AK_SIM_DEFAULT_MAX_STEPS_PER_UPDATE 8
+#define AK_SIM_DEFAULT_SOLVER_ITERATION_COUNT 2
+#define AK_SIM_DEFAULT_REGION_SIZE 64.0f
+
+/*Runs Task for every TaskIndex in [0, TaskCount) and returns once they have all finished. Tasks 
+  may run in any order and on any thread, but tasks running at the same time must be given 
+  different WorkerIndex values below the context's WorkerCount*/
+typedef void ak_sim_task_func(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData);
+typedef void ak_sim_parallel_for_func(ak_sim_task_func* Task, void* TaskData, uint32_t TaskCount, void* UserData);
+
 typedef struct {
     ak_sim_allocator            Allocator;
     ak_sim_shape_registration*  ShapeRegistrations;
     uint32_t                    ShapeRegistrationCount;
+    ak_sim_convex_registration* ConvexRegistrations;
+    uint32_t                    ConvexRegistrationCount;
+
+    /*Fixed step configuration. Zero fields use the AK_SIM_DEFAULT_* values*/
+    float                       FixedTimeStep;
+    uint32_t                    SubstepCount;
+    uint32_t                    MaxStepsPerUpdate; /*Caps the steps per update so slow frames can't spiral*/
+    uint32_t                    SolverIterationCount; /*Joint velocity iterations per substep*/
+
+    /*Multithreaded stepping. Each step bins the moving bodies into a grid of RegionSize cubes that 
+      run their broadphase as separate tasks, and splits the narrowphase into batches of pairs. 
+      Bodies crossing a cell border are handled by a boundary region every region is tested 
+      against. A NULL ParallelFor runs the tasks in order on the calling thread. The allocator 
+      must be thread safe when tasks run concurrently*/
+    ak_sim_parallel_for_func*   ParallelFor;
+    void*                       ParallelForUserData;
+    uint32_t                    WorkerCount; /*Zero uses one worker*/
+    float                       RegionSize;
+
+    /*Memory budgets. Everything a step needs for up to this many bodies, joints, broadphase 
+      pairs and contacts per substep is allocated when the context is created, so steps that 
+      stay within them never call the allocator. The broadphase pairs its fattened bounds, so 
+      allow some pairs beyond the ones reaching the narrowphase. Cloth and body pairs count 
+      against the pairs too, and creating a cloth allocates what stepping it needs. Going over 
+      a budget still works, the memory then grows on demand as it does when the budgets are zero*/
+    uint32_t                    MaxBodies;
+    uint32_t                    MaxJoints;
+    uint32_t                    MaxPairs;
+    uint32_t                    MaxContacts;
 } ak_sim_create_info;
 
 AKSIMDEF ak_sim_context* AK_Sim_Create_Context(const ak_sim_create_info* CreateInfo);
 AKSIMDEF void AK_Sim_Delete_Context(ak_sim_context* Context);
-AKSIMDEF void AK_Sim_Update(ak_sim_context* Context, float DeltaTime);
+
+/*Advances the simulation by exactly one fixed time step*/
+AKSIMDEF void AK_Sim_Step(ak_sim_context* Context);
+
+/*Accumulates DeltaTime and runs as many fixed steps as are due, up to MaxStepsPerUpdate. Whole 
+  steps past the cap are dropped and only the partial step is kept. Returns the number of steps taken*/
+AKSIMDEF uint32_t AK_Sim_Update(ak_sim_context* Context, float DeltaTime);
+
+/*Fraction of a fixed step left in the accumulator after the last update, in [0, 1)*/
+AKSIMDEF float AK_Sim_Get_Interpolation_Alpha(ak_sim_context* Context);
+
+typedef enum {
+    AK_SIM_PROFILE_PHASE_STEP,
+    AK_SIM_PROFILE_PHASE_BROADPHASE,
+    AK_SIM_PROFILE_PHASE_NARROWPHASE,
+    AK_SIM_PROFILE_PHASE_SOLVER,
+    AK_SIM_PROFILE_PHASE_INTEGRATION,
+    AK_SIM_PROFILE_PHASE_CLOTH,
+    AK_SIM_PROFILE_PHASE_COUNT
+} ak_sim_profile_phase;
+
+/*Timings and counters for the most recent step. Define AK_SIM_NO_PROFILE to compile the 
+  instrumentation out, in which case AK_Sim_Get_Stats returns zeros. Times are read from a 
+  monotonic wall clock, or from AK_SIM_GET_TIME_NS if you define it. Strict C89 builds on 
+  platforms whose clock_gettime is hidden fall back to clock(), which is the CPU time of the 
+  whole process, so phases running tasks on several threads report the sum over the threads*/
+typedef struct {
+    uint64_t PhaseTimeNS[AK_SIM_PROFILE_PHASE_COUNT];
+    int      ProcessCPUTime; /*Nonzero when the times come from the clock() fallback*/
+
+    /*Indexed by [TypeA][TypeB]. All user shape types share the AK_SIM_SHAPE_TYPE_USER slot*/
+    uint64_t NarrowphaseTimeNS[AK_SIM_SHAPE_TYPE_COUNT+1][AK_SIM_SHAPE_TYPE_COUNT+1];
+    uint32_t NarrowphaseCallCount[AK_SIM_SHAPE_TYPE_COUNT+1][AK_SIM_SHAPE_TYPE_COUNT+1];
+
+    uint32_t RegionCount;       /*Grid regions with moving bodies, not counting the boundary region*/
+    uint32_t BoundaryBodyCount; /*Moving bodies whose bounds crossed a region border*/
+    uint32_t BoundsUpdated;     /*Moving bodies whose bounds were recomputed because they moved*/
+    uint32_t FatBoundsUpdated;  /*Moving bodies whose swept bounds left their fat broadphase bounds*/
+    uint32_t IslandCount;       /*Groups of dynamic bodies connected by joints*/
+    uint32_t JointColorCount;   /*Most graph colors the joints of any one island needed*/
+    uint32_t SleepingBodyCount; /*Dynamic bodies whose island is asleep*/
+    uint32_t PairsTested;       /*Bounds overlap tests done by the broadphase*/
+    uint32_t PairsFound;        /*Pairs the broadphase handed to the narrowphase*/
+    uint32_t BatchedPairs;      /*Pair tests run through the batch kernels, summed over the substeps*/
+    uint32_t ContactsProduced;
+    uint32_t ClothContacts;     /*Particles pushed out of rigid bodies, summed over the substeps*/
+    size_t   ArenaBytesUsed;
+    size_t   ArenaHighWaterMark; /*Peak temp arena usage of any step since the context was created*/
+} ak_sim_stats;
+
+AKSIMDEF void AK_Sim_Get_Stats(ak_sim_context* Context, ak_sim_stats* Stats);
+
+/*Bytes the context holds from its allocator, split by what they're for. Unlike the stats this 
+  is always available*/
+typedef struct {
+    size_t Bodies;     /*Body pool*/
+    size_t Shapes;     /*Shape pool and the hull copies the registry owns*/
+    size_t Joints;     /*Joint pool*/
+    size_t Cloths;     /*Cloth pool and the particles and constraints of every cloth*/
+    size_t Broadphase; /*Static tree, cached body bounds and the pairs of the fat bounds*/
+    size_t PairCaches; /*Both pair cache tables*/
+    size_t Events;
+    size_t StepMemory; /*Temp arena and the worker arenas*/
+    size_t Context;    /*The context itself and its arena*/
+    size_t Total;
+} ak_sim_memory_usage;
+
+AKSIMDEF void AK_Sim_Get_Memory_Usage(ak_sim_context* Context, ak_sim_memory_usage* Usage);
+
+/*Writes the phase timings of the last AK_SIM_PROFILE_MAX_EVENTS events as Chrome trace event 
+  JSON (chrome://tracing, Perfetto). Like snprintf, returns the length of the full JSON and writes 
+  at most BufferSize bytes including the null terminator, so a NULL buffer queries the size*/
+AKSIMDEF size_t AK_Sim_Write_Chrome_Trace(ak_sim_context* Context, char* Buffer, size_t BufferSize);
 
 typedef struct {
     /*Properties for generic shapes*/
     ak_sim_shape_type     ShapeType;
     ak_sim_triangle_mesh* TriangleMesh;
     ak_sim_compound_shape CompoundShape;
+    ak_sim_heightfield*   Heightfield;
     void*                 ShapeUserData;
 
     /*Properties for convex shapes*/
@@ -192,30 +440,319 @@ typedef struct {
     void*              ConvexUserData;
 } ak_sim_shape_info;
 
+/*Static bodies never move and are never tested against each other. Kinematic bodies move by 
+  their velocity alone and are only tested against dynamic bodies*/
+typedef enum {
+    AK_SIM_BODY_TYPE_DYNAMIC,
+    AK_SIM_BODY_TYPE_STATIC,
+    AK_SIM_BODY_TYPE_KINEMATIC
+} ak_sim_body_type;
+
+#define AK_SIM_DEFAULT_DENSITY 1000.0f
+
+/*Two bodies are only tested when each one's category shares a bit with the other's mask*/
+#define AK_SIM_DEFAULT_COLLISION_CATEGORY 0x00000001
+#define AK_SIM_DEFAULT_COLLISION_MASK 0xFFFFFFFF
+
+/*Sensors report overlaps through sensor events but never produce contacts. They overlap any 
+  body that isn't a sensor, including kinematic bodies, as long as one of the two can move*/
+#define AK_SIM_BODY_FLAG_SENSOR 0x00000001
+
+/*Dynamic bodies connected by joints or touching contacts form islands. An island falls asleep 
+  once all of its bodies have been nearly still for half a second, and sleeping bodies are left 
+  out of the broadphase search, the narrowphase, the solver and integration. The island wakes 
+  when a moving body touches it, a joint ties it to a moving body or one of its bodies is given 
+  a velocity. Never sleep keeps the body's whole island awake*/
+#define AK_SIM_BODY_FLAG_NEVER_SLEEP 0x00000002
+
+/*Set and cleared by the simulation*/
+#define AK_SIM_BODY_FLAG_SLEEPING 0x00000004
+
+/*Shapes are immutable and shared by any number of bodies. The registry computes their bounds, mass 
+  properties and hull support data once at creation. Hull vertices, meshes, heightfields and 
+  compound children are referenced, not copied, so they must outlive the shape*/
+typedef uint32_t ak_sim_shape_id;
+#define AK_SIM_INVALID_SHAPE_ID 0
+
+/*The returned ID holds one reference for the caller and every body using the shape holds another. 
+  The shape is freed when the last reference goes*/
+AKSIMDEF ak_sim_shape_id AK_Sim_Create_Shape(ak_sim_context* Context, const ak_sim_shape_info* ShapeInfo);
+AKSIMDEF void AK_Sim_Release_Shape(ak_sim_context* Context, ak_sim_shape_id ShapeID);
+AKSIMDEF const ak_sim_shape* AK_Sim_Get_Shape(ak_sim_context* Context, ak_sim_shape_id ShapeID);
+AKSIMDEF ak_sim_mass_properties AK_Sim_Get_Shape_Mass_Properties(ak_sim_context* Context, ak_sim_shape_id ShapeID);
+
 typedef struct {
-    ak_sim_shape_info ShapeInfo;
-    ak_sim_v3         Position;
+    ak_sim_shape_id   Shape;
+    ak_sim_body_type  Type;
+    uint32_t          Flags;             /*AK_SIM_BODY_FLAG_**/
+    uint32_t          CollisionCategory; /*Zero uses AK_SIM_DEFAULT_COLLISION_CATEGORY*/
+    uint32_t          CollisionMask;     /*Zero uses AK_SIM_DEFAULT_COLLISION_MASK*/
+    ak_sim_position   Position;
     ak_sim_quat       Orientation;
     ak_sim_v3         Scale;
+    ak_sim_v3         LinearVelocity;
+    ak_sim_v3         AngularVelocity;
+    float             Density;           /*Zero uses AK_SIM_DEFAULT_DENSITY*/
     void*             UserData;
 } ak_sim_body_create_info;
 
 typedef uint64_t ak_sim_body_id;
+
+/*Static bodies live in their own broadphase tree that is only rebuilt when a static body is 
+  created or deleted, so don't move them or change Type after creation. Mass comes from the 
+  shape's mass properties, scale and density when the body is created. Bodies rotate about 
+  their origin, so the inertia is taken about it. Only dynamic bodies with a shape that has 
+  volume get a mass, every other body is immovable to the solver*/
 typedef struct {
     ak_sim_body_id ID;
-    ak_sim_transform Transform;
+    ak_sim_body_type Type;
+    uint32_t         Flags;
+    uint32_t         CollisionCategory;
+    uint32_t         CollisionMask;
+    ak_sim_body_transform Transform;
+    ak_sim_body_transform PrevTransform; /*Transform at the start of the last step, used for interpolation*/
     ak_sim_v3        Scale;
-    ak_sim_shape     Shape;
+    ak_sim_v3        LinearVelocity;
+    ak_sim_v3        AngularVelocity;
+    float            InvMass;
+    ak_sim_m3        InvInertia; /*Body space*/
+    ak_sim_shape_id  Shape;
+    float            SleepTime; /*Seconds the body has been nearly still*/
     void* UserData;
 } ak_sim_body;
 
+/*Heightfield bodies only collide with convex bodies. Meshes, compounds and other heightfields 
+  pass through them unless a shape registration adds a collision function for the pair*/
 AKSIMDEF ak_sim_body_id AK_Sim_Create_Body(ak_sim_context* Context, const ak_sim_body_create_info* CreateInfo);
 AKSIMDEF void AK_Sim_Delete_Body(ak_sim_context* Context, ak_sim_body_id BodyID);
+AKSIMDEF ak_sim_body* AK_Sim_Get_Body(ak_sim_context* Context, ak_sim_body_id BodyID);
+
+/*Wakes the body's island at the start of the next step. Needed after moving a sleeping body, 
+  setting its velocity through AK_Sim_Get_Body wakes it on its own*/
+AKSIMDEF void AK_Sim_Wake_Body(ak_sim_context* Context, ak_sim_body_id BodyID);
+
+/*Ball joints pin two bodies together at a point, hinges also keep an axis aligned, fixed joints 
+  also hold the relative orientation and distance joints keep two points a fixed distance apart*/
+typedef enum {
+    AK_SIM_JOINT_TYPE_BALL,
+    AK_SIM_JOINT_TYPE_HINGE,
+    AK_SIM_JOINT_TYPE_FIXED,
+    AK_SIM_JOINT_TYPE_DISTANCE
+} ak_sim_joint_type;
+
+/*Anchors and the axis are in world space and are attached to both bodies as they are at 
+  creation. Ball, hinge and fixed joints pin AnchorA on both bodies and ignore AnchorB*/
+typedef struct {
+    ak_sim_joint_type Type;
+    ak_sim_body_id    BodyA;
+    ak_sim_body_id    BodyB;
+    ak_sim_position   AnchorA;
+    ak_sim_position   AnchorB;
+    ak_sim_v3         Axis;     /*Hinge axis*/
+    float             Distance; /*Distance joint length. Zero uses the distance between the anchors*/
+    void*             UserData;
+} ak_sim_joint_create_info;
+
+typedef uint64_t ak_sim_joint_id;
+#define AK_SIM_INVALID_JOINT_ID 0
+
+/*Joints connect dynamic bodies into islands that are solved as separate tasks. Joints whose body 
+  was deleted are skipped until they are deleted too*/
+typedef struct {
+    ak_sim_joint_id   ID;
+    ak_sim_joint_type Type;
+    ak_sim_body_id    BodyA;
+    ak_sim_body_id    BodyB;
+    ak_sim_v3         LocalAnchorA;
+    ak_sim_v3         LocalAnchorB;
+    ak_sim_v3         LocalAxisA;
+    ak_sim_v3         LocalAxisB;
+    ak_sim_quat       RelativeOrientation; /*B's orientation in A's space at creation*/
+    float             Distance;
+
+    /*Impulses of the last substep, used to warm start the next one*/
+    ak_sim_v3         LinearImpulse;
+    ak_sim_v3         AngularImpulse;
+    float             AxialImpulse;
+    void*             UserData;
+} ak_sim_joint;
+
+AKSIMDEF ak_sim_joint_id AK_Sim_Create_Joint(ak_sim_context* Context, const ak_sim_joint_create_info* CreateInfo);
+AKSIMDEF void AK_Sim_Delete_Joint(ak_sim_context* Context, ak_sim_joint_id JointID);
+AKSIMDEF ak_sim_joint* AK_Sim_Get_Joint(ak_sim_context* Context, ak_sim_joint_id JointID);
+
+/*Cloth, ropes and other soft bodies made of particles joined by distance constraints. Edges 
+  and bends are particle index pairs held at their distance at creation. Bends usually join the 
+  far corners of two triangles that share an edge, or every other particle of a rope, and are 
+  given a larger compliance so the cloth folds more easily than it stretches*/
+typedef struct {
+    const ak_sim_position* Positions;
+    const float*           InvMasses;      /*NULL gives every particle an inverse mass of one. Zero pins a particle*/
+    uint32_t               ParticleCount;
+    const uint32_t*        Edges;          /*EdgeCount pairs*/
+    uint32_t               EdgeCount;
+    const uint32_t*        Bends;          /*BendCount pairs*/
+    uint32_t               BendCount;
+    float                  EdgeCompliance; /*Inverse stiffness, zero is rigid*/
+    float                  BendCompliance;
+    float                  Radius;         /*Particle radius against rigid bodies*/
+    float                  Friction;
+    float                  Damping;        /*Fraction of the velocity lost per second*/
+    ak_sim_v3              Gravity;        /*The rigid bodies have no gravity, so cloth brings its own*/
+    uint32_t               CollisionCategory; /*Zero uses AK_SIM_DEFAULT_COLLISION_CATEGORY*/
+    uint32_t               CollisionMask;     /*Zero uses AK_SIM_DEFAULT_COLLISION_MASK*/
+} ak_sim_cloth_create_info;
+
+typedef uint64_t ak_sim_cloth_id;
+#define AK_SIM_INVALID_CLOTH_ID 0
+
+/*Particles are pushed out of the rigid bodies they collide with but the bodies are not pushed 
+  back. Cloth is not part of the saved state, so snapshots can't be saved or loaded while any 
+  cloth exists*/
+AKSIMDEF ak_sim_cloth_id AK_Sim_Create_Cloth(ak_sim_context* Context, const ak_sim_cloth_create_info* CreateInfo);
+AKSIMDEF void AK_Sim_Delete_Cloth(ak_sim_context* Context, ak_sim_cloth_id ClothID);
+
+/*Copies up to MaxCount particle positions and returns the particle count. Positions may be NULL*/
+AKSIMDEF uint32_t AK_Sim_Get_Cloth_Positions(ak_sim_context* Context, ak_sim_cloth_id ClothID, ak_sim_position* Positions, uint32_t MaxCount);
+
+/*Moves a particle and stops it, for attaching pinned particles to something that moves*/
+AKSIMDEF void AK_Sim_Set_Cloth_Particle(ak_sim_context* Context, ak_sim_cloth_id ClothID, uint32_t Index, ak_sim_position Position, float InvMass);
+
+/*Body transform blended between the last two steps by AK_Sim_Get_Interpolation_Alpha. Use this for rendering*/
+AKSIMDEF ak_sim_body_transform AK_Sim_Get_Body_Render_Transform(ak_sim_context* Context, ak_sim_body_id BodyID);
+
+/*Two bodies start touching when a step produces a contact between them with a non negative 
+  depth, and stop touching when a step produces none or the pair leaves the broadphase. IDs are 
+  ordered with the smaller first*/
+typedef struct {
+    ak_sim_body_id BodyA;
+    ak_sim_body_id BodyB;
+} ak_sim_contact_event;
+
+typedef struct {
+    ak_sim_body_id Sensor;
+    ak_sim_body_id Visitor;
+} ak_sim_sensor_event;
+
+/*Begin and end events from every step taken by the last AK_Sim_Step or AK_Sim_Update call, in 
+  step order. A pair can begin and end within one update when it takes several steps. End events 
+  are also sent when either body was deleted, so their IDs may no longer be valid. The arrays 
+  live in the context and are overwritten by the next step or update*/
+typedef struct {
+    const ak_sim_contact_event* ContactBegin;
+    const ak_sim_contact_event* ContactEnd;
+    const ak_sim_sensor_event*  SensorBegin;
+    const ak_sim_sensor_event*  SensorEnd;
+    uint32_t                    ContactBeginCount;
+    uint32_t                    ContactEndCount;
+    uint32_t                    SensorBeginCount;
+    uint32_t                    SensorEndCount;
+} ak_sim_events;
+
+AKSIMDEF ak_sim_events AK_Sim_Get_Events(ak_sim_context* Context);
+
+typedef struct {
+    ak_sim_body_id  Body;
+    ak_sim_position Position;
+    ak_sim_v3       Normal;   /*Outward surface normal at the hit*/
+    float           Distance; /*Along the normalized direction*/
+} ak_sim_raycast_hit;
+
+/*Finds the closest body the ray from Origin along Direction hits within MaxDistance, skipping 
+  sensors. Returns nonzero on a hit. Rays starting inside a convex hit it at distance zero, 
+  meshes are hit from either side and heightfields only from above*/
+AKSIMDEF int AK_Sim_Raycast(ak_sim_context* Context, ak_sim_position Origin, ak_sim_v3 Direction, float MaxDistance, ak_sim_raycast_hit* Hit);
+
+#define AK_SIM_DEFAULT_MAX_SLOPE_COS 0.7071f /*45 degrees*/
+
+#define AK_SIM_CHARACTER_FLAG_GROUNDED 0x00000001
+
+/*Kinematic capsule characters, moved by sweeping the capsule and sliding it along whatever it 
+  hits. They aren't bodies, so bodies don't push them and they don't push bodies. The capsule stays 
+  upright along Y, which is the direction steps and slopes are measured along*/
+typedef struct {
+    ak_sim_position Position;          /*Capsule center*/
+    ak_sim_v3       Displacement;      /*Motion wanted from the next move, gravity included*/
+    ak_sim_capsule  Capsule;
+    float           StepHeight;        /*Tallest ledge walked up onto, and how far down a grounded character follows the ground*/
+    float           MaxSlopeCos;       /*Cosine of the steepest walkable slope. Zero uses AK_SIM_DEFAULT_MAX_SLOPE_COS*/
+    uint32_t        CollisionCategory; /*Zero uses AK_SIM_DEFAULT_COLLISION_CATEGORY*/
+    uint32_t        CollisionMask;     /*Zero uses AK_SIM_DEFAULT_COLLISION_MASK*/
+
+    /*Set by the move. Steps and following the ground need the last move to have ended grounded*/
+    uint32_t        Flags;             /*AK_SIM_CHARACTER_FLAG_**/
+    ak_sim_v3       Motion;            /*Displacement actually made*/
+    ak_sim_body_id  Ground;            /*Zero when not grounded*/
+    ak_sim_v3       GroundNormal;
+} ak_sim_character;
+
+/*Moves each character by its displacement, in parallel. The bodies near a character's whole move 
+  are found once per call and every sweep of its slides and steps only tests those. Characters skip 
+  each other, sensors and user shapes, and capsules starting inside a shape's core move out freely*/
+AKSIMDEF void AK_Sim_Move_Characters(ak_sim_context* Context, ak_sim_character* Characters, uint32_t CharacterCount);
+
+/*Number of fixed steps taken since the context was created*/
+AKSIMDEF uint64_t AK_Sim_Get_Step_Index(ak_sim_context* Context);
+
+/*Hash of the step index and every body's ID, transform and velocity. Compare across peers 
+  each step to catch a desync on the frame it happens. Only bit exact with AK_SIM_DETERMINISTIC*/
+AKSIMDEF uint64_t AK_Sim_Get_State_Hash(ak_sim_context* Context);
+
+/*World snapshots for rollback. The body and joint pools, including their ID generations, are 
+  stored as contiguous blocks so saving and loading are a header plus a memcpy. The step index, 
+  the update's partial step and the narrowphase pair caches are stored too. Shape data and user data 
+  are stored by pointer, so a snapshot is only valid in the process that made it. Snapshots 
+  don't hold shape references, so keep your own reference to every shape a snapshot you may 
+  still load uses. Loads fail, leaving the context untouched, if a body's shape was freed or 
+  replaced since the save. Buffers must be 8 byte aligned. Cloth can't be stored, so saves 
+  and loads fail while any cloth exists.
+  Passing a NULL buffer returns the size required. Saves return the bytes written, or 0 if 
+  the buffer is too small*/
+AKSIMDEF size_t AK_Sim_Save_State(ak_sim_context* Context, void* Buffer, size_t BufferSize);
+AKSIMDEF int    AK_Sim_Load_State(ak_sim_context* Context, const void* Buffer, size_t BufferSize);
+
+/*Delta snapshots only store the body and joint slots and the pair caches that differ from 
+  BaseState, a full snapshot made with AK_Sim_Save_State. Loading a delta needs the same base*/
+AKSIMDEF size_t AK_Sim_Save_Delta_State(ak_sim_context* Context, const void* BaseState, size_t BaseStateSize, void* Buffer, size_t BufferSize);
+AKSIMDEF int    AK_Sim_Load_Delta_State(ak_sim_context* Context, const void* BaseState, size_t BaseStateSize, const void* Buffer, size_t BufferSize);
 
 #endif
 
 #ifdef AK_SIM_IMPLEMENTATION
 
+/*AK_SIM_DETERMINISTIC processes pairs in sorted body ID order and keeps the compiler from 
+  fusing or reassociating float math, so identical inputs produce bit identical steps across 
+  runs and machines. GCC ignores the FP_CONTRACT pragma, so contraction is turned off through its 
+  optimize pragma instead. The settings are saved here and restored at the end of the 
+  implementation, so code after it compiles as before. MSVC has no stack for fp_contract and 
+  only restores float_control*/
+#ifdef AK_SIM_DETERMINISTIC
+# ifdef __FAST_MATH__
+# error "AK_SIM_DETERMINISTIC cannot be used with fast math"
+# endif
+# if defined(__i386__) && !defined(__SSE2_MATH__)
+# error "AK_SIM_DETERMINISTIC requires SSE2 float math on x86"
+# endif
+# if defined(_MSC_VER)
+# pragma float_control(precise, on, push)
+# pragma fp_contract(off)
+# elif defined(__clang__)
+# pragma STDC FP_CONTRACT OFF
+# elif defined(__GNUC__)
+# pragma GCC push_options
+# pragma GCC optimize("fp-contract=off")
+# else
+# pragma STDC FP_CONTRACT OFF
+# endif
+#endif
+
+/*SIMD kernels are used when SSE2 is available. Define AK_SIM_NO_SIMD to force the scalar paths. 
+  Kernels produce bit identical results to their scalar versions*/
+#if !defined(AK_SIM_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define AK_SIM__SSE2
+#include <emmintrin.h>
+#endif
+
 #ifndef AK_SIM_ASSERT
 #include <assert.h>
 #define AK_SIM_ASSERT(c) assert(c)
@@ -231,10 +768,28 @@ AKSIMDEF void AK_Sim_Delete_Body(ak_sim_context* Context, ak_sim_body_id BodyID)
 #define AK_SIM_MEMSET(dst, value, size) memset(dst, value, size)
 #endif
 
+#ifndef AK_SIM_MEMCMP
+#include <string.h>
+#define AK_SIM_MEMCMP(a, b, size) memcmp(a, b, size)
+#endif
+
+#ifndef AK_SIM_SQRT
+#include <math.h>
+#define AK_SIM_SQRT(x) (float)sqrt(x)
+#endif
+
+#ifndef AK_SIM_FMOD
+#include <math.h>
+#define AK_SIM_FMOD(x, y) (float)fmod(x, y)
+#endif
+
 #define AK_Sim__Align_Pow2(x, a) (((x) + (a)-1) & ~((a)-1))
 #define AK_Sim__Is_Pow2(x) (((x) != 0) && (((x) & ((x) - 1)) == 0))
+#define AK_Sim__Array_Count(a) (sizeof(a)/sizeof((a)[0]))
 #define AK_Sim__Max(a, b) (((a) > (b)) ? (a) : (b))
 #define AK_Sim__Min(a, b) (((a) < (b)) ? (a) : (b))
+#define AK_Sim__Abs(a) (((a) < 0) ? -(a) : (a))
+#define AK_SIM__PI 3.14159265358979f
 
 #ifndef AK_SIM_NO_STDLIB
 
@@ -258,6 +813,54 @@ static ak_sim_allocator AK_Sim__Get_Stdio_Allocator() {
 
 #endif
 
+#ifndef AK_SIM_NO_PROFILE
+
+#ifndef AK_SIM_GET_TIME_NS
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+static uint64_t AK_Sim__Get_Time_NS(void) {
+    static LARGE_INTEGER Frequency;
+    LARGE_INTEGER Counter;
+    if(!Frequency.QuadPart) QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Counter);
+    return (uint64_t)((double)Counter.QuadPart * (1000000000.0/(double)Frequency.QuadPart));
+}
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+static uint64_t AK_Sim__Get_Time_NS(void) {
+    static mach_timebase_info_data_t Timebase;
+    if(!Timebase.denom) mach_timebase_info(&Timebase);
+    return mach_absolute_time()*Timebase.numer/Timebase.denom;
+}
+#else
+#include <time.h>
+#if defined(CLOCK_MONOTONIC)
+static uint64_t AK_Sim__Get_Time_NS(void) {
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (uint64_t)Time.tv_sec*1000000000 + (uint64_t)Time.tv_nsec;
+}
+#else
+/*Strict C89 builds don't see clock_gettime, so fall back to the standard clock. It counts CPU 
+  time for the whole process rather than wall time, which the stats report*/
+#define AK_SIM__PROCESS_CPU_TIME 1
+static uint64_t AK_Sim__Get_Time_NS(void) {
+    return (uint64_t)((double)clock() * (1000000000.0/(double)CLOCKS_PER_SEC));
+}
+#endif
+#endif
+#define AK_SIM_GET_TIME_NS() AK_Sim__Get_Time_NS()
+#endif
+
+#ifndef AK_SIM__PROCESS_CPU_TIME
+#define AK_SIM__PROCESS_CPU_TIME 0
+#endif
+
+#endif
+
 static void* AK_Sim__Allocate_Memory(ak_sim_allocator* Allocator, size_t Size) {
     return Allocator->AllocateMemory(Size, Allocator->UserData);
 }
@@ -310,6 +913,225 @@ static ak_sim_m4x3 AK_Sim__Get_Matrix_Transform(const ak_sim_transform* Transfor
     return Result;
 }
 
+static ak_sim_v3 AK_Sim__V3_Add(ak_sim_v3 A, ak_sim_v3 B) {
+    return AK_Sim_V3(A.Data[0]+B.Data[0], A.Data[1]+B.Data[1], A.Data[2]+B.Data[2]);
+}
+
+static ak_sim_v3 AK_Sim__V3_Sub(ak_sim_v3 A, ak_sim_v3 B) {
+    return AK_Sim_V3(A.Data[0]-B.Data[0], A.Data[1]-B.Data[1], A.Data[2]-B.Data[2]);
+}
+
+static ak_sim_v3 AK_Sim__V3_Mul_S(ak_sim_v3 A, float S) {
+    return AK_Sim_V3(A.Data[0]*S, A.Data[1]*S, A.Data[2]*S);
+}
+
+static ak_sim_v3 AK_Sim__V3_Mul(ak_sim_v3 A, ak_sim_v3 B) {
+    return AK_Sim_V3(A.Data[0]*B.Data[0], A.Data[1]*B.Data[1], A.Data[2]*B.Data[2]);
+}
+
+static float AK_Sim__V3_Dot(ak_sim_v3 A, ak_sim_v3 B) {
+    return A.Data[0]*B.Data[0] + A.Data[1]*B.Data[1] + A.Data[2]*B.Data[2];
+}
+
+static ak_sim_v3 AK_Sim__V3_Cross(ak_sim_v3 A, ak_sim_v3 B) {
+    return AK_Sim_V3(A.Data[1]*B.Data[2] - A.Data[2]*B.Data[1],
+                     A.Data[2]*B.Data[0] - A.Data[0]*B.Data[2],
+                     A.Data[0]*B.Data[1] - A.Data[1]*B.Data[0]);
+}
+
+static float AK_Sim__V3_Length(ak_sim_v3 A) {
+    return AK_SIM_SQRT(AK_Sim__V3_Dot(A, A));
+}
+
+static ak_sim_v3 AK_Sim__V3_Normalize(ak_sim_v3 A) {
+    float Length = AK_Sim__V3_Length(A);
+    return Length > 0.0f ? AK_Sim__V3_Mul_S(A, 1.0f/Length) : A;
+}
+
+static ak_sim_v3 AK_Sim__V3_Min(ak_sim_v3 A, ak_sim_v3 B) {
+    return AK_Sim_V3(AK_Sim__Min(A.Data[0], B.Data[0]), AK_Sim__Min(A.Data[1], B.Data[1]), AK_Sim__Min(A.Data[2], B.Data[2]));
+}
+
+static ak_sim_v3 AK_Sim__V3_Max(ak_sim_v3 A, ak_sim_v3 B) {
+    return AK_Sim_V3(AK_Sim__Max(A.Data[0], B.Data[0]), AK_Sim__Max(A.Data[1], B.Data[1]), AK_Sim__Max(A.Data[2], B.Data[2]));
+}
+
+static ak_sim_v3 AK_Sim__V3_Lerp(ak_sim_v3 A, float t, ak_sim_v3 B) {
+    return AK_Sim__V3_Add(AK_Sim__V3_Mul_S(A, 1.0f-t), AK_Sim__V3_Mul_S(B, t));
+}
+
+#ifdef AK_SIM_DOUBLE_PRECISION
+static ak_sim_position AK_Sim__Position_Add_V3(ak_sim_position P, ak_sim_v3 V) {
+    ak_sim_position Result;
+    Result.Data[0] = P.Data[0] + (double)V.Data[0];
+    Result.Data[1] = P.Data[1] + (double)V.Data[1];
+    Result.Data[2] = P.Data[2] + (double)V.Data[2];
+    return Result;
+}
+
+/*Subtract in double first so nearby positions keep their full precision as a float offset*/
+static ak_sim_v3 AK_Sim__Position_Sub(ak_sim_position A, ak_sim_position B) {
+    return AK_Sim_V3((float)(A.Data[0]-B.Data[0]), (float)(A.Data[1]-B.Data[1]), (float)(A.Data[2]-B.Data[2]));
+}
+
+static ak_sim_position AK_Sim__Position_Lerp(ak_sim_position A, float t, ak_sim_position B) {
+    ak_sim_position Result;
+    Result.Data[0] = A.Data[0] + (B.Data[0]-A.Data[0])*(double)t;
+    Result.Data[1] = A.Data[1] + (B.Data[1]-A.Data[1])*(double)t;
+    Result.Data[2] = A.Data[2] + (B.Data[2]-A.Data[2])*(double)t;
+    return Result;
+}
+#else
+#define AK_Sim__Position_Add_V3(p, v) AK_Sim__V3_Add(p, v)
+#define AK_Sim__Position_Sub(a, b) AK_Sim__V3_Sub(a, b)
+#define AK_Sim__Position_Lerp(a, t, b) AK_Sim__V3_Lerp(a, t, b)
+#endif
+
+/*Float matrix of a body transform with Origin moved to zero*/
+static ak_sim_m4x3 AK_Sim__Get_Body_Matrix_Transform(const ak_sim_body_transform* Transform, ak_sim_position Origin) {
+    ak_sim_transform Relative;
+    Relative.Position = AK_Sim__Position_Sub(Transform->Position, Origin);
+    Relative.Orientation = Transform->Orientation;
+    return AK_Sim__Get_Matrix_Transform(&Relative);
+}
+
+static float AK_Sim__V3_Max_Component(ak_sim_v3 A) {
+    return AK_Sim__Max(AK_Sim__Max(A.Data[0], A.Data[1]), A.Data[2]);
+}
+
+static ak_sim_quat AK_Sim__Quat_Mul(ak_sim_quat A, ak_sim_quat B) {
+    ak_sim_quat Result;
+    Result.Data[0] = A.Data[3]*B.Data[0] + A.Data[0]*B.Data[3] + A.Data[1]*B.Data[2] - A.Data[2]*B.Data[1];
+    Result.Data[1] = A.Data[3]*B.Data[1] - A.Data[0]*B.Data[2] + A.Data[1]*B.Data[3] + A.Data[2]*B.Data[0];
+    Result.Data[2] = A.Data[3]*B.Data[2] + A.Data[0]*B.Data[1] - A.Data[1]*B.Data[0] + A.Data[2]*B.Data[3];
+    Result.Data[3] = A.Data[3]*B.Data[3] - A.Data[0]*B.Data[0] - A.Data[1]*B.Data[1] - A.Data[2]*B.Data[2];
+    return Result;
+}
+
+static ak_sim_quat AK_Sim__Quat_Conjugate(ak_sim_quat Q) {
+    return AK_Sim_Quat(-Q.Data[0], -Q.Data[1], -Q.Data[2], Q.Data[3]);
+}
+
+static ak_sim_quat AK_Sim__Quat_Normalize(ak_sim_quat Q) {
+    float LengthSq = Q.Data[0]*Q.Data[0] + Q.Data[1]*Q.Data[1] + Q.Data[2]*Q.Data[2] + Q.Data[3]*Q.Data[3];
+    if(LengthSq < 1e-12f) return AK_Sim_Quat_Identity();
+    float InvLength = 1.0f/AK_SIM_SQRT(LengthSq);
+    return AK_Sim_Quat(Q.Data[0]*InvLength, Q.Data[1]*InvLength, Q.Data[2]*InvLength, Q.Data[3]*InvLength);
+}
+
+/*Normalized lerp along the shortest arc*/
+static ak_sim_quat AK_Sim__Quat_Nlerp(ak_sim_quat A, float t, ak_sim_quat B) {
+    float Dot = A.Data[0]*B.Data[0] + A.Data[1]*B.Data[1] + A.Data[2]*B.Data[2] + A.Data[3]*B.Data[3];
+    float tB = Dot < 0.0f ? -t : t;
+    ak_sim_quat Result;
+    uint32_t i;
+    for(i = 0; i < 4; i++) {
+        Result.Data[i] = A.Data[i]*(1.0f-t) + B.Data[i]*tB;
+    }
+    return AK_Sim__Quat_Normalize(Result);
+}
+
+/*Advances Q by the angular velocity W over time step h*/
+static ak_sim_quat AK_Sim__Quat_Integrate(ak_sim_quat Q, ak_sim_v3 W, float h) {
+    ak_sim_quat Spin = AK_Sim__Quat_Mul(AK_Sim_Quat(W.Data[0], W.Data[1], W.Data[2], 0.0f), Q);
+    uint32_t i;
+    for(i = 0; i < 4; i++) {
+        Q.Data[i] += 0.5f*h*Spin.Data[i];
+    }
+    return AK_Sim__Quat_Normalize(Q);
+}
+
+static ak_sim_v3 AK_Sim__M3_Mul_V3(const ak_sim_m3* M, ak_sim_v3 V) {
+    ak_sim_v3 Result = AK_Sim__V3_Mul_S(M->Cols[0], V.Data[0]);
+    Result = AK_Sim__V3_Add(Result, AK_Sim__V3_Mul_S(M->Cols[1], V.Data[1]));
+    Result = AK_Sim__V3_Add(Result, AK_Sim__V3_Mul_S(M->Cols[2], V.Data[2]));
+    return Result;
+}
+
+static ak_sim_v3 AK_Sim__M3_Transpose_Mul_V3(const ak_sim_m3* M, ak_sim_v3 V) {
+    return AK_Sim_V3(AK_Sim__V3_Dot(M->Cols[0], V), AK_Sim__V3_Dot(M->Cols[1], V), AK_Sim__V3_Dot(M->Cols[2], V));
+}
+
+static ak_sim_m3 AK_Sim__M3_Mul(const ak_sim_m3* A, const ak_sim_m3* B) {
+    ak_sim_m3 Result;
+    Result.Cols[0] = AK_Sim__M3_Mul_V3(A, B->Cols[0]);
+    Result.Cols[1] = AK_Sim__M3_Mul_V3(A, B->Cols[1]);
+    Result.Cols[2] = AK_Sim__M3_Mul_V3(A, B->Cols[2]);
+    return Result;
+}
+
+static ak_sim_m3 AK_Sim__M3_Transpose(const ak_sim_m3* M) {
+    ak_sim_m3 Result;
+    uint32_t Row, Col;
+    for(Col = 0; Col < 3; Col++) {
+        Result.Cols[Col] = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+        for(Row = 0; Row < 3; Row++) {
+            Result.Cols[Col].Data[Row] = M->Cols[Row].Data[Col];
+        }
+    }
+    return Result;
+}
+
+static ak_sim_m3 AK_Sim__M3_Add(const ak_sim_m3* A, const ak_sim_m3* B) {
+    ak_sim_m3 Result;
+    Result.Cols[0] = AK_Sim__V3_Add(A->Cols[0], B->Cols[0]);
+    Result.Cols[1] = AK_Sim__V3_Add(A->Cols[1], B->Cols[1]);
+    Result.Cols[2] = AK_Sim__V3_Add(A->Cols[2], B->Cols[2]);
+    return Result;
+}
+
+/*Cross product matrix, Skew(A)*B == Cross(A, B)*/
+static ak_sim_m3 AK_Sim__M3_Skew(ak_sim_v3 A) {
+    ak_sim_m3 Result;
+    Result.Cols[0] = AK_Sim_V3(0.0f, A.Data[2], -A.Data[1]);
+    Result.Cols[1] = AK_Sim_V3(-A.Data[2], 0.0f, A.Data[0]);
+    Result.Cols[2] = AK_Sim_V3(A.Data[1], -A.Data[0], 0.0f);
+    return Result;
+}
+
+/*The rows of the inverse are the cross products of the columns over the determinant. Singular 
+  matrices return zero, which makes the solver treat the block as immovable*/
+static ak_sim_m3 AK_Sim__M3_Inverse(const ak_sim_m3* M) {
+    ak_sim_m3 Rows;
+    Rows.Cols[0] = AK_Sim__V3_Cross(M->Cols[1], M->Cols[2]);
+    Rows.Cols[1] = AK_Sim__V3_Cross(M->Cols[2], M->Cols[0]);
+    Rows.Cols[2] = AK_Sim__V3_Cross(M->Cols[0], M->Cols[1]);
+    float Det = AK_Sim__V3_Dot(M->Cols[0], Rows.Cols[0]);
+
+    ak_sim_m3 Result = AK_Sim__M3_Transpose(&Rows);
+    float InvDet = Det != 0.0f ? 1.0f/Det : 0.0f;
+    Result.Cols[0] = AK_Sim__V3_Mul_S(Result.Cols[0], InvDet);
+    Result.Cols[1] = AK_Sim__V3_Mul_S(Result.Cols[1], InvDet);
+    Result.Cols[2] = AK_Sim__V3_Mul_S(Result.Cols[2], InvDet);
+    return Result;
+}
+
+static ak_sim_v3 AK_Sim__M4x3_Mul_V3(const ak_sim_m4x3* M, ak_sim_v3 V) {
+    ak_sim_v3 Result = AK_Sim__V3_Mul_S(M->Cols[0], V.Data[0]);
+    Result = AK_Sim__V3_Add(Result, AK_Sim__V3_Mul_S(M->Cols[1], V.Data[1]));
+    Result = AK_Sim__V3_Add(Result, AK_Sim__V3_Mul_S(M->Cols[2], V.Data[2]));
+    return Result;
+}
+
+static ak_sim_v3 AK_Sim__M4x3_Transform_Point(const ak_sim_m4x3* M, ak_sim_v3 P) {
+    return AK_Sim__V3_Add(AK_Sim__M4x3_Mul_V3(M, P), M->Cols[3]);
+}
+
+/*Only for rigid transforms, where the inverse rotation is the transpose*/
+static ak_sim_v3 AK_Sim__M4x3_Inverse_Transform_Point(const ak_sim_m4x3* M, ak_sim_v3 P) {
+    ak_sim_v3 Delta = AK_Sim__V3_Sub(P, M->Cols[3]);
+    return AK_Sim_V3(AK_Sim__V3_Dot(M->Cols[0], Delta), AK_Sim__V3_Dot(M->Cols[1], Delta), AK_Sim__V3_Dot(M->Cols[2], Delta));
+}
+
+static ak_sim_m4x3 AK_Sim__M4x3_Mul(const ak_sim_m4x3* A, const ak_sim_m4x3* B) {
+    ak_sim_m4x3 Result;
+    Result.Cols[0] = AK_Sim__M4x3_Mul_V3(A, B->Cols[0]);
+    Result.Cols[1] = AK_Sim__M4x3_Mul_V3(A, B->Cols[1]);
+    Result.Cols[2] = AK_Sim__M4x3_Mul_V3(A, B->Cols[2]);
+    Result.Cols[3] = AK_Sim__M4x3_Transform_Point(A, B->Cols[3]);
+    return Result;
+}
+
 typedef struct ak_sim__arena_block ak_sim__arena_block;
 
 struct ak_sim__arena_block {
@@ -384,31 +1206,51 @@ static ak_sim__arena_block* AK_Sim__Arena_Get_Current_Block(ak_sim__arena* Arena
     return NULL;
 }
 
+static ak_sim__arena_block* AK_Sim__Arena_Add_Block(ak_sim__arena* Arena, size_t BlockSize) {
+    ak_sim__arena_block* Block = (ak_sim__arena_block*)AK_Sim__Allocate_Memory(Arena->Allocator, BlockSize+sizeof(ak_sim__arena_block));
+    Block->Start = (uint8_t*)(Block+1);
+    Block->At = Block->Start;
+    Block->End = Block->Start+BlockSize;
+    Block->Next = NULL;
+
+    if(!Arena->First) {
+        Arena->First = Arena->Last = Block;
+    }
+    else {
+        AK_SIM_ASSERT(Arena->Last);
+        Arena->Last->Next = Block;
+        Arena->Last = Block;
+    }
+    return Block;
+}
+
+/*Grows the arena to hold at least Size bytes. On an empty arena that is a single block, so 
+  pushes totalling less than Size, minus alignment, never allocate*/
+static void AK_Sim__Arena_Reserve(ak_sim__arena* Arena, size_t Size) {
+    size_t Capacity = 0;
+    ak_sim__arena_block* Block;
+    for(Block = Arena->First; Block; Block = Block->Next) {
+        Capacity += (size_t)(Block->End - Block->Start);
+    }
+
+    if(Capacity < Size) {
+        Block = AK_Sim__Arena_Add_Block(Arena, AK_Sim__Max(Size-Capacity, AK_SIM__DEFAULT_ARENA_BLOCK_SIZE));
+        if(!Arena->Current) Arena->Current = Block;
+    }
+}
+
 static void* AK_Sim__Arena_Push_Aligned(ak_sim__arena* Arena, size_t Size, size_t Alignment) {
     AK_SIM_ASSERT(AK_Sim__Is_Pow2(Alignment));
 
     ak_sim__arena_block* CurrentBlock = AK_Sim__Arena_Get_Current_Block(Arena, Size, Alignment);
     if(!CurrentBlock) {
-        size_t BlockSize = AK_Sim__Max(Alignment+Size, AK_SIM__DEFAULT_ARENA_BLOCK_SIZE);
-        ak_sim__arena_block* Block = (ak_sim__arena_block*)AK_Sim__Allocate_Memory(Arena->Allocator, BlockSize+sizeof(ak_sim__arena_block));
-        Block->Start = (uint8_t*)(Block+1);
-        Block->At = Block->Start;
-        Block->End = Block->Start+BlockSize;
-        CurrentBlock = Block;
-
-        if(!Arena->First) {
-            Arena->First = Arena->Last = Block;
-        }
-        else {
-            AK_SIM_ASSERT(Arena->Last);
-            Arena->Last->Next = Block;
-            Arena->Last = Block;
-        }
+        CurrentBlock = AK_Sim__Arena_Add_Block(Arena, AK_Sim__Max(Alignment+Size, AK_SIM__DEFAULT_ARENA_BLOCK_SIZE));
     }
 
     Arena->Current = CurrentBlock;
     Arena->Current->At = (uint8_t*)AK_Sim__Align_Pow2((size_t)Arena->Current->At, Alignment);
     uint8_t* Result = Arena->Current->At;
+    Arena->Current->At += Size;
     return Result;
 }
 
@@ -436,7 +1278,38 @@ static void AK_Sim__Arena_End_Temp(ak_sim__temp_arena* TempArena) {
     if(TempArena->Block) {
         Arena->Current = TempArena->Block;
         Arena->Current->At = TempArena->BlockAt;
+    } else {
+        Arena->Current = Arena->First;
+    }
+}
+
+static void AK_Sim__Arena_Clear(ak_sim__arena* Arena) {
+    ak_sim__arena_block* Block;
+    for(Block = Arena->First; Block; Block = Block->Next) {
+        Block->At = Block->Start;
+    }
+    Arena->Current = Arena->First;
+}
+
+/*Bytes allocated for the arena's blocks, used or not*/
+static size_t AK_Sim__Arena_Get_Size(ak_sim__arena* Arena) {
+    size_t Result = 0;
+    ak_sim__arena_block* Block;
+    for(Block = Arena->First; Block; Block = Block->Next) {
+        Result += sizeof(ak_sim__arena_block) + (size_t)(Block->End - Block->Start);
+    }
+    return Result;
+}
+
+static size_t AK_Sim__Arena_Get_Used(ak_sim__arena* Arena) {
+    size_t Result = 0;
+    ak_sim__arena_block* Block = Arena->First;
+    while(Block) {
+        Result += (size_t)(Block->At - Block->Start);
+        if(Block == Arena->Current) break;
+        Block = Block->Next;
     }
+    return Result;
 }
 
 #define AK_Sim__Arena_Push_Struct(arena, type) (type*)AK_Sim__Arena_Push(arena, sizeof(type))
@@ -465,18 +1338,23 @@ static void* AK_Sim__Array_Get(ak_sim__array* Array, uint32_t Index) {
     return Result;
 }
 
-static void AK_Sim__Array_Add(ak_sim__array* Array, const void* Data) {
-    if(Array->Count == Array->Capacity) {
-        uint32_t NewCapacity = Array->Capacity ? Array->Capacity*2 : 64;
-        uint8_t* NewData = (uint8_t*)AK_Sim__Allocate_Memory(Array->Allocator, NewCapacity*Array->DataSize);
+static void AK_Sim__Array_Reserve(ak_sim__array* Array, uint32_t Capacity) {
+    if(Capacity > Array->Capacity) {
+        uint8_t* NewData = (uint8_t*)AK_Sim__Allocate_Memory(Array->Allocator, Capacity*Array->DataSize);
 
         if(Array->Data) {
-            AK_SIM_MEMCPY(NewData, Array->Data, Array->Capacity*Array->DataSize);
+            AK_SIM_MEMCPY(NewData, Array->Data, Array->Count*Array->DataSize);
             AK_Sim__Free_Memory(Array->Allocator, Array->Data);
         }
 
         Array->Data = NewData;
-        Array->Capacity = NewCapacity;
+        Array->Capacity = Capacity;
+    }
+}
+
+static void AK_Sim__Array_Add(ak_sim__array* Array, const void* Data) {
+    if(Array->Count == Array->Capacity) {
+        AK_Sim__Array_Reserve(Array, Array->Capacity ? Array->Capacity*2 : 64);
     }
 
     uint32_t Index = Array->Count++;
@@ -521,8 +1399,10 @@ static void AK_Sim__Set_Expand_Items(ak_sim__set* Set, uint32_t ItemCapacity) {
 		NewSlotData[i] = AK_SIM__HASH_INVALID_SLOT;
 	}
 
-	AK_SIM_MEMCPY(NewKeyData, Set->Keys, Set->KeySize*Set->ItemCapacity);
-	AK_SIM_MEMCPY(NewSlotData, Set->Slots, sizeof(uint32_t)*Set->ItemCapacity);
+	if(Set->Keys) {
+		AK_SIM_MEMCPY(NewKeyData, Set->Keys, Set->KeySize*Set->ItemCapacity);
+		AK_SIM_MEMCPY(NewSlotData, Set->ItemSlots, sizeof(uint32_t)*Set->ItemCapacity);
+	}
 
 	if(Set->Keys)
 		AK_Sim__Free_Memory(Set->Allocator, Set->Keys);
@@ -541,11 +1421,12 @@ static void AK_Sim__Set_Expand_Slots(ak_sim__set* Set, uint32_t NewCapacity) {
     uint32_t i;
     for (i = 0; i < NewCapacity; i++) {
 		NewSlots[i].ItemIndex = AK_SIM__HASH_INVALID_SLOT;
+		NewSlots[i].BaseCount = 0;
 	}
 
 	for (i = 0; i < Set->SlotCapacity; i++) {
 		if (Set->Slots[i].ItemIndex != AK_SIM__HASH_INVALID_SLOT) {
-			uint32_t Hash = Set->Slots[i].ItemIndex;
+			uint32_t Hash = Set->Slots[i].Hash;
 			uint32_t BaseSlot = (Hash & SlotMask);
 			uint32_t Slot = BaseSlot;
 			while (NewSlots[Slot].ItemIndex != AK_SIM__HASH_INVALID_SLOT) {
@@ -566,6 +1447,39 @@ static void AK_Sim__Set_Expand_Slots(ak_sim__set* Set, uint32_t NewCapacity) {
 	Set->SlotCapacity = NewCapacity;
 }
 
+static void AK_Sim__Set_Delete(ak_sim__set* Set) {
+	if (Set->Keys) AK_Sim__Free_Memory(Set->Allocator, Set->Keys);
+	if (Set->Slots) AK_Sim__Free_Memory(Set->Allocator, Set->Slots);
+	AK_SIM_MEMSET(Set, 0, sizeof(ak_sim__set));
+}
+
+/*Removes every item but keeps the memory*/
+static void AK_Sim__Set_Clear(ak_sim__set* Set) {
+	uint32_t i;
+	for (i = 0; i < Set->SlotCapacity; i++) {
+		Set->Slots[i].ItemIndex = AK_SIM__HASH_INVALID_SLOT;
+		Set->Slots[i].BaseCount = 0;
+	}
+	Set->ItemCount = 0;
+}
+
+/*Makes room for Count items without growing the items or the slots*/
+static void AK_Sim__Set_Reserve(ak_sim__set* Set, uint32_t Count) {
+    if(Count > Set->ItemCapacity) {
+        AK_Sim__Set_Expand_Items(Set, Count);
+    }
+
+    /*Slots grow once the items reach two thirds of them*/
+    uint32_t SlotCount = AK_Sim__Ceil_Pow2_U32(Count + Count/2 + 1);
+    if(SlotCount > Set->SlotCapacity) {
+        AK_Sim__Set_Expand_Slots(Set, SlotCount);
+    }
+}
+
+static size_t AK_Sim__Set_Get_Size(const ak_sim__set* Set) {
+    return (Set->KeySize+sizeof(uint32_t))*Set->ItemCapacity + sizeof(ak_sim__hash_slot)*Set->SlotCapacity;
+}
+
 static void AK_Sim__Set_Init(ak_sim__set* Set, ak_sim_allocator* Allocator, size_t KeySize, ak_sim__key_hash_func* HashFunc,
                              ak_sim__key_comp_func* CompareFunc) {
     AK_SIM_MEMSET(Set, 0, sizeof(ak_sim__set));
@@ -673,6 +1587,17 @@ static int AK_Sim__Set_Find(ak_sim__set* Set, const void* Key) {
 	return Result;
 }
 
+/*Items are stored in insertion order, so the index doubles as an index into parallel arrays*/
+static uint32_t AK_Sim__Set_Find_Index(ak_sim__set* Set, const void* Key) {
+	uint32_t Slot = AK_Sim__Set_Find_Slot(Set, Key, Set->HashFunc(Key));
+	return Slot != AK_SIM__HASH_INVALID_SLOT ? Set->Slots[Slot].ItemIndex : AK_SIM__HASH_INVALID_SLOT;
+}
+
+static const void* AK_Sim__Set_Get_Key(ak_sim__set* Set, uint32_t Index) {
+	AK_SIM_ASSERT(Index < Set->ItemCount);
+	return Set->Keys + Index*Set->KeySize;
+}
+
 typedef struct {
     union {
         uint64_t ID;
@@ -686,6 +1611,7 @@ typedef struct {
 #define AK_SIM__POOL_FREE_INDEX ((uint32_t)-1)
 #define AK_Sim__Pool_Item_Size(pool) ((pool)->ItemSize+sizeof(ak_sim__pool_id))
 #define AK_Sim__Pool_Get_ID(pool, index) ((ak_sim__pool_id*)((pool)->Data + AK_Sim__Pool_Item_Size(pool)*(index)))
+#define AK_Sim__Pool_Get_Item(pool, index) ((uint8_t*)(AK_Sim__Pool_Get_ID(pool, index)+1))
 
 typedef struct {
 	ak_sim_allocator* Allocator;
@@ -721,6 +1647,24 @@ static void AK_Sim__Pool_Delete(ak_sim__pool* Pool) {
 	AK_SIM_MEMSET(Pool, 0, sizeof(ak_sim__pool));
 }
 
+static void AK_Sim__Pool_Reserve(ak_sim__pool* Pool, uint32_t Capacity) {
+	if (Capacity <= Pool->ItemCapacity) return;
+
+	uint32_t NewCapacity = AK_Sim__Max(Pool->ItemCapacity * 2, Capacity);
+	uint8_t* NewData = (uint8_t*)AK_Sim__Allocate_Memory(Pool->Allocator, AK_Sim__Pool_Item_Size(Pool)*NewCapacity);
+	AK_SIM_MEMCPY(NewData, Pool->Data, AK_Sim__Pool_Item_Size(Pool)*Pool->ItemCapacity);
+	AK_Sim__Free_Memory(Pool->Allocator, Pool->Data);
+	Pool->Data = NewData;
+
+	uint32_t i;
+	for (i = Pool->ItemCapacity; i < NewCapacity; i++) {
+		ak_sim__pool_id* NewID = AK_Sim__Pool_Get_ID(Pool, i);
+		NewID->Internal.Index = AK_SIM__POOL_FREE_INDEX;
+		NewID->Internal.Generation = 1;
+	}
+	Pool->ItemCapacity = NewCapacity;
+}
+
 static uint64_t AK_Sim__Pool_Allocate(ak_sim__pool* Pool) {
 	uint32_t Index = 0;
 	if (Pool->FirstFreeIndex != AK_SIM__POOL_FREE_INDEX) {
@@ -728,14 +1672,7 @@ static uint64_t AK_Sim__Pool_Allocate(ak_sim__pool* Pool) {
 		Pool->FirstFreeIndex = AK_Sim__Pool_Get_ID(Pool, Index)->Internal.Index;
 	} else {
 		Index = Pool->MaxUsed++;
-		if (Index >= Pool->ItemCapacity) {
-			uint32_t NewCapacity = Pool->ItemCapacity * 2;
-			uint8_t* NewData = (uint8_t*)AK_Sim__Allocate_Memory(Pool->Allocator, AK_Sim__Pool_Item_Size(Pool)*NewCapacity);
-			AK_SIM_MEMCPY(NewData, Pool->Data, AK_Sim__Pool_Item_Size(Pool)*Pool->ItemCapacity);
-			AK_Sim__Free_Memory(Pool->Allocator, Pool->Data);
-			Pool->Data = NewData;
-			Pool->ItemCapacity = NewCapacity;
-		}
+		AK_Sim__Pool_Reserve(Pool, Index+1);
 	}
 
 	ak_sim__pool_id* ID = AK_Sim__Pool_Get_ID(Pool, Index);
@@ -747,9 +1684,10 @@ static uint64_t AK_Sim__Pool_Allocate(ak_sim__pool* Pool) {
 static uint8_t* AK_Sim__Pool_Get(ak_sim__pool* Pool, uint64_t IDValue) {
     ak_sim__pool_id ID;
     ID.ID = IDValue;
+    if (ID.Internal.Index >= Pool->MaxUsed) return NULL;
 
 	ak_sim__pool_id* PoolID = AK_Sim__Pool_Get_ID(Pool, ID.Internal.Index);
-	if (PoolID->Internal.Generation == ID.Internal.Generation) {
+	if (PoolID->Internal.Index == ID.Internal.Index && PoolID->Internal.Generation == ID.Internal.Generation) {
 		return (uint8_t*)(PoolID + 1);
 	}
 	return NULL;
@@ -781,6 +1719,7 @@ static ak_sim__pool_iter AK_Sim__Pool_Begin_Iter(ak_sim__pool* Pool) {
         ak_sim__pool_id* ID = AK_Sim__Pool_Get_ID(Pool, i);
         if(ID->Internal.Index == i) {
             Result.Index = i;
+            break;
         }
     }
 
@@ -802,6 +1741,7 @@ static uint8_t* AK_Sim__Pool_Iter_Next(ak_sim__pool_iter* Iter) {
         PoolID = AK_Sim__Pool_Get_ID(Iter->Pool, i);
         if(PoolID->Internal.Index == i) {
             Iter->Index = i;
+            break;
         }
     }
 
@@ -820,235 +1760,6867 @@ static ak_sim_collision_func* AK_Sim__Collision_Table_Get_Func(ak_sim__collision
     return Func;
 }
 
-struct ak_sim_context {
-    ak_sim_allocator Allocator;
-    ak_sim__arena Arena;
-    ak_sim__arena TempArena;
-    ak_sim__collision_table CollisionTable;
-    ak_sim__pool BodyPool;
-};
+#ifndef AK_SIM_NO_PROFILE
+
+#ifndef AK_SIM_PROFILE_MAX_EVENTS
+#define AK_SIM_PROFILE_MAX_EVENTS 4096
+#endif
 
 typedef struct {
-    ak_sim_body_id AID;
-    ak_sim_body_id BID;
-} ak_sim__body_id_pair;
+    ak_sim_profile_phase Phase;
+    uint64_t             StartNS;
+    uint64_t             EndNS;
+} ak_sim__profile_event;
 
-AKSIMDEF ak_sim_v3 AK_Sim_V3(float x, float y, float z) {
+typedef struct {
+    ak_sim_stats          Stats;
+    ak_sim__profile_event Events[AK_SIM_PROFILE_MAX_EVENTS];
+    uint32_t              EventCount; /*Total recorded. Events wrap around the ring buffer*/
+} ak_sim__profiler;
+
+static void AK_Sim__Profiler_Record(ak_sim__profiler* Profiler, ak_sim_profile_phase Phase, uint64_t StartNS, uint64_t EndNS) {
+    Profiler->Stats.PhaseTimeNS[Phase] += EndNS-StartNS;
+    ak_sim__profile_event* Event = Profiler->Events + (Profiler->EventCount++ % AK_SIM_PROFILE_MAX_EVENTS);
+    Event->Phase = Phase;
+    Event->StartNS = StartNS;
+    Event->EndNS = EndNS;
+}
+
+#define AK_Sim__Profile_Begin(context, phase) uint64_t AK_Sim__Profile_##phase##_Start = AK_SIM_GET_TIME_NS()
+#define AK_Sim__Profile_End(context, phase) AK_Sim__Profiler_Record(&(context)->Profiler, AK_SIM_PROFILE_PHASE_##phase, AK_Sim__Profile_##phase##_Start, AK_SIM_GET_TIME_NS())
+#define AK_Sim__Profile_Count(context, counter, value) ((context)->Profiler.Stats.counter += (value))
+#else
+#define AK_Sim__Profile_Begin(context, phase)
+#define AK_Sim__Profile_End(context, phase)
+#define AK_Sim__Profile_Count(context, counter, value)
+#endif
+
+/*Scratch memory and counters owned by one worker. Tasks only touch the worker they run on, and 
+  the counters are merged into the step's stats once the tasks finish*/
+typedef struct {
+    ak_sim__arena Arena;
+#ifndef AK_SIM_NO_PROFILE
+    ak_sim_stats  Stats;
+#endif
+} ak_sim__worker;
+
+#ifndef AK_SIM_NO_PROFILE
+#define AK_Sim__Worker_Count(worker, counter, value) ((worker)->Stats.counter += (value))
+#else
+#define AK_Sim__Worker_Count(worker, counter, value)
+#endif
+
+#define AK_SIM__PAIR_FLAG_TOUCHING 0x00000001 /*A substep of the cache's step produced a non speculative contact*/
+#define AK_SIM__PAIR_FLAG_SENSOR_A 0x00000002
+#define AK_SIM__PAIR_FLAG_SENSOR_B 0x00000004
+#define AK_SIM__PAIR_FLAG_SENSOR (AK_SIM__PAIR_FLAG_SENSOR_A|AK_SIM__PAIR_FLAG_SENSOR_B)
+
+typedef struct {
+    ak_sim_v3 SeparatingAxis; /*Last GJK closest point of A - B, zero before the first query*/
+    uint32_t  SupportIndexA;  /*Hill climbing starts from the last support vertices*/
+    uint32_t  SupportIndexB;
+    uint32_t  Flags;
+} ak_sim__pair_cache;
+
+/*Narrowphase state that persists between steps, keyed by body pair. Caches are parallel to the 
+  set's items, which are in the same order as the step's pair array*/
+typedef struct {
+    ak_sim__set         Pairs;
+    ak_sim__pair_cache* Caches;
+    uint32_t            Capacity;
+} ak_sim__pair_cache_table;
+
+typedef struct {
+    ak_sim_v3 Min;
+    ak_sim_v3 Max;
+} ak_sim__aabb;
+
+/*Leaves carry the filter data so the broadphase can reject pairs without touching the bodies*/
+typedef struct {
+    ak_sim__aabb   AABB;
+    ak_sim_body_id ID;
+    uint32_t       CollisionCategory;
+    uint32_t       CollisionMask;
+    uint32_t       Type;
+    uint32_t       Flags;
+} ak_sim__bvh_item;
+
+/*Interior nodes have a Count of 0 and their children at First and First+1. Leaves own the 
+  items [First, First+Count)*/
+typedef struct {
+    ak_sim__aabb AABB;
+    uint32_t     First;
+    uint32_t     Count;
+} ak_sim__bvh_node;
+
+typedef struct {
+    ak_sim__bvh_node* Nodes;
+    ak_sim__bvh_item* Items;
+    uint32_t          NodeCount;
+    uint32_t          ItemCount;
+} ak_sim__bvh;
+
+/*Broadphase bounds of a body, kept between steps. The tight bounds are only recomputed 
+  when the transform, scale or shape they came from changes. Item holds the fat bounds, which 
+  are only replaced once the swept bounds leave them*/
+typedef struct {
+    ak_sim_body_transform Transform;
+    ak_sim_v3             Scale;
+    ak_sim_shape_id       Shape;
+    ak_sim__aabb          AABB;
+    ak_sim__aabb          SweptAABB; /*Static bodies only fill this in, with their bounds*/
+    ak_sim__bvh_item      Item;
+    int                   Stale; /*Fat bounds were replaced since the moving tree was built*/
+} ak_sim__body_bounds;
+
+typedef struct {
+    ak_sim_shape           Shape;
+    ak_sim__aabb           LocalAABB; /*Unscaled shape space*/
+    ak_sim_mass_properties MassProperties;
+    void*                  SupportData; /*Registry owned hull copy with adjacency, if the hull had none*/
+    size_t                 SupportDataSize;
+    uint32_t               RefCount;    /*Caller references*/
+    uint32_t               BodyCount;   /*Bodies using the shape*/
+} ak_sim__shape_entry;
+
+/*Cloth constraints are graph colored so that no two in a color share a particle. Constraints 
+  past this many colors share the last one and are solved in order*/
+#define AK_SIM__MAX_CLOTH_COLORS 32
+
+typedef struct {
+    uint32_t A;
+    uint32_t B;
+    float    RestLength;
+    float    Compliance;
+} ak_sim__cloth_constraint;
+
+/*Particles are stored as one array per component, relative to Origin so double precision 
+  worlds keep small float offsets. Every array lives in Memory*/
+typedef struct {
+    ak_sim_cloth_id           ID;
+    ak_sim_position           Origin;
+    float*                    X[3];
+    float*                    PrevX[3];    /*Positions at the start of the substep*/
+    float*                    V[3];
+    float*                    InvMasses;
+    uint32_t                  ParticleCount;
+    ak_sim__cloth_constraint* Constraints; /*Sorted by color*/
+    uint32_t                  ColorOffsets[AK_SIM__MAX_CLOTH_COLORS+2]; /*Color i is [ColorOffsets[i], ColorOffsets[i+1])*/
+    float                     Radius;
+    float                     Friction;
+    float                     Damping;
+    ak_sim_v3                 Gravity;
+    uint32_t                  CollisionCategory;
+    uint32_t                  CollisionMask;
+    void*                     Memory;
+    size_t                    MemorySize;
+} ak_sim__cloth;
+
+struct ak_sim_context {
+    ak_sim_allocator Allocator;
+    ak_sim__arena Arena;
+    ak_sim__arena TempArena;
+    ak_sim__collision_table CollisionTable;
+    ak_sim__pool BodyPool;
+    ak_sim__pool ShapePool;
+    ak_sim__pool JointPool;
+    ak_sim__pool ClothPool;
+
+    /*Indexed by type minus AK_SIM_SHAPE_TYPE_USER or AK_SIM_CONVEX_TYPE_USER*/
+    ak_sim_shape_vtable*  ShapeVTables;
+    ak_sim_convex_vtable* ConvexVTables;
+    uint32_t              ShapeVTableCount;
+    uint32_t              ConvexVTableCount;
+
+    /*Double buffered so the previous step's caches can be looked up while building this step's*/
+    ak_sim__pair_cache_table PairCaches[2];
+    uint32_t                 PairCacheIndex;
+
+    /*Touch events since the last AK_Sim_Step or AK_Sim_Update call started*/
+    ak_sim__arena EventArena;
+    ak_sim__array ContactBeginEvents; /*ak_sim_contact_event*/
+    ak_sim__array ContactEndEvents;   /*ak_sim_contact_event*/
+    ak_sim__array SensorBeginEvents;  /*ak_sim_sensor_event*/
+    ak_sim__array SensorEndEvents;    /*ak_sim_sensor_event*/
+
+    /*Static bodies only change when they're created or deleted, so their tree persists*/
+    ak_sim__bvh StaticTree;
+    uint32_t    StaticTreeCapacity;
+    int         StaticTreeDirty;
+
+    /*Indexed by body pool slot. The pairs of the fat bounds still hold while no fat bounds 
+      change and no body was created or deleted*/
+    ak_sim__body_bounds* BodyBounds;
+    uint32_t             BodyBoundsCapacity;
+    ak_sim__array        BroadphasePairs; /*ak_sim__body_id_pair*/
+    int                  BroadphaseDirty;
+
+    /*Fat bounds of the moving bodies at the last region search. Bodies that left their fat 
+      bounds since are stale in it and are the only ones searched again*/
+    ak_sim__bvh MovingTree;
+    uint32_t    MovingTreeCapacity;
+    int         MovingTreeDirty;
+
+    /*From the create info, zero when there is no budget*/
+    uint32_t MaxBodies;
+    uint32_t MaxJoints;
+    uint32_t MaxPairs;
+    uint32_t MaxContacts;
+
+    float    FixedTimeStep;
+    uint32_t SubstepCount;
+    uint32_t MaxStepsPerUpdate;
+    uint32_t SolverIterationCount;
+    float    Accumulator;
+    uint64_t StepIndex;
+
+    ak_sim_parallel_for_func* ParallelFor;
+    void*                     ParallelForUserData;
+    ak_sim__worker*           Workers;
+    uint32_t                  WorkerCount;
+    float                     RegionSize;
+
+#ifndef AK_SIM_NO_PROFILE
+    ak_sim__profiler Profiler;
+#endif
+};
+
+typedef struct {
+    ak_sim_body_id AID;
+    ak_sim_body_id BID;
+} ak_sim__body_id_pair;
+
+static uint32_t AK_Sim__Hash_U64(uint64_t x) {
+    x ^= x >> 32;
+	x *= 0xd6e8feb86659fd93;
+	x ^= x >> 32;
+	x *= 0xd6e8feb86659fd93;
+	x ^= x >> 32;
+	return (uint32_t)x;
+}
+
+static uint32_t AK_Sim__Body_Pair_Hash(const void* Key) {
+    const ak_sim__body_id_pair* Pair = (const ak_sim__body_id_pair*)Key;
+    /*IDs keep the pool index in the high bits, so both IDs have to be mixed in whole*/
+    return AK_Sim__Hash_U64(Pair->AID ^ (Pair->BID*0x9e3779b97f4a7c15));
+}
+
+static int AK_Sim__Body_Pair_Compare(const void* KeyA, const void* KeyB) {
+    const ak_sim__body_id_pair* A = (const ak_sim__body_id_pair*)KeyA;
+    const ak_sim__body_id_pair* B = (const ak_sim__body_id_pair*)KeyB;
+    return A->AID == B->AID && A->BID == B->BID;
+}
+
+static void AK_Sim__Pair_Cache_Table_Init(ak_sim__pair_cache_table* Table, ak_sim_allocator* Allocator) {
+    AK_Sim__Set_Init(&Table->Pairs, Allocator, sizeof(ak_sim__body_id_pair), AK_Sim__Body_Pair_Hash, AK_Sim__Body_Pair_Compare);
+    Table->Caches = NULL;
+    Table->Capacity = 0;
+}
+
+static void AK_Sim__Pair_Cache_Table_Delete(ak_sim__pair_cache_table* Table) {
+    if(Table->Caches) AK_Sim__Free_Memory(Table->Pairs.Allocator, Table->Caches);
+    AK_Sim__Set_Delete(&Table->Pairs);
+    Table->Caches = NULL;
+    Table->Capacity = 0;
+}
+
+/*Makes room for Count pairs and caches up front, so filling the table never allocates*/
+static void AK_Sim__Pair_Cache_Table_Reserve(ak_sim__pair_cache_table* Table, uint32_t Count) {
+    AK_Sim__Set_Reserve(&Table->Pairs, Count);
+    if(Count > Table->Capacity) {
+        if(Table->Caches) AK_Sim__Free_Memory(Table->Pairs.Allocator, Table->Caches);
+        Table->Caches = (ak_sim__pair_cache*)AK_Sim__Allocate_Memory(Table->Pairs.Allocator, Count*sizeof(ak_sim__pair_cache));
+        Table->Capacity = Count;
+    }
+}
+
+/*Empties the table and makes room for Count caches*/
+static void AK_Sim__Pair_Cache_Table_Reset(ak_sim__pair_cache_table* Table, uint32_t Count) {
+    AK_Sim__Set_Clear(&Table->Pairs);
+    if(Count > Table->Capacity) {
+        uint32_t NewCapacity = AK_Sim__Max(Table->Capacity*2, AK_Sim__Max(Count, 64));
+        if(Table->Caches) AK_Sim__Free_Memory(Table->Pairs.Allocator, Table->Caches);
+        Table->Caches = (ak_sim__pair_cache*)AK_Sim__Allocate_Memory(Table->Pairs.Allocator, NewCapacity*sizeof(ak_sim__pair_cache));
+        Table->Capacity = NewCapacity;
+    }
+}
+
+static void AK_Sim__Clear_Events(ak_sim_context* Context) {
+    AK_Sim__Arena_Clear(&Context->EventArena);
+    ak_sim_allocator* Allocator = &Context->EventArena.BaseAllocator;
+    AK_Sim__Array_Init(&Context->ContactBeginEvents, Allocator, sizeof(ak_sim_contact_event));
+    AK_Sim__Array_Init(&Context->ContactEndEvents, Allocator, sizeof(ak_sim_contact_event));
+    AK_Sim__Array_Init(&Context->SensorBeginEvents, Allocator, sizeof(ak_sim_sensor_event));
+    AK_Sim__Array_Init(&Context->SensorEndEvents, Allocator, sizeof(ak_sim_sensor_event));
+}
+
+AKSIMDEF ak_sim_v3 AK_Sim_V3(float x, float y, float z) {
     ak_sim_v3 Result;
     Result.Data[0] = x;
     Result.Data[1] = y;
     Result.Data[2] = z;
+    Result.Data[3] = 0.0f;
     return Result;
 }
 
-static void AK_Sim__Register_Collision(ak_sim__collision_table* Table, ak_sim_shape_type TypeA, ak_sim_shape_type TypeB, ak_sim_collision_func* CollisionFunc) {
-    uint32_t Index = TypeA*Table->MaxPerRow + TypeB;
-    AK_SIM_ASSERT(Index < Table->MaxPerRow*Table->MaxPerRow);
-    Table->CollisionFuncs[Index] = CollisionFunc;
+AKSIMDEF ak_sim_position AK_Sim_Position(double x, double y, double z) {
+#ifdef AK_SIM_DOUBLE_PRECISION
+    ak_sim_position Result;
+    Result.Data[0] = x;
+    Result.Data[1] = y;
+    Result.Data[2] = z;
+    return Result;
+#else
+    return AK_Sim_V3((float)x, (float)y, (float)z);
+#endif
 }
 
-static void AK_Sim__Convex_Collision(ak_sim_collision_collector* Collector, 
-                                     ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
-                                     ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+AKSIMDEF ak_sim_quat AK_Sim_Quat(float x, float y, float z, float w) {
+    ak_sim_quat Result;
+    Result.Data[0] = x;
+    Result.Data[1] = y;
+    Result.Data[2] = z;
+    Result.Data[3] = w;
+    return Result;
 }
 
-static void AK_Sim__Convex_Mesh_Collision(ak_sim_collision_collector* Collector, 
-                                          ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
-                                          ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+AKSIMDEF ak_sim_quat AK_Sim_Quat_Identity(void) {
+    return AK_Sim_Quat(0.0f, 0.0f, 0.0f, 1.0f);
 }
 
-static void AK_Sim__Convex_Compound_Collision(ak_sim_collision_collector* Collector, 
-                                              ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
-                                              ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+static ak_sim__aabb AK_Sim__AABB_Empty(void) {
+    ak_sim__aabb Result;
+    Result.Min = AK_Sim_V3(1e30f, 1e30f, 1e30f);
+    Result.Max = AK_Sim_V3(-1e30f, -1e30f, -1e30f);
+    return Result;
 }
 
-static void AK_Sim__Mesh_Convex_Collision(ak_sim_collision_collector* Collector, 
-                                          ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
-                                          ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+static void AK_Sim__AABB_Add_Point(ak_sim__aabb* AABB, ak_sim_v3 P) {
+    AABB->Min = AK_Sim__V3_Min(AABB->Min, P);
+    AABB->Max = AK_Sim__V3_Max(AABB->Max, P);
 }
 
-static void AK_Sim__Mesh_Collision(ak_sim_collision_collector* Collector, 
-                                   ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
-                                   ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+static ak_sim__aabb AK_Sim__AABB_Union(const ak_sim__aabb* A, const ak_sim__aabb* B) {
+    ak_sim__aabb Result;
+    Result.Min = AK_Sim__V3_Min(A->Min, B->Min);
+    Result.Max = AK_Sim__V3_Max(A->Max, B->Max);
+    return Result;
 }
 
-static void AK_Sim__Mesh_Compound_Collision(ak_sim_collision_collector* Collector, 
-                                            ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
-                                            ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+static ak_sim__aabb AK_Sim__AABB_Extend(const ak_sim__aabb* AABB, float Margin) {
+    ak_sim_v3 Extent = AK_Sim_V3(Margin, Margin, Margin);
+    ak_sim__aabb Result;
+    Result.Min = AK_Sim__V3_Sub(AABB->Min, Extent);
+    Result.Max = AK_Sim__V3_Add(AABB->Max, Extent);
+    return Result;
 }
 
-static void AK_Sim__Compound_Convex_Collision(ak_sim_collision_collector* Collector, 
-                                              ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
-                                              ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+static int AK_Sim__AABB_Overlap(const ak_sim__aabb* A, const ak_sim__aabb* B) {
+    return A->Min.Data[0] <= B->Max.Data[0] && A->Max.Data[0] >= B->Min.Data[0] &&
+           A->Min.Data[1] <= B->Max.Data[1] && A->Max.Data[1] >= B->Min.Data[1] &&
+           A->Min.Data[2] <= B->Max.Data[2] && A->Max.Data[2] >= B->Min.Data[2];
 }
 
-static void AK_Sim__Compound_Mesh_Collision(ak_sim_collision_collector* Collector, 
-                                            ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
-                                            ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+typedef struct {
+    uint32_t PairIndex;
+    uint32_t FirstContact;
+    uint32_t ContactCount;
+} ak_sim__contact_manifold;
+
+struct ak_sim_collision_collector {
+    ak_sim__arena*      Arena;
+    ak_sim__pair_cache* Cache;     /*Cache of the pair being collided, NULL outside the step*/
+    uint32_t            PairIndex;
+    ak_sim__array       Contacts;  /*ak_sim_contact*/
+    ak_sim__array       Manifolds; /*ak_sim__contact_manifold, one per pair that produced contacts*/
+};
+
+static ak_sim_collision_collector AK_Sim__Begin_Collision_Collector(ak_sim__arena* Arena) {
+    ak_sim_collision_collector Result;
+    AK_SIM_MEMSET(&Result, 0, sizeof(ak_sim_collision_collector));
+    Result.Arena = Arena;
+    AK_Sim__Array_Init(&Result.Contacts, &Arena->BaseAllocator, sizeof(ak_sim_contact));
+    AK_Sim__Array_Init(&Result.Manifolds, &Arena->BaseAllocator, sizeof(ak_sim__contact_manifold));
+    return Result;
 }
 
-static void AK_Sim__Compound_Collision(ak_sim_collision_collector* Collector, 
-                                       ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
-                                       ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+AKSIMDEF void AK_Sim_Add_Contact(ak_sim_collision_collector* Collector, const ak_sim_contact* Contact) {
+    ak_sim__contact_manifold* Manifold = NULL;
+    if(Collector->Manifolds.Count) {
+        Manifold = (ak_sim__contact_manifold*)AK_Sim__Array_Get(&Collector->Manifolds, Collector->Manifolds.Count-1);
+        if(Manifold->PairIndex != Collector->PairIndex) Manifold = NULL;
+    }
+
+    if(!Manifold) {
+        ak_sim__contact_manifold NewManifold;
+        NewManifold.PairIndex = Collector->PairIndex;
+        NewManifold.FirstContact = Collector->Contacts.Count;
+        NewManifold.ContactCount = 0;
+        AK_Sim__Array_Add(&Collector->Manifolds, &NewManifold);
+        Manifold = (ak_sim__contact_manifold*)AK_Sim__Array_Get(&Collector->Manifolds, Collector->Manifolds.Count-1);
+    }
+
+    AK_Sim__Array_Add(&Collector->Contacts, Contact);
+    Manifold->ContactCount++;
 }
 
-static ak_sim_collision_func* G_CollisionFunc[AK_SIM_SHAPE_TYPE_COUNT][AK_SIM_SHAPE_TYPE_COUNT] = {
-    {AK_Sim__Convex_Collision, AK_Sim__Convex_Mesh_Collision, AK_Sim__Convex_Compound_Collision},
-    {AK_Sim__Mesh_Convex_Collision, AK_Sim__Mesh_Collision, AK_Sim__Mesh_Compound_Collision},
-    {AK_Sim__Compound_Convex_Collision, AK_Sim__Compound_Mesh_Collision, AK_Sim__Compound_Collision}
-};
+/*Hulls at or below this many vertices are scanned instead of hill climbed. The whole hull is a 
+  few cache lines and four vertices are tested per instruction, so walking adjacency won't win*/
+#define AK_SIM__SUPPORT_BRUTE_FORCE_MAX 16
 
-AKSIMDEF ak_sim_context* AK_Sim_Create_Context(const ak_sim_create_info* CreateInfo) {
-    ak_sim_allocator Allocator = CreateInfo->Allocator;
-    if(!Allocator.AllocateMemory || !Allocator.FreeMemory) {
-#ifdef AK_SIM_NO_STDLIB
-        return NULL;
-#else
-        Allocator = AK_Sim__Get_Stdio_Allocator();
-#endif
+static uint32_t AK_Sim__Support_Index_Linear(const ak_sim_v3* Vertices, uint32_t VtxCount, ak_sim_v3 Direction) {
+    uint32_t Result = 0;
+    float BestDot = AK_Sim__V3_Dot(Vertices[0], Direction);
+    uint32_t i;
+    for(i = 1; i < VtxCount; i++) {
+        float Dot = AK_Sim__V3_Dot(Vertices[i], Direction);
+        if(Dot > BestDot) {
+            BestDot = Dot;
+            Result = i;
+        }
     }
+    return Result;
+}
 
-    ak_sim_context* Result = AK_Sim__Allocate_Struct(&Allocator, ak_sim_context);
-    Result->Allocator = Allocator;
-    AK_Sim__Arena_Create(&Result->Arena, &Result->Allocator);
-    AK_Sim__Arena_Create(&Result->TempArena, &Result->Allocator);
+#ifdef AK_SIM__SSE2
+static __m128 AK_Sim__Dot4_SSE2(const ak_sim_v3* Vertices, __m128 Dx, __m128 Dy, __m128 Dz) {
+    __m128 X = _mm_loadu_ps(Vertices[0].Data);
+    __m128 Y = _mm_loadu_ps(Vertices[1].Data);
+    __m128 Z = _mm_loadu_ps(Vertices[2].Data);
+    __m128 W = _mm_loadu_ps(Vertices[3].Data);
+    _MM_TRANSPOSE4_PS(X, Y, Z, W);
+    /*Same operation order as AK_Sim__V3_Dot*/
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(X, Dx), _mm_mul_ps(Y, Dy)), _mm_mul_ps(Z, Dz));
+}
 
-    ak_sim__collision_table* CollisionTable = &Result->CollisionTable;
-    uint32_t MaxPerRow = AK_SIM_SHAPE_TYPE_COUNT;
+/*Each lane keeps the first index that reached its maximum, so reducing the lanes with ties 
+  going to the lower index picks the same vertex as the linear scan*/
+static uint32_t AK_Sim__Support_Index_SSE2(const ak_sim_v3* Vertices, uint32_t VtxCount, ak_sim_v3 Direction) {
+    if(VtxCount < 4) return AK_Sim__Support_Index_Linear(Vertices, VtxCount, Direction);
+
+    __m128 Dx = _mm_set1_ps(Direction.Data[0]);
+    __m128 Dy = _mm_set1_ps(Direction.Data[1]);
+    __m128 Dz = _mm_set1_ps(Direction.Data[2]);
+
+    __m128i Index = _mm_set_epi32(3, 2, 1, 0);
+    __m128i BestIndex = Index;
+    __m128 BestDot = AK_Sim__Dot4_SSE2(Vertices, Dx, Dy, Dz);
 
     uint32_t i;
-    for(i = 0; i < CreateInfo->ShapeRegistrationCount; i++) {
-        ak_sim_shape_registration* Registration = CreateInfo->ShapeRegistrations+i;
-        AK_SIM_ASSERT(Registration->Type < AK_SIM_SHAPE_TYPE_COUNT);
-        MaxPerRow = AK_Sim__Max(Registration->Type, MaxPerRow);
+    for(i = 4; i+4 <= VtxCount; i += 4) {
+        Index = _mm_add_epi32(Index, _mm_set1_epi32(4));
+        __m128 Dot = AK_Sim__Dot4_SSE2(Vertices+i, Dx, Dy, Dz);
+        __m128 Mask = _mm_cmpgt_ps(Dot, BestDot);
+        __m128i IndexMask = _mm_castps_si128(Mask);
+        BestDot = _mm_or_ps(_mm_and_ps(Mask, Dot), _mm_andnot_ps(Mask, BestDot));
+        BestIndex = _mm_or_si128(_mm_and_si128(IndexMask, Index), _mm_andnot_si128(IndexMask, BestIndex));
     }
 
-    CollisionTable->MaxPerRow = MaxPerRow;
-    CollisionTable->CollisionFuncs = AK_Sim__Arena_Push_Array(&Result->Arena, MaxPerRow*MaxPerRow, ak_sim_collision_func*);
-    AK_SIM_MEMSET(CollisionTable->CollisionFuncs, 0, MaxPerRow*MaxPerRow*sizeof(ak_sim_collision_func*));
+    float Dots[4];
+    uint32_t Indices[4];
+    _mm_storeu_ps(Dots, BestDot);
+    _mm_storeu_si128((__m128i*)Indices, BestIndex);
+
+    uint32_t Result = Indices[0];
+    float Best = Dots[0];
+    uint32_t Lane;
+    for(Lane = 1; Lane < 4; Lane++) {
+        if(Dots[Lane] > Best || (Dots[Lane] == Best && Indices[Lane] < Result)) {
+            Best = Dots[Lane];
+            Result = Indices[Lane];
+        }
+    }
 
-    /*First register default shape types*/
-    for(i = 0; i < AK_SIM_SHAPE_TYPE_COUNT; i++) {
-        uint32_t j;
-        for(j = 0; j < AK_SIM_SHAPE_TYPE_COUNT; j++) {
-            AK_Sim__Register_Collision(CollisionTable, i, j, G_CollisionFunc[i][j]);
+    for(; i < VtxCount; i++) {
+        float Dot = AK_Sim__V3_Dot(Vertices[i], Direction);
+        if(Dot > Best) {
+            Best = Dot;
+            Result = i;
         }
     }
+    return Result;
+}
+#endif
 
-    /* Then register custom shapes */
-    for(i = 0; i < CreateInfo->ShapeRegistrationCount; i++) {
-        ak_sim_shape_registration* Registration = CreateInfo->ShapeRegistrations+i;
-        uint32_t j;
-        for(j = 0; j < Registration->CollisionFuncCount; j++) {
-            ak_sim_collision_registration* Collision = Registration->Collisions + j;
-            AK_Sim__Register_Collision(CollisionTable, Registration->Type, Collision->Type, Collision->CollisionFunc);
+/*Walks to the neighbor furthest along the direction until none improves. On a convex hull the 
+  local maximum is the global one, and starting from last step's vertex it's usually a step or two. 
+  Ties move to the lower index, so welded copies that only list their lowest copy can step onto it*/
+static uint32_t AK_Sim__Support_Index_Hill_Climb(const ak_sim_v3* Vertices, const uint32_t* AdjacencyOffsets, const uint32_t* AdjacentVertices, 
+                                                 ak_sim_v3 Direction, uint32_t StartIndex) {
+    uint32_t Result = StartIndex;
+    float BestDot = AK_Sim__V3_Dot(Vertices[Result], Direction);
+    for(;;) {
+        uint32_t Next = Result;
+        uint32_t i;
+        for(i = AdjacencyOffsets[Result]; i < AdjacencyOffsets[Result+1]; i++) {
+            uint32_t Neighbor = AdjacentVertices[i];
+            float Dot = AK_Sim__V3_Dot(Vertices[Neighbor], Direction);
+            if(Dot > BestDot || (Dot == BestDot && Neighbor < Next)) {
+                BestDot = Dot;
+                Next = Neighbor;
+            }
         }
+        if(Next == Result) break;
+        Result = Next;
     }
+    return Result;
+}
 
-    AK_Sim__Pool_Init_With_Size(&Result->BodyPool, &Result->Allocator, 512, sizeof(ak_sim_body));
+/*Spheres and capsules are a point or segment core plus a radius, so every convex type shares 
+  one support path. The proxy points into itself for those cores, so don't copy it*/
+typedef struct {
+    const ak_sim_v3*    Vertices;
+    const uint32_t*     AdjacencyOffsets;
+    const uint32_t*     AdjacentVertices;
+    const ak_sim_plane* Planes;
+    uint32_t            VtxCount;
+    uint32_t            PlaneCount;
+    float               Radius;
+    ak_sim_m4x3         Transform;
+    ak_sim_v3           Scale;
+    ak_sim_v3           CoreVertices[2];
+
+    /*User convexes answer support queries through their vtable instead of the vertices*/
+    const ak_sim_convex_vtable* VTable;
+    const void*                 UserData;
+} ak_sim__convex_proxy;
+
+static int AK_Sim__Convex_Proxy_Init(ak_sim__convex_proxy* Proxy, const ak_sim_convex* Convex, const ak_sim_m4x3* Transform, ak_sim_v3 Scale) {
+    AK_SIM_MEMSET(Proxy, 0, sizeof(ak_sim__convex_proxy));
+    Proxy->Transform = *Transform;
+    Proxy->Scale = Scale;
+
+    switch(Convex->Type) {
+        case AK_SIM_CONVEX_TYPE_SPHERE: {
+            Proxy->CoreVertices[0] = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+            Proxy->Vertices = Proxy->CoreVertices;
+            Proxy->VtxCount = 1;
+            Proxy->Radius = Convex->Internal.Sphere.Radius*AK_Sim__V3_Max_Component(Scale);
+        } break;
+
+        case AK_SIM_CONVEX_TYPE_CAPSULE: {
+            const ak_sim_capsule* Capsule = &Convex->Internal.Capsule;
+            Proxy->CoreVertices[0] = AK_Sim_V3(0.0f, Capsule->HalfHeight, 0.0f);
+            Proxy->CoreVertices[1] = AK_Sim_V3(0.0f, -Capsule->HalfHeight, 0.0f);
+            Proxy->Vertices = Proxy->CoreVertices;
+            Proxy->VtxCount = 2;
+            Proxy->Radius = Capsule->Radius*AK_Sim__Max(Scale.Data[0], Scale.Data[2]);
+        } break;
+
+        case AK_SIM_CONVEX_TYPE_HULL: {
+            const ak_sim_hull* Hull = Convex->Internal.Hull.Hull;
+            Proxy->Vertices = Hull->Vertices;
+            Proxy->VtxCount = Hull->VtxCount;
+            Proxy->AdjacencyOffsets = Hull->AdjacencyOffsets;
+            Proxy->AdjacentVertices = Hull->AdjacentVertices;
+            Proxy->Planes = Hull->Planes;
+            Proxy->PlaneCount = Hull->Planes ? Hull->FaceCount : 0;
+        } break;
+
+        default: {
+            const ak_sim_user_convex* User = &Convex->Internal.User;
+            if(!User->VTable || !User->VTable->Support) return 0;
+            Proxy->VTable = User->VTable;
+            Proxy->UserData = User->UserData;
+            Proxy->Vertices = Proxy->CoreVertices;
+            Proxy->VtxCount = 1;
+        } break;
+    }
 
+    return Proxy->VtxCount != 0;
+}
 
-    return Result;
+/*User supports have no vertex indices, so the point's bits stand in for one. GJK only compares 
+  them to spot repeated support points*/
+static uint32_t AK_Sim__Hash_Support_Point(ak_sim_v3 V) {
+    uint32_t Bits[3];
+    AK_SIM_MEMCPY(Bits, V.Data, sizeof(Bits));
+    return AK_Sim__Hash_U64(((uint64_t)Bits[0] << 32) | Bits[1]) ^ AK_Sim__Hash_U64(Bits[2]);
 }
 
-AKSIMDEF void AK_Sim_Delete_Context(ak_sim_context* Context) {
-    if(Context) {
-        ak_sim_allocator* Allocator = &Context->Allocator;
-        AK_Sim__Pool_Delete(&Context->BodyPool);
-        AK_Sim__Arena_Delete(&Context->TempArena);
-        AK_Sim__Arena_Delete(&Context->Arena);
-        AK_Sim__Free_Memory(Allocator, Context);
+static uint32_t AK_Sim__Convex_Proxy_Support_Index(const ak_sim__convex_proxy* Proxy, ak_sim_v3 LocalDirection, uint32_t StartIndex) {
+    if(Proxy->AdjacencyOffsets && Proxy->VtxCount > AK_SIM__SUPPORT_BRUTE_FORCE_MAX) {
+        if(StartIndex >= Proxy->VtxCount) StartIndex = 0;
+        return AK_Sim__Support_Index_Hill_Climb(Proxy->Vertices, Proxy->AdjacencyOffsets, Proxy->AdjacentVertices, LocalDirection, StartIndex);
     }
+
+#ifdef AK_SIM__SSE2
+    return AK_Sim__Support_Index_SSE2(Proxy->Vertices, Proxy->VtxCount, LocalDirection);
+#else
+    return AK_Sim__Support_Index_Linear(Proxy->Vertices, Proxy->VtxCount, LocalDirection);
+#endif
 }
 
-static uint32_t AK_Sim__Hash_U64(uint64_t x) {
-    x ^= x >> 32;
-	x *= 0xd6e8feb86659fd93;
-	x ^= x >> 32;
-	x *= 0xd6e8feb86659fd93;
-	x ^= x >> 32;
-	return (uint32_t)x;
+static ak_sim_v3 AK_Sim__Convex_Proxy_Vertex(const ak_sim__convex_proxy* Proxy, uint32_t Index) {
+    return AK_Sim__M4x3_Transform_Point(&Proxy->Transform, AK_Sim__V3_Mul(Proxy->Vertices[Index], Proxy->Scale));
 }
 
-static uint32_t AK_Sim__Body_Pair_Hash(const void* Key) {
-    const ak_sim__body_id_pair* Pair = (const ak_sim__body_id_pair*)Key;
-    return AK_Sim__Hash_U64((uint64_t)Pair->AID | ((uint64_t)Pair->BID << 32));
+/*World space support point of the core. Index holds the vertex to start searching from and 
+  receives the support vertex*/
+static ak_sim_v3 AK_Sim__Convex_Proxy_Support(const ak_sim__convex_proxy* Proxy, ak_sim_v3 Direction, uint32_t* Index) {
+    const ak_sim_m4x3* Transform = &Proxy->Transform;
+    ak_sim_v3 LocalDirection = AK_Sim_V3(AK_Sim__V3_Dot(Transform->Cols[0], Direction), 
+                                         AK_Sim__V3_Dot(Transform->Cols[1], Direction), 
+                                         AK_Sim__V3_Dot(Transform->Cols[2], Direction));
+    if(Proxy->VTable) {
+        ak_sim_v3 P = Proxy->VTable->Support(Proxy->UserData, AK_Sim__V3_Mul(LocalDirection, Proxy->Scale));
+        *Index = AK_Sim__Hash_Support_Point(P);
+        return AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(P, Proxy->Scale));
+    }
+
+    *Index = AK_Sim__Convex_Proxy_Support_Index(Proxy, AK_Sim__V3_Mul(LocalDirection, Proxy->Scale), *Index);
+    return AK_Sim__Convex_Proxy_Vertex(Proxy, *Index);
 }
 
-static int AK_Sim__Body_Pair_Compare(const void* KeyA, const void* KeyB) {
-    const ak_sim__body_id_pair* A = (const ak_sim__body_id_pair*)KeyA;
-    const ak_sim__body_id_pair* B = (const ak_sim__body_id_pair*)KeyB;
-    return A->AID == B->AID && A->BID == B->BID;
+/*World bounds of the core from six support queries, which is exact for any convex*/
+static ak_sim__aabb AK_Sim__Convex_Proxy_AABB(const ak_sim__convex_proxy* Proxy) {
+    ak_sim__aabb Result = AK_Sim__AABB_Empty();
+    uint32_t SupportIndex = 0;
+    uint32_t i;
+    for(i = 0; i < 6; i++) {
+        ak_sim_v3 Direction = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+        Direction.Data[i/2] = (i & 1) ? -1.0f : 1.0f;
+        AK_Sim__AABB_Add_Point(&Result, AK_Sim__Convex_Proxy_Support(Proxy, Direction, &SupportIndex));
+    }
+    return Result;
 }
 
+static void AK_Sim__Convex_Proxy_Plane(const ak_sim__convex_proxy* Proxy, uint32_t Index, ak_sim_v3* Normal, float* D) {
+    const ak_sim_v4* Plane = &Proxy->Planes[Index].NormalD;
+
+    /*Scaling keeps faces flat but skews their normals by the inverse scale*/
+    ak_sim_v3 ScaledNormal = AK_Sim_V3(Plane->Data[0]/Proxy->Scale.Data[0], Plane->Data[1]/Proxy->Scale.Data[1], Plane->Data[2]/Proxy->Scale.Data[2]);
+    float InvLength = 1.0f/AK_Sim__V3_Length(ScaledNormal);
+    *Normal = AK_Sim__M4x3_Mul_V3(&Proxy->Transform, AK_Sim__V3_Mul_S(ScaledNormal, InvLength));
+    *D = Plane->Data[3]*InvLength - AK_Sim__V3_Dot(*Normal, Proxy->Transform.Cols[3]);
+}
+
+static float AK_Sim__Convex_Proxy_Plane_Distance(const ak_sim__convex_proxy* Proxy, uint32_t Index, ak_sim_v3 P) {
+    ak_sim_v3 Normal;
+    float D;
+    AK_Sim__Convex_Proxy_Plane(Proxy, Index, &Normal, &D);
+    return AK_Sim__V3_Dot(Normal, P) + D;
+}
+
+/*GJK on the cores of two proxies, using the Minkowski difference A - B*/
+#define AK_SIM__GJK_MAX_ITERATIONS 32
+
 typedef struct {
-    ak_sim__set Set;
-} ak_sim__body_id_pair_set;
+    ak_sim_v3 PointA;
+    ak_sim_v3 PointB;
+    ak_sim_v3 W;
+    uint32_t  IndexA;
+    uint32_t  IndexB;
+    float     Weight;
+} ak_sim__gjk_vertex;
 
-struct ak_sim_collision_collector {
-    ak_sim__arena* Arena;
-};
+typedef struct {
+    ak_sim__gjk_vertex Vertices[4];
+    uint32_t           Count;
+} ak_sim__gjk_simplex;
 
-static ak_sim_collision_collector AK_Sim__Begin_Collision_Collector(ak_sim__arena* Arena) {
-    ak_sim_collision_collector Result;
-    AK_SIM_MEMSET(&Result, 0, sizeof(ak_sim_collision_collector));
-    Result.Arena = Arena;
+/*The sub simplex closest to the origin. A count of 4 means the origin is inside the tetrahedron*/
+typedef struct {
+    uint32_t Indices[4];
+    float    Weights[4];
+    uint32_t Count;
+} ak_sim__gjk_region;
+
+typedef struct {
+    ak_sim_v3 PointA; /*Closest points on the cores*/
+    ak_sim_v3 PointB;
+    ak_sim_v3 V;      /*PointA - PointB*/
+    float     Distance;
+    int       Overlap; /*Cores intersect, so the closest points only approximate the contact*/
+} ak_sim__gjk_result;
+
+static ak_sim__gjk_region AK_Sim__GJK_Region(uint32_t Count, uint32_t A, float WA, uint32_t B, float WB, uint32_t C, float WC) {
+    ak_sim__gjk_region Result;
+    Result.Count = Count;
+    Result.Indices[0] = A;
+    Result.Indices[1] = B;
+    Result.Indices[2] = C;
+    Result.Indices[3] = 3;
+    Result.Weights[0] = WA;
+    Result.Weights[1] = WB;
+    Result.Weights[2] = WC;
+    Result.Weights[3] = 0.0f;
     return Result;
 }
 
-static void AK_Sim__Update_Internal(ak_sim_context* Context, float DeltaTime, ak_sim__temp_arena* TempStorage) {
-    ak_sim__arena* TempArena = TempStorage->Arena;
-    
-    /*todo: Better broadphase*/
-    ak_sim__array PairArray;
-    ak_sim__set PairSet;
-    AK_Sim__Array_Init(&PairArray, &TempArena->BaseAllocator, sizeof(ak_sim__body_id_pair));
-    AK_Sim__Set_Init(&PairSet, &TempArena->BaseAllocator, sizeof(ak_sim__body_id_pair), AK_Sim__Body_Pair_Hash, AK_Sim__Body_Pair_Compare);
+static ak_sim_v3 AK_Sim__GJK_Region_Point(const ak_sim__gjk_simplex* Simplex, const ak_sim__gjk_region* Region) {
+    ak_sim_v3 Result = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    uint32_t i;
+    for(i = 0; i < Region->Count; i++) {
+        Result = AK_Sim__V3_Add(Result, AK_Sim__V3_Mul_S(Simplex->Vertices[Region->Indices[i]].W, Region->Weights[i]));
+    }
+    return Result;
+}
 
-    ak_sim__pool* BodyPool = &Context->BodyPool;
-    ak_sim__pool_iter BodyIterA = AK_Sim__Pool_Begin_Iter(BodyPool);
-    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIterA)) {
-        ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIterA);
-        ak_sim__pool_iter BodyIterB = AK_Sim__Pool_Begin_Iter(BodyPool);
-        while(AK_Sim__Pool_Iter_Is_Valid(&BodyIterB)) {
-            ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIterB);
-            if(BodyA != BodyB) {
-                ak_sim__body_id_pair Pair;
-                Pair.AID = AK_Sim__Min(BodyA->ID, BodyB->ID);
-                Pair.BID = AK_Sim__Max(BodyA->ID, BodyB->ID);
-
-                if(!AK_Sim__Set_Find(&PairSet, &Pair)) {
-                    AK_Sim__Array_Add(&PairArray, &Pair);
-                    AK_Sim__Set_Add(&PairSet, &Pair);
-                }
-            }
-        }
+static ak_sim__gjk_region AK_Sim__GJK_Solve_Segment(const ak_sim__gjk_simplex* Simplex, uint32_t A, uint32_t B) {
+    ak_sim_v3 PA = Simplex->Vertices[A].W;
+    ak_sim_v3 AB = AK_Sim__V3_Sub(Simplex->Vertices[B].W, PA);
+    float t = -AK_Sim__V3_Dot(PA, AB);
+    if(t <= 0.0f) return AK_Sim__GJK_Region(1, A, 1.0f, 0, 0.0f, 0, 0.0f);
+
+    float Denom = AK_Sim__V3_Dot(AB, AB);
+    if(t >= Denom) return AK_Sim__GJK_Region(1, B, 1.0f, 0, 0.0f, 0, 0.0f);
+
+    t /= Denom;
+    return AK_Sim__GJK_Region(2, A, 1.0f-t, B, t, 0, 0.0f);
+}
+
+/*Closest point on a triangle to the origin by Voronoi regions (Ericson, Real-Time Collision Detection 5.1.5)*/
+static ak_sim__gjk_region AK_Sim__GJK_Solve_Triangle(const ak_sim__gjk_simplex* Simplex, uint32_t A, uint32_t B, uint32_t C) {
+    ak_sim_v3 PA = Simplex->Vertices[A].W;
+    ak_sim_v3 PB = Simplex->Vertices[B].W;
+    ak_sim_v3 PC = Simplex->Vertices[C].W;
+    ak_sim_v3 AB = AK_Sim__V3_Sub(PB, PA);
+    ak_sim_v3 AC = AK_Sim__V3_Sub(PC, PA);
+
+    float d1 = -AK_Sim__V3_Dot(AB, PA);
+    float d2 = -AK_Sim__V3_Dot(AC, PA);
+    if(d1 <= 0.0f && d2 <= 0.0f) return AK_Sim__GJK_Region(1, A, 1.0f, 0, 0.0f, 0, 0.0f);
+
+    float d3 = -AK_Sim__V3_Dot(AB, PB);
+    float d4 = -AK_Sim__V3_Dot(AC, PB);
+    if(d3 >= 0.0f && d4 <= d3) return AK_Sim__GJK_Region(1, B, 1.0f, 0, 0.0f, 0, 0.0f);
+
+    float vc = d1*d4 - d3*d2;
+    if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        float v = d1 / (d1-d3);
+        return AK_Sim__GJK_Region(2, A, 1.0f-v, B, v, 0, 0.0f);
     }
 
-    ak_sim__collision_table* CollisionTable = &Context->CollisionTable;
-    ak_sim_collision_collector CollisionCollector = AK_Sim__Begin_Collision_Collector(TempArena);
+    float d5 = -AK_Sim__V3_Dot(AB, PC);
+    float d6 = -AK_Sim__V3_Dot(AC, PC);
+    if(d6 >= 0.0f && d5 <= d6) return AK_Sim__GJK_Region(1, C, 1.0f, 0, 0.0f, 0, 0.0f);
 
-    uint32_t PairIndex;
-    for(PairIndex = 0; PairIndex < PairArray.Count; PairIndex++) {
-        ak_sim__body_id_pair* Pair = (ak_sim__body_id_pair*)AK_Sim__Array_Get(&PairArray, PairIndex);
-        
-        ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(BodyPool, Pair->AID);
-        ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Get(BodyPool, Pair->BID);
+    float vb = d5*d2 - d1*d6;
+    if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        float w = d2 / (d2-d6);
+        return AK_Sim__GJK_Region(2, A, 1.0f-w, C, w, 0, 0.0f);
+    }
 
-        ak_sim_collision_func* CollisionFunc = AK_Sim__Collision_Table_Get_Func(CollisionTable, BodyA->Shape.Type, BodyB->Shape.Type);
-        if(CollisionFunc) {
-            ak_sim_m4x3 TransformA = AK_Sim__Get_Matrix_Transform(&BodyA->Transform);
-            ak_sim_m4x3 TransformB = AK_Sim__Get_Matrix_Transform(&BodyB->Transform);
+    float va = d3*d6 - d5*d4;
+    if(va <= 0.0f && (d4-d3) >= 0.0f && (d5-d6) >= 0.0f) {
+        float w = (d4-d3) / ((d4-d3) + (d5-d6));
+        return AK_Sim__GJK_Region(2, B, 1.0f-w, C, w, 0, 0.0f);
+    }
 
-            CollisionFunc(&CollisionCollector, &BodyA->Shape, &TransformA, BodyA->Scale, &BodyB->Shape, &TransformB, BodyB->Scale);
-        }
+    float Sum = va+vb+vc;
+    if(Sum <= 0.0f) {
+        /*Degenerate triangle, the closest edge is as good*/
+        ak_sim__gjk_region Result = AK_Sim__GJK_Solve_Segment(Simplex, A, B);
+        ak_sim__gjk_region Other = AK_Sim__GJK_Solve_Segment(Simplex, A, C);
+        ak_sim_v3 P = AK_Sim__GJK_Region_Point(Simplex, &Result);
+        ak_sim_v3 Q = AK_Sim__GJK_Region_Point(Simplex, &Other);
+        return AK_Sim__V3_Dot(Q, Q) < AK_Sim__V3_Dot(P, P) ? Other : Result;
     }
+
+    float Denom = 1.0f / Sum;
+    float v = vb*Denom;
+    float w = vc*Denom;
+    return AK_Sim__GJK_Region(3, A, 1.0f-v-w, B, v, C, w);
 }
 
-AKSIMDEF void AK_Sim_Update(ak_sim_context* Context, float DeltaTime) {
+/*Degenerate tetrahedra count as outside so their faces get searched instead*/
+static int AK_Sim__GJK_Origin_Outside_Face(ak_sim_v3 A, ak_sim_v3 B, ak_sim_v3 C, ak_sim_v3 D) {
+    ak_sim_v3 Normal = AK_Sim__V3_Cross(AK_Sim__V3_Sub(B, A), AK_Sim__V3_Sub(C, A));
+    float SignOrigin = -AK_Sim__V3_Dot(A, Normal);
+    float SignD = AK_Sim__V3_Dot(AK_Sim__V3_Sub(D, A), Normal);
+    return SignOrigin*SignD <= 0.0f;
+}
+
+static ak_sim__gjk_region AK_Sim__GJK_Solve_Tetrahedron(const ak_sim__gjk_simplex* Simplex) {
+    static const uint32_t Faces[4][4] = {{0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 3, 1}, {1, 2, 3, 0}};
+
+    ak_sim__gjk_region Result = AK_Sim__GJK_Region(4, 0, 0.0f, 1, 0.0f, 2, 0.0f);
+    float BestDistanceSq = 1e30f;
+    uint32_t i;
+    for(i = 0; i < 4; i++) {
+        const uint32_t* Face = Faces[i];
+        if(AK_Sim__GJK_Origin_Outside_Face(Simplex->Vertices[Face[0]].W, Simplex->Vertices[Face[1]].W, 
+                                           Simplex->Vertices[Face[2]].W, Simplex->Vertices[Face[3]].W)) {
+            ak_sim__gjk_region Region = AK_Sim__GJK_Solve_Triangle(Simplex, Face[0], Face[1], Face[2]);
+            ak_sim_v3 P = AK_Sim__GJK_Region_Point(Simplex, &Region);
+            float DistanceSq = AK_Sim__V3_Dot(P, P);
+            if(DistanceSq < BestDistanceSq) {
+                BestDistanceSq = DistanceSq;
+                Result = Region;
+            }
+        }
+    }
+    return Result;
+}
+
+static void AK_Sim__GJK_Reduce(ak_sim__gjk_simplex* Simplex, const ak_sim__gjk_region* Region) {
+    ak_sim__gjk_vertex Vertices[4];
+    AK_SIM_MEMCPY(Vertices, Simplex->Vertices, sizeof(Vertices));
+    uint32_t i;
+    for(i = 0; i < Region->Count; i++) {
+        Simplex->Vertices[i] = Vertices[Region->Indices[i]];
+        Simplex->Vertices[i].Weight = Region->Weights[i];
+    }
+    Simplex->Count = Region->Count;
+}
+
+/*Warm starts from the pair cache's separating axis and support vertices and writes them back*/
+static ak_sim__gjk_result AK_Sim__GJK(const ak_sim__convex_proxy* A, const ak_sim__convex_proxy* B, ak_sim__pair_cache* Cache) {
+    ak_sim__gjk_result Result;
+    AK_SIM_MEMSET(&Result, 0, sizeof(ak_sim__gjk_result));
+
+    uint32_t IndexA = Cache->SupportIndexA;
+    uint32_t IndexB = Cache->SupportIndexB;
+    ak_sim_v3 V = Cache->SeparatingAxis;
+    if(AK_Sim__V3_Dot(V, V) < 1e-12f) V = AK_Sim__V3_Sub(A->Transform.Cols[3], B->Transform.Cols[3]);
+    if(AK_Sim__V3_Dot(V, V) < 1e-12f) V = AK_Sim_V3(1.0f, 0.0f, 0.0f);
+
+    ak_sim__gjk_simplex Simplex;
+    Simplex.Count = 0;
+
+    uint32_t Iteration;
+    for(Iteration = 0; Iteration < AK_SIM__GJK_MAX_ITERATIONS; Iteration++) {
+        ak_sim__gjk_vertex* Vertex = Simplex.Vertices + Simplex.Count;
+        Vertex->PointA = AK_Sim__Convex_Proxy_Support(A, AK_Sim__V3_Mul_S(V, -1.0f), &IndexA);
+        Vertex->PointB = AK_Sim__Convex_Proxy_Support(B, V, &IndexB);
+        Vertex->W = AK_Sim__V3_Sub(Vertex->PointA, Vertex->PointB);
+        Vertex->IndexA = IndexA;
+        Vertex->IndexB = IndexB;
+
+        if(Simplex.Count) {
+            /*Stop when the new support point gets no closer to the origin or repeats a vertex*/
+            float VV = AK_Sim__V3_Dot(V, V);
+            if(VV - AK_Sim__V3_Dot(V, Vertex->W) <= 1e-5f*VV) break;
+
+            int Duplicate = 0;
+            uint32_t i;
+            for(i = 0; i < Simplex.Count; i++) {
+                Duplicate |= Simplex.Vertices[i].IndexA == IndexA && Simplex.Vertices[i].IndexB == IndexB;
+            }
+            if(Duplicate) break;
+        }
+
+        Simplex.Count++;
+
+        ak_sim__gjk_region Region;
+        switch(Simplex.Count) {
+            case 1: Region = AK_Sim__GJK_Region(1, 0, 1.0f, 0, 0.0f, 0, 0.0f); break;
+            case 2: Region = AK_Sim__GJK_Solve_Segment(&Simplex, 0, 1); break;
+            case 3: Region = AK_Sim__GJK_Solve_Triangle(&Simplex, 0, 1, 2); break;
+            default: Region = AK_Sim__GJK_Solve_Tetrahedron(&Simplex); break;
+        }
+
+        if(Region.Count == 4) {
+            Result.Overlap = 1;
+            break;
+        }
+
+        /*The region indexes the simplex from before it's compacted*/
+        V = AK_Sim__GJK_Region_Point(&Simplex, &Region);
+        AK_Sim__GJK_Reduce(&Simplex, &Region);
+
+        Result.PointA = Result.PointB = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+        uint32_t i;
+        for(i = 0; i < Simplex.Count; i++) {
+            Result.PointA = AK_Sim__V3_Add(Result.PointA, AK_Sim__V3_Mul_S(Simplex.Vertices[i].PointA, Simplex.Vertices[i].Weight));
+            Result.PointB = AK_Sim__V3_Add(Result.PointB, AK_Sim__V3_Mul_S(Simplex.Vertices[i].PointB, Simplex.Vertices[i].Weight));
+        }
+
+        if(AK_Sim__V3_Dot(V, V) < 1e-12f) {
+            Result.Overlap = 1;
+            break;
+        }
+    }
+
+    Result.V = V;
+    Result.Distance = Result.Overlap ? 0.0f : AK_Sim__V3_Length(V);
+
+    if(!Result.Overlap) Cache->SeparatingAxis = V;
+    Cache->SupportIndexA = IndexA;
+    Cache->SupportIndexB = IndexB;
+    return Result;
+}
+
+/*Contacts are generated for surfaces closer than this so the solver can stop bodies before 
+  they touch instead of after they've already sunk in*/
+#define AK_SIM__SPECULATIVE_DISTANCE 0.02f
+#define AK_SIM__CONTACT_TOLERANCE 0.001f
+#define AK_SIM__MAX_CONTACT_CANDIDATES 64
+
+static void AK_Sim__Emit_Contact(ak_sim_collision_collector* Collector, ak_sim_v3 Position, ak_sim_v3 Normal, float Depth) {
+    ak_sim_contact Contact;
+    Contact.Position = Position;
+    Contact.Normal = Normal;
+    Contact.Depth = Depth;
+    AK_Sim_Add_Contact(Collector, &Contact);
+}
+
+/*Single contact between the closest points of the cores, pushed out by the radii*/
+static ak_sim_contact AK_Sim__Get_GJK_Contact(const ak_sim__gjk_result* GJK, const ak_sim__convex_proxy* A, const ak_sim__convex_proxy* B) {
+    ak_sim_v3 Normal;
+    if(!GJK->Overlap && GJK->Distance > 1e-6f) {
+        Normal = AK_Sim__V3_Mul_S(GJK->V, -1.0f/GJK->Distance);
+    } else {
+        Normal = AK_Sim__V3_Sub(B->Transform.Cols[3], A->Transform.Cols[3]);
+        float Length = AK_Sim__V3_Length(Normal);
+        Normal = Length > 1e-6f ? AK_Sim__V3_Mul_S(Normal, 1.0f/Length) : AK_Sim_V3(0.0f, 1.0f, 0.0f);
+    }
+
+    ak_sim_v3 SurfaceA = AK_Sim__V3_Add(GJK->PointA, AK_Sim__V3_Mul_S(Normal, A->Radius));
+    ak_sim_v3 SurfaceB = AK_Sim__V3_Sub(GJK->PointB, AK_Sim__V3_Mul_S(Normal, B->Radius));
+
+    ak_sim_contact Result;
+    Result.Position = AK_Sim__V3_Lerp(SurfaceA, 0.5f, SurfaceB);
+    Result.Normal = Normal;
+    Result.Depth = A->Radius + B->Radius - GJK->Distance;
+    return Result;
+}
+
+static void AK_Sim__Emit_GJK_Contact(ak_sim_collision_collector* Collector, const ak_sim__gjk_result* GJK, 
+                                     const ak_sim__convex_proxy* A, const ak_sim__convex_proxy* B) {
+    ak_sim_contact Contact = AK_Sim__Get_GJK_Contact(GJK, A, B);
+    AK_Sim_Add_Contact(Collector, &Contact);
+}
+
+typedef struct {
+    uint32_t  PlaneIndex;
+    ak_sim_v3 Normal;
+    float     D;
+    float     Separation;
+} ak_sim__face_query;
+
+/*Largest separation of Other's surface from any of Hull's face planes*/
+static ak_sim__face_query AK_Sim__Face_Query(const ak_sim__convex_proxy* Hull, const ak_sim__convex_proxy* Other) {
+    ak_sim__face_query Result;
+    AK_SIM_MEMSET(&Result, 0, sizeof(ak_sim__face_query));
+    Result.Separation = -1e30f;
+
+    uint32_t SupportIndex = 0;
+    uint32_t i;
+    for(i = 0; i < Hull->PlaneCount; i++) {
+        ak_sim_v3 Normal;
+        float D;
+        AK_Sim__Convex_Proxy_Plane(Hull, i, &Normal, &D);
+        ak_sim_v3 P = AK_Sim__Convex_Proxy_Support(Other, AK_Sim__V3_Mul_S(Normal, -1.0f), &SupportIndex);
+        float Separation = AK_Sim__V3_Dot(Normal, P) + D - Other->Radius;
+        if(Separation > Result.Separation) {
+            Result.PlaneIndex = i;
+            Result.Normal = Normal;
+            Result.D = D;
+            Result.Separation = Separation;
+        }
+    }
+    return Result;
+}
+
+/*Orders points around a convex polygon without trig. Increases monotonically with the angle 
+  of (x, y) over [0, 4)*/
+static float AK_Sim__Diamond_Angle(float x, float y) {
+    if(y >= 0.0f) return x >= 0.0f ? y/(x+y) : 1.0f - x/(-x+y);
+    return x < 0.0f ? 2.0f - y/(-x-y) : 3.0f + x/(x-y);
+}
+
+/*The incident feature to clip. Rounded cores are their point or segment, hulls use the face 
+  most opposed to the reference normal, wound around its center*/
+static uint32_t AK_Sim__Get_Incident_Polygon(const ak_sim__convex_proxy* Incident, ak_sim_v3 ReferenceNormal, ak_sim_v3* Polygon) {
+    uint32_t Count = 0;
+    uint32_t i;
+
+    /*User convexes have no faces, so their feature is made of the support points around the 
+      deepest one that sit as deep, which finds the corners of a face lying on the reference*/
+    if(Incident->VTable) {
+        ak_sim_v3 Down = AK_Sim__V3_Mul_S(ReferenceNormal, -1.0f);
+        ak_sim_v3 Axis = AK_Sim__Abs(ReferenceNormal.Data[0]) < 0.57f ? AK_Sim_V3(1.0f, 0.0f, 0.0f) : AK_Sim_V3(0.0f, 1.0f, 0.0f);
+        ak_sim_v3 TangentU = AK_Sim__V3_Normalize(AK_Sim__V3_Cross(ReferenceNormal, Axis));
+        ak_sim_v3 TangentV = AK_Sim__V3_Cross(ReferenceNormal, TangentU);
+
+        uint32_t SupportIndex = 0;
+        ak_sim_v3 Deepest = AK_Sim__Convex_Proxy_Support(Incident, Down, &SupportIndex);
+        float DeepestDistance = AK_Sim__V3_Dot(ReferenceNormal, Deepest);
+        for(i = 0; i < 4; i++) {
+            ak_sim_v3 Tilt = AK_Sim__V3_Add(AK_Sim__V3_Mul_S(TangentU, (i == 0 || i == 3) ? 1.0f : -1.0f), 
+                                            AK_Sim__V3_Mul_S(TangentV, (i < 2) ? 1.0f : -1.0f));
+            ak_sim_v3 P = AK_Sim__Convex_Proxy_Support(Incident, AK_Sim__V3_Add(Down, Tilt), &SupportIndex);
+            if(AK_Sim__V3_Dot(ReferenceNormal, P) - DeepestDistance > AK_SIM__CONTACT_TOLERANCE) continue;
+
+            int Duplicate = 0;
+            uint32_t j;
+            for(j = 0; j < Count; j++) {
+                ak_sim_v3 Delta = AK_Sim__V3_Sub(P, Polygon[j]);
+                Duplicate |= AK_Sim__V3_Dot(Delta, Delta) < 1e-8f;
+            }
+            if(!Duplicate) Polygon[Count++] = P;
+        }
+        if(!Count) Polygon[Count++] = Deepest;
+        return Count;
+    }
+
+    if(!Incident->PlaneCount) {
+        for(i = 0; i < Incident->VtxCount; i++) {
+            Polygon[Count++] = AK_Sim__Convex_Proxy_Vertex(Incident, i);
+        }
+        return Count;
+    }
+
+    ak_sim_v3 FaceNormal = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    float FaceD = 0.0f;
+    float MinCos = 1e30f;
+    for(i = 0; i < Incident->PlaneCount; i++) {
+        ak_sim_v3 Normal;
+        float D;
+        AK_Sim__Convex_Proxy_Plane(Incident, i, &Normal, &D);
+        float Cos = AK_Sim__V3_Dot(Normal, ReferenceNormal);
+        if(Cos < MinCos) {
+            MinCos = Cos;
+            FaceNormal = Normal;
+            FaceD = D;
+        }
+    }
+
+    ak_sim_v3 Center = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    for(i = 0; i < Incident->VtxCount && Count < AK_SIM__MAX_CONTACT_CANDIDATES; i++) {
+        ak_sim_v3 P = AK_Sim__Convex_Proxy_Vertex(Incident, i);
+        if(AK_Sim__Abs(AK_Sim__V3_Dot(FaceNormal, P) + FaceD) <= AK_SIM__CONTACT_TOLERANCE) {
+            Polygon[Count++] = P;
+            Center = AK_Sim__V3_Add(Center, P);
+        }
+    }
+    if(Count < 3) return Count;
+    Center = AK_Sim__V3_Mul_S(Center, 1.0f/(float)Count);
+
+    ak_sim_v3 U = AK_Sim__V3_Sub(Polygon[0], Center);
+    ak_sim_v3 V = AK_Sim__V3_Cross(FaceNormal, U);
+    float Angles[AK_SIM__MAX_CONTACT_CANDIDATES];
+    for(i = 0; i < Count; i++) {
+        ak_sim_v3 Delta = AK_Sim__V3_Sub(Polygon[i], Center);
+        Angles[i] = AK_Sim__Diamond_Angle(AK_Sim__V3_Dot(Delta, U), AK_Sim__V3_Dot(Delta, V));
+    }
+
+    for(i = 1; i < Count; i++) {
+        ak_sim_v3 P = Polygon[i];
+        float Angle = Angles[i];
+        uint32_t j = i;
+        while(j > 0 && Angles[j-1] > Angle) {
+            Polygon[j] = Polygon[j-1];
+            Angles[j] = Angles[j-1];
+            j--;
+        }
+        Polygon[j] = P;
+        Angles[j] = Angle;
+    }
+    return Count;
+}
+
+/*Sutherland-Hodgman clip of the incident polygon against every reference hull plane except 
+  the reference face, leaving the part over the reference face*/
+static uint32_t AK_Sim__Clip_Polygon(const ak_sim__convex_proxy* Reference, uint32_t ReferencePlane, ak_sim_v3* Polygon, uint32_t Count) {
+    ak_sim_v3 Clipped[AK_SIM__MAX_CONTACT_CANDIDATES];
+    uint32_t PlaneIndex;
+    for(PlaneIndex = 0; PlaneIndex < Reference->PlaneCount && Count; PlaneIndex++) {
+        if(PlaneIndex == ReferencePlane) continue;
+
+        ak_sim_v3 Normal;
+        float D;
+        AK_Sim__Convex_Proxy_Plane(Reference, PlaneIndex, &Normal, &D);
+
+        uint32_t ClippedCount = 0;
+        uint32_t i;
+        for(i = 0; i < Count; i++) {
+            ak_sim_v3 P = Polygon[i];
+            ak_sim_v3 Q = Polygon[(i+1) % Count];
+            float DistanceP = AK_Sim__V3_Dot(Normal, P) + D;
+            float DistanceQ = AK_Sim__V3_Dot(Normal, Q) + D;
+
+            if(DistanceP <= 0.0f && ClippedCount < AK_SIM__MAX_CONTACT_CANDIDATES) {
+                Clipped[ClippedCount++] = P;
+            }
+
+            if((DistanceP < 0.0f && DistanceQ > 0.0f) || (DistanceP > 0.0f && DistanceQ < 0.0f)) {
+                if(ClippedCount < AK_SIM__MAX_CONTACT_CANDIDATES) {
+                    Clipped[ClippedCount++] = AK_Sim__V3_Lerp(P, DistanceP/(DistanceP-DistanceQ), Q);
+                }
+            }
+        }
+
+        AK_SIM_MEMCPY(Polygon, Clipped, ClippedCount*sizeof(ak_sim_v3));
+        Count = ClippedCount;
+    }
+    return Count;
+}
+
+/*Keeps the deepest point, the point furthest from it, the point making the largest triangle 
+  with those two and the point furthest across from that triangle*/
+static uint32_t AK_Sim__Reduce_Contacts(const ak_sim_v3* Positions, const float* Depths, uint32_t Count, ak_sim_v3 Normal, uint32_t* Result) {
+    uint32_t i;
+    if(Count <= 4) {
+        for(i = 0; i < Count; i++) Result[i] = i;
+        return Count;
+    }
+
+    uint32_t Index0 = 0;
+    for(i = 1; i < Count; i++) {
+        if(Depths[i] > Depths[Index0]) Index0 = i;
+    }
+
+    uint32_t Index1 = Index0;
+    float BestDistanceSq = 0.0f;
+    for(i = 0; i < Count; i++) {
+        ak_sim_v3 Delta = AK_Sim__V3_Sub(Positions[i], Positions[Index0]);
+        float DistanceSq = AK_Sim__V3_Dot(Delta, Delta);
+        if(DistanceSq > BestDistanceSq) {
+            BestDistanceSq = DistanceSq;
+            Index1 = i;
+        }
+    }
+
+    ak_sim_v3 Edge = AK_Sim__V3_Sub(Positions[Index1], Positions[Index0]);
+    uint32_t Index2 = Index0;
+    float BestArea = 0.0f;
+    for(i = 0; i < Count; i++) {
+        float Area = AK_Sim__V3_Dot(AK_Sim__V3_Cross(Edge, AK_Sim__V3_Sub(Positions[i], Positions[Index0])), Normal);
+        if(AK_Sim__Abs(Area) > AK_Sim__Abs(BestArea)) {
+            BestArea = Area;
+            Index2 = i;
+        }
+    }
+
+    uint32_t Index3 = Index0;
+    float BestOppositeArea = 0.0f;
+    for(i = 0; i < Count; i++) {
+        float Area = AK_Sim__V3_Dot(AK_Sim__V3_Cross(Edge, AK_Sim__V3_Sub(Positions[i], Positions[Index0])), Normal);
+        float OppositeArea = BestArea < 0.0f ? Area : -Area;
+        if(OppositeArea > BestOppositeArea) {
+            BestOppositeArea = OppositeArea;
+            Index3 = i;
+        }
+    }
+
+    uint32_t ResultCount = 0;
+    Result[ResultCount++] = Index0;
+    if(Index1 != Index0) Result[ResultCount++] = Index1;
+    if(Index2 != Index0) Result[ResultCount++] = Index2;
+    if(Index3 != Index0) Result[ResultCount++] = Index3;
+    return ResultCount;
+}
+
+static void AK_Sim__Add_Contact_Candidate(ak_sim_v3* Positions, float* Depths, uint32_t* Count, ak_sim_v3 Position, float Depth) {
+    uint32_t i;
+    for(i = 0; i < *Count; i++) {
+        ak_sim_v3 Delta = AK_Sim__V3_Sub(Positions[i], Position);
+        if(AK_Sim__V3_Dot(Delta, Delta) < AK_SIM__CONTACT_TOLERANCE*AK_SIM__CONTACT_TOLERANCE) return;
+    }
+    if(*Count < AK_SIM__MAX_CONTACT_CANDIDATES) {
+        Positions[*Count] = Position;
+        Depths[*Count] = Depth;
+        (*Count)++;
+    }
+}
+
+/*Spheres and capsules against each other get the single GJK contact. When a hull is involved 
+  the face with the least penetration becomes the reference face and the contacts are the 
+  incident face clipped to it, reduced to four points. Edge axes 
+  aren't tested, so separated edge cases fall back to GJK and penetrating ones use the 
+  shallowest face, which overestimates depth but still pushes the right way*/
+static void AK_Sim__Collide_Convex_Proxies(ak_sim_collision_collector* Collector, const ak_sim__convex_proxy* A, const ak_sim__convex_proxy* B) {
+    ak_sim__pair_cache LocalCache;
+    ak_sim__pair_cache* Cache = Collector->Cache;
+    if(!Cache) {
+        AK_SIM_MEMSET(&LocalCache, 0, sizeof(ak_sim__pair_cache));
+        Cache = &LocalCache;
+    }
+
+    ak_sim__gjk_result GJK = AK_Sim__GJK(A, B, Cache);
+    float Radius = A->Radius + B->Radius;
+    if(!GJK.Overlap && GJK.Distance > Radius + AK_SIM__SPECULATIVE_DISTANCE) return;
+
+    if(!A->PlaneCount && !B->PlaneCount) {
+        AK_Sim__Emit_GJK_Contact(Collector, &GJK, A, B);
+        return;
+    }
+
+    ak_sim__face_query FaceA = AK_Sim__Face_Query(A, B);
+    ak_sim__face_query FaceB = AK_Sim__Face_Query(B, A);
+    if(FaceA.Separation > AK_SIM__SPECULATIVE_DISTANCE || FaceB.Separation > AK_SIM__SPECULATIVE_DISTANCE) return;
+
+    float FaceSeparation = AK_Sim__Max(FaceA.Separation, FaceB.Separation);
+    if(!GJK.Overlap && GJK.Distance - Radius > FaceSeparation + AK_SIM__CONTACT_TOLERANCE) {
+        AK_Sim__Emit_GJK_Contact(Collector, &GJK, A, B);
+        return;
+    }
+
+    /*Prefer A's face unless B's is clearly better, so the reference doesn't flicker between nearly parallel faces*/
+    const ak_sim__convex_proxy* Reference = A;
+    const ak_sim__convex_proxy* Incident = B;
+    const ak_sim__face_query* Face = &FaceA;
+    if(FaceB.Separation > 0.98f*FaceA.Separation + AK_SIM__CONTACT_TOLERANCE) {
+        Reference = B;
+        Incident = A;
+        Face = &FaceB;
+    }
+    ak_sim_v3 N = Face->Normal;
+
+    ak_sim_v3 Polygon[AK_SIM__MAX_CONTACT_CANDIDATES];
+    uint32_t PolygonCount = AK_Sim__Get_Incident_Polygon(Incident, N, Polygon);
+    PolygonCount = AK_Sim__Clip_Polygon(Reference, Face->PlaneIndex, Polygon, PolygonCount);
+
+    ak_sim_v3 Positions[AK_SIM__MAX_CONTACT_CANDIDATES];
+    float Depths[AK_SIM__MAX_CONTACT_CANDIDATES];
+    uint32_t CandidateCount = 0;
+
+    uint32_t i;
+    for(i = 0; i < PolygonCount; i++) {
+        ak_sim_v3 P = Polygon[i];
+        float PlaneDistance = AK_Sim__V3_Dot(N, P) + Face->D;
+        float Separation = PlaneDistance - Incident->Radius;
+        if(Separation > AK_SIM__SPECULATIVE_DISTANCE) continue;
+
+        ak_sim_v3 OnPlane = AK_Sim__V3_Sub(P, AK_Sim__V3_Mul_S(N, PlaneDistance));
+        ak_sim_v3 Surface = AK_Sim__V3_Sub(P, AK_Sim__V3_Mul_S(N, Incident->Radius));
+        AK_Sim__Add_Contact_Candidate(Positions, Depths, &CandidateCount, AK_Sim__V3_Lerp(OnPlane, 0.5f, Surface), -Separation);
+    }
+
+    ak_sim_v3 Normal = Reference == A ? N : AK_Sim__V3_Mul_S(N, -1.0f);
+    if(!CandidateCount) {
+        if(!GJK.Overlap) {
+            AK_Sim__Emit_GJK_Contact(Collector, &GJK, A, B);
+        } else {
+            uint32_t SupportIndex = 0;
+            ak_sim_v3 P = AK_Sim__Convex_Proxy_Support(Incident, AK_Sim__V3_Mul_S(N, -1.0f), &SupportIndex);
+            P = AK_Sim__V3_Sub(P, AK_Sim__V3_Mul_S(N, Incident->Radius + 0.5f*Face->Separation));
+            AK_Sim__Emit_Contact(Collector, P, Normal, -Face->Separation);
+        }
+        return;
+    }
+
+    uint32_t Kept[4];
+    uint32_t KeptCount = AK_Sim__Reduce_Contacts(Positions, Depths, CandidateCount, N, Kept);
+    for(i = 0; i < KeptCount; i++) {
+        AK_Sim__Emit_Contact(Collector, Positions[Kept[i]], Normal, Depths[Kept[i]]);
+    }
+}
+
+static int AK_Sim__Hull_Vertices_Share_Edge(const ak_sim_hull* Hull, uint32_t VertexA, uint32_t VertexB, float Tolerance) {
+    uint32_t SharedCount = 0;
+    uint32_t i;
+    for(i = 0; i < Hull->FaceCount && SharedCount < 2; i++) {
+        const ak_sim_v4* Plane = &Hull->Planes[i].NormalD;
+        ak_sim_v3 Normal = AK_Sim_V3(Plane->Data[0], Plane->Data[1], Plane->Data[2]);
+        float DistanceA = AK_Sim__V3_Dot(Normal, Hull->Vertices[VertexA]) + Plane->Data[3];
+        float DistanceB = AK_Sim__V3_Dot(Normal, Hull->Vertices[VertexB]) + Plane->Data[3];
+        SharedCount += AK_Sim__Abs(DistanceA) <= Tolerance && AK_Sim__Abs(DistanceB) <= Tolerance;
+    }
+    return SharedCount >= 2;
+}
+
+#define AK_SIM__HULL_EMPTY_SLOT 0xFFFFFFFF
+
+static int AK_Sim__V3_Equal(ak_sim_v3 A, ak_sim_v3 B) {
+    return A.Data[0] == B.Data[0] && A.Data[1] == B.Data[1] && A.Data[2] == B.Data[2];
+}
+
+/*Adding zero turns -0 into +0, so positions that compare equal hash the same*/
+static uint32_t AK_Sim__Hash_Hull_Vertex(ak_sim_v3 Vertex) {
+    float Data[3];
+    uint32_t Bits[3];
+    uint32_t i;
+    for(i = 0; i < 3; i++) Data[i] = Vertex.Data[i] + 0.0f;
+    AK_SIM_MEMCPY(Bits, Data, sizeof(Bits));
+    return AK_Sim__Hash_U64((((uint64_t)Bits[0] << 32) | Bits[1]) ^ ((uint64_t)Bits[2]*0x9e3779b97f4a7c15));
+}
+
+/*Welds every vertex to the lowest index vertex at the same position, then hashes each face's 
+  loop edges between the welded vertices so twin edges are only stored once*/
+static size_t AK_Sim__Build_Hull_Adjacency_From_Faces(ak_sim_hull* Hull, void* Buffer, size_t BufferSize) {
+    uint32_t VtxCount = Hull->VtxCount;
+    uint32_t HalfEdgeCount = 0;
+    uint32_t i, j;
+    for(i = 0; i < Hull->FaceCount; i++) {
+        AK_SIM_ASSERT(Hull->Faces[i].FirstVtx + Hull->Faces[i].VtxCount <= VtxCount);
+        HalfEdgeCount += Hull->Faces[i].VtxCount;
+    }
+    if(!HalfEdgeCount) return 0;
+
+    /*Welded copies have one neighbor and every edge adds a neighbor to both its ends*/
+    uint32_t MaxNeighborCount = VtxCount + 2*HalfEdgeCount;
+    uint32_t WeldSlotCount = AK_Sim__Ceil_Pow2_U32(2*VtxCount);
+    uint32_t EdgeSlotCount = AK_Sim__Ceil_Pow2_U32(2*HalfEdgeCount);
+    size_t Result = ((size_t)VtxCount+1 + MaxNeighborCount + VtxCount + WeldSlotCount + EdgeSlotCount + 2*(size_t)HalfEdgeCount)*sizeof(uint32_t);
+    if(!Buffer || BufferSize < Result) return Result;
+
+    uint32_t* AdjacencyOffsets = (uint32_t*)Buffer;
+    uint32_t* AdjacentVertices = AdjacencyOffsets + VtxCount+1;
+    uint32_t* Welded = AdjacentVertices + MaxNeighborCount;
+    uint32_t* WeldSlots = Welded + VtxCount;
+    uint32_t* EdgeSlots = WeldSlots + WeldSlotCount;
+    uint32_t* Edges = EdgeSlots + EdgeSlotCount;
+
+    AK_SIM_MEMSET(WeldSlots, 0xFF, WeldSlotCount*sizeof(uint32_t));
+    for(i = 0; i < VtxCount; i++) {
+        uint32_t Slot = AK_Sim__Hash_Hull_Vertex(Hull->Vertices[i]) & (WeldSlotCount-1);
+        while(WeldSlots[Slot] != AK_SIM__HULL_EMPTY_SLOT && !AK_Sim__V3_Equal(Hull->Vertices[WeldSlots[Slot]], Hull->Vertices[i])) {
+            Slot = (Slot+1) & (WeldSlotCount-1);
+        }
+        if(WeldSlots[Slot] == AK_SIM__HULL_EMPTY_SLOT) WeldSlots[Slot] = i;
+        Welded[i] = WeldSlots[Slot];
+        AdjacencyOffsets[i] = Welded[i] != i;
+    }
+
+    uint32_t EdgeCount = 0;
+    AK_SIM_MEMSET(EdgeSlots, 0xFF, EdgeSlotCount*sizeof(uint32_t));
+    for(i = 0; i < Hull->FaceCount; i++) {
+        const ak_sim_face* Face = Hull->Faces + i;
+        for(j = 0; j < Face->VtxCount; j++) {
+            uint32_t A = Welded[Face->FirstVtx + j];
+            uint32_t B = Welded[Face->FirstVtx + (j+1) % Face->VtxCount];
+            if(A == B) continue;
+            uint32_t Low = AK_Sim__Min(A, B);
+            uint32_t High = AK_Sim__Max(A, B);
+            uint32_t Slot = AK_Sim__Hash_U64(((uint64_t)Low << 32) | High) & (EdgeSlotCount-1);
+            while(EdgeSlots[Slot] != AK_SIM__HULL_EMPTY_SLOT) {
+                const uint32_t* Edge = Edges + 2*EdgeSlots[Slot];
+                if(Edge[0] == Low && Edge[1] == High) break;
+                Slot = (Slot+1) & (EdgeSlotCount-1);
+            }
+            if(EdgeSlots[Slot] != AK_SIM__HULL_EMPTY_SLOT) continue;
+
+            EdgeSlots[Slot] = EdgeCount;
+            Edges[2*EdgeCount] = Low;
+            Edges[2*EdgeCount+1] = High;
+            EdgeCount++;
+            AdjacencyOffsets[Low]++;
+            AdjacencyOffsets[High]++;
+        }
+    }
+
+    /*Turn the counts into offsets, keeping a write cursor per vertex in the weld slots*/
+    uint32_t* Cursors = WeldSlots;
+    uint32_t Count = 0;
+    for(i = 0; i < VtxCount; i++) {
+        uint32_t NeighborCount = AdjacencyOffsets[i];
+        AdjacencyOffsets[i] = Count;
+        Cursors[i] = Count;
+        Count += NeighborCount;
+    }
+    AdjacencyOffsets[VtxCount] = Count;
+
+    for(i = 0; i < VtxCount; i++) {
+        if(Welded[i] != i) AdjacentVertices[Cursors[i]++] = Welded[i];
+    }
+    for(i = 0; i < EdgeCount; i++) {
+        uint32_t Low = Edges[2*i];
+        uint32_t High = Edges[2*i+1];
+        AdjacentVertices[Cursors[Low]++] = High;
+        AdjacentVertices[Cursors[High]++] = Low;
+    }
+
+    Hull->AdjacencyOffsets = AdjacencyOffsets;
+    Hull->AdjacentVertices = AdjacentVertices;
+    return Result;
+}
+
+AKSIMDEF size_t AK_Sim_Build_Hull_Adjacency(ak_sim_hull* Hull, void* Buffer, size_t BufferSize) {
+    if(!Hull->Planes || !Hull->FaceCount || !Hull->VtxCount) return 0;
+    if(Hull->Faces) return AK_Sim__Build_Hull_Adjacency_From_Faces(Hull, Buffer, BufferSize);
+
+    float Extent = 1.0f;
+    uint32_t i, j;
+    for(i = 0; i < Hull->VtxCount; i++) {
+        for(j = 0; j < 3; j++) Extent = AK_Sim__Max(Extent, AK_Sim__Abs(Hull->Vertices[i].Data[j]));
+    }
+    float Tolerance = 1e-4f*Extent;
+
+    size_t NeighborCount = 0;
+    for(i = 0; i < Hull->VtxCount; i++) {
+        for(j = 0; j < Hull->VtxCount; j++) {
+            if(i != j && AK_Sim__Hull_Vertices_Share_Edge(Hull, i, j, Tolerance)) NeighborCount++;
+        }
+    }
+
+    size_t Result = (Hull->VtxCount+1+NeighborCount)*sizeof(uint32_t);
+    if(!Buffer || BufferSize < Result) return Result;
+
+    uint32_t* AdjacencyOffsets = (uint32_t*)Buffer;
+    uint32_t* AdjacentVertices = AdjacencyOffsets + Hull->VtxCount+1;
+    uint32_t Count = 0;
+    for(i = 0; i < Hull->VtxCount; i++) {
+        AdjacencyOffsets[i] = Count;
+        for(j = 0; j < Hull->VtxCount; j++) {
+            if(i != j && AK_Sim__Hull_Vertices_Share_Edge(Hull, i, j, Tolerance)) AdjacentVertices[Count++] = j;
+        }
+    }
+    AdjacencyOffsets[Hull->VtxCount] = Count;
+
+    Hull->AdjacencyOffsets = AdjacencyOffsets;
+    Hull->AdjacentVertices = AdjacentVertices;
+    return Result;
+}
+
+/*Triangles collide as a flat hull whose planes are the face and its three edges. The proxy 
+  points into the struct, so don't copy it*/
+typedef struct {
+    ak_sim__convex_proxy Proxy;
+    ak_sim_v3            Vertices[3];
+    ak_sim_plane         Planes[4];
+} ak_sim__triangle_proxy;
+
+static void AK_Sim__Set_Plane(ak_sim_plane* Plane, ak_sim_v3 Normal, ak_sim_v3 Point) {
+    Plane->NormalD.Data[0] = Normal.Data[0];
+    Plane->NormalD.Data[1] = Normal.Data[1];
+    Plane->NormalD.Data[2] = Normal.Data[2];
+    Plane->NormalD.Data[3] = -AK_Sim__V3_Dot(Normal, Point);
+}
+
+/*Takes world space vertices wound counter clockwise when seen from the front. Returns 0 for degenerate triangles*/
+static int AK_Sim__Triangle_Proxy_Init(ak_sim__triangle_proxy* Triangle, ak_sim_v3 A, ak_sim_v3 B, ak_sim_v3 C) {
+    ak_sim_v3 Normal = AK_Sim__V3_Cross(AK_Sim__V3_Sub(B, A), AK_Sim__V3_Sub(C, A));
+    float Length = AK_Sim__V3_Length(Normal);
+    if(Length < 1e-12f) return 0;
+    Normal = AK_Sim__V3_Mul_S(Normal, 1.0f/Length);
+
+    Triangle->Vertices[0] = A;
+    Triangle->Vertices[1] = B;
+    Triangle->Vertices[2] = C;
+    AK_Sim__Set_Plane(&Triangle->Planes[0], Normal, A);
+
+    uint32_t i;
+    for(i = 0; i < 3; i++) {
+        ak_sim_v3 P = Triangle->Vertices[i];
+        ak_sim_v3 Q = Triangle->Vertices[(i+1) % 3];
+        ak_sim_v3 EdgeNormal = AK_Sim__V3_Cross(AK_Sim__V3_Sub(Q, P), Normal);
+        AK_Sim__Set_Plane(&Triangle->Planes[i+1], AK_Sim__V3_Mul_S(EdgeNormal, 1.0f/AK_Sim__V3_Length(EdgeNormal)), P);
+    }
+
+    ak_sim__convex_proxy* Proxy = &Triangle->Proxy;
+    AK_SIM_MEMSET(Proxy, 0, sizeof(ak_sim__convex_proxy));
+    Proxy->Vertices = Triangle->Vertices;
+    Proxy->VtxCount = 3;
+    Proxy->Planes = Triangle->Planes;
+    Proxy->PlaneCount = 4;
+    Proxy->Transform.Cols[0] = AK_Sim_V3(1.0f, 0.0f, 0.0f);
+    Proxy->Transform.Cols[1] = AK_Sim_V3(0.0f, 1.0f, 0.0f);
+    Proxy->Transform.Cols[2] = AK_Sim_V3(0.0f, 0.0f, 1.0f);
+    Proxy->Transform.Cols[3] = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    Proxy->Scale = AK_Sim_V3(1.0f, 1.0f, 1.0f);
+    return 1;
+}
+
+/*Contacts from every triangle a convex touches, reduced together so the pair gets one manifold*/
+typedef struct {
+    ak_sim_v3 Positions[AK_SIM__MAX_CONTACT_CANDIDATES];
+    ak_sim_v3 Normals[AK_SIM__MAX_CONTACT_CANDIDATES];
+    float     Depths[AK_SIM__MAX_CONTACT_CANDIDATES];
+    uint32_t  Count;
+} ak_sim__triangle_contacts;
+
+static void AK_Sim__Add_Triangle_Contact(ak_sim__triangle_contacts* Contacts, ak_sim_v3 Position, ak_sim_v3 Normal, float Depth) {
+    uint32_t Count = Contacts->Count;
+    AK_Sim__Add_Contact_Candidate(Contacts->Positions, Contacts->Depths, &Contacts->Count, Position, Depth);
+    if(Contacts->Count != Count) Contacts->Normals[Count] = Normal;
+}
+
+/*Triangle normals differ across terrain, so the points are picked by their spread around the 
+  average normal and keep their own normals*/
+static void AK_Sim__Emit_Triangle_Contacts(ak_sim_collision_collector* Collector, const ak_sim__triangle_contacts* Contacts) {
+    if(!Contacts->Count) return;
+
+    ak_sim_v3 Normal = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    uint32_t i;
+    for(i = 0; i < Contacts->Count; i++) {
+        Normal = AK_Sim__V3_Add(Normal, Contacts->Normals[i]);
+    }
+
+    uint32_t Kept[4];
+    uint32_t KeptCount = AK_Sim__Reduce_Contacts(Contacts->Positions, Contacts->Depths, Contacts->Count, Normal, Kept);
+    for(i = 0; i < KeptCount; i++) {
+        uint32_t Index = Kept[i];
+        AK_Sim__Emit_Contact(Collector, Contacts->Positions[Index], Contacts->Normals[Index], Contacts->Depths[Index]);
+    }
+}
+
+/*One sided. The triangle face is always the reference face so contacts on terrain don't catch 
+  on the internal edges between triangles, except when GJK finds the convex off to the side of 
+  the face, where the edge or vertex contact is the right one*/
+static void AK_Sim__Collide_Convex_Triangle(ak_sim__triangle_contacts* Contacts, const ak_sim__convex_proxy* Convex, const ak_sim__triangle_proxy* Triangle, int ConvexIsA) {
+    const ak_sim_v4* FacePlane = &Triangle->Planes[0].NormalD;
+    ak_sim_v3 N = AK_Sim_V3(FacePlane->Data[0], FacePlane->Data[1], FacePlane->Data[2]);
+    float D = FacePlane->Data[3];
+
+    uint32_t SupportIndex = 0;
+    ak_sim_v3 Deepest = AK_Sim__Convex_Proxy_Support(Convex, AK_Sim__V3_Mul_S(N, -1.0f), &SupportIndex);
+    float Separation = AK_Sim__V3_Dot(N, Deepest) + D - Convex->Radius;
+    if(Separation > AK_SIM__SPECULATIVE_DISTANCE) return;
+
+    /*Shapes entirely behind the face have already gone through it and are left alone*/
+    ak_sim_v3 Highest = AK_Sim__Convex_Proxy_Support(Convex, N, &SupportIndex);
+    if(AK_Sim__V3_Dot(N, Highest) + D + Convex->Radius < 0.0f) return;
+
+    /*Triangles are only collided once, so the pair cache only seeds the search direction*/
+    ak_sim__pair_cache Cache;
+    AK_SIM_MEMSET(&Cache, 0, sizeof(ak_sim__pair_cache));
+    Cache.SeparatingAxis = ConvexIsA ? N : AK_Sim__V3_Mul_S(N, -1.0f);
+
+    const ak_sim__convex_proxy* A = ConvexIsA ? Convex : &Triangle->Proxy;
+    const ak_sim__convex_proxy* B = ConvexIsA ? &Triangle->Proxy : Convex;
+    ak_sim__gjk_result GJK = AK_Sim__GJK(A, B, &Cache);
+    if(!GJK.Overlap && GJK.Distance > Convex->Radius + AK_SIM__SPECULATIVE_DISTANCE) return;
+    if(!GJK.Overlap && GJK.Distance - Convex->Radius > Separation + AK_SIM__CONTACT_TOLERANCE) {
+        ak_sim_contact Contact = AK_Sim__Get_GJK_Contact(&GJK, A, B);
+        AK_Sim__Add_Triangle_Contact(Contacts, Contact.Position, Contact.Normal, Contact.Depth);
+        return;
+    }
+
+    ak_sim_v3 Polygon[AK_SIM__MAX_CONTACT_CANDIDATES];
+    uint32_t PolygonCount = AK_Sim__Get_Incident_Polygon(Convex, N, Polygon);
+    PolygonCount = AK_Sim__Clip_Polygon(&Triangle->Proxy, 0, Polygon, PolygonCount);
+
+    ak_sim_v3 Normal = ConvexIsA ? AK_Sim__V3_Mul_S(N, -1.0f) : N;
+    uint32_t i;
+    for(i = 0; i < PolygonCount; i++) {
+        ak_sim_v3 P = Polygon[i];
+        float PlaneDistance = AK_Sim__V3_Dot(N, P) + D;
+        float PointSeparation = PlaneDistance - Convex->Radius;
+        if(PointSeparation > AK_SIM__SPECULATIVE_DISTANCE) continue;
+
+        ak_sim_v3 OnPlane = AK_Sim__V3_Sub(P, AK_Sim__V3_Mul_S(N, PlaneDistance));
+        ak_sim_v3 Surface = AK_Sim__V3_Sub(P, AK_Sim__V3_Mul_S(N, Convex->Radius));
+        AK_Sim__Add_Triangle_Contact(Contacts, AK_Sim__V3_Lerp(OnPlane, 0.5f, Surface), Normal, -PointSeparation);
+    }
+
+    /*Cores hanging off the face clip to nothing. Separated ones still get the closest points, 
+      penetrating ones are left to the neighbouring triangle they're over*/
+    if(!PolygonCount && !GJK.Overlap) {
+        ak_sim_contact Contact = AK_Sim__Get_GJK_Contact(&GJK, A, B);
+        AK_Sim__Add_Triangle_Contact(Contacts, Contact.Position, Contact.Normal, Contact.Depth);
+    }
+}
+
+static uint32_t AK_Sim__Heightfield_Level_Size(uint32_t CellCount, uint32_t Level) {
+    return ((CellCount-1) >> Level) + 1;
+}
+
+AKSIMDEF size_t AK_Sim_Build_Heightfield_Ranges(ak_sim_heightfield* Heightfield, void* Buffer, size_t BufferSize) {
+    if(Heightfield->SampleCountX < 2 || Heightfield->SampleCountZ < 2) return 0;
+
+    uint32_t CellCountX = Heightfield->SampleCountX-1;
+    uint32_t CellCountZ = Heightfield->SampleCountZ-1;
+    uint32_t LevelCount = 0;
+    size_t RangeCount = 0;
+    for(;;) {
+        uint32_t Width = AK_Sim__Heightfield_Level_Size(CellCountX, LevelCount);
+        uint32_t Height = AK_Sim__Heightfield_Level_Size(CellCountZ, LevelCount);
+        RangeCount += (size_t)Width*Height;
+        LevelCount++;
+        if(Width == 1 && Height == 1) break;
+    }
+
+    size_t Result = RangeCount*sizeof(ak_sim_heightfield_range);
+    if(!Buffer || BufferSize < Result) return Result;
+
+    ak_sim_heightfield_range* Ranges = (ak_sim_heightfield_range*)Buffer;
+    const uint16_t* Heights = Heightfield->Heights;
+    uint32_t SampleCountX = Heightfield->SampleCountX;
+    uint32_t x, z;
+    for(z = 0; z < CellCountZ; z++) {
+        for(x = 0; x < CellCountX; x++) {
+            uint16_t H00 = Heights[z*SampleCountX + x];
+            uint16_t H10 = Heights[z*SampleCountX + x+1];
+            uint16_t H01 = Heights[(z+1)*SampleCountX + x];
+            uint16_t H11 = Heights[(z+1)*SampleCountX + x+1];
+            ak_sim_heightfield_range* Range = Ranges + z*CellCountX + x;
+            Range->Min = AK_Sim__Min(AK_Sim__Min(H00, H10), AK_Sim__Min(H01, H11));
+            Range->Max = AK_Sim__Max(AK_Sim__Max(H00, H10), AK_Sim__Max(H01, H11));
+        }
+    }
+
+    ak_sim_heightfield_range* Below = Ranges;
+    ak_sim_heightfield_range* Level = Ranges + CellCountX*CellCountZ;
+    uint32_t LevelIndex;
+    for(LevelIndex = 1; LevelIndex < LevelCount; LevelIndex++) {
+        uint32_t BelowWidth = AK_Sim__Heightfield_Level_Size(CellCountX, LevelIndex-1);
+        uint32_t BelowHeight = AK_Sim__Heightfield_Level_Size(CellCountZ, LevelIndex-1);
+        uint32_t Width = AK_Sim__Heightfield_Level_Size(CellCountX, LevelIndex);
+        uint32_t Height = AK_Sim__Heightfield_Level_Size(CellCountZ, LevelIndex);
+        for(z = 0; z < Height; z++) {
+            for(x = 0; x < Width; x++) {
+                ak_sim_heightfield_range* Range = Level + z*Width + x;
+                Range->Min = 0xFFFF;
+                Range->Max = 0;
+
+                uint32_t i;
+                for(i = 0; i < 4; i++) {
+                    uint32_t BelowX = 2*x + (i & 1);
+                    uint32_t BelowZ = 2*z + (i >> 1);
+                    if(BelowX < BelowWidth && BelowZ < BelowHeight) {
+                        const ak_sim_heightfield_range* Child = Below + BelowZ*BelowWidth + BelowX;
+                        Range->Min = AK_Sim__Min(Range->Min, Child->Min);
+                        Range->Max = AK_Sim__Max(Range->Max, Child->Max);
+                    }
+                }
+            }
+        }
+        Below = Level;
+        Level += Width*Height;
+    }
+
+    Heightfield->Ranges = Ranges;
+    Heightfield->LevelCount = LevelCount;
+    Heightfield->RangeCount = (uint32_t)RangeCount;
+    return Result;
+}
+
+static ak_sim__aabb AK_Sim__Get_Heightfield_Local_AABB(const ak_sim_heightfield* Heightfield) {
+    uint32_t Min = 0xFFFF, Max = 0;
+    if(Heightfield->Ranges) {
+        const ak_sim_heightfield_range* Top = Heightfield->Ranges + Heightfield->RangeCount-1;
+        Min = Top->Min;
+        Max = Top->Max;
+    } else {
+        uint32_t i;
+        for(i = 0; i < Heightfield->SampleCountX*Heightfield->SampleCountZ; i++) {
+            Min = AK_Sim__Min(Min, (uint32_t)Heightfield->Heights[i]);
+            Max = AK_Sim__Max(Max, (uint32_t)Heightfield->Heights[i]);
+        }
+    }
+
+    ak_sim__aabb Result;
+    Result.Min = AK_Sim_V3(0.0f, Heightfield->HeightOffset + (float)Min*Heightfield->HeightScale, 0.0f);
+    Result.Max = AK_Sim_V3((float)(Heightfield->SampleCountX-1)*Heightfield->CellSize, 
+                           Heightfield->HeightOffset + (float)Max*Heightfield->HeightScale, 
+                           (float)(Heightfield->SampleCountZ-1)*Heightfield->CellSize);
+    return Result;
+}
+
+static ak_sim_v3 AK_Sim__Heightfield_Point(const ak_sim_heightfield* Heightfield, uint32_t x, uint32_t z) {
+    float Height = Heightfield->HeightOffset + (float)Heightfield->Heights[z*Heightfield->SampleCountX + x]*Heightfield->HeightScale;
+    return AK_Sim_V3((float)x*Heightfield->CellSize, Height, (float)z*Heightfield->CellSize);
+}
+
+static void AK_Sim__Collide_Convex_Heightfield_Cell(ak_sim__triangle_contacts* Contacts, const ak_sim__convex_proxy* Convex, const ak_sim_heightfield* Heightfield, 
+                                                   const ak_sim_m4x3* Transform, ak_sim_v3 Scale, uint32_t x, uint32_t z, int ConvexIsA) {
+    ak_sim_v3 P00 = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(AK_Sim__Heightfield_Point(Heightfield, x, z), Scale));
+    ak_sim_v3 P10 = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(AK_Sim__Heightfield_Point(Heightfield, x+1, z), Scale));
+    ak_sim_v3 P01 = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(AK_Sim__Heightfield_Point(Heightfield, x, z+1), Scale));
+    ak_sim_v3 P11 = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(AK_Sim__Heightfield_Point(Heightfield, x+1, z+1), Scale));
+
+    ak_sim__triangle_proxy Triangle;
+    if(AK_Sim__Triangle_Proxy_Init(&Triangle, P00, P01, P11)) {
+        AK_Sim__Collide_Convex_Triangle(Contacts, Convex, &Triangle, ConvexIsA);
+    }
+    if(AK_Sim__Triangle_Proxy_Init(&Triangle, P00, P11, P10)) {
+        AK_Sim__Collide_Convex_Triangle(Contacts, Convex, &Triangle, ConvexIsA);
+    }
+}
+
+typedef struct {
+    uint32_t Level;
+    uint32_t X;
+    uint32_t Z;
+} ak_sim__heightfield_node;
+
+#define AK_SIM__HEIGHTFIELD_MAX_LEVELS 32
+
+/*Cells under world space Bounds, found from the bounds in the unscaled grid space. Returns 0 when 
+  they miss the grid*/
+static int AK_Sim__Get_Heightfield_Cells(const ak_sim_heightfield* Heightfield, const ak_sim_m4x3* Transform, ak_sim_v3 Scale, const ak_sim__aabb* Bounds, 
+                                         ak_sim__aabb* LocalBounds, uint32_t* CellMin, uint32_t* CellMax) {
+    if(Heightfield->SampleCountX < 2 || Heightfield->SampleCountZ < 2) return 0;
+
+    *LocalBounds = AK_Sim__AABB_Empty();
+    uint32_t i;
+    for(i = 0; i < 8; i++) {
+        ak_sim_v3 Corner = AK_Sim_V3((i & 1) ? Bounds->Max.Data[0] : Bounds->Min.Data[0], 
+                                     (i & 2) ? Bounds->Max.Data[1] : Bounds->Min.Data[1], 
+                                     (i & 4) ? Bounds->Max.Data[2] : Bounds->Min.Data[2]);
+        Corner = AK_Sim__M4x3_Inverse_Transform_Point(Transform, Corner);
+        AK_Sim__AABB_Add_Point(LocalBounds, AK_Sim_V3(Corner.Data[0]/Scale.Data[0], Corner.Data[1]/Scale.Data[1], Corner.Data[2]/Scale.Data[2]));
+    }
+
+    uint32_t CellCountX = Heightfield->SampleCountX-1;
+    uint32_t CellCountZ = Heightfield->SampleCountZ-1;
+    float MinX = LocalBounds->Min.Data[0]/Heightfield->CellSize;
+    float MaxX = LocalBounds->Max.Data[0]/Heightfield->CellSize;
+    float MinZ = LocalBounds->Min.Data[2]/Heightfield->CellSize;
+    float MaxZ = LocalBounds->Max.Data[2]/Heightfield->CellSize;
+    if(MaxX < 0.0f || MaxZ < 0.0f || MinX >= (float)CellCountX || MinZ >= (float)CellCountZ) return 0;
+
+    CellMin[0] = MinX > 0.0f ? (uint32_t)MinX : 0;
+    CellMin[1] = MinZ > 0.0f ? (uint32_t)MinZ : 0;
+    CellMax[0] = AK_Sim__Min((uint32_t)MaxX, CellCountX-1);
+    CellMax[1] = AK_Sim__Min((uint32_t)MaxZ, CellCountZ-1);
+    return 1;
+}
+
+/*Cells under the convex's bounds are found directly from the grid. With range levels the search 
+  descends from the single top range and drops any block whose heights can't reach the bounds*/
+static void AK_Sim__Collide_Convex_Heightfield(ak_sim_collision_collector* Collector, const ak_sim__convex_proxy* Convex, const ak_sim_heightfield* Heightfield, 
+                                              const ak_sim_m4x3* Transform, ak_sim_v3 Scale, int ConvexIsA) {
+    ak_sim__aabb Bounds = AK_Sim__Convex_Proxy_AABB(Convex);
+    Bounds = AK_Sim__AABB_Extend(&Bounds, Convex->Radius + AK_SIM__SPECULATIVE_DISTANCE);
+
+    ak_sim__aabb LocalBounds;
+    uint32_t CellMin[2], CellMax[2];
+    if(!AK_Sim__Get_Heightfield_Cells(Heightfield, Transform, Scale, &Bounds, &LocalBounds, CellMin, CellMax)) return;
+
+    uint32_t CellCountX = Heightfield->SampleCountX-1;
+    uint32_t CellCountZ = Heightfield->SampleCountZ-1;
+    uint32_t CellMinX = CellMin[0];
+    uint32_t CellMinZ = CellMin[1];
+    uint32_t CellMaxX = CellMax[0];
+    uint32_t CellMaxZ = CellMax[1];
+    uint32_t i;
+
+    ak_sim__triangle_contacts Contacts;
+    Contacts.Count = 0;
+
+    uint32_t x, z;
+    if(!Heightfield->Ranges) {
+        for(z = CellMinZ; z <= CellMaxZ; z++) {
+            for(x = CellMinX; x <= CellMaxX; x++) {
+                AK_Sim__Collide_Convex_Heightfield_Cell(&Contacts, Convex, Heightfield, Transform, Scale, x, z, ConvexIsA);
+            }
+        }
+        AK_Sim__Emit_Triangle_Contacts(Collector, &Contacts);
+        return;
+    }
+
+    /*Bounds height in sample units*/
+    float MinSample = (LocalBounds.Min.Data[1]-Heightfield->HeightOffset)/Heightfield->HeightScale;
+    float MaxSample = (LocalBounds.Max.Data[1]-Heightfield->HeightOffset)/Heightfield->HeightScale;
+
+    AK_SIM_ASSERT(Heightfield->LevelCount <= AK_SIM__HEIGHTFIELD_MAX_LEVELS);
+    uint32_t LevelOffsets[AK_SIM__HEIGHTFIELD_MAX_LEVELS];
+    uint32_t LevelOffset = 0;
+    for(i = 0; i < Heightfield->LevelCount; i++) {
+        LevelOffsets[i] = LevelOffset;
+        LevelOffset += AK_Sim__Heightfield_Level_Size(CellCountX, i)*AK_Sim__Heightfield_Level_Size(CellCountZ, i);
+    }
+
+    /*Depth first, so at most three siblings wait per level*/
+    ak_sim__heightfield_node Stack[3*AK_SIM__HEIGHTFIELD_MAX_LEVELS+1];
+    uint32_t StackCount = 0;
+    Stack[StackCount].Level = Heightfield->LevelCount-1;
+    Stack[StackCount].X = 0;
+    Stack[StackCount].Z = 0;
+    StackCount++;
+
+    while(StackCount) {
+        ak_sim__heightfield_node Node = Stack[--StackCount];
+        uint32_t FirstX = Node.X << Node.Level;
+        uint32_t FirstZ = Node.Z << Node.Level;
+        uint32_t LastX = ((Node.X+1) << Node.Level)-1;
+        uint32_t LastZ = ((Node.Z+1) << Node.Level)-1;
+        if(FirstX > CellMaxX || LastX < CellMinX || FirstZ > CellMaxZ || LastZ < CellMinZ) continue;
+
+        uint32_t Width = AK_Sim__Heightfield_Level_Size(CellCountX, Node.Level);
+        const ak_sim_heightfield_range* Range = Heightfield->Ranges + LevelOffsets[Node.Level] + Node.Z*Width + Node.X;
+        if((float)Range->Max < MinSample || (float)Range->Min > MaxSample) continue;
+
+        if(Node.Level == 0) {
+            AK_Sim__Collide_Convex_Heightfield_Cell(&Contacts, Convex, Heightfield, Transform, Scale, Node.X, Node.Z, ConvexIsA);
+            continue;
+        }
+
+        uint32_t ChildWidth = AK_Sim__Heightfield_Level_Size(CellCountX, Node.Level-1);
+        uint32_t ChildHeight = AK_Sim__Heightfield_Level_Size(CellCountZ, Node.Level-1);
+        for(i = 4; i > 0; i--) {
+            uint32_t ChildX = 2*Node.X + ((i-1) & 1);
+            uint32_t ChildZ = 2*Node.Z + ((i-1) >> 1);
+            if(ChildX < ChildWidth && ChildZ < ChildHeight) {
+                Stack[StackCount].Level = Node.Level-1;
+                Stack[StackCount].X = ChildX;
+                Stack[StackCount].Z = ChildZ;
+                StackCount++;
+            }
+        }
+    }
+    AK_Sim__Emit_Triangle_Contacts(Collector, &Contacts);
+}
+
+static void AK_Sim__Register_Collision(ak_sim__collision_table* Table, ak_sim_shape_type TypeA, ak_sim_shape_type TypeB, ak_sim_collision_func* CollisionFunc) {
+    uint32_t Index = TypeA*Table->MaxPerRow + TypeB;
+    AK_SIM_ASSERT(Index < Table->MaxPerRow*Table->MaxPerRow);
+    Table->CollisionFuncs[Index] = CollisionFunc;
+}
+
+static void AK_Sim__Convex_Collision(ak_sim_collision_collector* Collector, 
+                                     ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                     ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+    ak_sim__convex_proxy ProxyA, ProxyB;
+    if(!AK_Sim__Convex_Proxy_Init(&ProxyA, &ShapeA->Internal.Convex, TransformA, ScaleA)) return;
+    if(!AK_Sim__Convex_Proxy_Init(&ProxyB, &ShapeB->Internal.Convex, TransformB, ScaleB)) return;
+    AK_Sim__Collide_Convex_Proxies(Collector, &ProxyA, &ProxyB);
+}
+
+static void AK_Sim__Convex_Mesh_Collision(ak_sim_collision_collector* Collector, 
+                                          ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                          ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+}
+
+static void AK_Sim__Convex_Compound_Collision(ak_sim_collision_collector* Collector, 
+                                              ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                              ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+}
+
+static void AK_Sim__Mesh_Convex_Collision(ak_sim_collision_collector* Collector, 
+                                          ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                          ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+}
+
+static void AK_Sim__Mesh_Collision(ak_sim_collision_collector* Collector, 
+                                   ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                   ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+}
+
+static void AK_Sim__Mesh_Compound_Collision(ak_sim_collision_collector* Collector, 
+                                            ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                            ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+}
+
+static void AK_Sim__Compound_Convex_Collision(ak_sim_collision_collector* Collector, 
+                                              ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                              ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+}
+
+static void AK_Sim__Compound_Mesh_Collision(ak_sim_collision_collector* Collector, 
+                                            ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                            ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+}
+
+static void AK_Sim__Compound_Collision(ak_sim_collision_collector* Collector, 
+                                       ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                       ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+}
+
+static void AK_Sim__Convex_Heightfield_Collision(ak_sim_collision_collector* Collector, 
+                                                ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                                ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+    ak_sim__convex_proxy Proxy;
+    if(!AK_Sim__Convex_Proxy_Init(&Proxy, &ShapeA->Internal.Convex, TransformA, ScaleA)) return;
+    AK_Sim__Collide_Convex_Heightfield(Collector, &Proxy, ShapeB->Internal.Heightfield.Heightfield, TransformB, ScaleB, 1);
+}
+
+static void AK_Sim__Heightfield_Convex_Collision(ak_sim_collision_collector* Collector, 
+                                                ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA,
+                                                ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+    ak_sim__convex_proxy Proxy;
+    if(!AK_Sim__Convex_Proxy_Init(&Proxy, &ShapeB->Internal.Convex, TransformB, ScaleB)) return;
+    AK_Sim__Collide_Convex_Heightfield(Collector, &Proxy, ShapeA->Internal.Heightfield.Heightfield, TransformA, ScaleA, 0);
+}
+
+/*Heightfields only collide with convex shapes. Their pairs with meshes, compounds and other 
+  heightfields are skipped unless a collision function is registered for them*/
+static ak_sim_collision_func* G_CollisionFunc[AK_SIM_SHAPE_TYPE_COUNT][AK_SIM_SHAPE_TYPE_COUNT] = {
+    {AK_Sim__Convex_Collision, AK_Sim__Convex_Mesh_Collision, AK_Sim__Convex_Compound_Collision, AK_Sim__Convex_Heightfield_Collision},
+    {AK_Sim__Mesh_Convex_Collision, AK_Sim__Mesh_Collision, AK_Sim__Mesh_Compound_Collision, NULL},
+    {AK_Sim__Compound_Convex_Collision, AK_Sim__Compound_Mesh_Collision, AK_Sim__Compound_Collision, NULL},
+    {AK_Sim__Heightfield_Convex_Collision, NULL, NULL, NULL}
+};
+
+static void AK_Sim__Reserve_Budgets(ak_sim_context* Context);
+
+AKSIMDEF ak_sim_context* AK_Sim_Create_Context(const ak_sim_create_info* CreateInfo) {
+    ak_sim_allocator Allocator = CreateInfo->Allocator;
+    if(!Allocator.AllocateMemory || !Allocator.FreeMemory) {
+#ifdef AK_SIM_NO_STDLIB
+        return NULL;
+#else
+        Allocator = AK_Sim__Get_Stdio_Allocator();
+#endif
+    }
+
+    ak_sim_context* Result = AK_Sim__Allocate_Struct(&Allocator, ak_sim_context);
+    AK_SIM_MEMSET(Result, 0, sizeof(ak_sim_context));
+    Result->Allocator = Allocator;
+    AK_Sim__Arena_Create(&Result->Arena, &Result->Allocator);
+    AK_Sim__Arena_Create(&Result->TempArena, &Result->Allocator);
+    AK_Sim__Arena_Create(&Result->EventArena, &Result->Allocator);
+    AK_Sim__Clear_Events(Result);
+
+    /*One row and column per type up to the largest registered one, so dispatch stays a single lookup*/
+    ak_sim__collision_table* CollisionTable = &Result->CollisionTable;
+    uint32_t MaxPerRow = AK_SIM_SHAPE_TYPE_COUNT;
+
+    uint32_t i;
+    for(i = 0; i < CreateInfo->ShapeRegistrationCount; i++) {
+        ak_sim_shape_registration* Registration = CreateInfo->ShapeRegistrations+i;
+        MaxPerRow = AK_Sim__Max((uint32_t)Registration->Type+1, MaxPerRow);
+        uint32_t j;
+        for(j = 0; j < Registration->CollisionFuncCount; j++) {
+            MaxPerRow = AK_Sim__Max((uint32_t)Registration->Collisions[j].Type+1, MaxPerRow);
+        }
+    }
+
+    CollisionTable->MaxPerRow = MaxPerRow;
+    CollisionTable->CollisionFuncs = AK_Sim__Arena_Push_Array(&Result->Arena, MaxPerRow*MaxPerRow, ak_sim_collision_func*);
+    AK_SIM_MEMSET(CollisionTable->CollisionFuncs, 0, MaxPerRow*MaxPerRow*sizeof(ak_sim_collision_func*));
+
+    Result->ShapeVTableCount = MaxPerRow - AK_SIM_SHAPE_TYPE_USER;
+    if(Result->ShapeVTableCount) {
+        Result->ShapeVTables = AK_Sim__Arena_Push_Array(&Result->Arena, Result->ShapeVTableCount, ak_sim_shape_vtable);
+        AK_SIM_MEMSET(Result->ShapeVTables, 0, Result->ShapeVTableCount*sizeof(ak_sim_shape_vtable));
+        for(i = 0; i < CreateInfo->ShapeRegistrationCount; i++) {
+            ak_sim_shape_registration* Registration = CreateInfo->ShapeRegistrations+i;
+            if(Registration->Type >= AK_SIM_SHAPE_TYPE_USER) {
+                Result->ShapeVTables[Registration->Type-AK_SIM_SHAPE_TYPE_USER] = Registration->VTable;
+            }
+        }
+    }
+
+    for(i = 0; i < CreateInfo->ConvexRegistrationCount; i++) {
+        ak_sim_convex_registration* Registration = CreateInfo->ConvexRegistrations+i;
+        AK_SIM_ASSERT(Registration->Type >= AK_SIM_CONVEX_TYPE_USER);
+        Result->ConvexVTableCount = AK_Sim__Max((uint32_t)(Registration->Type-AK_SIM_CONVEX_TYPE_USER)+1, Result->ConvexVTableCount);
+    }
+
+    if(Result->ConvexVTableCount) {
+        Result->ConvexVTables = AK_Sim__Arena_Push_Array(&Result->Arena, Result->ConvexVTableCount, ak_sim_convex_vtable);
+        AK_SIM_MEMSET(Result->ConvexVTables, 0, Result->ConvexVTableCount*sizeof(ak_sim_convex_vtable));
+        for(i = 0; i < CreateInfo->ConvexRegistrationCount; i++) {
+            ak_sim_convex_registration* Registration = CreateInfo->ConvexRegistrations+i;
+            Result->ConvexVTables[Registration->Type-AK_SIM_CONVEX_TYPE_USER] = Registration->VTable;
+        }
+    }
+
+    /*First register default shape types*/
+    for(i = 0; i < AK_SIM_SHAPE_TYPE_COUNT; i++) {
+        uint32_t j;
+        for(j = 0; j < AK_SIM_SHAPE_TYPE_COUNT; j++) {
+            AK_Sim__Register_Collision(CollisionTable, i, j, G_CollisionFunc[i][j]);
+        }
+    }
+
+    /* Then register custom shapes */
+    for(i = 0; i < CreateInfo->ShapeRegistrationCount; i++) {
+        ak_sim_shape_registration* Registration = CreateInfo->ShapeRegistrations+i;
+        uint32_t j;
+        for(j = 0; j < Registration->CollisionFuncCount; j++) {
+            ak_sim_collision_registration* Collision = Registration->Collisions + j;
+            AK_Sim__Register_Collision(CollisionTable, Registration->Type, Collision->Type, Collision->CollisionFunc);
+        }
+    }
+
+    Result->MaxBodies = CreateInfo->MaxBodies;
+    Result->MaxJoints = CreateInfo->MaxJoints;
+    Result->MaxPairs = CreateInfo->MaxPairs;
+    Result->MaxContacts = CreateInfo->MaxContacts;
+
+    AK_Sim__Pool_Init_With_Size(&Result->BodyPool, &Result->Allocator, AK_Sim__Max(Result->MaxBodies, 512), sizeof(ak_sim_body));
+    AK_Sim__Pool_Init_With_Size(&Result->ShapePool, &Result->Allocator, 64, sizeof(ak_sim__shape_entry));
+    AK_Sim__Pool_Init_With_Size(&Result->JointPool, &Result->Allocator, AK_Sim__Max(Result->MaxJoints, 64), sizeof(ak_sim_joint));
+    AK_Sim__Pool_Init_With_Size(&Result->ClothPool, &Result->Allocator, 16, sizeof(ak_sim__cloth));
+    AK_Sim__Pair_Cache_Table_Init(&Result->PairCaches[0], &Result->Allocator);
+    AK_Sim__Pair_Cache_Table_Init(&Result->PairCaches[1], &Result->Allocator);
+    AK_Sim__Array_Init(&Result->BroadphasePairs, &Result->Allocator, sizeof(ak_sim__body_id_pair));
+    Result->PairCacheIndex = 0;
+
+    Result->FixedTimeStep = CreateInfo->FixedTimeStep > 0.0f ? CreateInfo->FixedTimeStep : AK_SIM_DEFAULT_FIXED_TIME_STEP;
+    Result->SubstepCount = CreateInfo->SubstepCount ? CreateInfo->SubstepCount : AK_SIM_DEFAULT_SUBSTEP_COUNT;
+    Result->MaxStepsPerUpdate = CreateInfo->MaxStepsPerUpdate ? CreateInfo->MaxStepsPerUpdate : AK_SIM_DEFAULT_MAX_STEPS_PER_UPDATE;
+    Result->SolverIterationCount = CreateInfo->SolverIterationCount ? CreateInfo->SolverIterationCount : AK_SIM_DEFAULT_SOLVER_ITERATION_COUNT;
+    Result->Accumulator = 0.0f;
+    Result->StepIndex = 0;
+
+    Result->ParallelFor = CreateInfo->ParallelFor;
+    Result->ParallelForUserData = CreateInfo->ParallelForUserData;
+    Result->WorkerCount = CreateInfo->WorkerCount ? CreateInfo->WorkerCount : 1;
+    Result->RegionSize = CreateInfo->RegionSize > 0.0f ? CreateInfo->RegionSize : AK_SIM_DEFAULT_REGION_SIZE;
+    Result->Workers = AK_Sim__Arena_Push_Array(&Result->Arena, Result->WorkerCount, ak_sim__worker);
+    AK_SIM_MEMSET(Result->Workers, 0, Result->WorkerCount*sizeof(ak_sim__worker));
+    for(i = 0; i < Result->WorkerCount; i++) {
+        AK_Sim__Arena_Create(&Result->Workers[i].Arena, &Result->Allocator);
+    }
+
+    AK_Sim__Reserve_Budgets(Result);
+    return Result;
+}
+
+AKSIMDEF void AK_Sim_Delete_Context(ak_sim_context* Context) {
+    if(Context) {
+        ak_sim_allocator* Allocator = &Context->Allocator;
+        AK_Sim__Pair_Cache_Table_Delete(&Context->PairCaches[0]);
+        AK_Sim__Pair_Cache_Table_Delete(&Context->PairCaches[1]);
+        if(Context->StaticTree.Items) AK_Sim__Free_Memory(Allocator, Context->StaticTree.Items);
+        if(Context->StaticTree.Nodes) AK_Sim__Free_Memory(Allocator, Context->StaticTree.Nodes);
+        if(Context->MovingTree.Items) AK_Sim__Free_Memory(Allocator, Context->MovingTree.Items);
+        if(Context->MovingTree.Nodes) AK_Sim__Free_Memory(Allocator, Context->MovingTree.Nodes);
+        if(Context->BodyBounds) AK_Sim__Free_Memory(Allocator, Context->BodyBounds);
+        if(Context->BroadphasePairs.Data) AK_Sim__Free_Memory(Allocator, Context->BroadphasePairs.Data);
+        ak_sim__pool_iter ShapeIter = AK_Sim__Pool_Begin_Iter(&Context->ShapePool);
+        while(AK_Sim__Pool_Iter_Is_Valid(&ShapeIter)) {
+            ak_sim__shape_entry* Entry = (ak_sim__shape_entry*)AK_Sim__Pool_Iter_Next(&ShapeIter);
+            if(Entry->SupportData) AK_Sim__Free_Memory(Allocator, Entry->SupportData);
+        }
+
+        ak_sim__pool_iter ClothIter = AK_Sim__Pool_Begin_Iter(&Context->ClothPool);
+        while(AK_Sim__Pool_Iter_Is_Valid(&ClothIter)) {
+            ak_sim__cloth* Cloth = (ak_sim__cloth*)AK_Sim__Pool_Iter_Next(&ClothIter);
+            AK_Sim__Free_Memory(Allocator, Cloth->Memory);
+        }
+
+        AK_Sim__Pool_Delete(&Context->ClothPool);
+        AK_Sim__Pool_Delete(&Context->JointPool);
+        AK_Sim__Pool_Delete(&Context->ShapePool);
+        AK_Sim__Pool_Delete(&Context->BodyPool);
+
+        uint32_t i;
+        for(i = 0; i < Context->WorkerCount; i++) {
+            AK_Sim__Arena_Delete(&Context->Workers[i].Arena);
+        }
+
+        AK_Sim__Arena_Delete(&Context->EventArena);
+        AK_Sim__Arena_Delete(&Context->TempArena);
+        AK_Sim__Arena_Delete(&Context->Arena);
+        AK_Sim__Free_Memory(Allocator, Context);
+    }
+}
+
+static int AK_Sim__Body_Pair_Less(const ak_sim__body_id_pair* A, const ak_sim__body_id_pair* B) {
+    return A->AID < B->AID || (A->AID == B->AID && A->BID < B->BID);
+}
+
+/*Bottom up merge sort. Stable, and its order only depends on the pair keys*/
+static void AK_Sim__Sort_Body_Pairs(ak_sim__body_id_pair* Pairs, uint32_t Count, ak_sim__arena* TempArena) {
+    if(Count < 2) return;
+
+    ak_sim__body_id_pair* Src = Pairs;
+    ak_sim__body_id_pair* Dst = AK_Sim__Arena_Push_Array(TempArena, Count, ak_sim__body_id_pair);
+
+    uint32_t Width;
+    for(Width = 1; Width < Count; Width *= 2) {
+        uint32_t Start;
+        for(Start = 0; Start < Count; Start += 2*Width) {
+            uint32_t Mid = AK_Sim__Min(Start+Width, Count);
+            uint32_t End = AK_Sim__Min(Start+2*Width, Count);
+            uint32_t i = Start, j = Mid, k = Start;
+            while(i < Mid && j < End) {
+                Dst[k++] = AK_Sim__Body_Pair_Less(Src+j, Src+i) ? Src[j++] : Src[i++];
+            }
+            while(i < Mid) Dst[k++] = Src[i++];
+            while(j < End) Dst[k++] = Src[j++];
+        }
+
+        ak_sim__body_id_pair* Temp = Src;
+        Src = Dst;
+        Dst = Temp;
+    }
+
+    if(Src != Pairs) {
+        AK_SIM_MEMCPY(Pairs, Src, Count*sizeof(ak_sim__body_id_pair));
+    }
+}
+
+typedef struct {
+    ak_sim__set Set;
+} ak_sim__body_id_pair_set;
+
+static void AK_Sim__Shape_From_Info(ak_sim_shape* Shape, const ak_sim_shape_info* Info) {
+    AK_SIM_MEMSET(Shape, 0, sizeof(ak_sim_shape));
+    Shape->Type = Info->ShapeType;
+    switch(Info->ShapeType) {
+        case AK_SIM_SHAPE_TYPE_CONVEX: {
+            ak_sim_convex* Convex = &Shape->Internal.Convex;
+            Convex->Type = Info->ConvexType;
+            switch(Info->ConvexType) {
+                case AK_SIM_CONVEX_TYPE_SPHERE: {
+                    Convex->Internal.Sphere = Info->Sphere;
+                } break;
+
+                case AK_SIM_CONVEX_TYPE_CAPSULE: {
+                    Convex->Internal.Capsule = Info->Capsule;
+                } break;
+
+                case AK_SIM_CONVEX_TYPE_HULL: {
+                    Convex->Internal.Hull.Hull = Info->Hull;
+                } break;
+
+                default: {
+                    Convex->Internal.User.UserData = Info->ConvexUserData;
+                } break;
+            }
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_MESH: {
+            Shape->Internal.TriangleMesh.Mesh = Info->TriangleMesh;
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_COMPOUND: {
+            Shape->Internal.Compound = Info->CompoundShape;
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_HEIGHTFIELD: {
+            Shape->Internal.Heightfield.Heightfield = Info->Heightfield;
+        } break;
+
+        default: {
+            Shape->Internal.User.UserData = Info->ShapeUserData;
+        } break;
+    }
+}
+
+static ak_sim__aabb AK_Sim__Get_Points_AABB(const ak_sim_v3* Points, uint32_t PointCount, const ak_sim_m4x3* Transform, ak_sim_v3 Scale) {
+    ak_sim__aabb Result = AK_Sim__AABB_Empty();
+    uint32_t i;
+    for(i = 0; i < PointCount; i++) {
+        AK_Sim__AABB_Add_Point(&Result, AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(Points[i], Scale)));
+    }
+    return Result;
+}
+
+/*Transforms the scaled box's center and projects its half extent onto the world axes instead of 
+  transforming all eight corners*/
+static ak_sim__aabb AK_Sim__Get_Box_AABB(const ak_sim__aabb* LocalAABB, const ak_sim_m4x3* Transform, ak_sim_v3 Scale) {
+    ak_sim_v3 Center = AK_Sim__V3_Mul(AK_Sim__V3_Mul_S(AK_Sim__V3_Add(LocalAABB->Min, LocalAABB->Max), 0.5f), Scale);
+    ak_sim_v3 HalfExtent = AK_Sim__V3_Mul(AK_Sim__V3_Mul_S(AK_Sim__V3_Sub(LocalAABB->Max, LocalAABB->Min), 0.5f), Scale);
+    Center = AK_Sim__M4x3_Transform_Point(Transform, Center);
+
+    ak_sim_v3 Extent;
+    uint32_t i;
+    for(i = 0; i < 3; i++) {
+        Extent.Data[i] = AK_Sim__Abs(Transform->Cols[0].Data[i]*HalfExtent.Data[0]) + 
+                         AK_Sim__Abs(Transform->Cols[1].Data[i]*HalfExtent.Data[1]) + 
+                         AK_Sim__Abs(Transform->Cols[2].Data[i]*HalfExtent.Data[2]);
+    }
+
+    ak_sim__aabb Result;
+    Result.Min = AK_Sim__V3_Sub(Center, Extent);
+    Result.Max = AK_Sim__V3_Add(Center, Extent);
+    return Result;
+}
+
+static ak_sim__aabb AK_Sim__Get_Shape_AABB(const ak_sim_shape* Shape, const ak_sim_m4x3* Transform, ak_sim_v3 Scale) {
+    ak_sim__aabb Result;
+    switch(Shape->Type) {
+        case AK_SIM_SHAPE_TYPE_CONVEX: {
+            const ak_sim_convex* Convex = &Shape->Internal.Convex;
+            switch(Convex->Type) {
+                case AK_SIM_CONVEX_TYPE_SPHERE: {
+                    float Radius = Convex->Internal.Sphere.Radius*AK_Sim__V3_Max_Component(Scale);
+                    Result.Min = Result.Max = Transform->Cols[3];
+                    Result = AK_Sim__AABB_Extend(&Result, Radius);
+                } break;
+
+                case AK_SIM_CONVEX_TYPE_CAPSULE: {
+                    const ak_sim_capsule* Capsule = &Convex->Internal.Capsule;
+                    float Radius = Capsule->Radius*AK_Sim__Max(Scale.Data[0], Scale.Data[2]);
+                    ak_sim_v3 Axis = AK_Sim__V3_Mul_S(Transform->Cols[1], Capsule->HalfHeight*Scale.Data[1]);
+                    Result = AK_Sim__AABB_Empty();
+                    AK_Sim__AABB_Add_Point(&Result, AK_Sim__V3_Add(Transform->Cols[3], Axis));
+                    AK_Sim__AABB_Add_Point(&Result, AK_Sim__V3_Sub(Transform->Cols[3], Axis));
+                    Result = AK_Sim__AABB_Extend(&Result, Radius);
+                } break;
+
+                case AK_SIM_CONVEX_TYPE_HULL: {
+                    const ak_sim_hull* Hull = Convex->Internal.Hull.Hull;
+                    Result = AK_Sim__Get_Points_AABB(Hull->Vertices, Hull->VtxCount, Transform, Scale);
+                } break;
+
+                default: {
+                    const ak_sim_user_convex* User = &Convex->Internal.User;
+                    ak_sim__convex_proxy Proxy;
+                    if(User->VTable && User->VTable->Bounds) {
+                        ak_sim__aabb LocalAABB;
+                        User->VTable->Bounds(User->UserData, &LocalAABB.Min, &LocalAABB.Max);
+                        Result = AK_Sim__Get_Box_AABB(&LocalAABB, Transform, Scale);
+                    } else if(AK_Sim__Convex_Proxy_Init(&Proxy, Convex, Transform, Scale)) {
+                        Result = AK_Sim__Convex_Proxy_AABB(&Proxy);
+                    } else {
+                        Result.Min = AK_Sim_V3(-1e30f, -1e30f, -1e30f);
+                        Result.Max = AK_Sim_V3(1e30f, 1e30f, 1e30f);
+                    }
+                } break;
+            }
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_MESH: {
+            const ak_sim_triangle_mesh* Mesh = Shape->Internal.TriangleMesh.Mesh;
+            Result = AK_Sim__Get_Points_AABB(Mesh->Vertices, Mesh->VtxCount, Transform, Scale);
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_COMPOUND: {
+            const ak_sim_compound_shape* Compound = &Shape->Internal.Compound;
+            Result = AK_Sim__AABB_Empty();
+            uint32_t i;
+            for(i = 0; i < Compound->ShapeCount; i++) {
+                const ak_sim_generic_shape* Child = Compound->Shapes + i;
+                ak_sim_m4x3 ChildTransform = AK_Sim__Get_Matrix_Transform(&Child->Transform);
+                ChildTransform.Cols[3] = AK_Sim__V3_Mul(ChildTransform.Cols[3], Scale);
+                ChildTransform = AK_Sim__M4x3_Mul(Transform, &ChildTransform);
+                ak_sim__aabb ChildAABB = AK_Sim__Get_Shape_AABB(&Child->Shape, &ChildTransform, Scale);
+                Result = AK_Sim__AABB_Union(&Result, &ChildAABB);
+            }
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_HEIGHTFIELD: {
+            ak_sim__aabb LocalAABB = AK_Sim__Get_Heightfield_Local_AABB(Shape->Internal.Heightfield.Heightfield);
+            Result = AK_Sim__Get_Box_AABB(&LocalAABB, Transform, Scale);
+        } break;
+
+        default: {
+            const ak_sim_user_shape* User = &Shape->Internal.User;
+            if(User->VTable && User->VTable->Bounds) {
+                ak_sim__aabb LocalAABB;
+                User->VTable->Bounds(User->UserData, &LocalAABB.Min, &LocalAABB.Max);
+                Result = AK_Sim__Get_Box_AABB(&LocalAABB, Transform, Scale);
+            } else {
+                /*Without bounds they overlap everything*/
+                Result.Min = AK_Sim_V3(-1e30f, -1e30f, -1e30f);
+                Result.Max = AK_Sim_V3(1e30f, 1e30f, 1e30f);
+            }
+        } break;
+    }
+    return Result;
+}
+
+/*Shape IDs are the pool index plus one in the high 24 bits and the low 8 bits of the pool 
+  generation, so the invalid ID of 0 is never handed out*/
+#define AK_SIM__SHAPE_ID_GENERATION_BITS 8
+#define AK_SIM__SHAPE_ID_GENERATION_MASK ((1u << AK_SIM__SHAPE_ID_GENERATION_BITS)-1)
+#define AK_SIM__MAX_SHAPE_COUNT ((1u << (32-AK_SIM__SHAPE_ID_GENERATION_BITS))-1)
+
+static ak_sim_shape_id AK_Sim__Shape_ID_From_Pool_ID(ak_sim__pool_id ID) {
+    AK_SIM_ASSERT(ID.Internal.Index < AK_SIM__MAX_SHAPE_COUNT);
+    return ((ID.Internal.Index+1) << AK_SIM__SHAPE_ID_GENERATION_BITS) | (ID.Internal.Generation & AK_SIM__SHAPE_ID_GENERATION_MASK);
+}
+
+static ak_sim__shape_entry* AK_Sim__Get_Shape_Entry(ak_sim_context* Context, ak_sim_shape_id ShapeID) {
+    ak_sim__pool* Pool = &Context->ShapePool;
+    uint32_t Index = (ShapeID >> AK_SIM__SHAPE_ID_GENERATION_BITS)-1;
+    if(ShapeID == AK_SIM_INVALID_SHAPE_ID || Index >= Pool->MaxUsed) return NULL;
+
+    ak_sim__pool_id* PoolID = AK_Sim__Pool_Get_ID(Pool, Index);
+    if(PoolID->Internal.Index != Index || (PoolID->Internal.Generation & AK_SIM__SHAPE_ID_GENERATION_MASK) != (ShapeID & AK_SIM__SHAPE_ID_GENERATION_MASK)) {
+        return NULL;
+    }
+    return (ak_sim__shape_entry*)(PoolID+1);
+}
+
+static void AK_Sim__Free_Shape_If_Unused(ak_sim_context* Context, ak_sim_shape_id ShapeID) {
+    ak_sim__shape_entry* Entry = AK_Sim__Get_Shape_Entry(Context, ShapeID);
+    if(Entry && !Entry->RefCount && !Entry->BodyCount) {
+        if(Entry->SupportData) AK_Sim__Free_Memory(&Context->Allocator, Entry->SupportData);
+        ak_sim__pool_id ID = *((ak_sim__pool_id*)Entry-1);
+        AK_Sim__Pool_Free(&Context->ShapePool, ID);
+    }
+}
+
+/*Covariance of the tetrahedron (0, A, B, C) is Det/120*(AA' + BB' + CC' + (A+B+C)(A+B+C)')*/
+static void AK_Sim__Add_Tetrahedron_Mass(ak_sim_v3 A, ak_sim_v3 B, ak_sim_v3 C, float* Volume, ak_sim_v3* Moment, ak_sim_m3* Covariance) {
+    float Det = AK_Sim__V3_Dot(A, AK_Sim__V3_Cross(B, C));
+    ak_sim_v3 Sum = AK_Sim__V3_Add(AK_Sim__V3_Add(A, B), C);
+    *Volume += Det/6.0f;
+    *Moment = AK_Sim__V3_Add(*Moment, AK_Sim__V3_Mul_S(Sum, Det/24.0f));
+
+    uint32_t Row, Col;
+    for(Col = 0; Col < 3; Col++) {
+        for(Row = 0; Row < 3; Row++) {
+            float Value = A.Data[Row]*A.Data[Col] + B.Data[Row]*B.Data[Col] + C.Data[Row]*C.Data[Col] + Sum.Data[Row]*Sum.Data[Col];
+            Covariance->Cols[Col].Data[Row] += Det/120.0f*Value;
+        }
+    }
+}
+
+/*Inertia from a covariance matrix taken about the center of mass*/
+static ak_sim_m3 AK_Sim__Inertia_From_Covariance(const ak_sim_m3* Covariance) {
+    float Trace = Covariance->Cols[0].Data[0] + Covariance->Cols[1].Data[1] + Covariance->Cols[2].Data[2];
+    ak_sim_m3 Result;
+    uint32_t Row, Col;
+    for(Col = 0; Col < 3; Col++) {
+        Result.Cols[Col] = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+        for(Row = 0; Row < 3; Row++) {
+            Result.Cols[Col].Data[Row] = (Row == Col ? Trace : 0.0f) - Covariance->Cols[Col].Data[Row];
+        }
+    }
+    return Result;
+}
+
+/*Hull faces are rebuilt from the planes: the vertices on each plane sorted around it and fanned 
+  into tetrahedra with the vertex average*/
+static ak_sim_mass_properties AK_Sim__Get_Hull_Mass_Properties(const ak_sim_hull* Hull, ak_sim__arena* TempArena) {
+    ak_sim_mass_properties Result;
+    AK_SIM_MEMSET(&Result, 0, sizeof(ak_sim_mass_properties));
+    if(!Hull->VtxCount || !Hull->Planes) return Result;
+
+    ak_sim_v3 Reference = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim__aabb Bounds = AK_Sim__AABB_Empty();
+    uint32_t i, j;
+    for(i = 0; i < Hull->VtxCount; i++) {
+        Reference = AK_Sim__V3_Add(Reference, Hull->Vertices[i]);
+        AK_Sim__AABB_Add_Point(&Bounds, Hull->Vertices[i]);
+    }
+    Reference = AK_Sim__V3_Mul_S(Reference, 1.0f/(float)Hull->VtxCount);
+    float Tolerance = 1e-4f*AK_Sim__V3_Length(AK_Sim__V3_Sub(Bounds.Max, Bounds.Min));
+
+    ak_sim__temp_arena Temp = AK_Sim__Arena_Begin_Temp(TempArena);
+    uint32_t* Polygon = AK_Sim__Arena_Push_Array(TempArena, Hull->VtxCount, uint32_t);
+    float* Angles = AK_Sim__Arena_Push_Array(TempArena, Hull->VtxCount, float);
+
+    float Volume = 0.0f;
+    ak_sim_v3 Moment = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim_m3 Covariance;
+    AK_SIM_MEMSET(&Covariance, 0, sizeof(ak_sim_m3));
+
+    uint32_t PlaneIndex;
+    for(PlaneIndex = 0; PlaneIndex < Hull->FaceCount; PlaneIndex++) {
+        const ak_sim_v4* Plane = &Hull->Planes[PlaneIndex].NormalD;
+        ak_sim_v3 Normal = AK_Sim_V3(Plane->Data[0], Plane->Data[1], Plane->Data[2]);
+
+        uint32_t Count = 0;
+        ak_sim_v3 Center = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+        for(i = 0; i < Hull->VtxCount; i++) {
+            if(AK_Sim__Abs(AK_Sim__V3_Dot(Normal, Hull->Vertices[i]) + Plane->Data[3]) <= Tolerance) {
+                Polygon[Count++] = i;
+                Center = AK_Sim__V3_Add(Center, Hull->Vertices[i]);
+            }
+        }
+        if(Count < 3) continue;
+        Center = AK_Sim__V3_Mul_S(Center, 1.0f/(float)Count);
+
+        /*Counter clockwise around the outward normal, so the tetrahedra have positive volume*/
+        ak_sim_v3 U = AK_Sim__V3_Normalize(AK_Sim__V3_Sub(Hull->Vertices[Polygon[0]], Center));
+        ak_sim_v3 V = AK_Sim__V3_Cross(Normal, U);
+        for(i = 0; i < Count; i++) {
+            ak_sim_v3 Delta = AK_Sim__V3_Sub(Hull->Vertices[Polygon[i]], Center);
+            Angles[i] = AK_Sim__Diamond_Angle(AK_Sim__V3_Dot(Delta, U), AK_Sim__V3_Dot(Delta, V));
+        }
+        for(i = 1; i < Count; i++) {
+            uint32_t Index = Polygon[i];
+            float Angle = Angles[i];
+            for(j = i; j > 0 && Angles[j-1] > Angle; j--) {
+                Polygon[j] = Polygon[j-1];
+                Angles[j] = Angles[j-1];
+            }
+            Polygon[j] = Index;
+            Angles[j] = Angle;
+        }
+
+        ak_sim_v3 A = AK_Sim__V3_Sub(Hull->Vertices[Polygon[0]], Reference);
+        for(i = 1; i+1 < Count; i++) {
+            ak_sim_v3 B = AK_Sim__V3_Sub(Hull->Vertices[Polygon[i]], Reference);
+            ak_sim_v3 C = AK_Sim__V3_Sub(Hull->Vertices[Polygon[i+1]], Reference);
+            AK_Sim__Add_Tetrahedron_Mass(A, B, C, &Volume, &Moment, &Covariance);
+        }
+    }
+    AK_Sim__Arena_End_Temp(&Temp);
+
+    if(Volume <= 0.0f) return Result;
+
+    /*Move the covariance from the reference point to the center of mass*/
+    ak_sim_v3 Offset = AK_Sim__V3_Mul_S(Moment, 1.0f/Volume);
+    uint32_t Row, Col;
+    for(Col = 0; Col < 3; Col++) {
+        for(Row = 0; Row < 3; Row++) {
+            Covariance.Cols[Col].Data[Row] -= Volume*Offset.Data[Row]*Offset.Data[Col];
+        }
+    }
+
+    Result.Volume = Volume;
+    Result.CenterOfMass = AK_Sim__V3_Add(Reference, Offset);
+    Result.Inertia = AK_Sim__Inertia_From_Covariance(&Covariance);
+    return Result;
+}
+
+static ak_sim_mass_properties AK_Sim__Get_Mass_Properties(const ak_sim_shape* Shape, ak_sim__arena* TempArena) {
+    ak_sim_mass_properties Result;
+    AK_SIM_MEMSET(&Result, 0, sizeof(ak_sim_mass_properties));
+    Result.Inertia.Cols[0] = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    Result.Inertia.Cols[1] = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    Result.Inertia.Cols[2] = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+
+    switch(Shape->Type) {
+        case AK_SIM_SHAPE_TYPE_CONVEX: {
+            const ak_sim_convex* Convex = &Shape->Internal.Convex;
+            switch(Convex->Type) {
+                case AK_SIM_CONVEX_TYPE_SPHERE: {
+                    float Radius = Convex->Internal.Sphere.Radius;
+                    Result.Volume = 4.0f/3.0f*AK_SIM__PI*Radius*Radius*Radius;
+                    float I = 0.4f*Result.Volume*Radius*Radius;
+                    Result.Inertia.Cols[0].Data[0] = Result.Inertia.Cols[1].Data[1] = Result.Inertia.Cols[2].Data[2] = I;
+                } break;
+
+                case AK_SIM_CONVEX_TYPE_CAPSULE: {
+                    /*A cylinder plus the two hemispheres shifted out to its caps*/
+                    float Radius = Convex->Internal.Capsule.Radius;
+                    float Height = 2.0f*Convex->Internal.Capsule.HalfHeight;
+                    float CylinderVolume = AK_SIM__PI*Radius*Radius*Height;
+                    float SphereVolume = 4.0f/3.0f*AK_SIM__PI*Radius*Radius*Radius;
+                    Result.Volume = CylinderVolume + SphereVolume;
+
+                    float AxisI = CylinderVolume*Radius*Radius*0.5f + SphereVolume*Radius*Radius*0.4f;
+                    float SideI = CylinderVolume*(Height*Height/12.0f + Radius*Radius*0.25f) + 
+                                  SphereVolume*(Radius*Radius*0.4f + Height*Height*0.25f + 0.375f*Height*Radius);
+                    Result.Inertia.Cols[0].Data[0] = Result.Inertia.Cols[2].Data[2] = SideI;
+                    Result.Inertia.Cols[1].Data[1] = AxisI;
+                } break;
+
+                case AK_SIM_CONVEX_TYPE_HULL: {
+                    Result = AK_Sim__Get_Hull_Mass_Properties(Convex->Internal.Hull.Hull, TempArena);
+                } break;
+
+                default: {
+                    const ak_sim_user_convex* User = &Convex->Internal.User;
+                    if(User->VTable && User->VTable->MassProperties) Result = User->VTable->MassProperties(User->UserData);
+                } break;
+            }
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_COMPOUND: {
+            /*Children are rotated into the compound's frame and combined with the parallel axis theorem*/
+            const ak_sim_compound_shape* Compound = &Shape->Internal.Compound;
+            ak_sim_mass_properties Children[2];
+            ak_sim_m3 Covariance;
+            AK_SIM_MEMSET(&Covariance, 0, sizeof(ak_sim_m3));
+
+            uint32_t Pass, i, Row, Col, k;
+            for(Pass = 0; Pass < 2; Pass++) {
+                for(i = 0; i < Compound->ShapeCount; i++) {
+                    const ak_sim_generic_shape* Child = Compound->Shapes + i;
+                    Children[0] = AK_Sim__Get_Mass_Properties(&Child->Shape, TempArena);
+                    if(Children[0].Volume <= 0.0f) continue;
+
+                    ak_sim_m3 R = AK_Sim__Quat_To_M3(Child->Transform.Orientation);
+                    ak_sim_v3 Center = AK_Sim__V3_Add(Child->Transform.Position, AK_Sim__M3_Mul_V3(&R, Children[0].CenterOfMass));
+                    if(Pass == 0) {
+                        Result.Volume += Children[0].Volume;
+                        Result.CenterOfMass = AK_Sim__V3_Add(Result.CenterOfMass, AK_Sim__V3_Mul_S(Center, Children[0].Volume));
+                        continue;
+                    }
+
+                    /*Child covariance about its own center, rotated, then shifted to the compound center*/
+                    ak_sim_v3 Offset = AK_Sim__V3_Sub(Center, Children[1].CenterOfMass);
+                    const ak_sim_m3* I = &Children[0].Inertia;
+                    float Trace = 0.5f*(I->Cols[0].Data[0] + I->Cols[1].Data[1] + I->Cols[2].Data[2]);
+                    for(Col = 0; Col < 3; Col++) {
+                        for(Row = 0; Row < 3; Row++) {
+                            float Value = 0.0f;
+                            uint32_t l;
+                            for(k = 0; k < 3; k++) {
+                                for(l = 0; l < 3; l++) {
+                                    float ChildCovariance = (k == l ? Trace : 0.0f) - I->Cols[l].Data[k];
+                                    Value += R.Cols[k].Data[Row]*ChildCovariance*R.Cols[l].Data[Col];
+                                }
+                            }
+                            Covariance.Cols[Col].Data[Row] += Value + Children[0].Volume*Offset.Data[Row]*Offset.Data[Col];
+                        }
+                    }
+                }
+
+                if(Pass == 0) {
+                    if(Result.Volume <= 0.0f) break;
+                    Result.CenterOfMass = AK_Sim__V3_Mul_S(Result.CenterOfMass, 1.0f/Result.Volume);
+                    Children[1].CenterOfMass = Result.CenterOfMass;
+                }
+            }
+
+            if(Result.Volume > 0.0f) Result.Inertia = AK_Sim__Inertia_From_Covariance(&Covariance);
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_MESH:
+        case AK_SIM_SHAPE_TYPE_HEIGHTFIELD: {
+        } break;
+
+        default: {
+            const ak_sim_user_shape* User = &Shape->Internal.User;
+            if(User->VTable && User->VTable->MassProperties) Result = User->VTable->MassProperties(User->UserData);
+        } break;
+    }
+
+    return Result;
+}
+
+AKSIMDEF ak_sim_shape_id AK_Sim_Create_Shape(ak_sim_context* Context, const ak_sim_shape_info* ShapeInfo) {
+    ak_sim__pool_id ID;
+    ID.ID = AK_Sim__Pool_Allocate(&Context->ShapePool);
+    ak_sim__shape_entry* Entry = (ak_sim__shape_entry*)AK_Sim__Pool_Get_Item(&Context->ShapePool, ID.Internal.Index);
+    AK_SIM_MEMSET(Entry, 0, sizeof(ak_sim__shape_entry));
+    AK_Sim__Shape_From_Info(&Entry->Shape, ShapeInfo);
+
+    if(Entry->Shape.Type >= AK_SIM_SHAPE_TYPE_USER) {
+        uint32_t Index = Entry->Shape.Type - AK_SIM_SHAPE_TYPE_USER;
+        AK_SIM_ASSERT(Index < Context->ShapeVTableCount);
+        Entry->Shape.Internal.User.VTable = Context->ShapeVTables + Index;
+    } else if(Entry->Shape.Type == AK_SIM_SHAPE_TYPE_CONVEX && Entry->Shape.Internal.Convex.Type >= AK_SIM_CONVEX_TYPE_USER) {
+        uint32_t Index = Entry->Shape.Internal.Convex.Type - AK_SIM_CONVEX_TYPE_USER;
+        AK_SIM_ASSERT(Index < Context->ConvexVTableCount);
+        Entry->Shape.Internal.Convex.Internal.User.VTable = Context->ConvexVTables + Index;
+    }
+
+    /*Large hulls without adjacency would fall back to scanning every vertex per support query*/
+    if(Entry->Shape.Type == AK_SIM_SHAPE_TYPE_CONVEX && Entry->Shape.Internal.Convex.Type == AK_SIM_CONVEX_TYPE_HULL) {
+        const ak_sim_hull* Hull = Entry->Shape.Internal.Convex.Internal.Hull.Hull;
+        if(Hull->VtxCount > AK_SIM__SUPPORT_BRUTE_FORCE_MAX && !Hull->AdjacencyOffsets) {
+            ak_sim_hull Copy = *Hull;
+            size_t BuildSize = AK_Sim_Build_Hull_Adjacency(&Copy, NULL, 0);
+            if(BuildSize) {
+                /*Build in temp memory and only keep the adjacency, not the scratch after it*/
+                ak_sim__temp_arena Temp = AK_Sim__Arena_Begin_Temp(&Context->TempArena);
+                AK_Sim_Build_Hull_Adjacency(&Copy, AK_Sim__Arena_Push(&Context->TempArena, BuildSize), BuildSize);
+                size_t AdjacencySize = (Copy.VtxCount+1+Copy.AdjacencyOffsets[Copy.VtxCount])*sizeof(uint32_t);
+                size_t HullSize = AK_Sim__Align_Pow2(sizeof(ak_sim_hull), 8);
+                uint8_t* Memory = (uint8_t*)AK_Sim__Allocate_Memory(&Context->Allocator, HullSize+AdjacencySize);
+                uint32_t* AdjacencyOffsets = (uint32_t*)(Memory+HullSize);
+                AK_SIM_MEMCPY(AdjacencyOffsets, Copy.AdjacencyOffsets, AdjacencySize);
+                Copy.AdjacencyOffsets = AdjacencyOffsets;
+                Copy.AdjacentVertices = AdjacencyOffsets + Copy.VtxCount+1;
+                AK_SIM_MEMCPY(Memory, &Copy, sizeof(ak_sim_hull));
+                AK_Sim__Arena_End_Temp(&Temp);
+                Entry->SupportData = Memory;
+                Entry->SupportDataSize = HullSize+AdjacencySize;
+                Entry->Shape.Internal.Convex.Internal.Hull.Hull = (ak_sim_hull*)Memory;
+            }
+        }
+    }
+
+    ak_sim_m4x3 Identity;
+    AK_SIM_MEMSET(&Identity, 0, sizeof(ak_sim_m4x3));
+    Identity.Cols[0] = AK_Sim_V3(1.0f, 0.0f, 0.0f);
+    Identity.Cols[1] = AK_Sim_V3(0.0f, 1.0f, 0.0f);
+    Identity.Cols[2] = AK_Sim_V3(0.0f, 0.0f, 1.0f);
+    Identity.Cols[3] = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    Entry->LocalAABB = AK_Sim__Get_Shape_AABB(&Entry->Shape, &Identity, AK_Sim_V3(1.0f, 1.0f, 1.0f));
+    Entry->MassProperties = AK_Sim__Get_Mass_Properties(&Entry->Shape, &Context->TempArena);
+    Entry->RefCount = 1;
+    return AK_Sim__Shape_ID_From_Pool_ID(ID);
+}
+
+AKSIMDEF void AK_Sim_Release_Shape(ak_sim_context* Context, ak_sim_shape_id ShapeID) {
+    ak_sim__shape_entry* Entry = AK_Sim__Get_Shape_Entry(Context, ShapeID);
+    if(Entry && Entry->RefCount) {
+        Entry->RefCount--;
+        AK_Sim__Free_Shape_If_Unused(Context, ShapeID);
+    }
+}
+
+AKSIMDEF const ak_sim_shape* AK_Sim_Get_Shape(ak_sim_context* Context, ak_sim_shape_id ShapeID) {
+    ak_sim__shape_entry* Entry = AK_Sim__Get_Shape_Entry(Context, ShapeID);
+    return Entry ? &Entry->Shape : NULL;
+}
+
+AKSIMDEF ak_sim_mass_properties AK_Sim_Get_Shape_Mass_Properties(ak_sim_context* Context, ak_sim_shape_id ShapeID) {
+    ak_sim_mass_properties Result;
+    ak_sim__shape_entry* Entry = AK_Sim__Get_Shape_Entry(Context, ShapeID);
+    if(Entry) return Entry->MassProperties;
+    AK_SIM_MEMSET(&Result, 0, sizeof(ak_sim_mass_properties));
+    return Result;
+}
+
+/*Hulls, meshes, compounds and heightfields use the precomputed local bounds instead of visiting 
+  every vertex. Rounded shapes are cheaper and tighter to bound directly*/
+static ak_sim__aabb AK_Sim__Get_Shape_Entry_AABB(const ak_sim__shape_entry* Entry, const ak_sim_m4x3* Transform, ak_sim_v3 Scale) {
+    const ak_sim_shape* Shape = &Entry->Shape;
+    int UseLocalAABB = Shape->Type == AK_SIM_SHAPE_TYPE_MESH || Shape->Type == AK_SIM_SHAPE_TYPE_COMPOUND || Shape->Type == AK_SIM_SHAPE_TYPE_HEIGHTFIELD || 
+                       (Shape->Type == AK_SIM_SHAPE_TYPE_CONVEX && Shape->Internal.Convex.Type == AK_SIM_CONVEX_TYPE_HULL);
+    if(!UseLocalAABB) return AK_Sim__Get_Shape_AABB(Shape, Transform, Scale);
+    return AK_Sim__Get_Box_AABB(&Entry->LocalAABB, Transform, Scale);
+}
+
+/*Bodies restored by a snapshot load may use different shapes than the ones they replaced*/
+static void AK_Sim__Recount_Shape_Bodies(ak_sim_context* Context) {
+    ak_sim__pool_iter ShapeIter = AK_Sim__Pool_Begin_Iter(&Context->ShapePool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&ShapeIter)) {
+        ak_sim__shape_entry* Entry = (ak_sim__shape_entry*)AK_Sim__Pool_Iter_Next(&ShapeIter);
+        Entry->BodyCount = 0;
+    }
+
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(&Context->BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        ak_sim__shape_entry* Entry = AK_Sim__Get_Shape_Entry(Context, Body->Shape);
+        AK_SIM_ASSERT(Entry);
+        Entry->BodyCount++;
+    }
+}
+
+/*Scales the shape's unit density covariance, then moves it from the center of mass to the body 
+  origin. Scaling the covariance is exact for any scale, unlike scaling the inertia*/
+static void AK_Sim__Set_Body_Mass(ak_sim_body* Body, const ak_sim__shape_entry* Shape, float Density) {
+    const ak_sim_mass_properties* Properties = &Shape->MassProperties;
+    ak_sim_v3 Scale = Body->Scale;
+    float ScaleVolume = AK_Sim__Abs(Scale.Data[0]*Scale.Data[1]*Scale.Data[2]);
+    float Mass = Density*Properties->Volume*ScaleVolume;
+
+    Body->InvMass = 0.0f;
+    AK_SIM_MEMSET(&Body->InvInertia, 0, sizeof(ak_sim_m3));
+    if(Body->Type != AK_SIM_BODY_TYPE_DYNAMIC || Mass <= 0.0f) return;
+
+    const ak_sim_m3* I = &Properties->Inertia;
+    ak_sim_v3 Center = AK_Sim__V3_Mul(Properties->CenterOfMass, Scale);
+    float Trace = 0.5f*(I->Cols[0].Data[0] + I->Cols[1].Data[1] + I->Cols[2].Data[2]);
+    ak_sim_m3 Covariance;
+    uint32_t Row, Col;
+    for(Col = 0; Col < 3; Col++) {
+        Covariance.Cols[Col] = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+        for(Row = 0; Row < 3; Row++) {
+            float UnitCovariance = (Row == Col ? Trace : 0.0f) - I->Cols[Col].Data[Row];
+            Covariance.Cols[Col].Data[Row] = Density*ScaleVolume*UnitCovariance*Scale.Data[Row]*Scale.Data[Col] + 
+                                             Mass*Center.Data[Row]*Center.Data[Col];
+        }
+    }
+
+    ak_sim_m3 Inertia = AK_Sim__Inertia_From_Covariance(&Covariance);
+    Body->InvMass = 1.0f/Mass;
+    Body->InvInertia = AK_Sim__M3_Inverse(&Inertia);
+}
+
+AKSIMDEF ak_sim_body_id AK_Sim_Create_Body(ak_sim_context* Context, const ak_sim_body_create_info* CreateInfo) {
+    ak_sim__pool_id ID;
+    ID.ID = AK_Sim__Pool_Allocate(&Context->BodyPool);
+    ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Get_Item(&Context->BodyPool, ID.Internal.Index);
+    AK_SIM_MEMSET(Body, 0, sizeof(ak_sim_body));
+
+    Body->ID = ID.ID;
+    Body->Transform.Position = CreateInfo->Position;
+    Body->Transform.Orientation = AK_Sim__Quat_Normalize(CreateInfo->Orientation);
+    Body->PrevTransform = Body->Transform;
+
+    /*Zero scale is almost always an uninitialized create info, so treat it as unit scale*/
+    Body->Scale = CreateInfo->Scale;
+    if(Body->Scale.Data[0] == 0.0f && Body->Scale.Data[1] == 0.0f && Body->Scale.Data[2] == 0.0f) {
+        Body->Scale = AK_Sim_V3(1.0f, 1.0f, 1.0f);
+    }
+
+    Body->Type = CreateInfo->Type;
+    Body->Flags = CreateInfo->Flags;
+    Body->CollisionCategory = CreateInfo->CollisionCategory ? CreateInfo->CollisionCategory : AK_SIM_DEFAULT_COLLISION_CATEGORY;
+    Body->CollisionMask = CreateInfo->CollisionMask ? CreateInfo->CollisionMask : AK_SIM_DEFAULT_COLLISION_MASK;
+
+    if(Body->Type != AK_SIM_BODY_TYPE_STATIC) {
+        Body->LinearVelocity = CreateInfo->LinearVelocity;
+        Body->AngularVelocity = CreateInfo->AngularVelocity;
+    } else {
+        Context->StaticTreeDirty = 1;
+    }
+    Context->BroadphaseDirty = 1;
+
+    ak_sim__shape_entry* Shape = AK_Sim__Get_Shape_Entry(Context, CreateInfo->Shape);
+    AK_SIM_ASSERT(Shape);
+    Shape->BodyCount++;
+    Body->Shape = CreateInfo->Shape;
+    Body->UserData = CreateInfo->UserData;
+    AK_Sim__Set_Body_Mass(Body, Shape, CreateInfo->Density > 0.0f ? CreateInfo->Density : AK_SIM_DEFAULT_DENSITY);
+    return ID.ID;
+}
+
+static void AK_Sim__Wake_Body(ak_sim_body* Body) {
+    if(Body) {
+        Body->Flags &= ~AK_SIM_BODY_FLAG_SLEEPING;
+        Body->SleepTime = 0.0f;
+    }
+}
+
+/*Bodies resting on a deleted body have nothing holding them anymore*/
+static void AK_Sim__Wake_Touching_Bodies(ak_sim_context* Context, ak_sim_body_id BodyID) {
+    ak_sim__pair_cache_table* Table = Context->PairCaches + Context->PairCacheIndex;
+    uint32_t i;
+    for(i = 0; i < Table->Pairs.ItemCount; i++) {
+        const ak_sim__body_id_pair* Pair = (const ak_sim__body_id_pair*)AK_Sim__Set_Get_Key(&Table->Pairs, i);
+        if(!(Table->Caches[i].Flags & AK_SIM__PAIR_FLAG_TOUCHING)) continue;
+        if(Pair->AID == BodyID) AK_Sim__Wake_Body((ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->BID));
+        if(Pair->BID == BodyID) AK_Sim__Wake_Body((ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->AID));
+    }
+}
+
+AKSIMDEF void AK_Sim_Delete_Body(ak_sim_context* Context, ak_sim_body_id BodyID) {
+    ak_sim__pool_id ID;
+    ID.ID = BodyID;
+    ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, BodyID);
+    if(Body) {
+        if(Body->Type == AK_SIM_BODY_TYPE_STATIC) Context->StaticTreeDirty = 1;
+        Context->BroadphaseDirty = 1;
+        AK_Sim__Wake_Touching_Bodies(Context, BodyID);
+
+        ak_sim_shape_id ShapeID = Body->Shape;
+        ak_sim__shape_entry* Shape = AK_Sim__Get_Shape_Entry(Context, ShapeID);
+        AK_SIM_ASSERT(Shape && Shape->BodyCount);
+        Shape->BodyCount--;
+
+        AK_Sim__Pool_Free(&Context->BodyPool, ID);
+        AK_Sim__Free_Shape_If_Unused(Context, ShapeID);
+    }
+}
+
+AKSIMDEF ak_sim_body* AK_Sim_Get_Body(ak_sim_context* Context, ak_sim_body_id BodyID) {
+    return (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, BodyID);
+}
+
+AKSIMDEF void AK_Sim_Wake_Body(ak_sim_context* Context, ak_sim_body_id BodyID) {
+    AK_Sim__Wake_Body(AK_Sim_Get_Body(Context, BodyID));
+}
+
+AKSIMDEF ak_sim_joint_id AK_Sim_Create_Joint(ak_sim_context* Context, const ak_sim_joint_create_info* CreateInfo) {
+    ak_sim_body* BodyA = AK_Sim_Get_Body(Context, CreateInfo->BodyA);
+    ak_sim_body* BodyB = AK_Sim_Get_Body(Context, CreateInfo->BodyB);
+    AK_SIM_ASSERT(BodyA && BodyB && BodyA != BodyB);
+    if(!BodyA || !BodyB || BodyA == BodyB) return AK_SIM_INVALID_JOINT_ID;
+    AK_Sim__Wake_Body(BodyA);
+    AK_Sim__Wake_Body(BodyB);
+
+    ak_sim__pool_id ID;
+    ID.ID = AK_Sim__Pool_Allocate(&Context->JointPool);
+    ak_sim_joint* Joint = (ak_sim_joint*)AK_Sim__Pool_Get_Item(&Context->JointPool, ID.Internal.Index);
+    AK_SIM_MEMSET(Joint, 0, sizeof(ak_sim_joint));
+
+    Joint->ID = ID.ID;
+    Joint->Type = CreateInfo->Type;
+    Joint->BodyA = CreateInfo->BodyA;
+    Joint->BodyB = CreateInfo->BodyB;
+    Joint->UserData = CreateInfo->UserData;
+
+    ak_sim_m3 RotationA = AK_Sim__Quat_To_M3(BodyA->Transform.Orientation);
+    ak_sim_m3 RotationB = AK_Sim__Quat_To_M3(BodyB->Transform.Orientation);
+    ak_sim_position AnchorB = CreateInfo->Type == AK_SIM_JOINT_TYPE_DISTANCE ? CreateInfo->AnchorB : CreateInfo->AnchorA;
+    Joint->LocalAnchorA = AK_Sim__M3_Transpose_Mul_V3(&RotationA, AK_Sim__Position_Sub(CreateInfo->AnchorA, BodyA->Transform.Position));
+    Joint->LocalAnchorB = AK_Sim__M3_Transpose_Mul_V3(&RotationB, AK_Sim__Position_Sub(AnchorB, BodyB->Transform.Position));
+
+    ak_sim_v3 Axis = AK_Sim__V3_Normalize(CreateInfo->Axis);
+    Joint->LocalAxisA = AK_Sim__M3_Transpose_Mul_V3(&RotationA, Axis);
+    Joint->LocalAxisB = AK_Sim__M3_Transpose_Mul_V3(&RotationB, Axis);
+    Joint->RelativeOrientation = AK_Sim__Quat_Mul(AK_Sim__Quat_Conjugate(BodyA->Transform.Orientation), BodyB->Transform.Orientation);
+
+    Joint->Distance = CreateInfo->Distance;
+    if(Joint->Distance <= 0.0f) Joint->Distance = AK_Sim__V3_Length(AK_Sim__Position_Sub(AnchorB, CreateInfo->AnchorA));
+    return ID.ID;
+}
+
+AKSIMDEF void AK_Sim_Delete_Joint(ak_sim_context* Context, ak_sim_joint_id JointID) {
+    ak_sim__pool_id ID;
+    ID.ID = JointID;
+    ak_sim_joint* Joint = (ak_sim_joint*)AK_Sim__Pool_Get(&Context->JointPool, JointID);
+    if(Joint) {
+        AK_Sim__Wake_Body(AK_Sim_Get_Body(Context, Joint->BodyA));
+        AK_Sim__Wake_Body(AK_Sim_Get_Body(Context, Joint->BodyB));
+        AK_Sim__Pool_Free(&Context->JointPool, ID);
+    }
+}
+
+AKSIMDEF ak_sim_joint* AK_Sim_Get_Joint(ak_sim_context* Context, ak_sim_joint_id JointID) {
+    return (ak_sim_joint*)AK_Sim__Pool_Get(&Context->JointPool, JointID);
+}
+
+AKSIMDEF ak_sim_cloth_id AK_Sim_Create_Cloth(ak_sim_context* Context, const ak_sim_cloth_create_info* CreateInfo) {
+    uint32_t ParticleCount = CreateInfo->ParticleCount;
+    uint32_t ConstraintCapacity = CreateInfo->EdgeCount + CreateInfo->BendCount;
+    AK_SIM_ASSERT(ParticleCount && CreateInfo->Positions);
+    if(!ParticleCount || !CreateInfo->Positions) return AK_SIM_INVALID_CLOTH_ID;
+
+    ak_sim__pool_id ID;
+    ID.ID = AK_Sim__Pool_Allocate(&Context->ClothPool);
+    ak_sim__cloth* Cloth = (ak_sim__cloth*)AK_Sim__Pool_Get_Item(&Context->ClothPool, ID.Internal.Index);
+    AK_SIM_MEMSET(Cloth, 0, sizeof(ak_sim__cloth));
+
+    /*Constraints go first so the float arrays after them stay aligned*/
+    Cloth->MemorySize = ConstraintCapacity*sizeof(ak_sim__cloth_constraint) + 10*ParticleCount*sizeof(float);
+    Cloth->Memory = AK_Sim__Allocate_Memory(&Context->Allocator, Cloth->MemorySize);
+    Cloth->Constraints = (ak_sim__cloth_constraint*)Cloth->Memory;
+    float* Floats = (float*)(Cloth->Constraints + ConstraintCapacity);
+    uint32_t i, k;
+    for(k = 0; k < 3; k++) {
+        Cloth->X[k] = Floats + k*ParticleCount;
+        Cloth->PrevX[k] = Floats + (3+k)*ParticleCount;
+        Cloth->V[k] = Floats + (6+k)*ParticleCount;
+    }
+    Cloth->InvMasses = Floats + 9*ParticleCount;
+
+    Cloth->ID = ID.ID;
+#ifdef AK_SIM_DOUBLE_PRECISION
+    Cloth->Origin = CreateInfo->Positions[0];
+#else
+    Cloth->Origin = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+#endif
+    Cloth->ParticleCount = ParticleCount;
+    Cloth->Radius = CreateInfo->Radius;
+    Cloth->Friction = CreateInfo->Friction;
+    Cloth->Damping = CreateInfo->Damping;
+    Cloth->Gravity = CreateInfo->Gravity;
+    Cloth->CollisionCategory = CreateInfo->CollisionCategory ? CreateInfo->CollisionCategory : AK_SIM_DEFAULT_COLLISION_CATEGORY;
+    Cloth->CollisionMask = CreateInfo->CollisionMask ? CreateInfo->CollisionMask : AK_SIM_DEFAULT_COLLISION_MASK;
+
+    for(i = 0; i < ParticleCount; i++) {
+        ak_sim_v3 P = AK_Sim__Position_Sub(CreateInfo->Positions[i], Cloth->Origin);
+        for(k = 0; k < 3; k++) {
+            Cloth->X[k][i] = P.Data[k];
+            Cloth->PrevX[k][i] = P.Data[k];
+            Cloth->V[k][i] = 0.0f;
+        }
+        Cloth->InvMasses[i] = CreateInfo->InvMasses ? CreateInfo->InvMasses[i] : 1.0f;
+    }
+
+    /*Greedy coloring on the particles, then a stable counting sort by color*/
+    ak_sim__arena* TempArena = &Context->TempArena;
+    ak_sim__temp_arena Temp = AK_Sim__Arena_Begin_Temp(TempArena);
+    uint32_t* ColorMasks = AK_Sim__Arena_Push_Array(TempArena, ParticleCount, uint32_t);
+    ak_sim__cloth_constraint* Constraints = AK_Sim__Arena_Push_Array(TempArena, ConstraintCapacity+1, ak_sim__cloth_constraint);
+    uint32_t* Colors = AK_Sim__Arena_Push_Array(TempArena, ConstraintCapacity+1, uint32_t);
+    AK_SIM_MEMSET(ColorMasks, 0, ParticleCount*sizeof(uint32_t));
+
+    uint32_t ColorCounts[AK_SIM__MAX_CLOTH_COLORS+1];
+    AK_SIM_MEMSET(ColorCounts, 0, sizeof(ColorCounts));
+    uint32_t ConstraintCount = 0;
+    for(i = 0; i < ConstraintCapacity; i++) {
+        int IsEdge = i < CreateInfo->EdgeCount;
+        const uint32_t* Pair = IsEdge ? CreateInfo->Edges + 2*i : CreateInfo->Bends + 2*(i-CreateInfo->EdgeCount);
+        AK_SIM_ASSERT(Pair[0] < ParticleCount && Pair[1] < ParticleCount && Pair[0] != Pair[1]);
+        if(Pair[0] >= ParticleCount || Pair[1] >= ParticleCount || Pair[0] == Pair[1]) continue;
+
+        ak_sim__cloth_constraint* Constraint = Constraints + ConstraintCount;
+        Constraint->A = Pair[0];
+        Constraint->B = Pair[1];
+        Constraint->RestLength = AK_Sim__V3_Length(AK_Sim__Position_Sub(CreateInfo->Positions[Pair[1]], CreateInfo->Positions[Pair[0]]));
+        Constraint->Compliance = IsEdge ? CreateInfo->EdgeCompliance : CreateInfo->BendCompliance;
+
+        uint32_t Used = ColorMasks[Constraint->A] | ColorMasks[Constraint->B];
+        uint32_t Color = 0;
+        while(Color < AK_SIM__MAX_CLOTH_COLORS && (Used & (1u << Color))) Color++;
+        if(Color < AK_SIM__MAX_CLOTH_COLORS) {
+            ColorMasks[Constraint->A] |= 1u << Color;
+            ColorMasks[Constraint->B] |= 1u << Color;
+        }
+        Colors[ConstraintCount++] = Color;
+        ColorCounts[Color]++;
+    }
+
+    uint32_t Offset = 0;
+    uint32_t Color;
+    for(Color = 0; Color <= AK_SIM__MAX_CLOTH_COLORS; Color++) {
+        Cloth->ColorOffsets[Color] = Offset;
+        Offset += ColorCounts[Color];
+        ColorCounts[Color] = Cloth->ColorOffsets[Color];
+    }
+    Cloth->ColorOffsets[AK_SIM__MAX_CLOTH_COLORS+1] = Offset;
+    for(i = 0; i < ConstraintCount; i++) {
+        Cloth->Constraints[ColorCounts[Colors[i]]++] = Constraints[i];
+    }
+
+    AK_Sim__Arena_End_Temp(&Temp);
+    AK_Sim__Reserve_Budgets(Context);
+    return ID.ID;
+}
+
+AKSIMDEF void AK_Sim_Delete_Cloth(ak_sim_context* Context, ak_sim_cloth_id ClothID) {
+    ak_sim__pool_id ID;
+    ID.ID = ClothID;
+    ak_sim__cloth* Cloth = (ak_sim__cloth*)AK_Sim__Pool_Get(&Context->ClothPool, ClothID);
+    if(Cloth) {
+        AK_Sim__Free_Memory(&Context->Allocator, Cloth->Memory);
+        AK_Sim__Pool_Free(&Context->ClothPool, ID);
+    }
+}
+
+AKSIMDEF uint32_t AK_Sim_Get_Cloth_Positions(ak_sim_context* Context, ak_sim_cloth_id ClothID, ak_sim_position* Positions, uint32_t MaxCount) {
+    const ak_sim__cloth* Cloth = (const ak_sim__cloth*)AK_Sim__Pool_Get(&Context->ClothPool, ClothID);
+    if(!Cloth) return 0;
+
+    if(Positions) {
+        uint32_t Count = AK_Sim__Min(MaxCount, Cloth->ParticleCount);
+        uint32_t i;
+        for(i = 0; i < Count; i++) {
+            Positions[i] = AK_Sim__Position_Add_V3(Cloth->Origin, AK_Sim_V3(Cloth->X[0][i], Cloth->X[1][i], Cloth->X[2][i]));
+        }
+    }
+    return Cloth->ParticleCount;
+}
+
+AKSIMDEF void AK_Sim_Set_Cloth_Particle(ak_sim_context* Context, ak_sim_cloth_id ClothID, uint32_t Index, ak_sim_position Position, float InvMass) {
+    ak_sim__cloth* Cloth = (ak_sim__cloth*)AK_Sim__Pool_Get(&Context->ClothPool, ClothID);
+    AK_SIM_ASSERT(!Cloth || Index < Cloth->ParticleCount);
+    if(!Cloth || Index >= Cloth->ParticleCount) return;
+
+    ak_sim_v3 P = AK_Sim__Position_Sub(Position, Cloth->Origin);
+    uint32_t k;
+    for(k = 0; k < 3; k++) {
+        Cloth->X[k][Index] = P.Data[k];
+        Cloth->PrevX[k][Index] = P.Data[k];
+        Cloth->V[k][Index] = 0.0f;
+    }
+    Cloth->InvMasses[Index] = InvMass;
+}
+
+/*Point the body's float collision data is computed around. Double precision worlds rebase on the 
+  body itself so the float kernels only ever see small offsets*/
+static ak_sim_position AK_Sim__Get_Body_Origin(const ak_sim_body* Body) {
+#ifdef AK_SIM_DOUBLE_PRECISION
+    return Body->Transform.Position;
+#else
+    return AK_Sim_V3(0.0f, 0.0f, 0.0f);
+#endif
+}
+
+/*Bounds around Origin moved to world space. In double precision the move is done in double and 
+  the result rounded outward, so the float bounds never lose part of what they hold*/
+static ak_sim__aabb AK_Sim__Get_World_AABB(const ak_sim__aabb* AABB, ak_sim_position Origin) {
+    ak_sim__aabb Result = *AABB;
+#ifdef AK_SIM_DOUBLE_PRECISION
+    uint32_t i;
+    for(i = 0; i < 3; i++) {
+        double Min = Origin.Data[i] + (double)Result.Min.Data[i];
+        double Max = Origin.Data[i] + (double)Result.Max.Data[i];
+
+        /*Two float ulps at this magnitude cover the rounding of the cast and the margin itself*/
+        float Margin = (float)(AK_Sim__Max(AK_Sim__Abs(Min), AK_Sim__Abs(Max))*2.4e-7);
+        Result.Min.Data[i] = (float)Min - Margin;
+        Result.Max.Data[i] = (float)Max + Margin;
+    }
+#else
+    Result.Min = AK_Sim__V3_Add(Result.Min, Origin);
+    Result.Max = AK_Sim__V3_Add(Result.Max, Origin);
+#endif
+    return Result;
+}
+
+/*World bounds moved so Origin is at zero, the inverse of AK_Sim__Get_World_AABB*/
+static ak_sim__aabb AK_Sim__Get_Local_AABB(const ak_sim__aabb* AABB, ak_sim_position Origin) {
+    ak_sim__aabb Result = *AABB;
+#ifdef AK_SIM_DOUBLE_PRECISION
+    uint32_t i;
+    for(i = 0; i < 3; i++) {
+        double Min = (double)Result.Min.Data[i] - Origin.Data[i];
+        double Max = (double)Result.Max.Data[i] - Origin.Data[i];
+        float Margin = (float)(AK_Sim__Max(AK_Sim__Abs(Min), AK_Sim__Abs(Max))*2.4e-7);
+        Result.Min.Data[i] = (float)Min - Margin;
+        Result.Max.Data[i] = (float)Max + Margin;
+    }
+#else
+    Result.Min = AK_Sim__V3_Sub(Result.Min, Origin);
+    Result.Max = AK_Sim__V3_Sub(Result.Max, Origin);
+#endif
+    return Result;
+}
+
+/*World bounds of the body. In double precision they're computed around the body and then moved 
+  to its position*/
+static ak_sim__aabb AK_Sim__Get_Body_AABB(ak_sim_context* Context, const ak_sim_body* Body) {
+    ak_sim_position Origin = AK_Sim__Get_Body_Origin(Body);
+    ak_sim_m4x3 Transform = AK_Sim__Get_Body_Matrix_Transform(&Body->Transform, Origin);
+    ak_sim__aabb Result = AK_Sim__Get_Shape_Entry_AABB(AK_Sim__Get_Shape_Entry(Context, Body->Shape), &Transform, Body->Scale);
+    return AK_Sim__Get_World_AABB(&Result, Origin);
+}
+
+/*Bounds of the body swept over one fixed step, so the pair list stays valid for every substep*/
+static ak_sim__aabb AK_Sim__Get_Swept_AABB(const ak_sim__aabb* AABB, const ak_sim_body* Body, float DeltaTime) {
+    ak_sim__aabb Result = *AABB;
+
+    ak_sim_v3 Displacement = AK_Sim__V3_Mul_S(Body->LinearVelocity, DeltaTime);
+    ak_sim__aabb Swept = Result;
+    Swept.Min = AK_Sim__V3_Add(Swept.Min, Displacement);
+    Swept.Max = AK_Sim__V3_Add(Swept.Max, Displacement);
+    Result = AK_Sim__AABB_Union(&Result, &Swept);
+
+    /*Rotation can move the surface by at most the angular speed times the bounding radius*/
+    ak_sim_v3 HalfExtent = AK_Sim__V3_Mul_S(AK_Sim__V3_Sub(Result.Max, Result.Min), 0.5f);
+    float AngularMargin = AK_Sim__V3_Length(Body->AngularVelocity)*DeltaTime*AK_Sim__V3_Length(HalfExtent);
+    return AK_Sim__AABB_Extend(&Result, AngularMargin);
+}
+
+#define AK_SIM__FAT_AABB_MARGIN 0.05f
+#define AK_SIM__FAT_AABB_PREDICTED_STEPS 4.0f
+
+/*Swept bounds stretched along the velocity, so a body that keeps its course stays inside them 
+  for several steps*/
+static ak_sim__aabb AK_Sim__Get_Fat_AABB(const ak_sim__aabb* SweptAABB, const ak_sim_body* Body, float DeltaTime) {
+    ak_sim_v3 Prediction = AK_Sim__V3_Mul_S(Body->LinearVelocity, DeltaTime*AK_SIM__FAT_AABB_PREDICTED_STEPS);
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim__aabb Result;
+    Result.Min = AK_Sim__V3_Add(SweptAABB->Min, AK_Sim__V3_Min(Prediction, Zero));
+    Result.Max = AK_Sim__V3_Add(SweptAABB->Max, AK_Sim__V3_Max(Prediction, Zero));
+    return AK_Sim__AABB_Extend(&Result, AK_SIM__FAT_AABB_MARGIN);
+}
+
+#define AK_SIM__BVH_LEAF_SIZE 4
+#define AK_SIM__BVH_MAX_DEPTH 64
+
+static float AK_Sim__BVH_Item_Center(const ak_sim__bvh_item* Item, uint32_t Axis) {
+    return Item->AABB.Min.Data[Axis] + Item->AABB.Max.Data[Axis];
+}
+
+/*Quickselect. Puts the K-th item along Axis at K with nothing greater before it and nothing less after*/
+static void AK_Sim__BVH_Select(ak_sim__bvh_item* Items, uint32_t Count, uint32_t K, uint32_t Axis) {
+    uint32_t Low = 0;
+    uint32_t High = Count-1;
+    while(Low < High) {
+        float Pivot = AK_Sim__BVH_Item_Center(&Items[Low + (High-Low)/2], Axis);
+        uint32_t i = Low, j = High;
+        while(i <= j) {
+            while(AK_Sim__BVH_Item_Center(&Items[i], Axis) < Pivot) i++;
+            while(AK_Sim__BVH_Item_Center(&Items[j], Axis) > Pivot) j--;
+            if(i <= j) {
+                ak_sim__bvh_item Temp = Items[i];
+                Items[i] = Items[j];
+                Items[j] = Temp;
+                i++;
+                if(j == 0) break;
+                j--;
+            }
+        }
+        if(K <= j) High = j;
+        else if(K >= i) Low = i;
+        else break;
+    }
+}
+
+static void AK_Sim__BVH_Build_Node(ak_sim__bvh* BVH, uint32_t NodeIndex, uint32_t First, uint32_t Count) {
+    ak_sim__bvh_node* Node = BVH->Nodes + NodeIndex;
+    ak_sim__aabb CenterBounds = AK_Sim__AABB_Empty();
+    Node->AABB = AK_Sim__AABB_Empty();
+
+    uint32_t i;
+    for(i = First; i < First+Count; i++) {
+        ak_sim__bvh_item* Item = BVH->Items + i;
+        Node->AABB = AK_Sim__AABB_Union(&Node->AABB, &Item->AABB);
+        AK_Sim__AABB_Add_Point(&CenterBounds, AK_Sim__V3_Add(Item->AABB.Min, Item->AABB.Max));
+    }
+
+    if(Count <= AK_SIM__BVH_LEAF_SIZE) {
+        Node->First = First;
+        Node->Count = Count;
+        return;
+    }
+
+    /*Median split on the longest axis of the item centers keeps the tree balanced*/
+    ak_sim_v3 Extent = AK_Sim__V3_Sub(CenterBounds.Max, CenterBounds.Min);
+    uint32_t Axis = 0;
+    if(Extent.Data[1] > Extent.Data[Axis]) Axis = 1;
+    if(Extent.Data[2] > Extent.Data[Axis]) Axis = 2;
+
+    uint32_t HalfCount = Count/2;
+    AK_Sim__BVH_Select(BVH->Items + First, Count, HalfCount, Axis);
+
+    uint32_t Children = BVH->NodeCount;
+    BVH->NodeCount += 2;
+    Node->First = Children;
+    Node->Count = 0;
+
+    AK_Sim__BVH_Build_Node(BVH, Children, First, HalfCount);
+    AK_Sim__BVH_Build_Node(BVH, Children+1, First+HalfCount, Count-HalfCount);
+}
+
+/*Reorders Items. Nodes needs room for 2*ItemCount nodes*/
+static void AK_Sim__BVH_Build(ak_sim__bvh* BVH, ak_sim__bvh_item* Items, uint32_t ItemCount, ak_sim__bvh_node* Nodes) {
+    BVH->Nodes = Nodes;
+    BVH->Items = Items;
+    BVH->ItemCount = ItemCount;
+    BVH->NodeCount = 0;
+    if(ItemCount) {
+        BVH->NodeCount = 1;
+        AK_Sim__BVH_Build_Node(BVH, 0, 0, ItemCount);
+    }
+}
+
+static int AK_Sim__Is_Item_Awake(const ak_sim__bvh_item* Item) {
+    return Item->Type != AK_SIM_BODY_TYPE_STATIC && !(Item->Flags & AK_SIM_BODY_FLAG_SLEEPING);
+}
+
+/*Pairs of sleeping and static bodies can't change, so they keep their pair caches instead*/
+static int AK_Sim__Should_Collide(const ak_sim__bvh_item* A, const ak_sim__bvh_item* B) {
+    if(!(A->CollisionCategory & B->CollisionMask) || !(B->CollisionCategory & A->CollisionMask)) return 0;
+    if(!AK_Sim__Is_Item_Awake(A) && !AK_Sim__Is_Item_Awake(B)) return 0;
+    if((A->Flags | B->Flags) & AK_SIM_BODY_FLAG_SENSOR) {
+        if(A->Flags & B->Flags & AK_SIM_BODY_FLAG_SENSOR) return 0;
+        return A->Type != AK_SIM_BODY_TYPE_STATIC || B->Type != AK_SIM_BODY_TYPE_STATIC;
+    }
+    return A->Type == AK_SIM_BODY_TYPE_DYNAMIC || B->Type == AK_SIM_BODY_TYPE_DYNAMIC;
+}
+
+/*Adds the pairs between Item and the tree's items. In its own tree an item only pairs with 
+  items of a larger ID, so every pair is found once*/
+static void AK_Sim__BVH_Find_Pairs(ak_sim__worker* Worker, const ak_sim__bvh* BVH, const ak_sim__bvh_item* Item, int SameTree, ak_sim__array* PairArray) {
+    if(!BVH->NodeCount) return;
+
+    uint32_t Stack[AK_SIM__BVH_MAX_DEPTH];
+    uint32_t StackCount = 0;
+    Stack[StackCount++] = 0;
+    while(StackCount) {
+        const ak_sim__bvh_node* Node = BVH->Nodes + Stack[--StackCount];
+        if(!AK_Sim__AABB_Overlap(&Node->AABB, &Item->AABB)) continue;
+
+        if(Node->Count) {
+            uint32_t i;
+            for(i = Node->First; i < Node->First+Node->Count; i++) {
+                const ak_sim__bvh_item* Other = BVH->Items + i;
+                if(SameTree && Other->ID <= Item->ID) continue;
+                if(!AK_Sim__Should_Collide(Item, Other)) continue;
+
+                AK_Sim__Worker_Count(Worker, PairsTested, 1);
+                if(AK_Sim__AABB_Overlap(&Item->AABB, &Other->AABB)) {
+                    ak_sim__body_id_pair Pair;
+                    Pair.AID = AK_Sim__Min(Item->ID, Other->ID);
+                    Pair.BID = AK_Sim__Max(Item->ID, Other->ID);
+                    AK_Sim__Array_Add(PairArray, &Pair);
+                }
+            }
+        } else {
+            AK_SIM_ASSERT(StackCount+2 <= AK_SIM__BVH_MAX_DEPTH);
+            Stack[StackCount++] = Node->First+1;
+            Stack[StackCount++] = Node->First;
+        }
+    }
+}
+
+/*Adds the IDs of the tree's items that overlap Item and collide with it*/
+static void AK_Sim__BVH_Find_Overlaps(const ak_sim__bvh* BVH, const ak_sim__bvh_item* Item, ak_sim__array* IDArray) {
+    if(!BVH->NodeCount) return;
+
+    uint32_t Stack[AK_SIM__BVH_MAX_DEPTH];
+    uint32_t StackCount = 0;
+    Stack[StackCount++] = 0;
+    while(StackCount) {
+        const ak_sim__bvh_node* Node = BVH->Nodes + Stack[--StackCount];
+        if(!AK_Sim__AABB_Overlap(&Node->AABB, &Item->AABB)) continue;
+
+        if(Node->Count) {
+            uint32_t i;
+            for(i = Node->First; i < Node->First+Node->Count; i++) {
+                const ak_sim__bvh_item* Other = BVH->Items + i;
+                if(AK_Sim__Should_Collide(Item, Other) && AK_Sim__AABB_Overlap(&Item->AABB, &Other->AABB)) {
+                    AK_Sim__Array_Add(IDArray, &Other->ID);
+                }
+            }
+        } else {
+            AK_SIM_ASSERT(StackCount+2 <= AK_SIM__BVH_MAX_DEPTH);
+            Stack[StackCount++] = Node->First+1;
+            Stack[StackCount++] = Node->First;
+        }
+    }
+}
+
+static void AK_Sim__BVH_Item_From_Body(ak_sim__bvh_item* Item, const ak_sim_body* Body, const ak_sim__aabb* AABB) {
+    Item->AABB = *AABB;
+    Item->ID = Body->ID;
+    Item->CollisionCategory = Body->CollisionCategory;
+    Item->CollisionMask = Body->CollisionMask;
+    Item->Type = Body->Type;
+    Item->Flags = Body->Flags;
+}
+
+/*For the trees that persist between steps. Their contents are rebuilt afterwards*/
+static void AK_Sim__Reserve_Tree(ak_sim_context* Context, ak_sim__bvh* Tree, uint32_t* TreeCapacity, uint32_t Capacity) {
+    if(Capacity > *TreeCapacity) {
+        if(Tree->Items) AK_Sim__Free_Memory(&Context->Allocator, Tree->Items);
+        if(Tree->Nodes) AK_Sim__Free_Memory(&Context->Allocator, Tree->Nodes);
+        Tree->Items = (ak_sim__bvh_item*)AK_Sim__Allocate_Memory(&Context->Allocator, Capacity*sizeof(ak_sim__bvh_item));
+        Tree->Nodes = (ak_sim__bvh_node*)AK_Sim__Allocate_Memory(&Context->Allocator, 2*Capacity*sizeof(ak_sim__bvh_node));
+        *TreeCapacity = Capacity;
+    }
+}
+
+static void AK_Sim__Rebuild_Static_Tree(ak_sim_context* Context) {
+    ak_sim__bvh* Tree = &Context->StaticTree;
+    uint32_t StaticCount = 0;
+
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(&Context->BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        StaticCount += Body->Type == AK_SIM_BODY_TYPE_STATIC;
+    }
+
+    if(StaticCount > Context->StaticTreeCapacity) {
+        AK_Sim__Reserve_Tree(Context, Tree, &Context->StaticTreeCapacity, AK_Sim__Max(Context->StaticTreeCapacity*2, AK_Sim__Max(StaticCount, 64)));
+    }
+
+    uint32_t ItemCount = 0;
+    BodyIter = AK_Sim__Pool_Begin_Iter(&Context->BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        if(Body->Type == AK_SIM_BODY_TYPE_STATIC) {
+            ak_sim__pool_id ID;
+            ID.ID = Body->ID;
+            ak_sim__aabb AABB = AK_Sim__Get_Body_AABB(Context, Body);
+            AK_Sim__BVH_Item_From_Body(&Tree->Items[ItemCount++], Body, &AABB);
+            Context->BodyBounds[ID.Internal.Index].SweptAABB = AABB;
+        }
+    }
+
+    AK_Sim__BVH_Build(Tree, Tree->Items, ItemCount, Tree->Nodes);
+    Context->StaticTreeDirty = 0;
+    Context->BroadphaseDirty = 1;
+}
+
+static void AK_Sim__Reserve_Body_Bounds(ak_sim_context* Context, uint32_t SlotCount) {
+    if(SlotCount > Context->BodyBoundsCapacity) {
+        uint32_t NewCapacity = AK_Sim__Max(Context->BodyBoundsCapacity*2, AK_Sim__Max(SlotCount, 64));
+        ak_sim__body_bounds* BodyBounds = (ak_sim__body_bounds*)AK_Sim__Allocate_Memory(&Context->Allocator, NewCapacity*sizeof(ak_sim__body_bounds));
+        AK_SIM_MEMSET(BodyBounds, 0, NewCapacity*sizeof(ak_sim__body_bounds));
+        if(Context->BodyBounds) {
+            AK_SIM_MEMCPY(BodyBounds, Context->BodyBounds, Context->BodyBoundsCapacity*sizeof(ak_sim__body_bounds));
+            AK_Sim__Free_Memory(&Context->Allocator, Context->BodyBounds);
+        }
+        Context->BodyBounds = BodyBounds;
+        Context->BodyBoundsCapacity = NewCapacity;
+    }
+}
+
+static void AK_Sim__Parallel_For(ak_sim_context* Context, ak_sim_task_func* Task, void* TaskData, uint32_t TaskCount) {
+    if(Context->ParallelFor && TaskCount > 1) {
+        Context->ParallelFor(Task, TaskData, TaskCount, Context->ParallelForUserData);
+    } else {
+        uint32_t TaskIndex;
+        for(TaskIndex = 0; TaskIndex < TaskCount; TaskIndex++) {
+            Task(TaskIndex, 0, TaskData);
+        }
+    }
+}
+
+static void AK_Sim__Merge_Worker_Stats(ak_sim_context* Context) {
+#ifndef AK_SIM_NO_PROFILE
+    ak_sim_stats* Stats = &Context->Profiler.Stats;
+    uint32_t i;
+    for(i = 0; i < Context->WorkerCount; i++) {
+        ak_sim_stats* WorkerStats = &Context->Workers[i].Stats;
+        Stats->BoundsUpdated += WorkerStats->BoundsUpdated;
+        Stats->PairsTested += WorkerStats->PairsTested;
+        Stats->BatchedPairs += WorkerStats->BatchedPairs;
+        Stats->ContactsProduced += WorkerStats->ContactsProduced;
+        Stats->ClothContacts += WorkerStats->ClothContacts;
+
+        uint32_t TypeA;
+        for(TypeA = 0; TypeA <= AK_SIM_SHAPE_TYPE_COUNT; TypeA++) {
+            uint32_t TypeB;
+            for(TypeB = 0; TypeB <= AK_SIM_SHAPE_TYPE_COUNT; TypeB++) {
+                Stats->NarrowphaseTimeNS[TypeA][TypeB] += WorkerStats->NarrowphaseTimeNS[TypeA][TypeB];
+                Stats->NarrowphaseCallCount[TypeA][TypeB] += WorkerStats->NarrowphaseCallCount[TypeA][TypeB];
+            }
+        }
+        AK_SIM_MEMSET(WorkerStats, 0, sizeof(ak_sim_stats));
+    }
+#endif
+}
+
+#define AK_SIM__BODY_TASK_SIZE 256
+#define AK_SIM__REGION_CELL_BITS 21
+#define AK_SIM__REGION_CELL_LIMIT (1 << (AK_SIM__REGION_CELL_BITS-1))
+
+/*A region owns the moving bodies whose swept bounds fit in one grid cell, so its bodies can only 
+  touch each other, static bodies and the bodies crossing cell borders. Those go to the boundary 
+  region, which is always the last one and whose tree every region is tested against*/
+typedef struct {
+    ak_sim__bvh_item* Items;
+    uint32_t          ItemCount;
+    ak_sim__bvh       Tree;
+    ak_sim__array     Pairs; /*ak_sim__body_id_pair*/
+} ak_sim__region;
+
+typedef struct {
+    uint64_t Key;
+    uint32_t Index;
+} ak_sim__region_key;
+
+typedef struct {
+    ak_sim_context*   Context;
+    ak_sim_body**     Bodies;
+    ak_sim__bvh_item* Items;
+    uint8_t*          Moved; /*Set for bodies whose fat bounds were replaced*/
+    uint32_t          Count;
+} ak_sim__body_bounds_task;
+
+typedef struct {
+    ak_sim_context* Context;
+    ak_sim__region* Regions;
+    uint32_t        RegionCount;
+} ak_sim__region_task;
+
+static void AK_Sim__Body_Bounds_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__body_bounds_task* Task = (ak_sim__body_bounds_task*)TaskData;
+    uint32_t First = TaskIndex*AK_SIM__BODY_TASK_SIZE;
+    uint32_t Last = AK_Sim__Min(First+AK_SIM__BODY_TASK_SIZE, Task->Count);
+
+    ak_sim_context* Context = Task->Context;
+    float DeltaTime = Context->FixedTimeStep;
+
+    uint32_t i;
+    for(i = First; i < Last; i++) {
+        const ak_sim_body* Body = Task->Bodies[i];
+        ak_sim__pool_id ID;
+        ID.ID = Body->ID;
+        ak_sim__body_bounds* Bounds = Context->BodyBounds + ID.Internal.Index;
+
+        /*Sleeping bodies don't move, so once their bounds are marked asleep they stay as they are*/
+        if((Body->Flags & AK_SIM_BODY_FLAG_SLEEPING) && Bounds->Item.ID == Body->ID && (Bounds->Item.Flags & AK_SIM_BODY_FLAG_SLEEPING)) {
+            Task->Moved[i] = 0;
+            Task->Items[i] = Bounds->Item;
+            continue;
+        }
+
+        /*The ID check catches slots that were reused by a new body*/
+        int IsValid = Bounds->Item.ID == Body->ID && Bounds->Shape == Body->Shape && 
+                      !AK_SIM_MEMCMP(&Bounds->Scale, &Body->Scale, sizeof(ak_sim_v3));
+        if(!IsValid || AK_SIM_MEMCMP(&Bounds->Transform, &Body->Transform, sizeof(ak_sim_body_transform))) {
+            Bounds->Transform = Body->Transform;
+            Bounds->Scale = Body->Scale;
+            Bounds->Shape = Body->Shape;
+            Bounds->AABB = AK_Sim__Get_Body_AABB(Context, Body);
+            AK_Sim__Worker_Count(Context->Workers + WorkerIndex, BoundsUpdated, 1);
+        }
+
+        Bounds->SweptAABB = AK_Sim__Get_Swept_AABB(&Bounds->AABB, Body, DeltaTime);
+        ak_sim__bvh_item Item;
+        AK_Sim__BVH_Item_From_Body(&Item, Body, &Bounds->Item.AABB);
+
+        const ak_sim__aabb* SweptAABB = &Bounds->SweptAABB;
+        const ak_sim__aabb* FatAABB = &Bounds->Item.AABB;
+        int IsContained = AK_SIM_MEMCMP(&Item, &Bounds->Item, sizeof(ak_sim__bvh_item)) == 0 && 
+                          FatAABB->Min.Data[0] <= SweptAABB->Min.Data[0] && SweptAABB->Max.Data[0] <= FatAABB->Max.Data[0] && 
+                          FatAABB->Min.Data[1] <= SweptAABB->Min.Data[1] && SweptAABB->Max.Data[1] <= FatAABB->Max.Data[1] && 
+                          FatAABB->Min.Data[2] <= SweptAABB->Min.Data[2] && SweptAABB->Max.Data[2] <= FatAABB->Max.Data[2];
+        Task->Moved[i] = !IsContained;
+        if(!IsContained) {
+            Item.AABB = AK_Sim__Get_Fat_AABB(SweptAABB, Body, DeltaTime);
+            Bounds->Item = Item;
+            Bounds->Stale = 1;
+        }
+        Task->Items[i] = Bounds->Item;
+    }
+}
+
+static void AK_Sim__Build_Region_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__region_task* Task = (ak_sim__region_task*)TaskData;
+    ak_sim__region* Region = Task->Regions + TaskIndex;
+    ak_sim__arena* Arena = &Task->Context->Workers[WorkerIndex].Arena;
+
+    ak_sim__bvh_node* Nodes = AK_Sim__Arena_Push_Array(Arena, 2*Region->ItemCount, ak_sim__bvh_node);
+    AK_Sim__BVH_Build(&Region->Tree, Region->Items, Region->ItemCount, Nodes);
+}
+
+/*Runs once every region's tree is built, since regions read the boundary tree*/
+static void AK_Sim__Find_Region_Pairs_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__region_task* Task = (ak_sim__region_task*)TaskData;
+    ak_sim_context* Context = Task->Context;
+    ak_sim__worker* Worker = Context->Workers + WorkerIndex;
+    ak_sim__region* Region = Task->Regions + TaskIndex;
+    ak_sim__region* Boundary = Task->Regions + Task->RegionCount-1;
+
+    AK_Sim__Array_Init(&Region->Pairs, &Worker->Arena.BaseAllocator, sizeof(ak_sim__body_id_pair));
+
+    uint32_t i;
+    for(i = 0; i < Region->ItemCount; i++) {
+        const ak_sim__bvh_item* Item = Region->Items + i;
+        AK_Sim__BVH_Find_Pairs(Worker, &Region->Tree, Item, 1, &Region->Pairs);
+        AK_Sim__BVH_Find_Pairs(Worker, &Context->StaticTree, Item, 0, &Region->Pairs);
+        if(Region != Boundary) AK_Sim__BVH_Find_Pairs(Worker, &Boundary->Tree, Item, 0, &Region->Pairs);
+    }
+}
+
+static int32_t AK_Sim__Get_Region_Cell(float Value, float InvRegionSize) {
+    float Cell = Value*InvRegionSize;
+    Cell = AK_Sim__Max(Cell, -(float)AK_SIM__REGION_CELL_LIMIT);
+    Cell = AK_Sim__Min(Cell, (float)(AK_SIM__REGION_CELL_LIMIT-1));
+    int32_t Result = (int32_t)Cell;
+    return (float)Result > Cell ? Result-1 : Result;
+}
+
+/*Bottom up merge sort like AK_Sim__Sort_Body_Pairs. Stable, so bodies keep their pool order 
+  within a region*/
+static void AK_Sim__Sort_Region_Keys(ak_sim__region_key* Keys, uint32_t Count, ak_sim__arena* TempArena) {
+    if(Count < 2) return;
+
+    ak_sim__region_key* Src = Keys;
+    ak_sim__region_key* Dst = AK_Sim__Arena_Push_Array(TempArena, Count, ak_sim__region_key);
+
+    uint32_t Width;
+    for(Width = 1; Width < Count; Width *= 2) {
+        uint32_t Start;
+        for(Start = 0; Start < Count; Start += 2*Width) {
+            uint32_t Mid = AK_Sim__Min(Start+Width, Count);
+            uint32_t End = AK_Sim__Min(Start+2*Width, Count);
+            uint32_t i = Start, j = Mid, k = Start;
+            while(i < Mid && j < End) {
+                Dst[k++] = Src[j].Key < Src[i].Key ? Src[j++] : Src[i++];
+            }
+            while(i < Mid) Dst[k++] = Src[i++];
+            while(j < End) Dst[k++] = Src[j++];
+        }
+
+        ak_sim__region_key* Temp = Src;
+        Src = Dst;
+        Dst = Temp;
+    }
+
+    if(Src != Keys) {
+        AK_SIM_MEMCPY(Keys, Src, Count*sizeof(ak_sim__region_key));
+    }
+}
+
+/*Moving bodies are binned into regions by their fat bounds, so they migrate between regions as 
+  they move. Each region builds a tree of its bodies and finds its pairs as its own task. Static 
+  bodies are never tested against each other*/
+static void AK_Sim__Find_Region_Pairs(ak_sim_context* Context, const ak_sim__bvh_item* BodyItems, uint32_t BodyCount, ak_sim__arena* TempArena) {
+    Context->BroadphasePairs.Count = 0;
+
+    /*Interior bodies are sorted by cell to the front of the items, boundary bodies go to the back*/
+    float InvRegionSize = 1.0f/Context->RegionSize;
+    ak_sim__region_key* Keys = AK_Sim__Arena_Push_Array(TempArena, BodyCount, ak_sim__region_key);
+    ak_sim__bvh_item* Items = AK_Sim__Arena_Push_Array(TempArena, BodyCount, ak_sim__bvh_item);
+    uint32_t KeyCount = 0;
+    uint32_t BoundaryCount = 0;
+
+    uint32_t i;
+    for(i = 0; i < BodyCount; i++) {
+        const ak_sim__aabb* AABB = &BodyItems[i].AABB;
+        uint64_t Key = 0;
+        int IsBoundary = 0;
+
+        uint32_t Axis;
+        for(Axis = 0; Axis < 3; Axis++) {
+            int32_t MinCell = AK_Sim__Get_Region_Cell(AABB->Min.Data[Axis], InvRegionSize);
+            int32_t MaxCell = AK_Sim__Get_Region_Cell(AABB->Max.Data[Axis], InvRegionSize);
+            IsBoundary |= MinCell != MaxCell;
+            Key = (Key << AK_SIM__REGION_CELL_BITS) | (uint64_t)(MinCell+AK_SIM__REGION_CELL_LIMIT);
+        }
+
+        if(IsBoundary) {
+            Items[BodyCount-(++BoundaryCount)] = BodyItems[i];
+        } else {
+            Keys[KeyCount].Key = Key;
+            Keys[KeyCount].Index = i;
+            KeyCount++;
+        }
+    }
+
+    AK_Sim__Sort_Region_Keys(Keys, KeyCount, TempArena);
+
+    uint32_t RegionCount = 1;
+    for(i = 0; i < KeyCount; i++) {
+        Items[i] = BodyItems[Keys[i].Index];
+        RegionCount += i == 0 || Keys[i].Key != Keys[i-1].Key;
+    }
+
+    ak_sim__region* Regions = AK_Sim__Arena_Push_Array(TempArena, RegionCount, ak_sim__region);
+    AK_SIM_MEMSET(Regions, 0, RegionCount*sizeof(ak_sim__region));
+
+    uint32_t RegionIndex = 0;
+    for(i = 0; i < KeyCount; i++) {
+        if(i && Keys[i].Key != Keys[i-1].Key) RegionIndex++;
+        if(!Regions[RegionIndex].Items) Regions[RegionIndex].Items = Items+i;
+        Regions[RegionIndex].ItemCount++;
+    }
+
+    /*Boundary items were stored back to front, which is still a deterministic order*/
+    Regions[RegionCount-1].Items = Items+(BodyCount-BoundaryCount);
+    Regions[RegionCount-1].ItemCount = BoundaryCount;
+
+    AK_Sim__Profile_Count(Context, RegionCount, RegionCount-1);
+    AK_Sim__Profile_Count(Context, BoundaryBodyCount, BoundaryCount);
+
+    ak_sim__region_task RegionTask;
+    RegionTask.Context = Context;
+    RegionTask.Regions = Regions;
+    RegionTask.RegionCount = RegionCount;
+    AK_Sim__Parallel_For(Context, AK_Sim__Build_Region_Task, &RegionTask, RegionCount);
+    AK_Sim__Parallel_For(Context, AK_Sim__Find_Region_Pairs_Task, &RegionTask, RegionCount);
+
+    for(i = 0; i < RegionCount; i++) {
+        ak_sim__region* Region = Regions + i;
+        uint32_t j;
+        for(j = 0; j < Region->Pairs.Count; j++) {
+            AK_Sim__Array_Add(&Context->BroadphasePairs, AK_Sim__Array_Get(&Region->Pairs, j));
+        }
+    }
+}
+
+/*Past this share of stale moving bodies, searching every region again is cheaper than searching 
+  the stale bodies one by one*/
+#define AK_SIM__MAX_STALE_SHARE 0.25f
+
+typedef struct {
+    ak_sim_context*   Context;
+    ak_sim__bvh_item* Items; /*Of the bodies whose fat bounds were replaced this step*/
+    uint32_t          Count;
+    const uint8_t*    MovedSlots; /*Indexed by body pool slot*/
+    ak_sim__bvh       StaleTree;
+    ak_sim__array*    Pairs; /*One per task*/
+} ak_sim__stale_pair_task;
+
+/*The moving tree still holds the old fat bounds of stale bodies, so those pairs are dropped and come 
+  from the stale tree instead. There, two bodies that both moved this step find each other, so only 
+  the one with the smaller ID keeps the pair, which also drops a body's pair with itself*/
+static void AK_Sim__Keep_Stale_Pairs(ak_sim_context* Context, const ak_sim__bvh_item* Item, const uint8_t* MovedSlots, 
+                                     ak_sim__array* Pairs, uint32_t First, int FromStaleTree) {
+    uint32_t Count = First;
+    uint32_t i;
+    for(i = First; i < Pairs->Count; i++) {
+        ak_sim__body_id_pair Pair = *(const ak_sim__body_id_pair*)AK_Sim__Array_Get(Pairs, i);
+        ak_sim__pool_id OtherID;
+        OtherID.ID = Pair.AID == Item->ID ? Pair.BID : Pair.AID;
+        int Keep = FromStaleTree ? !MovedSlots[OtherID.Internal.Index] || Item->ID < OtherID.ID : 
+                                   !Context->BodyBounds[OtherID.Internal.Index].Stale;
+        if(Keep) *(ak_sim__body_id_pair*)AK_Sim__Array_Get(Pairs, Count++) = Pair;
+    }
+    Pairs->Count = Count;
+}
+
+static void AK_Sim__Find_Stale_Pairs_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__stale_pair_task* Task = (ak_sim__stale_pair_task*)TaskData;
+    ak_sim_context* Context = Task->Context;
+    ak_sim__worker* Worker = Context->Workers + WorkerIndex;
+    ak_sim__array* Pairs = Task->Pairs + TaskIndex;
+    AK_Sim__Array_Init(Pairs, &Worker->Arena.BaseAllocator, sizeof(ak_sim__body_id_pair));
+
+    uint32_t First = TaskIndex*AK_SIM__BODY_TASK_SIZE;
+    uint32_t Last = AK_Sim__Min(First+AK_SIM__BODY_TASK_SIZE, Task->Count);
+    uint32_t i;
+    for(i = First; i < Last; i++) {
+        const ak_sim__bvh_item* Item = Task->Items + i;
+        AK_Sim__BVH_Find_Pairs(Worker, &Context->StaticTree, Item, 0, Pairs);
+
+        uint32_t FirstPair = Pairs->Count;
+        AK_Sim__BVH_Find_Pairs(Worker, &Context->MovingTree, Item, 0, Pairs);
+        AK_Sim__Keep_Stale_Pairs(Context, Item, Task->MovedSlots, Pairs, FirstPair, 0);
+
+        FirstPair = Pairs->Count;
+        AK_Sim__BVH_Find_Pairs(Worker, &Task->StaleTree, Item, 0, Pairs);
+        AK_Sim__Keep_Stale_Pairs(Context, Item, Task->MovedSlots, Pairs, FirstPair, 1);
+    }
+}
+
+/*Pairs between bodies whose fat bounds didn't change still hold, so only the bodies that moved 
+  this step drop their pairs and are searched again. Every stale body goes in a small tree of 
+  its own, since the moving tree doesn't have its current fat bounds*/
+static void AK_Sim__Find_Stale_Pairs(ak_sim_context* Context, const ak_sim__body_bounds_task* BoundsTask, uint32_t MovedCount, 
+                                     uint32_t StaleCount, ak_sim__arena* TempArena) {
+    uint8_t* MovedSlots = AK_Sim__Arena_Push_Array(TempArena, Context->BodyPool.MaxUsed, uint8_t);
+    AK_SIM_MEMSET(MovedSlots, 0, Context->BodyPool.MaxUsed*sizeof(uint8_t));
+    ak_sim__bvh_item* StaleItems = AK_Sim__Arena_Push_Array(TempArena, StaleCount, ak_sim__bvh_item);
+
+    ak_sim__stale_pair_task StaleTask;
+    StaleTask.Context = Context;
+    StaleTask.Items = AK_Sim__Arena_Push_Array(TempArena, MovedCount, ak_sim__bvh_item);
+    StaleTask.Count = 0;
+    StaleTask.MovedSlots = MovedSlots;
+
+    uint32_t StaleIndex = 0;
+    uint32_t i;
+    for(i = 0; i < BoundsTask->Count; i++) {
+        ak_sim__pool_id ID;
+        ID.ID = BoundsTask->Bodies[i]->ID;
+        if(Context->BodyBounds[ID.Internal.Index].Stale) StaleItems[StaleIndex++] = BoundsTask->Items[i];
+        if(BoundsTask->Moved[i]) {
+            StaleTask.Items[StaleTask.Count++] = BoundsTask->Items[i];
+            MovedSlots[ID.Internal.Index] = 1;
+        }
+    }
+    AK_Sim__BVH_Build(&StaleTask.StaleTree, StaleItems, StaleCount, AK_Sim__Arena_Push_Array(TempArena, 2*StaleCount, ak_sim__bvh_node));
+
+    ak_sim__array* BroadphasePairs = &Context->BroadphasePairs;
+    uint32_t PairCount = 0;
+    for(i = 0; i < BroadphasePairs->Count; i++) {
+        ak_sim__body_id_pair Pair = *(const ak_sim__body_id_pair*)AK_Sim__Array_Get(BroadphasePairs, i);
+        ak_sim__pool_id IDA, IDB;
+        IDA.ID = Pair.AID;
+        IDB.ID = Pair.BID;
+        if(!MovedSlots[IDA.Internal.Index] && !MovedSlots[IDB.Internal.Index]) {
+            *(ak_sim__body_id_pair*)AK_Sim__Array_Get(BroadphasePairs, PairCount++) = Pair;
+        }
+    }
+    BroadphasePairs->Count = PairCount;
+
+    uint32_t TaskCount = (StaleTask.Count+AK_SIM__BODY_TASK_SIZE-1)/AK_SIM__BODY_TASK_SIZE;
+    StaleTask.Pairs = AK_Sim__Arena_Push_Array(TempArena, TaskCount, ak_sim__array);
+    AK_Sim__Parallel_For(Context, AK_Sim__Find_Stale_Pairs_Task, &StaleTask, TaskCount);
+
+    for(i = 0; i < TaskCount; i++) {
+        uint32_t j;
+        for(j = 0; j < StaleTask.Pairs[i].Count; j++) {
+            AK_Sim__Array_Add(BroadphasePairs, AK_Sim__Array_Get(&StaleTask.Pairs[i], j));
+        }
+    }
+}
+
+/*The regions are only searched again once too many bodies went stale in the moving tree, before 
+  that only the bodies that left their fat bounds are. The fat pairs whose swept bounds overlap 
+  this step go to the narrowphase*/
+static void AK_Sim__Find_Pairs(ak_sim_context* Context, ak_sim__array* PairArray, ak_sim__arena* TempArena) {
+    AK_Sim__Reserve_Body_Bounds(Context, Context->BodyPool.MaxUsed);
+    if(Context->StaticTreeDirty) AK_Sim__Rebuild_Static_Tree(Context);
+
+    ak_sim__pool* BodyPool = &Context->BodyPool;
+    ak_sim_body** Bodies = AK_Sim__Arena_Push_Array(TempArena, BodyPool->ItemCount, ak_sim_body*);
+    uint32_t BodyCount = 0;
+
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        if(Body->Type != AK_SIM_BODY_TYPE_STATIC) Bodies[BodyCount++] = Body;
+    }
+
+    ak_sim__body_bounds_task BoundsTask;
+    BoundsTask.Context = Context;
+    BoundsTask.Bodies = Bodies;
+    BoundsTask.Items = AK_Sim__Arena_Push_Array(TempArena, BodyCount, ak_sim__bvh_item);
+    BoundsTask.Moved = AK_Sim__Arena_Push_Array(TempArena, BodyCount, uint8_t);
+    BoundsTask.Count = BodyCount;
+    AK_Sim__Parallel_For(Context, AK_Sim__Body_Bounds_Task, &BoundsTask, (BodyCount+AK_SIM__BODY_TASK_SIZE-1)/AK_SIM__BODY_TASK_SIZE);
+
+    uint32_t i;
+    uint32_t MovedCount = 0;
+    uint32_t StaleCount = 0;
+    for(i = 0; i < BodyCount; i++) {
+        ak_sim__pool_id ID;
+        ID.ID = Bodies[i]->ID;
+        MovedCount += BoundsTask.Moved[i];
+        StaleCount += Context->BodyBounds[ID.Internal.Index].Stale;
+    }
+    AK_Sim__Profile_Count(Context, FatBoundsUpdated, MovedCount);
+
+    uint32_t MaxStaleCount = (uint32_t)(AK_SIM__MAX_STALE_SHARE*(float)BodyCount);
+    if(Context->BroadphaseDirty || (MovedCount && (Context->MovingTreeDirty || StaleCount > MaxStaleCount))) {
+        AK_Sim__Find_Region_Pairs(Context, BoundsTask.Items, BodyCount, TempArena);
+        Context->BroadphaseDirty = 0;
+
+        /*While most bodies keep moving the next step searches the regions again anyway*/
+        Context->MovingTreeDirty = MovedCount > MaxStaleCount;
+        if(!Context->MovingTreeDirty) {
+            ak_sim__bvh* Tree = &Context->MovingTree;
+            if(BodyCount > Context->MovingTreeCapacity) {
+                AK_Sim__Reserve_Tree(Context, Tree, &Context->MovingTreeCapacity, AK_Sim__Max(Context->MovingTreeCapacity*2, AK_Sim__Max(BodyCount, 64)));
+            }
+            AK_SIM_MEMCPY(Tree->Items, BoundsTask.Items, BodyCount*sizeof(ak_sim__bvh_item));
+            AK_Sim__BVH_Build(Tree, Tree->Items, BodyCount, Tree->Nodes);
+        }
+
+        for(i = 0; i < BodyCount; i++) {
+            ak_sim__pool_id ID;
+            ID.ID = Bodies[i]->ID;
+            Context->BodyBounds[ID.Internal.Index].Stale = 0;
+        }
+    } else if(MovedCount) {
+        AK_Sim__Find_Stale_Pairs(Context, &BoundsTask, MovedCount, StaleCount, TempArena);
+    }
+
+    for(i = 0; i < Context->BroadphasePairs.Count; i++) {
+        const ak_sim__body_id_pair* Pair = (const ak_sim__body_id_pair*)AK_Sim__Array_Get(&Context->BroadphasePairs, i);
+        ak_sim__pool_id IDA, IDB;
+        IDA.ID = Pair->AID;
+        IDB.ID = Pair->BID;
+        const ak_sim__body_bounds* BoundsA = Context->BodyBounds + IDA.Internal.Index;
+        const ak_sim__body_bounds* BoundsB = Context->BodyBounds + IDB.Internal.Index;
+        if(AK_Sim__AABB_Overlap(&BoundsA->SweptAABB, &BoundsB->SweptAABB)) {
+            AK_Sim__Array_Add(PairArray, Pair);
+        }
+    }
+}
+
+static int AK_Sim__Is_Body_Awake(const ak_sim_body* Body) {
+    return Body->Type != AK_SIM_BODY_TYPE_STATIC && !(Body->Flags & AK_SIM_BODY_FLAG_SLEEPING);
+}
+
+/*Whether the broadphase skipped the pair because neither body can move*/
+static int AK_Sim__Is_Pair_Asleep(ak_sim_context* Context, const ak_sim__body_id_pair* Pair) {
+    ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->AID);
+    ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->BID);
+    return BodyA && BodyB && !AK_Sim__Is_Body_Awake(BodyA) && !AK_Sim__Is_Body_Awake(BodyB);
+}
+
+/*Builds this step's pair caches in pair array order, carrying over last step's cache for pairs 
+  that persist. The touching flag starts clear and is set again by this step's narrowphase. 
+  Sleeping pairs come after the pair array with their cache untouched, so they stay touching 
+  and keep their island together while it sleeps*/
+static ak_sim__pair_cache* AK_Sim__Update_Pair_Caches(ak_sim_context* Context, ak_sim__array* PairArray) {
+    ak_sim__pair_cache_table* PrevTable = Context->PairCaches + Context->PairCacheIndex;
+    Context->PairCacheIndex ^= 1;
+    ak_sim__pair_cache_table* Table = Context->PairCaches + Context->PairCacheIndex;
+
+    uint32_t SleepingCount = 0;
+    uint32_t i;
+    for(i = 0; i < PrevTable->Pairs.ItemCount; i++) {
+        SleepingCount += AK_Sim__Is_Pair_Asleep(Context, (const ak_sim__body_id_pair*)AK_Sim__Set_Get_Key(&PrevTable->Pairs, i));
+    }
+    AK_Sim__Pair_Cache_Table_Reset(Table, PairArray->Count+SleepingCount);
+
+    for(i = 0; i < PairArray->Count; i++) {
+        ak_sim__body_id_pair* Pair = (ak_sim__body_id_pair*)AK_Sim__Array_Get(PairArray, i);
+        AK_Sim__Set_Add(&Table->Pairs, Pair);
+
+        uint32_t PrevIndex = AK_Sim__Set_Find_Index(&PrevTable->Pairs, Pair);
+        if(PrevIndex != AK_SIM__HASH_INVALID_SLOT) {
+            Table->Caches[i] = PrevTable->Caches[PrevIndex];
+            Table->Caches[i].Flags &= ~AK_SIM__PAIR_FLAG_TOUCHING;
+        } else {
+            ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->AID);
+            ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->BID);
+            AK_SIM_MEMSET(&Table->Caches[i], 0, sizeof(ak_sim__pair_cache));
+            if(BodyA->Flags & AK_SIM_BODY_FLAG_SENSOR) Table->Caches[i].Flags |= AK_SIM__PAIR_FLAG_SENSOR_A;
+            if(BodyB->Flags & AK_SIM_BODY_FLAG_SENSOR) Table->Caches[i].Flags |= AK_SIM__PAIR_FLAG_SENSOR_B;
+        }
+    }
+
+    if(SleepingCount) {
+        for(i = 0; i < PrevTable->Pairs.ItemCount; i++) {
+            const ak_sim__body_id_pair* Pair = (const ak_sim__body_id_pair*)AK_Sim__Set_Get_Key(&PrevTable->Pairs, i);
+            if(AK_Sim__Is_Pair_Asleep(Context, Pair) && AK_Sim__Set_Find_Index(&Table->Pairs, Pair) == AK_SIM__HASH_INVALID_SLOT) {
+                Table->Caches[Table->Pairs.ItemCount] = PrevTable->Caches[i];
+                AK_Sim__Set_Add(&Table->Pairs, Pair);
+            }
+        }
+    }
+
+    return Table->Caches;
+}
+
+static void AK_Sim__Add_Touch_Event(ak_sim_context* Context, const ak_sim__body_id_pair* Pair, uint32_t Flags, int Begin) {
+    if(Flags & AK_SIM__PAIR_FLAG_SENSOR) {
+        /*Flags come from the cache, so this works after either body is deleted*/
+        ak_sim_sensor_event Event;
+        int ASensor = (Flags & AK_SIM__PAIR_FLAG_SENSOR_A) != 0;
+        Event.Sensor = ASensor ? Pair->AID : Pair->BID;
+        Event.Visitor = ASensor ? Pair->BID : Pair->AID;
+        AK_Sim__Array_Add(Begin ? &Context->SensorBeginEvents : &Context->SensorEndEvents, &Event);
+    } else {
+        ak_sim_contact_event Event;
+        Event.BodyA = Pair->AID;
+        Event.BodyB = Pair->BID;
+        AK_Sim__Array_Add(Begin ? &Context->ContactBeginEvents : &Context->ContactEndEvents, &Event);
+    }
+}
+
+/*Diffs the touching flags of this step's caches against last step's. Pairs are visited in pair 
+  array order, so events are as deterministic as the pairs*/
+static void AK_Sim__Generate_Touch_Events(ak_sim_context* Context) {
+    ak_sim__pair_cache_table* Table = Context->PairCaches + Context->PairCacheIndex;
+    ak_sim__pair_cache_table* PrevTable = Context->PairCaches + (Context->PairCacheIndex^1);
+
+    uint32_t i;
+    for(i = 0; i < PrevTable->Pairs.ItemCount; i++) {
+        ak_sim__pair_cache* PrevCache = PrevTable->Caches + i;
+        if(!(PrevCache->Flags & AK_SIM__PAIR_FLAG_TOUCHING)) continue;
+
+        const ak_sim__body_id_pair* Pair = (const ak_sim__body_id_pair*)AK_Sim__Set_Get_Key(&PrevTable->Pairs, i);
+        uint32_t Index = AK_Sim__Set_Find_Index(&Table->Pairs, Pair);
+        if(Index == AK_SIM__HASH_INVALID_SLOT || !(Table->Caches[Index].Flags & AK_SIM__PAIR_FLAG_TOUCHING)) {
+            AK_Sim__Add_Touch_Event(Context, Pair, PrevCache->Flags, 0);
+        }
+    }
+
+    for(i = 0; i < Table->Pairs.ItemCount; i++) {
+        ak_sim__pair_cache* Cache = Table->Caches + i;
+        if(!(Cache->Flags & AK_SIM__PAIR_FLAG_TOUCHING)) continue;
+
+        const ak_sim__body_id_pair* Pair = (const ak_sim__body_id_pair*)AK_Sim__Set_Get_Key(&Table->Pairs, i);
+        uint32_t PrevIndex = AK_Sim__Set_Find_Index(&PrevTable->Pairs, Pair);
+        if(PrevIndex == AK_SIM__HASH_INVALID_SLOT || !(PrevTable->Caches[PrevIndex].Flags & AK_SIM__PAIR_FLAG_TOUCHING)) {
+            AK_Sim__Add_Touch_Event(Context, Pair, Cache->Flags, 1);
+        }
+    }
+}
+
+/*Sets the pair touching if any of its new contacts has a non negative depth. Sensors only need 
+  to know whether they overlap, so their contacts are dropped along with the manifold the 
+  collector opened for them*/
+static void AK_Sim__Finish_Pair(ak_sim_collision_collector* Collector, ak_sim__pair_cache* Cache, uint32_t FirstContact) {
+    uint32_t ContactIndex;
+    for(ContactIndex = FirstContact; ContactIndex < Collector->Contacts.Count; ContactIndex++) {
+        ak_sim_contact* Contact = (ak_sim_contact*)AK_Sim__Array_Get(&Collector->Contacts, ContactIndex);
+        if(Contact->Depth >= 0.0f) {
+            Cache->Flags |= AK_SIM__PAIR_FLAG_TOUCHING;
+            break;
+        }
+    }
+
+    if((Cache->Flags & AK_SIM__PAIR_FLAG_SENSOR) && Collector->Contacts.Count > FirstContact) {
+        Collector->Contacts.Count = FirstContact;
+        Collector->Manifolds.Count--;
+    }
+}
+
+static void AK_Sim__Collide_Pair(ak_sim_context* Context, ak_sim__array* PairArray, uint32_t PairIndex, 
+                                 ak_sim__pair_cache* PairCaches, ak_sim_collision_collector* CollisionCollector) {
+    ak_sim__body_id_pair* Pair = (ak_sim__body_id_pair*)AK_Sim__Array_Get(PairArray, PairIndex);
+    ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->AID);
+    ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->BID);
+
+    ak_sim_shape* ShapeA = &AK_Sim__Get_Shape_Entry(Context, BodyA->Shape)->Shape;
+    ak_sim_shape* ShapeB = &AK_Sim__Get_Shape_Entry(Context, BodyB->Shape)->Shape;
+
+    ak_sim_collision_func* CollisionFunc = AK_Sim__Collision_Table_Get_Func(&Context->CollisionTable, ShapeA->Type, ShapeB->Type);
+    if(!CollisionFunc) return;
+
+    ak_sim_position Origin = AK_Sim__Get_Body_Origin(BodyA);
+    ak_sim_m4x3 TransformA = AK_Sim__Get_Body_Matrix_Transform(&BodyA->Transform, Origin);
+    ak_sim_m4x3 TransformB = AK_Sim__Get_Body_Matrix_Transform(&BodyB->Transform, Origin);
+
+    ak_sim__pair_cache* Cache = PairCaches + PairIndex;
+    uint32_t FirstContact = CollisionCollector->Contacts.Count;
+    CollisionCollector->PairIndex = PairIndex;
+    CollisionCollector->Cache = Cache;
+    CollisionFunc(CollisionCollector, ShapeA, &TransformA, BodyA->Scale, ShapeB, &TransformB, BodyB->Scale);
+    AK_Sim__Finish_Pair(CollisionCollector, Cache, FirstContact);
+}
+
+/*Sphere pairs and sphere capsule pairs skip GJK. Either is a point against a segment, with a 
+  sphere being a segment of zero length, so both kinds share one closed form kernel that runs 
+  across several pairs at once. Every other pair goes through the collision table*/
+typedef enum {
+    AK_SIM__PAIR_KIND_SPHERE_SPHERE,
+    AK_SIM__PAIR_KIND_SPHERE_CAPSULE,
+    AK_SIM__PAIR_KIND_GENERIC,
+    AK_SIM__PAIR_KIND_COUNT
+} ak_sim__pair_kind;
+
+static ak_sim__pair_kind AK_Sim__Get_Pair_Kind(ak_sim_context* Context, const ak_sim_shape* ShapeA, const ak_sim_shape* ShapeB) {
+    if(ShapeA->Type != AK_SIM_SHAPE_TYPE_CONVEX || ShapeB->Type != AK_SIM_SHAPE_TYPE_CONVEX) return AK_SIM__PAIR_KIND_GENERIC;
+
+    /*A registered convex collision replaces the built in one, kernels included*/
+    ak_sim_collision_func* CollisionFunc = AK_Sim__Collision_Table_Get_Func(&Context->CollisionTable, AK_SIM_SHAPE_TYPE_CONVEX, AK_SIM_SHAPE_TYPE_CONVEX);
+    if(CollisionFunc != AK_Sim__Convex_Collision) return AK_SIM__PAIR_KIND_GENERIC;
+
+    ak_sim_convex_type TypeA = ShapeA->Internal.Convex.Type;
+    ak_sim_convex_type TypeB = ShapeB->Internal.Convex.Type;
+    if(TypeA == AK_SIM_CONVEX_TYPE_SPHERE && TypeB == AK_SIM_CONVEX_TYPE_SPHERE) return AK_SIM__PAIR_KIND_SPHERE_SPHERE;
+    if((TypeA == AK_SIM_CONVEX_TYPE_SPHERE && TypeB == AK_SIM_CONVEX_TYPE_CAPSULE) || 
+       (TypeA == AK_SIM_CONVEX_TYPE_CAPSULE && TypeB == AK_SIM_CONVEX_TYPE_SPHERE)) return AK_SIM__PAIR_KIND_SPHERE_CAPSULE;
+    return AK_SIM__PAIR_KIND_GENERIC;
+}
+
+/*Pairs are timed by their [TypeA][TypeB] stats slot*/
+#define AK_SIM__PAIR_BUCKET_COUNT ((AK_SIM_SHAPE_TYPE_COUNT+1)*(AK_SIM_SHAPE_TYPE_COUNT+1))
+
+static uint32_t AK_Sim__Get_Pair_Bucket(const ak_sim_shape* ShapeA, const ak_sim_shape* ShapeB) {
+    uint32_t TypeA = AK_Sim__Min((uint32_t)ShapeA->Type, (uint32_t)AK_SIM_SHAPE_TYPE_USER);
+    uint32_t TypeB = AK_Sim__Min((uint32_t)ShapeB->Type, (uint32_t)AK_SIM_SHAPE_TYPE_USER);
+    return TypeA*(AK_SIM_SHAPE_TYPE_COUNT+1) + TypeB;
+}
+
+/*Stable counting sort of the pair indices by kind, with generic pairs also sorted by bucket. 
+  Shapes can't change during a step, so every substep shares the order. KindOffsets needs 
+  AK_SIM__PAIR_KIND_COUNT+1 entries. Buckets gets the bucket of each sorted pair*/
+static uint32_t* AK_Sim__Sort_Pairs_By_Kind(ak_sim_context* Context, ak_sim__array* PairArray, uint32_t* KindOffsets, const uint8_t** Buckets, 
+                                            ak_sim__arena* TempArena) {
+    uint8_t* Keys = AK_Sim__Arena_Push_Array(TempArena, PairArray->Count, uint8_t);
+    uint8_t* SortedBuckets = AK_Sim__Arena_Push_Array(TempArena, PairArray->Count, uint8_t);
+    uint32_t* Result = AK_Sim__Arena_Push_Array(TempArena, PairArray->Count, uint32_t);
+    uint32_t Counts[AK_SIM__PAIR_KIND_GENERIC+AK_SIM__PAIR_BUCKET_COUNT];
+    AK_SIM_MEMSET(Counts, 0, sizeof(Counts));
+
+    uint32_t i;
+    for(i = 0; i < PairArray->Count; i++) {
+        ak_sim__body_id_pair* Pair = (ak_sim__body_id_pair*)AK_Sim__Array_Get(PairArray, i);
+        ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->AID);
+        ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->BID);
+        const ak_sim_shape* ShapeA = &AK_Sim__Get_Shape_Entry(Context, BodyA->Shape)->Shape;
+        const ak_sim_shape* ShapeB = &AK_Sim__Get_Shape_Entry(Context, BodyB->Shape)->Shape;
+        ak_sim__pair_kind Kind = AK_Sim__Get_Pair_Kind(Context, ShapeA, ShapeB);
+        Keys[i] = (uint8_t)(Kind == AK_SIM__PAIR_KIND_GENERIC ? Kind + AK_Sim__Get_Pair_Bucket(ShapeA, ShapeB) : Kind);
+        Counts[Keys[i]]++;
+    }
+
+    uint32_t Offset = 0;
+    uint32_t Key;
+    for(Key = 0; Key < AK_Sim__Array_Count(Counts); Key++) {
+        if(Key <= AK_SIM__PAIR_KIND_GENERIC) KindOffsets[Key] = Offset;
+        uint32_t Count = Counts[Key];
+        Counts[Key] = Offset;
+        Offset += Count;
+    }
+    KindOffsets[AK_SIM__PAIR_KIND_COUNT] = Offset;
+
+    for(i = 0; i < PairArray->Count; i++) {
+        uint32_t Index = Counts[Keys[i]]++;
+        Result[Index] = i;
+        SortedBuckets[Index] = (uint8_t)(Keys[i] >= AK_SIM__PAIR_KIND_GENERIC ? Keys[i]-AK_SIM__PAIR_KIND_GENERIC : 0);
+    }
+    *Buckets = SortedBuckets;
+    return Result;
+}
+
+#define AK_SIM__PAIR_BATCH_SIZE 4
+
+/*Lane i of every array belongs to the same pair. Each side is a segment from Start to 
+  Start+Delta around body A's origin*/
+typedef struct {
+    float StartA[3][AK_SIM__PAIR_BATCH_SIZE];
+    float DeltaA[3][AK_SIM__PAIR_BATCH_SIZE];
+    float StartB[3][AK_SIM__PAIR_BATCH_SIZE];
+    float DeltaB[3][AK_SIM__PAIR_BATCH_SIZE];
+    float RadiusA[AK_SIM__PAIR_BATCH_SIZE];
+    float RadiusB[AK_SIM__PAIR_BATCH_SIZE];
+
+    float Position[3][AK_SIM__PAIR_BATCH_SIZE];
+    float Normal[3][AK_SIM__PAIR_BATCH_SIZE];
+    float Depth[AK_SIM__PAIR_BATCH_SIZE];
+    float Distance[AK_SIM__PAIR_BATCH_SIZE]; /*Between the cores*/
+} ak_sim__pair_batch;
+
+/*Same core and radius as AK_Sim__Convex_Proxy_Init gives the sphere or capsule*/
+static void AK_Sim__Set_Pair_Batch_Side(float Start[3][AK_SIM__PAIR_BATCH_SIZE], float Delta[3][AK_SIM__PAIR_BATCH_SIZE], float* Radius, uint32_t Lane, 
+                                        const ak_sim_convex* Convex, const ak_sim_m4x3* Transform, ak_sim_v3 Scale) {
+    ak_sim_v3 P = Transform->Cols[3];
+    ak_sim_v3 D = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    if(Convex->Type == AK_SIM_CONVEX_TYPE_CAPSULE) {
+        ak_sim_v3 Axis = AK_Sim__V3_Mul_S(Transform->Cols[1], Convex->Internal.Capsule.HalfHeight*Scale.Data[1]);
+        D = AK_Sim__V3_Mul_S(Axis, -2.0f);
+        P = AK_Sim__V3_Add(P, Axis);
+        Radius[Lane] = Convex->Internal.Capsule.Radius*AK_Sim__Max(Scale.Data[0], Scale.Data[2]);
+    } else {
+        Radius[Lane] = Convex->Internal.Sphere.Radius*AK_Sim__V3_Max_Component(Scale);
+    }
+
+    uint32_t k;
+    for(k = 0; k < 3; k++) {
+        Start[k][Lane] = P.Data[k];
+        Delta[k][Lane] = D.Data[k];
+    }
+}
+
+static ak_sim_v3 AK_Sim__Closest_On_Segment(ak_sim_v3 Start, ak_sim_v3 Delta, ak_sim_v3 P) {
+    float LengthSq = AK_Sim__V3_Dot(Delta, Delta);
+    float t = AK_Sim__V3_Dot(AK_Sim__V3_Sub(P, Start), Delta)/(LengthSq > 0.0f ? LengthSq : 1.0f);
+    t = AK_Sim__Max(AK_Sim__Min(t, 1.0f), 0.0f);
+    return AK_Sim__V3_Add(Start, AK_Sim__V3_Mul_S(Delta, t));
+}
+
+/*The point of B's segment closest to A's start, then the point of A's segment closest to that, 
+  which is exact while either side is a point. The contact is built like AK_Sim__Get_GJK_Contact. 
+  Cores closer than 1e-6 get a meaningless normal here and are left to the caller*/
+static void AK_Sim__Collide_Pair_Batch_Scalar(ak_sim__pair_batch* Batch) {
+    uint32_t Lane, k;
+    for(Lane = 0; Lane < AK_SIM__PAIR_BATCH_SIZE; Lane++) {
+        ak_sim_v3 StartA = AK_Sim_V3(Batch->StartA[0][Lane], Batch->StartA[1][Lane], Batch->StartA[2][Lane]);
+        ak_sim_v3 DeltaA = AK_Sim_V3(Batch->DeltaA[0][Lane], Batch->DeltaA[1][Lane], Batch->DeltaA[2][Lane]);
+        ak_sim_v3 StartB = AK_Sim_V3(Batch->StartB[0][Lane], Batch->StartB[1][Lane], Batch->StartB[2][Lane]);
+        ak_sim_v3 DeltaB = AK_Sim_V3(Batch->DeltaB[0][Lane], Batch->DeltaB[1][Lane], Batch->DeltaB[2][Lane]);
+        ak_sim_v3 PointB = AK_Sim__Closest_On_Segment(StartB, DeltaB, StartA);
+        ak_sim_v3 PointA = AK_Sim__Closest_On_Segment(StartA, DeltaA, PointB);
+
+        ak_sim_v3 V = AK_Sim__V3_Sub(PointA, PointB);
+        float Distance = AK_SIM_SQRT(AK_Sim__V3_Dot(V, V));
+        ak_sim_v3 Normal = AK_Sim__V3_Mul_S(V, -1.0f/AK_Sim__Max(Distance, 1e-6f));
+        ak_sim_v3 SurfaceA = AK_Sim__V3_Add(PointA, AK_Sim__V3_Mul_S(Normal, Batch->RadiusA[Lane]));
+        ak_sim_v3 SurfaceB = AK_Sim__V3_Sub(PointB, AK_Sim__V3_Mul_S(Normal, Batch->RadiusB[Lane]));
+        ak_sim_v3 Position = AK_Sim__V3_Lerp(SurfaceA, 0.5f, SurfaceB);
+
+        for(k = 0; k < 3; k++) {
+            Batch->Position[k][Lane] = Position.Data[k];
+            Batch->Normal[k][Lane] = Normal.Data[k];
+        }
+        Batch->Depth[Lane] = Batch->RadiusA[Lane] + Batch->RadiusB[Lane] - Distance;
+        Batch->Distance[Lane] = Distance;
+    }
+}
+
+#ifdef AK_SIM__SSE2
+/*Same operation order as AK_Sim__V3_Dot*/
+static __m128 AK_Sim__Dot3_SSE2(const __m128* A, const __m128* B) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(A[0], B[0]), _mm_mul_ps(A[1], B[1])), _mm_mul_ps(A[2], B[2]));
+}
+
+static void AK_Sim__Closest_On_Segment_SSE2(const __m128* Start, const __m128* Delta, const __m128* P, __m128* Result) {
+    __m128 One = _mm_set1_ps(1.0f);
+    __m128 Zero = _mm_setzero_ps();
+    __m128 LengthSq = AK_Sim__Dot3_SSE2(Delta, Delta);
+    __m128 HasLength = _mm_cmpgt_ps(LengthSq, Zero);
+    __m128 Divisor = _mm_or_ps(_mm_and_ps(HasLength, LengthSq), _mm_andnot_ps(HasLength, One));
+
+    __m128 Offset[3];
+    uint32_t k;
+    for(k = 0; k < 3; k++) Offset[k] = _mm_sub_ps(P[k], Start[k]);
+    __m128 t = _mm_div_ps(AK_Sim__Dot3_SSE2(Offset, Delta), Divisor);
+    t = _mm_max_ps(_mm_min_ps(t, One), Zero);
+    for(k = 0; k < 3; k++) Result[k] = _mm_add_ps(Start[k], _mm_mul_ps(Delta[k], t));
+}
+
+/*Four pairs per iteration, bit identical to AK_Sim__Collide_Pair_Batch_Scalar. _mm_sqrt_ps is 
+  correctly rounded like the default AK_SIM_SQRT*/
+static void AK_Sim__Collide_Pair_Batch_SSE2(ak_sim__pair_batch* Batch) {
+    __m128 StartA[3], DeltaA[3], StartB[3], DeltaB[3], PointA[3], PointB[3], V[3], Normal[3];
+    uint32_t k;
+    for(k = 0; k < 3; k++) {
+        StartA[k] = _mm_loadu_ps(Batch->StartA[k]);
+        DeltaA[k] = _mm_loadu_ps(Batch->DeltaA[k]);
+        StartB[k] = _mm_loadu_ps(Batch->StartB[k]);
+        DeltaB[k] = _mm_loadu_ps(Batch->DeltaB[k]);
+    }
+    AK_Sim__Closest_On_Segment_SSE2(StartB, DeltaB, StartA, PointB);
+    AK_Sim__Closest_On_Segment_SSE2(StartA, DeltaA, PointB, PointA);
+
+    for(k = 0; k < 3; k++) V[k] = _mm_sub_ps(PointA[k], PointB[k]);
+    __m128 Distance = _mm_sqrt_ps(AK_Sim__Dot3_SSE2(V, V));
+    __m128 Scale = _mm_div_ps(_mm_set1_ps(-1.0f), _mm_max_ps(Distance, _mm_set1_ps(1e-6f)));
+    __m128 RadiusA = _mm_loadu_ps(Batch->RadiusA);
+    __m128 RadiusB = _mm_loadu_ps(Batch->RadiusB);
+    __m128 Half = _mm_set1_ps(0.5f);
+    for(k = 0; k < 3; k++) {
+        Normal[k] = _mm_mul_ps(V[k], Scale);
+        __m128 SurfaceA = _mm_add_ps(PointA[k], _mm_mul_ps(Normal[k], RadiusA));
+        __m128 SurfaceB = _mm_sub_ps(PointB[k], _mm_mul_ps(Normal[k], RadiusB));
+        _mm_storeu_ps(Batch->Position[k], _mm_add_ps(_mm_mul_ps(SurfaceA, Half), _mm_mul_ps(SurfaceB, Half)));
+        _mm_storeu_ps(Batch->Normal[k], Normal[k]);
+    }
+    _mm_storeu_ps(Batch->Depth, _mm_sub_ps(_mm_add_ps(RadiusA, RadiusB), Distance));
+    _mm_storeu_ps(Batch->Distance, Distance);
+}
+#endif
+
+/*Gathers up to AK_SIM__PAIR_BATCH_SIZE pairs at a time into the batch, runs the kernel on all 
+  lanes and emits the contacts the same way AK_Sim__Collide_Convex_Proxies does for two cores 
+  without faces*/
+static void AK_Sim__Collide_Pair_Batches(ak_sim_context* Context, ak_sim__worker* Worker, ak_sim__array* PairArray, const uint32_t* PairIndices, uint32_t PairCount, 
+                                         ak_sim__pair_cache* PairCaches, ak_sim_collision_collector* CollisionCollector) {
+#ifndef AK_SIM_NO_PROFILE
+    uint64_t StartNS = AK_SIM_GET_TIME_NS();
+#endif
+
+    uint32_t First;
+    for(First = 0; First < PairCount; First += AK_SIM__PAIR_BATCH_SIZE) {
+        uint32_t LaneCount = AK_Sim__Min(PairCount-First, (uint32_t)AK_SIM__PAIR_BATCH_SIZE);
+        ak_sim__pair_batch Batch;
+        AK_SIM_MEMSET(&Batch, 0, sizeof(ak_sim__pair_batch));
+
+        uint32_t Lane;
+        for(Lane = 0; Lane < LaneCount; Lane++) {
+            ak_sim__body_id_pair* Pair = (ak_sim__body_id_pair*)AK_Sim__Array_Get(PairArray, PairIndices[First+Lane]);
+            ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->AID);
+            ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Pair->BID);
+            ak_sim_position Origin = AK_Sim__Get_Body_Origin(BodyA);
+            ak_sim_m4x3 TransformA = AK_Sim__Get_Body_Matrix_Transform(&BodyA->Transform, Origin);
+            ak_sim_m4x3 TransformB = AK_Sim__Get_Body_Matrix_Transform(&BodyB->Transform, Origin);
+            const ak_sim_convex* ConvexA = &AK_Sim__Get_Shape_Entry(Context, BodyA->Shape)->Shape.Internal.Convex;
+            const ak_sim_convex* ConvexB = &AK_Sim__Get_Shape_Entry(Context, BodyB->Shape)->Shape.Internal.Convex;
+            AK_Sim__Set_Pair_Batch_Side(Batch.StartA, Batch.DeltaA, Batch.RadiusA, Lane, ConvexA, &TransformA, BodyA->Scale);
+            AK_Sim__Set_Pair_Batch_Side(Batch.StartB, Batch.DeltaB, Batch.RadiusB, Lane, ConvexB, &TransformB, BodyB->Scale);
+        }
+
+#ifdef AK_SIM__SSE2
+        AK_Sim__Collide_Pair_Batch_SSE2(&Batch);
+#else
+        AK_Sim__Collide_Pair_Batch_Scalar(&Batch);
+#endif
+
+        for(Lane = 0; Lane < LaneCount; Lane++) {
+            uint32_t PairIndex = PairIndices[First+Lane];
+            float Distance = Batch.Distance[Lane];
+            if(Distance > Batch.RadiusA[Lane] + Batch.RadiusB[Lane] + AK_SIM__SPECULATIVE_DISTANCE) continue;
+            if(Distance <= 1e-6f) {
+                AK_Sim__Collide_Pair(Context, PairArray, PairIndex, PairCaches, CollisionCollector);
+                continue;
+            }
+
+            ak_sim__pair_cache* Cache = PairCaches + PairIndex;
+            uint32_t FirstContact = CollisionCollector->Contacts.Count;
+            CollisionCollector->PairIndex = PairIndex;
+            CollisionCollector->Cache = Cache;
+            AK_Sim__Emit_Contact(CollisionCollector, AK_Sim_V3(Batch.Position[0][Lane], Batch.Position[1][Lane], Batch.Position[2][Lane]), 
+                                 AK_Sim_V3(Batch.Normal[0][Lane], Batch.Normal[1][Lane], Batch.Normal[2][Lane]), Batch.Depth[Lane]);
+            AK_Sim__Finish_Pair(CollisionCollector, Cache, FirstContact);
+        }
+    }
+
+    AK_Sim__Worker_Count(Worker, BatchedPairs, PairCount);
+#ifndef AK_SIM_NO_PROFILE
+    Worker->Stats.NarrowphaseTimeNS[AK_SIM_SHAPE_TYPE_CONVEX][AK_SIM_SHAPE_TYPE_CONVEX] += AK_SIM_GET_TIME_NS()-StartNS;
+    Worker->Stats.NarrowphaseCallCount[AK_SIM_SHAPE_TYPE_CONVEX][AK_SIM_SHAPE_TYPE_CONVEX] += PairCount;
+#endif
+}
+
+#define AK_SIM__PAIR_TASK_SIZE 128
+
+/*The narrowphase runs in batches of pairs, each collecting its contacts into its own collector 
+  on the worker's arena. Tasks walk the pairs in kind order, so the batch kernels get long runs*/
+typedef struct {
+    ak_sim_context*             Context;
+    ak_sim__array*              PairArray;
+    ak_sim__pair_cache*         PairCaches;
+    const uint32_t*             PairIndices; /*Sorted by kind*/
+    const uint8_t*              PairBuckets;
+    uint32_t                    KindOffsets[AK_SIM__PAIR_KIND_COUNT+1];
+    ak_sim_collision_collector* Collectors;
+} ak_sim__narrowphase_task;
+
+static void AK_Sim__Narrowphase_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__narrowphase_task* Task = (ak_sim__narrowphase_task*)TaskData;
+    ak_sim__worker* Worker = Task->Context->Workers + WorkerIndex;
+    ak_sim_collision_collector* Collector = Task->Collectors + TaskIndex;
+    *Collector = AK_Sim__Begin_Collision_Collector(&Worker->Arena);
+
+    uint32_t FirstPair = TaskIndex*AK_SIM__PAIR_TASK_SIZE;
+    uint32_t LastPair = AK_Sim__Min(FirstPair+AK_SIM__PAIR_TASK_SIZE, Task->PairArray->Count);
+    uint32_t Kind;
+    for(Kind = 0; Kind < AK_SIM__PAIR_KIND_COUNT; Kind++) {
+        uint32_t First = AK_Sim__Max(FirstPair, Task->KindOffsets[Kind]);
+        uint32_t Last = AK_Sim__Min(LastPair, Task->KindOffsets[Kind+1]);
+        if(First >= Last) continue;
+
+        if(Kind == AK_SIM__PAIR_KIND_GENERIC) {
+            /*Each run of one bucket is timed as a whole rather than reading the clock per pair*/
+            uint32_t RunFirst = First;
+            while(RunFirst < Last) {
+                uint32_t Bucket = Task->PairBuckets[RunFirst];
+                uint32_t RunLast = RunFirst+1;
+                while(RunLast < Last && Task->PairBuckets[RunLast] == Bucket) RunLast++;
+
+#ifndef AK_SIM_NO_PROFILE
+                uint64_t StartNS = AK_SIM_GET_TIME_NS();
+#endif
+                uint32_t i;
+                for(i = RunFirst; i < RunLast; i++) {
+                    AK_Sim__Collide_Pair(Task->Context, Task->PairArray, Task->PairIndices[i], Task->PairCaches, Collector);
+                }
+#ifndef AK_SIM_NO_PROFILE
+                uint32_t TypeA = Bucket/(AK_SIM_SHAPE_TYPE_COUNT+1);
+                uint32_t TypeB = Bucket%(AK_SIM_SHAPE_TYPE_COUNT+1);
+                Worker->Stats.NarrowphaseTimeNS[TypeA][TypeB] += AK_SIM_GET_TIME_NS()-StartNS;
+                Worker->Stats.NarrowphaseCallCount[TypeA][TypeB] += RunLast-RunFirst;
+#endif
+                RunFirst = RunLast;
+            }
+        } else {
+            AK_Sim__Collide_Pair_Batches(Task->Context, Worker, Task->PairArray, Task->PairIndices+First, Last-First, Task->PairCaches, Collector);
+        }
+    }
+
+    Collector->Cache = NULL;
+    AK_Sim__Worker_Count(Worker, ContactsProduced, Collector->Contacts.Count);
+}
+
+static void AK_Sim__Integrate_Bodies(ak_sim_context* Context, float DeltaTime) {
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(&Context->BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        if(!AK_Sim__Is_Body_Awake(Body)) continue;
+
+        ak_sim_body_transform* Transform = &Body->Transform;
+        Transform->Position = AK_Sim__Position_Add_V3(Transform->Position, AK_Sim__V3_Mul_S(Body->LinearVelocity, DeltaTime));
+        Transform->Orientation = AK_Sim__Quat_Integrate(Transform->Orientation, Body->AngularVelocity, DeltaTime);
+    }
+}
+
+/*Joints are soft constraints, a stiff spring and damper solved implicitly. Unlike a plain 
+  position bias they stay stable at any substep size and iteration count*/
+#define AK_SIM__JOINT_HERTZ 60.0f
+#define AK_SIM__JOINT_DAMPING_RATIO 2.0f
+
+/*Joints past this many colors share the last one and are solved in order*/
+#define AK_SIM__MAX_JOINT_COLORS 32
+#define AK_SIM__JOINT_TASK_SIZE 64
+
+typedef struct {
+    float BiasRate;
+    float MassScale;
+    float ImpulseScale;
+} ak_sim__softness;
+
+static ak_sim__softness AK_Sim__Make_Softness(float Hertz, float DampingRatio, float DeltaTime) {
+    float Omega = 2.0f*AK_SIM__PI*Hertz;
+    float A1 = 2.0f*DampingRatio + DeltaTime*Omega;
+    float A2 = DeltaTime*Omega*A1;
+    float A3 = 1.0f/(1.0f+A2);
+
+    ak_sim__softness Result;
+    Result.BiasRate = Omega/A1;
+    Result.MassScale = A2*A3;
+    Result.ImpulseScale = A3;
+    return Result;
+}
+
+/*Per substep solver data of one joint. Non dynamic bodies have zero inverse mass and are never written*/
+typedef struct {
+    ak_sim_joint* Joint;
+    ak_sim_body*  BodyA;
+    ak_sim_body*  BodyB;
+    ak_sim_m3     InvInertiaA; /*World space*/
+    ak_sim_m3     InvInertiaB;
+    ak_sim_v3     AnchorA;     /*World space offsets from the body origins*/
+    ak_sim_v3     AnchorB;
+
+    /*Point constraint of ball, hinge and fixed joints, solved as one 3x3 block*/
+    ak_sim_v3     LinearError;
+    ak_sim_m3     LinearMass;
+
+    /*Fixed joints solve all three angular rows as a 3x3 block, hinges the two rows in HingeAxes 
+      as a 2x2 block in the top left*/
+    ak_sim_v3     AngularError;
+    ak_sim_m3     AngularMass;
+    ak_sim_v3     HingeAxes[2];
+
+    ak_sim_v3     Axis; /*Distance joint direction from anchor A to anchor B*/
+    float         AxialError;
+    float         AxialMass;
+} ak_sim__joint_constraint;
+
+/*Joints of an island are sorted by color. Joints of one color share no dynamic body*/
+typedef struct {
+    uint32_t FirstJoint;
+    uint32_t JointCount;
+} ak_sim__island;
+
+/*A range of joints, either whole small islands or joints of one color from a large island*/
+typedef struct {
+    uint32_t First;
+    uint32_t Last;
+} ak_sim__joint_batch;
+
+typedef struct {
+    ak_sim_context*           Context;
+    ak_sim_joint**            Joints;       /*Sorted by island, then color*/
+    ak_sim__joint_constraint* Constraints;  /*Parallel to Joints*/
+    ak_sim__joint_batch*      IslandBatches;
+    ak_sim__joint_batch*      ColorBatches; /*Sorted by color*/
+    uint32_t                  IslandBatchCount;
+    uint32_t                  ColorBatchOffsets[AK_SIM__MAX_JOINT_COLORS+2];
+    uint32_t                  Color;        /*Color the batch tasks are solving*/
+    ak_sim__softness          Softness;
+} ak_sim__joint_solver;
+
+static uint32_t AK_Sim__Find_Island_Root(uint32_t* Parents, uint32_t Index) {
+    while(Parents[Index] != Index) {
+        Parents[Index] = Parents[Parents[Index]];
+        Index = Parents[Index];
+    }
+    return Index;
+}
+
+static ak_sim_m3 AK_Sim__Get_World_Inv_Inertia(const ak_sim_body* Body, const ak_sim_m3* Rotation) {
+    ak_sim_m3 Transpose = AK_Sim__M3_Transpose(Rotation);
+    ak_sim_m3 Temp = AK_Sim__M3_Mul(&Body->InvInertia, &Transpose);
+    return AK_Sim__M3_Mul(Rotation, &Temp);
+}
+
+/*Any two unit vectors perpendicular to Axis and each other*/
+static void AK_Sim__Get_Perpendicular_Axes(ak_sim_v3 Axis, ak_sim_v3* AxisB, ak_sim_v3* AxisC) {
+    ak_sim_v3 Other = AK_Sim__Abs(Axis.Data[0]) < 0.57735f ? AK_Sim_V3(1.0f, 0.0f, 0.0f) : AK_Sim_V3(0.0f, 1.0f, 0.0f);
+    *AxisB = AK_Sim__V3_Normalize(AK_Sim__V3_Cross(Axis, Other));
+    *AxisC = AK_Sim__V3_Cross(Axis, *AxisB);
+}
+
+/*Splits one island's color sorted joints into batches of one color. Counts the batches of each 
+  color when Batches is null, and otherwise writes them at the cursor of their color. The overflow 
+  color is one batch, since its joints may share bodies*/
+static void AK_Sim__Add_Joint_Color_Batches(const uint32_t* Colors, uint32_t First, uint32_t Last, uint32_t* ColorCursors, ak_sim__joint_batch* Batches) {
+    while(First < Last) {
+        uint32_t Color = Colors[First];
+        uint32_t End = First;
+        while(End < Last && Colors[End] == Color && (Color == AK_SIM__MAX_JOINT_COLORS || End-First < AK_SIM__JOINT_TASK_SIZE)) End++;
+        if(Batches) {
+            Batches[ColorCursors[Color]].First = First;
+            Batches[ColorCursors[Color]].Last = End;
+        }
+        ColorCursors[Color]++;
+        First = End;
+    }
+}
+
+/*Groups the dynamic bodies connected by joints into islands with a union find over body slots, 
+  then colors each island's joints greedily. Returns 0 when there is nothing to solve*/
+static int AK_Sim__Build_Joint_Solver(ak_sim_context* Context, ak_sim__joint_solver* Solver, ak_sim__arena* TempArena) {
+    AK_SIM_MEMSET(Solver, 0, sizeof(ak_sim__joint_solver));
+    Solver->Context = Context;
+    if(!Context->JointPool.ItemCount) return 0;
+
+    ak_sim__pool* BodyPool = &Context->BodyPool;
+    uint32_t BodySlotCount = BodyPool->MaxUsed;
+    uint32_t* Parents = AK_Sim__Arena_Push_Array(TempArena, BodySlotCount, uint32_t);
+    uint32_t* IslandIndices = AK_Sim__Arena_Push_Array(TempArena, BodySlotCount, uint32_t);
+    uint32_t* ColorMasks = AK_Sim__Arena_Push_Array(TempArena, BodySlotCount, uint32_t);
+    uint32_t i;
+    for(i = 0; i < BodySlotCount; i++) {
+        Parents[i] = i;
+        IslandIndices[i] = (uint32_t)-1;
+        ColorMasks[i] = 0;
+    }
+
+    /*Joints with a deleted body or no dynamic body have nothing to solve. Islands sleep as a 
+      whole, so a joint with a sleeping body is asleep*/
+    uint32_t JointCapacity = Context->JointPool.ItemCount;
+    ak_sim_joint** Joints = AK_Sim__Arena_Push_Array(TempArena, JointCapacity, ak_sim_joint*);
+    uint32_t* JointIslands = AK_Sim__Arena_Push_Array(TempArena, JointCapacity, uint32_t);
+    uint32_t JointCount = 0;
+    ak_sim__pool_iter JointIter = AK_Sim__Pool_Begin_Iter(&Context->JointPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&JointIter)) {
+        ak_sim_joint* Joint = (ak_sim_joint*)AK_Sim__Pool_Iter_Next(&JointIter);
+        ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(BodyPool, Joint->BodyA);
+        ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Get(BodyPool, Joint->BodyB);
+        if(!BodyA || !BodyB || ((BodyA->Flags | BodyB->Flags) & AK_SIM_BODY_FLAG_SLEEPING)) continue;
+
+        int DynamicA = BodyA->Type == AK_SIM_BODY_TYPE_DYNAMIC;
+        int DynamicB = BodyB->Type == AK_SIM_BODY_TYPE_DYNAMIC;
+        if(!DynamicA && !DynamicB) continue;
+
+        ak_sim__pool_id IDA, IDB;
+        IDA.ID = Joint->BodyA;
+        IDB.ID = Joint->BodyB;
+        if(DynamicA && DynamicB) {
+            /*The smaller slot becomes the root so islands don't depend on joint order*/
+            uint32_t RootA = AK_Sim__Find_Island_Root(Parents, IDA.Internal.Index);
+            uint32_t RootB = AK_Sim__Find_Island_Root(Parents, IDB.Internal.Index);
+            Parents[AK_Sim__Max(RootA, RootB)] = AK_Sim__Min(RootA, RootB);
+        }
+        Joints[JointCount++] = Joint;
+    }
+    if(!JointCount) return 0;
+
+    /*Islands are numbered in joint order, which is pool order and so deterministic*/
+    uint32_t IslandCount = 0;
+    for(i = 0; i < JointCount; i++) {
+        ak_sim__pool_id ID;
+        ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(BodyPool, Joints[i]->BodyA);
+        ID.ID = BodyA->Type == AK_SIM_BODY_TYPE_DYNAMIC ? Joints[i]->BodyA : Joints[i]->BodyB;
+        uint32_t Root = AK_Sim__Find_Island_Root(Parents, ID.Internal.Index);
+        if(IslandIndices[Root] == (uint32_t)-1) IslandIndices[Root] = IslandCount++;
+        JointIslands[i] = IslandIndices[Root];
+    }
+
+    ak_sim__island* Islands = AK_Sim__Arena_Push_Array(TempArena, IslandCount, ak_sim__island);
+    AK_SIM_MEMSET(Islands, 0, IslandCount*sizeof(ak_sim__island));
+    for(i = 0; i < JointCount; i++) Islands[JointIslands[i]].JointCount++;
+    uint32_t First = 0;
+    for(i = 0; i < IslandCount; i++) {
+        Islands[i].FirstJoint = First;
+        First += Islands[i].JointCount;
+        Islands[i].JointCount = 0;
+    }
+
+    ak_sim_joint** SortedJoints = AK_Sim__Arena_Push_Array(TempArena, JointCount, ak_sim_joint*);
+    for(i = 0; i < JointCount; i++) {
+        ak_sim__island* Island = Islands + JointIslands[i];
+        SortedJoints[Island->FirstJoint + Island->JointCount++] = Joints[i];
+    }
+
+    /*Greedy coloring on the dynamic bodies, then a stable counting sort by color per island*/
+    uint32_t* JointColors = JointIslands;
+    uint32_t* SortedColors = AK_Sim__Arena_Push_Array(TempArena, JointCount, uint32_t);
+    uint32_t MaxColorCount = 0;
+    uint32_t IslandIndex;
+    for(IslandIndex = 0; IslandIndex < IslandCount; IslandIndex++) {
+        ak_sim__island* Island = Islands + IslandIndex;
+        uint32_t ColorCounts[AK_SIM__MAX_JOINT_COLORS+1];
+        AK_SIM_MEMSET(ColorCounts, 0, sizeof(ColorCounts));
+
+        for(i = Island->FirstJoint; i < Island->FirstJoint+Island->JointCount; i++) {
+            ak_sim_joint* Joint = SortedJoints[i];
+            ak_sim__pool_id IDA, IDB;
+            IDA.ID = Joint->BodyA;
+            IDB.ID = Joint->BodyB;
+            int DynamicA = ((ak_sim_body*)AK_Sim__Pool_Get(BodyPool, Joint->BodyA))->Type == AK_SIM_BODY_TYPE_DYNAMIC;
+            int DynamicB = ((ak_sim_body*)AK_Sim__Pool_Get(BodyPool, Joint->BodyB))->Type == AK_SIM_BODY_TYPE_DYNAMIC;
+            uint32_t Used = (DynamicA ? ColorMasks[IDA.Internal.Index] : 0) | (DynamicB ? ColorMasks[IDB.Internal.Index] : 0);
+
+            uint32_t Color = 0;
+            while(Color < AK_SIM__MAX_JOINT_COLORS && (Used & (1u << Color))) Color++;
+            if(Color < AK_SIM__MAX_JOINT_COLORS) {
+                if(DynamicA) ColorMasks[IDA.Internal.Index] |= 1u << Color;
+                if(DynamicB) ColorMasks[IDB.Internal.Index] |= 1u << Color;
+            }
+            JointColors[i] = Color;
+            ColorCounts[Color]++;
+            MaxColorCount = AK_Sim__Max(MaxColorCount, Color+1);
+        }
+
+        uint32_t Offset = Island->FirstJoint;
+        uint32_t Color;
+        for(Color = 0; Color <= AK_SIM__MAX_JOINT_COLORS; Color++) {
+            uint32_t Count = ColorCounts[Color];
+            ColorCounts[Color] = Offset;
+            Offset += Count;
+        }
+        for(i = Island->FirstJoint; i < Island->FirstJoint+Island->JointCount; i++) {
+            SortedColors[ColorCounts[JointColors[i]]] = JointColors[i];
+            Joints[ColorCounts[JointColors[i]]++] = SortedJoints[i];
+        }
+    }
+
+    /*Small islands are grouped into tasks of about AK_SIM__JOINT_TASK_SIZE joints and solved 
+      whole. Larger islands are split into batches of one color, so the batches of a color can run 
+      in parallel*/
+    ak_sim__joint_batch* IslandBatches = AK_Sim__Arena_Push_Array(TempArena, IslandCount, ak_sim__joint_batch);
+    uint32_t ColorCursors[AK_SIM__MAX_JOINT_COLORS+1];
+    AK_SIM_MEMSET(ColorCursors, 0, sizeof(ColorCursors));
+    uint32_t IslandBatchCount = 0;
+    uint32_t TaskJointCount = 0;
+    for(i = 0; i < IslandCount; i++) {
+        uint32_t FirstJoint = Islands[i].FirstJoint;
+        uint32_t LastJoint = FirstJoint + Islands[i].JointCount;
+        if(Islands[i].JointCount >= AK_SIM__JOINT_TASK_SIZE) {
+            AK_Sim__Add_Joint_Color_Batches(SortedColors, FirstJoint, LastJoint, ColorCursors, NULL);
+            TaskJointCount = 0;
+            continue;
+        }
+
+        if(!TaskJointCount) IslandBatches[IslandBatchCount++].First = FirstJoint;
+        IslandBatches[IslandBatchCount-1].Last = LastJoint;
+        TaskJointCount += Islands[i].JointCount;
+        if(TaskJointCount >= AK_SIM__JOINT_TASK_SIZE) TaskJointCount = 0;
+    }
+
+    uint32_t ColorBatchCount = 0;
+    uint32_t Color;
+    for(Color = 0; Color <= AK_SIM__MAX_JOINT_COLORS; Color++) {
+        Solver->ColorBatchOffsets[Color] = ColorBatchCount;
+        ColorBatchCount += ColorCursors[Color];
+        ColorCursors[Color] = Solver->ColorBatchOffsets[Color];
+    }
+    Solver->ColorBatchOffsets[AK_SIM__MAX_JOINT_COLORS+1] = ColorBatchCount;
+
+    ak_sim__joint_batch* ColorBatches = AK_Sim__Arena_Push_Array(TempArena, ColorBatchCount, ak_sim__joint_batch);
+    for(i = 0; i < IslandCount; i++) {
+        if(Islands[i].JointCount >= AK_SIM__JOINT_TASK_SIZE) {
+            AK_Sim__Add_Joint_Color_Batches(SortedColors, Islands[i].FirstJoint, Islands[i].FirstJoint+Islands[i].JointCount, ColorCursors, ColorBatches);
+        }
+    }
+
+    Solver->Joints = Joints;
+    Solver->Constraints = AK_Sim__Arena_Push_Array(TempArena, JointCount, ak_sim__joint_constraint);
+    Solver->IslandBatches = IslandBatches;
+    Solver->ColorBatches = ColorBatches;
+    Solver->IslandBatchCount = IslandBatchCount;
+
+    AK_Sim__Profile_Count(Context, IslandCount, IslandCount);
+    AK_Sim__Profile_Count(Context, JointColorCount, MaxColorCount);
+    return 1;
+}
+
+static void AK_Sim__Prepare_Joint(ak_sim_context* Context, ak_sim__joint_constraint* Constraint, ak_sim_joint* Joint) {
+    ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Joint->BodyA);
+    ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Joint->BodyB);
+    ak_sim_m3 RotationA = AK_Sim__Quat_To_M3(BodyA->Transform.Orientation);
+    ak_sim_m3 RotationB = AK_Sim__Quat_To_M3(BodyB->Transform.Orientation);
+
+    Constraint->Joint = Joint;
+    Constraint->BodyA = BodyA;
+    Constraint->BodyB = BodyB;
+    Constraint->InvInertiaA = AK_Sim__Get_World_Inv_Inertia(BodyA, &RotationA);
+    Constraint->InvInertiaB = AK_Sim__Get_World_Inv_Inertia(BodyB, &RotationB);
+    Constraint->AnchorA = AK_Sim__M3_Mul_V3(&RotationA, Joint->LocalAnchorA);
+    Constraint->AnchorB = AK_Sim__M3_Mul_V3(&RotationB, Joint->LocalAnchorB);
+
+    ak_sim_v3 Origins = AK_Sim__Position_Sub(BodyB->Transform.Position, BodyA->Transform.Position);
+    ak_sim_v3 Separation = AK_Sim__V3_Add(Origins, AK_Sim__V3_Sub(Constraint->AnchorB, Constraint->AnchorA));
+    ak_sim_m3 AngularK = AK_Sim__M3_Add(&Constraint->InvInertiaA, &Constraint->InvInertiaB);
+
+    if(Joint->Type == AK_SIM_JOINT_TYPE_DISTANCE) {
+        float Length = AK_Sim__V3_Length(Separation);
+        Constraint->Axis = Length > 1e-6f ? AK_Sim__V3_Mul_S(Separation, 1.0f/Length) : AK_Sim_V3(0.0f, 1.0f, 0.0f);
+        Constraint->AxialError = Length - Joint->Distance;
+
+        ak_sim_v3 CrossA = AK_Sim__V3_Cross(Constraint->AnchorA, Constraint->Axis);
+        ak_sim_v3 CrossB = AK_Sim__V3_Cross(Constraint->AnchorB, Constraint->Axis);
+        float K = BodyA->InvMass + BodyB->InvMass + 
+                  AK_Sim__V3_Dot(CrossA, AK_Sim__M3_Mul_V3(&Constraint->InvInertiaA, CrossA)) + 
+                  AK_Sim__V3_Dot(CrossB, AK_Sim__M3_Mul_V3(&Constraint->InvInertiaB, CrossB));
+        Constraint->AxialMass = K > 0.0f ? 1.0f/K : 0.0f;
+        return;
+    }
+
+    /*K = (mA + mB)*E - [rA]*IA*[rA] - [rB]*IB*[rB]*/
+    ak_sim_m3 SkewA = AK_Sim__M3_Skew(Constraint->AnchorA);
+    ak_sim_m3 SkewB = AK_Sim__M3_Skew(Constraint->AnchorB);
+    ak_sim_m3 TermA = AK_Sim__M3_Mul(&Constraint->InvInertiaA, &SkewA);
+    ak_sim_m3 TermB = AK_Sim__M3_Mul(&Constraint->InvInertiaB, &SkewB);
+    TermA = AK_Sim__M3_Mul(&SkewA, &TermA);
+    TermB = AK_Sim__M3_Mul(&SkewB, &TermB);
+    ak_sim_m3 K;
+    uint32_t i;
+    for(i = 0; i < 3; i++) {
+        K.Cols[i] = AK_Sim__V3_Mul_S(AK_Sim__V3_Add(TermA.Cols[i], TermB.Cols[i]), -1.0f);
+        K.Cols[i].Data[i] += BodyA->InvMass + BodyB->InvMass;
+    }
+    Constraint->LinearError = Separation;
+    Constraint->LinearMass = AK_Sim__M3_Inverse(&K);
+
+    if(Joint->Type == AK_SIM_JOINT_TYPE_HINGE) {
+        /*Keeps A's axis perpendicular to the two axes perpendicular to B's axis*/
+        ak_sim_v3 AxisA = AK_Sim__M3_Mul_V3(&RotationA, Joint->LocalAxisA);
+        ak_sim_v3 AxisB = AK_Sim__M3_Mul_V3(&RotationB, Joint->LocalAxisB);
+        ak_sim_v3 PerpB[2];
+        AK_Sim__Get_Perpendicular_Axes(AxisB, PerpB, PerpB+1);
+
+        float K2[2][2];
+        uint32_t j;
+        for(i = 0; i < 2; i++) {
+            Constraint->HingeAxes[i] = AK_Sim__V3_Cross(PerpB[i], AxisA);
+            Constraint->AngularError.Data[i] = AK_Sim__V3_Dot(AxisA, PerpB[i]);
+        }
+        for(i = 0; i < 2; i++) {
+            for(j = 0; j < 2; j++) {
+                K2[i][j] = AK_Sim__V3_Dot(Constraint->HingeAxes[i], AK_Sim__M3_Mul_V3(&AngularK, Constraint->HingeAxes[j]));
+            }
+        }
+
+        float Det = K2[0][0]*K2[1][1] - K2[0][1]*K2[1][0];
+        float InvDet = Det != 0.0f ? 1.0f/Det : 0.0f;
+        AK_SIM_MEMSET(&Constraint->AngularMass, 0, sizeof(ak_sim_m3));
+        Constraint->AngularMass.Cols[0].Data[0] = K2[1][1]*InvDet;
+        Constraint->AngularMass.Cols[0].Data[1] = -K2[1][0]*InvDet;
+        Constraint->AngularMass.Cols[1].Data[0] = -K2[0][1]*InvDet;
+        Constraint->AngularMass.Cols[1].Data[1] = K2[0][0]*InvDet;
+    } else if(Joint->Type == AK_SIM_JOINT_TYPE_FIXED) {
+        /*Small angle rotation from the target orientation to B's, in world space*/
+        ak_sim_quat Target = AK_Sim__Quat_Mul(BodyA->Transform.Orientation, Joint->RelativeOrientation);
+        ak_sim_quat Error = AK_Sim__Quat_Mul(BodyB->Transform.Orientation, AK_Sim__Quat_Conjugate(Target));
+        float Sign = Error.Data[3] < 0.0f ? -2.0f : 2.0f;
+        Constraint->AngularError = AK_Sim_V3(Error.Data[0]*Sign, Error.Data[1]*Sign, Error.Data[2]*Sign);
+        Constraint->AngularMass = AK_Sim__M3_Inverse(&AngularK);
+    }
+}
+
+static void AK_Sim__Apply_Joint_Impulse(ak_sim__joint_constraint* Constraint, ak_sim_v3 Linear, ak_sim_v3 Angular) {
+    ak_sim_body* BodyA = Constraint->BodyA;
+    ak_sim_body* BodyB = Constraint->BodyB;
+    if(BodyA->Type == AK_SIM_BODY_TYPE_DYNAMIC) {
+        ak_sim_v3 Torque = AK_Sim__V3_Add(AK_Sim__V3_Cross(Constraint->AnchorA, Linear), Angular);
+        BodyA->LinearVelocity = AK_Sim__V3_Sub(BodyA->LinearVelocity, AK_Sim__V3_Mul_S(Linear, BodyA->InvMass));
+        BodyA->AngularVelocity = AK_Sim__V3_Sub(BodyA->AngularVelocity, AK_Sim__M3_Mul_V3(&Constraint->InvInertiaA, Torque));
+    }
+    if(BodyB->Type == AK_SIM_BODY_TYPE_DYNAMIC) {
+        ak_sim_v3 Torque = AK_Sim__V3_Add(AK_Sim__V3_Cross(Constraint->AnchorB, Linear), Angular);
+        BodyB->LinearVelocity = AK_Sim__V3_Add(BodyB->LinearVelocity, AK_Sim__V3_Mul_S(Linear, BodyB->InvMass));
+        BodyB->AngularVelocity = AK_Sim__V3_Add(BodyB->AngularVelocity, AK_Sim__M3_Mul_V3(&Constraint->InvInertiaB, Torque));
+    }
+}
+
+static ak_sim_v3 AK_Sim__Get_Hinge_Impulse(const ak_sim__joint_constraint* Constraint, float Impulse0, float Impulse1) {
+    return AK_Sim__V3_Add(AK_Sim__V3_Mul_S(Constraint->HingeAxes[0], Impulse0), AK_Sim__V3_Mul_S(Constraint->HingeAxes[1], Impulse1));
+}
+
+static void AK_Sim__Warm_Start_Joint(ak_sim__joint_constraint* Constraint) {
+    ak_sim_joint* Joint = Constraint->Joint;
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    switch(Joint->Type) {
+        case AK_SIM_JOINT_TYPE_DISTANCE: {
+            AK_Sim__Apply_Joint_Impulse(Constraint, AK_Sim__V3_Mul_S(Constraint->Axis, Joint->AxialImpulse), Zero);
+        } break;
+
+        case AK_SIM_JOINT_TYPE_HINGE: {
+            ak_sim_v3 Angular = AK_Sim__Get_Hinge_Impulse(Constraint, Joint->AngularImpulse.Data[0], Joint->AngularImpulse.Data[1]);
+            AK_Sim__Apply_Joint_Impulse(Constraint, Joint->LinearImpulse, Angular);
+        } break;
+
+        case AK_SIM_JOINT_TYPE_FIXED: {
+            AK_Sim__Apply_Joint_Impulse(Constraint, Joint->LinearImpulse, Joint->AngularImpulse);
+        } break;
+
+        default: {
+            AK_Sim__Apply_Joint_Impulse(Constraint, Joint->LinearImpulse, Zero);
+        } break;
+    }
+}
+
+/*Relative velocity of anchor B to anchor A*/
+static ak_sim_v3 AK_Sim__Get_Joint_Anchor_Velocity(const ak_sim__joint_constraint* Constraint) {
+    const ak_sim_body* BodyA = Constraint->BodyA;
+    const ak_sim_body* BodyB = Constraint->BodyB;
+    ak_sim_v3 VelocityA = AK_Sim__V3_Add(BodyA->LinearVelocity, AK_Sim__V3_Cross(BodyA->AngularVelocity, Constraint->AnchorA));
+    ak_sim_v3 VelocityB = AK_Sim__V3_Add(BodyB->LinearVelocity, AK_Sim__V3_Cross(BodyB->AngularVelocity, Constraint->AnchorB));
+    return AK_Sim__V3_Sub(VelocityB, VelocityA);
+}
+
+/*Each block computes impulse = -MassScale*M*(Cdot + BiasRate*C) - ImpulseScale*Accumulated. 
+  Angular rows go first so the point constraint has the final say*/
+static void AK_Sim__Solve_Joint(ak_sim__joint_constraint* Constraint, const ak_sim__softness* Softness) {
+    ak_sim_joint* Joint = Constraint->Joint;
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+
+    if(Joint->Type == AK_SIM_JOINT_TYPE_DISTANCE) {
+        float Cdot = AK_Sim__V3_Dot(Constraint->Axis, AK_Sim__Get_Joint_Anchor_Velocity(Constraint));
+        float Impulse = -Softness->MassScale*Constraint->AxialMass*(Cdot + Softness->BiasRate*Constraint->AxialError) - 
+                        Softness->ImpulseScale*Joint->AxialImpulse;
+        Joint->AxialImpulse += Impulse;
+        AK_Sim__Apply_Joint_Impulse(Constraint, AK_Sim__V3_Mul_S(Constraint->Axis, Impulse), Zero);
+        return;
+    }
+
+    if(Joint->Type == AK_SIM_JOINT_TYPE_HINGE) {
+        ak_sim_v3 RelativeW = AK_Sim__V3_Sub(Constraint->BodyB->AngularVelocity, Constraint->BodyA->AngularVelocity);
+        ak_sim_v3 Rhs = AK_Sim_V3(AK_Sim__V3_Dot(Constraint->HingeAxes[0], RelativeW) + Softness->BiasRate*Constraint->AngularError.Data[0], 
+                                  AK_Sim__V3_Dot(Constraint->HingeAxes[1], RelativeW) + Softness->BiasRate*Constraint->AngularError.Data[1], 0.0f);
+        ak_sim_v3 Impulse = AK_Sim__V3_Mul_S(AK_Sim__M3_Mul_V3(&Constraint->AngularMass, Rhs), -Softness->MassScale);
+        Impulse = AK_Sim__V3_Sub(Impulse, AK_Sim__V3_Mul_S(Joint->AngularImpulse, Softness->ImpulseScale));
+        Joint->AngularImpulse = AK_Sim__V3_Add(Joint->AngularImpulse, Impulse);
+        AK_Sim__Apply_Joint_Impulse(Constraint, Zero, AK_Sim__Get_Hinge_Impulse(Constraint, Impulse.Data[0], Impulse.Data[1]));
+    } else if(Joint->Type == AK_SIM_JOINT_TYPE_FIXED) {
+        ak_sim_v3 RelativeW = AK_Sim__V3_Sub(Constraint->BodyB->AngularVelocity, Constraint->BodyA->AngularVelocity);
+        ak_sim_v3 Rhs = AK_Sim__V3_Add(RelativeW, AK_Sim__V3_Mul_S(Constraint->AngularError, Softness->BiasRate));
+        ak_sim_v3 Impulse = AK_Sim__V3_Mul_S(AK_Sim__M3_Mul_V3(&Constraint->AngularMass, Rhs), -Softness->MassScale);
+        Impulse = AK_Sim__V3_Sub(Impulse, AK_Sim__V3_Mul_S(Joint->AngularImpulse, Softness->ImpulseScale));
+        Joint->AngularImpulse = AK_Sim__V3_Add(Joint->AngularImpulse, Impulse);
+        AK_Sim__Apply_Joint_Impulse(Constraint, Zero, Impulse);
+    }
+
+    ak_sim_v3 Rhs = AK_Sim__V3_Add(AK_Sim__Get_Joint_Anchor_Velocity(Constraint), AK_Sim__V3_Mul_S(Constraint->LinearError, Softness->BiasRate));
+    ak_sim_v3 Impulse = AK_Sim__V3_Mul_S(AK_Sim__M3_Mul_V3(&Constraint->LinearMass, Rhs), -Softness->MassScale);
+    Impulse = AK_Sim__V3_Sub(Impulse, AK_Sim__V3_Mul_S(Joint->LinearImpulse, Softness->ImpulseScale));
+    Joint->LinearImpulse = AK_Sim__V3_Add(Joint->LinearImpulse, Impulse);
+    AK_Sim__Apply_Joint_Impulse(Constraint, Impulse, Zero);
+}
+
+/*Islands share no dynamic body, so small islands are solved whole as independent tasks, going 
+  color by color like the large islands do*/
+static void AK_Sim__Solve_Joints_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__joint_solver* Solver = (ak_sim__joint_solver*)TaskData;
+    uint32_t FirstJoint = Solver->IslandBatches[TaskIndex].First;
+    uint32_t LastJoint = Solver->IslandBatches[TaskIndex].Last;
+
+    uint32_t i, Iteration;
+    for(i = FirstJoint; i < LastJoint; i++) {
+        AK_Sim__Prepare_Joint(Solver->Context, Solver->Constraints+i, Solver->Joints[i]);
+        AK_Sim__Warm_Start_Joint(Solver->Constraints+i);
+    }
+
+    for(Iteration = 0; Iteration < Solver->Context->SolverIterationCount; Iteration++) {
+        for(i = FirstJoint; i < LastJoint; i++) {
+            AK_Sim__Solve_Joint(Solver->Constraints+i, &Solver->Softness);
+        }
+    }
+}
+
+/*Prepare only writes the constraints, so every color's batches go at once*/
+static void AK_Sim__Prepare_Joint_Batch_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__joint_solver* Solver = (ak_sim__joint_solver*)TaskData;
+    const ak_sim__joint_batch* Batch = Solver->ColorBatches + TaskIndex;
+    uint32_t i;
+    for(i = Batch->First; i < Batch->Last; i++) {
+        AK_Sim__Prepare_Joint(Solver->Context, Solver->Constraints+i, Solver->Joints[i]);
+    }
+}
+
+static void AK_Sim__Warm_Start_Joint_Batch_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__joint_solver* Solver = (ak_sim__joint_solver*)TaskData;
+    const ak_sim__joint_batch* Batch = Solver->ColorBatches + Solver->ColorBatchOffsets[Solver->Color] + TaskIndex;
+    uint32_t i;
+    for(i = Batch->First; i < Batch->Last; i++) {
+        AK_Sim__Warm_Start_Joint(Solver->Constraints+i);
+    }
+}
+
+static void AK_Sim__Solve_Joint_Batch_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__joint_solver* Solver = (ak_sim__joint_solver*)TaskData;
+    const ak_sim__joint_batch* Batch = Solver->ColorBatches + Solver->ColorBatchOffsets[Solver->Color] + TaskIndex;
+    uint32_t i;
+    for(i = Batch->First; i < Batch->Last; i++) {
+        AK_Sim__Solve_Joint(Solver->Constraints+i, &Solver->Softness);
+    }
+}
+
+static void AK_Sim__Run_Joint_Colors(ak_sim_context* Context, ak_sim__joint_solver* Solver, ak_sim_task_func* Task) {
+    uint32_t Color;
+    for(Color = 0; Color <= AK_SIM__MAX_JOINT_COLORS; Color++) {
+        uint32_t BatchCount = Solver->ColorBatchOffsets[Color+1]-Solver->ColorBatchOffsets[Color];
+        if(BatchCount) {
+            Solver->Color = Color;
+            AK_Sim__Parallel_For(Context, Task, Solver, BatchCount);
+        }
+    }
+}
+
+/*One substep of joints. Large islands go color by color with the batches of a color in parallel, 
+  which solves their joints in the same order as a single task would*/
+static void AK_Sim__Solve_Joints(ak_sim_context* Context, ak_sim__joint_solver* Solver) {
+    if(Solver->IslandBatchCount) {
+        AK_Sim__Parallel_For(Context, AK_Sim__Solve_Joints_Task, Solver, Solver->IslandBatchCount);
+    }
+
+    uint32_t ColorBatchCount = Solver->ColorBatchOffsets[AK_SIM__MAX_JOINT_COLORS+1];
+    if(!ColorBatchCount) return;
+
+    AK_Sim__Parallel_For(Context, AK_Sim__Prepare_Joint_Batch_Task, Solver, ColorBatchCount);
+    AK_Sim__Run_Joint_Colors(Context, Solver, AK_Sim__Warm_Start_Joint_Batch_Task);
+    uint32_t Iteration;
+    for(Iteration = 0; Iteration < Context->SolverIterationCount; Iteration++) {
+        AK_Sim__Run_Joint_Colors(Context, Solver, AK_Sim__Solve_Joint_Batch_Task);
+    }
+}
+
+#define AK_SIM__CLOTH_TASK_SIZE 256
+
+/*A rigid body a cloth may touch this step, with its swept bounds around the cloth's origin*/
+typedef struct {
+    uint32_t           ClothIndex;
+    const ak_sim_body* Body;
+    ak_sim_shape*      Shape;
+    ak_sim__aabb       AABB;
+} ak_sim__cloth_collider;
+
+/*A range of one cloth's particles, or of one color of its constraints*/
+typedef struct {
+    uint32_t ClothIndex;
+    uint32_t First;
+    uint32_t Last;
+} ak_sim__cloth_batch;
+
+typedef struct {
+    ak_sim_context*         Context;
+    ak_sim__cloth**         Cloths;
+    ak_sim__cloth_collider* Colliders;         /*Sorted by cloth*/
+    uint32_t*               FirstColliders;    /*Cloth i collides with [FirstColliders[i], FirstColliders[i+1])*/
+    ak_sim__cloth_batch*    ParticleBatches;
+    uint32_t                ParticleBatchCount;
+    ak_sim__cloth_batch*    ConstraintBatches; /*Sorted by color*/
+    uint32_t                ColorBatchOffsets[AK_SIM__MAX_CLOTH_COLORS+2];
+    uint32_t                Color;             /*Color the constraint tasks are solving*/
+    float                   DeltaTime;
+} ak_sim__cloth_solver;
+
+/*Splits the cloths into batches and finds the rigid bodies each one may touch this step. Cloth 
+  bounds cover the particles' motion over the step, like the swept body bounds, and are tested 
+  against the static tree and against the moving bodies through a tree of the cloths. Returns 0 
+  when there is no cloth*/
+static int AK_Sim__Build_Cloth_Solver(ak_sim_context* Context, ak_sim__cloth_solver* Solver, ak_sim__arena* TempArena) {
+    AK_SIM_MEMSET(Solver, 0, sizeof(ak_sim__cloth_solver));
+    Solver->Context = Context;
+    uint32_t ClothCount = Context->ClothPool.ItemCount;
+    if(!ClothCount) return 0;
+
+    float DeltaTime = Context->FixedTimeStep;
+    ak_sim__cloth** Cloths = AK_Sim__Arena_Push_Array(TempArena, ClothCount, ak_sim__cloth*);
+    ak_sim__bvh_item* ClothItems = AK_Sim__Arena_Push_Array(TempArena, ClothCount, ak_sim__bvh_item);
+    uint32_t ColorBatchCounts[AK_SIM__MAX_CLOTH_COLORS+1];
+    AK_SIM_MEMSET(ColorBatchCounts, 0, sizeof(ColorBatchCounts));
+    uint32_t ParticleBatchCount = 0;
+    uint32_t ClothIndex = 0;
+    uint32_t Color, i, j;
+
+    ak_sim__pool_iter ClothIter = AK_Sim__Pool_Begin_Iter(&Context->ClothPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&ClothIter)) {
+        ak_sim__cloth* Cloth = (ak_sim__cloth*)AK_Sim__Pool_Iter_Next(&ClothIter);
+        ak_sim_v3 Fall = AK_Sim__V3_Mul_S(Cloth->Gravity, 0.5f*DeltaTime*DeltaTime);
+        ak_sim__aabb AABB = AK_Sim__AABB_Empty();
+        for(i = 0; i < Cloth->ParticleCount; i++) {
+            ak_sim_v3 P = AK_Sim_V3(Cloth->X[0][i], Cloth->X[1][i], Cloth->X[2][i]);
+            ak_sim_v3 V = AK_Sim_V3(Cloth->V[0][i], Cloth->V[1][i], Cloth->V[2][i]);
+            AK_Sim__AABB_Add_Point(&AABB, P);
+            AK_Sim__AABB_Add_Point(&AABB, AK_Sim__V3_Add(P, AK_Sim__V3_Add(AK_Sim__V3_Mul_S(V, DeltaTime), Fall)));
+        }
+        AABB = AK_Sim__AABB_Extend(&AABB, Cloth->Radius + AK_SIM__FAT_AABB_MARGIN);
+
+        ak_sim__bvh_item* Item = ClothItems + ClothIndex;
+        Item->AABB = AK_Sim__Get_World_AABB(&AABB, Cloth->Origin);
+        Item->ID = ClothIndex;
+        Item->CollisionCategory = Cloth->CollisionCategory;
+        Item->CollisionMask = Cloth->CollisionMask;
+        Item->Type = AK_SIM_BODY_TYPE_DYNAMIC;
+        Item->Flags = 0;
+        Cloths[ClothIndex++] = Cloth;
+
+        ParticleBatchCount += (Cloth->ParticleCount+AK_SIM__CLOTH_TASK_SIZE-1)/AK_SIM__CLOTH_TASK_SIZE;
+        for(Color = 0; Color < AK_SIM__MAX_CLOTH_COLORS; Color++) {
+            uint32_t Count = Cloth->ColorOffsets[Color+1]-Cloth->ColorOffsets[Color];
+            ColorBatchCounts[Color] += (Count+AK_SIM__CLOTH_TASK_SIZE-1)/AK_SIM__CLOTH_TASK_SIZE;
+        }
+        if(Cloth->ColorOffsets[AK_SIM__MAX_CLOTH_COLORS+1] > Cloth->ColorOffsets[AK_SIM__MAX_CLOTH_COLORS]) {
+            ColorBatchCounts[AK_SIM__MAX_CLOTH_COLORS]++;
+        }
+    }
+    AK_SIM_ASSERT(ClothIndex == ClothCount);
+
+    uint32_t ConstraintBatchCount = 0;
+    for(Color = 0; Color <= AK_SIM__MAX_CLOTH_COLORS; Color++) {
+        Solver->ColorBatchOffsets[Color] = ConstraintBatchCount;
+        ConstraintBatchCount += ColorBatchCounts[Color];
+        ColorBatchCounts[Color] = Solver->ColorBatchOffsets[Color];
+    }
+    Solver->ColorBatchOffsets[AK_SIM__MAX_CLOTH_COLORS+1] = ConstraintBatchCount;
+
+    /*The overflow color of a cloth is one batch, since its constraints may share particles*/
+    ak_sim__cloth_batch* ParticleBatches = AK_Sim__Arena_Push_Array(TempArena, ParticleBatchCount, ak_sim__cloth_batch);
+    ak_sim__cloth_batch* ConstraintBatches = AK_Sim__Arena_Push_Array(TempArena, ConstraintBatchCount, ak_sim__cloth_batch);
+    uint32_t ParticleBatchIndex = 0;
+    for(ClothIndex = 0; ClothIndex < ClothCount; ClothIndex++) {
+        const ak_sim__cloth* Cloth = Cloths[ClothIndex];
+        for(i = 0; i < Cloth->ParticleCount; i += AK_SIM__CLOTH_TASK_SIZE) {
+            ak_sim__cloth_batch* Batch = ParticleBatches + ParticleBatchIndex++;
+            Batch->ClothIndex = ClothIndex;
+            Batch->First = i;
+            Batch->Last = AK_Sim__Min(i+AK_SIM__CLOTH_TASK_SIZE, Cloth->ParticleCount);
+        }
+
+        for(Color = 0; Color <= AK_SIM__MAX_CLOTH_COLORS; Color++) {
+            uint32_t First = Cloth->ColorOffsets[Color];
+            uint32_t Last = Cloth->ColorOffsets[Color+1];
+            uint32_t BatchSize = Color < AK_SIM__MAX_CLOTH_COLORS ? AK_SIM__CLOTH_TASK_SIZE : Last-First;
+            for(i = First; i < Last; i += BatchSize) {
+                ak_sim__cloth_batch* Batch = ConstraintBatches + ColorBatchCounts[Color]++;
+                Batch->ClothIndex = ClothIndex;
+                Batch->First = i;
+                Batch->Last = AK_Sim__Min(i+BatchSize, Last);
+            }
+        }
+    }
+
+    /*Sensors don't push particles, so they're skipped*/
+    ak_sim__pool* BodyPool = &Context->BodyPool;
+    ak_sim__array Colliders, IDs;
+    AK_Sim__Array_Init(&Colliders, &TempArena->BaseAllocator, sizeof(ak_sim__cloth_collider));
+    AK_Sim__Array_Init(&IDs, &TempArena->BaseAllocator, sizeof(ak_sim_body_id));
+    for(ClothIndex = 0; ClothIndex < ClothCount; ClothIndex++) {
+        IDs.Count = 0;
+        AK_Sim__BVH_Find_Overlaps(&Context->StaticTree, ClothItems + ClothIndex, &IDs);
+        for(j = 0; j < IDs.Count; j++) {
+            ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Get(BodyPool, *(ak_sim_body_id*)AK_Sim__Array_Get(&IDs, j));
+            if(Body->Flags & AK_SIM_BODY_FLAG_SENSOR) continue;
+
+            ak_sim__cloth_collider Collider;
+            ak_sim__aabb AABB = AK_Sim__Get_Body_AABB(Context, Body);
+            Collider.ClothIndex = ClothIndex;
+            Collider.Body = Body;
+            Collider.Shape = &AK_Sim__Get_Shape_Entry(Context, Body->Shape)->Shape;
+            Collider.AABB = AK_Sim__Get_Local_AABB(&AABB, Cloths[ClothIndex]->Origin);
+            AK_Sim__Array_Add(&Colliders, &Collider);
+        }
+    }
+
+    /*Building the tree reorders the items, which is why the static queries go first*/
+    ak_sim__bvh ClothTree;
+    AK_Sim__BVH_Build(&ClothTree, ClothItems, ClothCount, AK_Sim__Arena_Push_Array(TempArena, 2*ClothCount, ak_sim__bvh_node));
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        if(Body->Type == AK_SIM_BODY_TYPE_STATIC || (Body->Flags & AK_SIM_BODY_FLAG_SENSOR)) continue;
+
+        ak_sim__pool_id ID;
+        ID.ID = Body->ID;
+        const ak_sim__aabb* SweptAABB = &Context->BodyBounds[ID.Internal.Index].SweptAABB;
+        ak_sim__bvh_item Item;
+        AK_Sim__BVH_Item_From_Body(&Item, Body, SweptAABB);
+
+        IDs.Count = 0;
+        AK_Sim__BVH_Find_Overlaps(&ClothTree, &Item, &IDs);
+        for(j = 0; j < IDs.Count; j++) {
+            ak_sim__cloth_collider Collider;
+            Collider.ClothIndex = (uint32_t)*(ak_sim_body_id*)AK_Sim__Array_Get(&IDs, j);
+            Collider.Body = Body;
+            Collider.Shape = &AK_Sim__Get_Shape_Entry(Context, Body->Shape)->Shape;
+            Collider.AABB = AK_Sim__Get_Local_AABB(SweptAABB, Cloths[Collider.ClothIndex]->Origin);
+            AK_Sim__Array_Add(&Colliders, &Collider);
+        }
+    }
+
+    /*Stable counting sort by cloth, so each cloth sees its colliders in a deterministic order*/
+    uint32_t* FirstColliders = AK_Sim__Arena_Push_Array(TempArena, ClothCount+1, uint32_t);
+    ak_sim__cloth_collider* SortedColliders = AK_Sim__Arena_Push_Array(TempArena, Colliders.Count, ak_sim__cloth_collider);
+    AK_SIM_MEMSET(FirstColliders, 0, (ClothCount+1)*sizeof(uint32_t));
+    for(j = 0; j < Colliders.Count; j++) {
+        FirstColliders[((ak_sim__cloth_collider*)AK_Sim__Array_Get(&Colliders, j))->ClothIndex+1]++;
+    }
+    for(ClothIndex = 0; ClothIndex < ClothCount; ClothIndex++) {
+        FirstColliders[ClothIndex+1] += FirstColliders[ClothIndex];
+    }
+    uint32_t* NextColliders = AK_Sim__Arena_Push_Array(TempArena, ClothCount, uint32_t);
+    AK_SIM_MEMCPY(NextColliders, FirstColliders, ClothCount*sizeof(uint32_t));
+    for(j = 0; j < Colliders.Count; j++) {
+        const ak_sim__cloth_collider* Collider = (const ak_sim__cloth_collider*)AK_Sim__Array_Get(&Colliders, j);
+        SortedColliders[NextColliders[Collider->ClothIndex]++] = *Collider;
+    }
+
+    Solver->Cloths = Cloths;
+    Solver->Colliders = SortedColliders;
+    Solver->FirstColliders = FirstColliders;
+    Solver->ParticleBatches = ParticleBatches;
+    Solver->ParticleBatchCount = ParticleBatchCount;
+    Solver->ConstraintBatches = ConstraintBatches;
+    return 1;
+}
+
+/*Moves the particles by their velocity and gravity. Pinned particles keep a zero velocity*/
+static void AK_Sim__Predict_Cloth_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__cloth_solver* Solver = (ak_sim__cloth_solver*)TaskData;
+    const ak_sim__cloth_batch* Batch = Solver->ParticleBatches + TaskIndex;
+    ak_sim__cloth* Cloth = Solver->Cloths[Batch->ClothIndex];
+    const float* InvMasses = Cloth->InvMasses;
+    float DeltaTime = Solver->DeltaTime;
+    float Damping = AK_Sim__Max(1.0f - Cloth->Damping*DeltaTime, 0.0f);
+
+    uint32_t i, k;
+    for(k = 0; k < 3; k++) {
+        float* X = Cloth->X[k];
+        float* PrevX = Cloth->PrevX[k];
+        float* V = Cloth->V[k];
+        float Acceleration = Cloth->Gravity.Data[k]*DeltaTime;
+        for(i = Batch->First; i < Batch->Last; i++) {
+            PrevX[i] = X[i];
+            V[i] = InvMasses[i] > 0.0f ? (V[i] + Acceleration)*Damping : 0.0f;
+            X[i] += V[i]*DeltaTime;
+        }
+    }
+}
+
+/*XPBD distance constraints. With one iteration per substep the accumulated multiplier is always 
+  zero going in, so it isn't stored. A batch never shares a particle with another of its color*/
+static void AK_Sim__Solve_Cloth_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__cloth_solver* Solver = (ak_sim__cloth_solver*)TaskData;
+    const ak_sim__cloth_batch* Batch = Solver->ConstraintBatches + Solver->ColorBatchOffsets[Solver->Color] + TaskIndex;
+    ak_sim__cloth* Cloth = Solver->Cloths[Batch->ClothIndex];
+    float* X = Cloth->X[0];
+    float* Y = Cloth->X[1];
+    float* Z = Cloth->X[2];
+    const float* InvMasses = Cloth->InvMasses;
+    float InvDeltaTimeSq = 1.0f/(Solver->DeltaTime*Solver->DeltaTime);
+
+    uint32_t i;
+    for(i = Batch->First; i < Batch->Last; i++) {
+        const ak_sim__cloth_constraint* Constraint = Cloth->Constraints + i;
+        uint32_t A = Constraint->A;
+        uint32_t B = Constraint->B;
+        float WA = InvMasses[A];
+        float WB = InvMasses[B];
+        float W = WA + WB + Constraint->Compliance*InvDeltaTimeSq;
+        if(W <= 0.0f) continue;
+
+        float DX = X[B]-X[A];
+        float DY = Y[B]-Y[A];
+        float DZ = Z[B]-Z[A];
+        float Length = AK_SIM_SQRT(DX*DX + DY*DY + DZ*DZ);
+        if(Length < 1e-6f) continue;
+
+        /*Divided by the length once here instead of normalizing the direction*/
+        float Lambda = (Length - Constraint->RestLength)/(W*Length);
+        X[A] += DX*Lambda*WA; Y[A] += DY*Lambda*WA; Z[A] += DZ*Lambda*WA;
+        X[B] -= DX*Lambda*WB; Y[B] -= DY*Lambda*WB; Z[B] -= DZ*Lambda*WB;
+    }
+}
+
+/*Pushes the particles out of the rigid bodies near their cloth, collided as spheres through the 
+  collision table, then sets their velocity from how far they moved over the substep. Only the 
+  deepest contact with each body is resolved, as contacts with several of its features would push 
+  the particle out more than once*/
+static void AK_Sim__Collide_Cloth_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__cloth_solver* Solver = (ak_sim__cloth_solver*)TaskData;
+    ak_sim_context* Context = Solver->Context;
+    const ak_sim__cloth_batch* Batch = Solver->ParticleBatches + TaskIndex;
+    ak_sim__cloth* Cloth = Solver->Cloths[Batch->ClothIndex];
+    float DeltaTime = Solver->DeltaTime;
+    uint32_t FirstCollider = Solver->FirstColliders[Batch->ClothIndex];
+    uint32_t LastCollider = Solver->FirstColliders[Batch->ClothIndex+1];
+    uint32_t i, j, k;
+
+    if(FirstCollider < LastCollider) {
+        ak_sim__worker* Worker = Context->Workers + WorkerIndex;
+        ak_sim_collision_collector Collector = AK_Sim__Begin_Collision_Collector(&Worker->Arena);
+
+        ak_sim_shape Sphere;
+        AK_SIM_MEMSET(&Sphere, 0, sizeof(ak_sim_shape));
+        Sphere.Type = AK_SIM_SHAPE_TYPE_CONVEX;
+        Sphere.Internal.Convex.Type = AK_SIM_CONVEX_TYPE_SPHERE;
+        Sphere.Internal.Convex.Internal.Sphere.Radius = Cloth->Radius;
+
+        ak_sim_m4x3 SphereTransform;
+        SphereTransform.Cols[0] = AK_Sim_V3(1.0f, 0.0f, 0.0f);
+        SphereTransform.Cols[1] = AK_Sim_V3(0.0f, 1.0f, 0.0f);
+        SphereTransform.Cols[2] = AK_Sim_V3(0.0f, 0.0f, 1.0f);
+        ak_sim_v3 One = AK_Sim_V3(1.0f, 1.0f, 1.0f);
+        ak_sim_v3 Extent = AK_Sim_V3(Cloth->Radius, Cloth->Radius, Cloth->Radius);
+
+        for(j = FirstCollider; j < LastCollider; j++) {
+            const ak_sim__cloth_collider* Collider = Solver->Colliders + j;
+            const ak_sim_body* Body = Collider->Body;
+            ak_sim_collision_func* CollisionFunc = AK_Sim__Collision_Table_Get_Func(&Context->CollisionTable, AK_SIM_SHAPE_TYPE_CONVEX, Collider->Shape->Type);
+            if(!CollisionFunc) continue;
+
+            ak_sim_m4x3 Transform = AK_Sim__Get_Body_Matrix_Transform(&Body->Transform, Cloth->Origin);
+            for(i = Batch->First; i < Batch->Last; i++) {
+                if(Cloth->InvMasses[i] <= 0.0f) continue;
+
+                ak_sim_v3 P = AK_Sim_V3(Cloth->X[0][i], Cloth->X[1][i], Cloth->X[2][i]);
+                ak_sim__aabb ParticleAABB;
+                ParticleAABB.Min = AK_Sim__V3_Sub(P, Extent);
+                ParticleAABB.Max = AK_Sim__V3_Add(P, Extent);
+                if(!AK_Sim__AABB_Overlap(&ParticleAABB, &Collider->AABB)) continue;
+
+                Collector.Contacts.Count = 0;
+                Collector.Manifolds.Count = 0;
+                SphereTransform.Cols[3] = P;
+                CollisionFunc(&Collector, &Sphere, &SphereTransform, One, Collider->Shape, &Transform, Body->Scale);
+
+                float Depth = 0.0f;
+                ak_sim_v3 Normal = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+                uint32_t ContactIndex;
+                for(ContactIndex = 0; ContactIndex < Collector.Contacts.Count; ContactIndex++) {
+                    const ak_sim_contact* Contact = (const ak_sim_contact*)AK_Sim__Array_Get(&Collector.Contacts, ContactIndex);
+                    if(Contact->Depth > Depth) {
+                        Depth = Contact->Depth;
+                        Normal = AK_Sim__V3_Mul_S(Contact->Normal, -1.0f);
+                    }
+                }
+                if(Depth <= 0.0f) continue;
+
+                /*Friction takes away motion along the surface relative to the body, at most 
+                  Friction times the push along the normal*/
+                P = AK_Sim__V3_Add(P, AK_Sim__V3_Mul_S(Normal, Depth));
+                ak_sim_v3 PrevP = AK_Sim_V3(Cloth->PrevX[0][i], Cloth->PrevX[1][i], Cloth->PrevX[2][i]);
+                ak_sim_v3 BodyVelocity = AK_Sim__V3_Add(Body->LinearVelocity, AK_Sim__V3_Cross(Body->AngularVelocity, AK_Sim__V3_Sub(P, Transform.Cols[3])));
+                ak_sim_v3 Motion = AK_Sim__V3_Sub(AK_Sim__V3_Sub(P, PrevP), AK_Sim__V3_Mul_S(BodyVelocity, DeltaTime));
+                ak_sim_v3 Tangent = AK_Sim__V3_Sub(Motion, AK_Sim__V3_Mul_S(Normal, AK_Sim__V3_Dot(Motion, Normal)));
+                float TangentLength = AK_Sim__V3_Length(Tangent);
+                if(TangentLength > 0.0f) {
+                    P = AK_Sim__V3_Sub(P, AK_Sim__V3_Mul_S(Tangent, AK_Sim__Min(Cloth->Friction*Depth/TangentLength, 1.0f)));
+                }
+
+                for(k = 0; k < 3; k++) Cloth->X[k][i] = P.Data[k];
+                AK_Sim__Worker_Count(Worker, ClothContacts, 1);
+            }
+        }
+    }
+
+    float InvDeltaTime = 1.0f/DeltaTime;
+    for(k = 0; k < 3; k++) {
+        const float* X = Cloth->X[k];
+        const float* PrevX = Cloth->PrevX[k];
+        float* V = Cloth->V[k];
+        for(i = Batch->First; i < Batch->Last; i++) {
+            V[i] = (X[i]-PrevX[i])*InvDeltaTime;
+        }
+    }
+}
+
+/*One position based substep. Colors run one after another and the batches of a color run in 
+  parallel*/
+static void AK_Sim__Step_Cloths(ak_sim_context* Context, ak_sim__cloth_solver* Solver) {
+    AK_Sim__Parallel_For(Context, AK_Sim__Predict_Cloth_Task, Solver, Solver->ParticleBatchCount);
+
+    uint32_t Color;
+    for(Color = 0; Color <= AK_SIM__MAX_CLOTH_COLORS; Color++) {
+        uint32_t BatchCount = Solver->ColorBatchOffsets[Color+1]-Solver->ColorBatchOffsets[Color];
+        if(BatchCount) {
+            Solver->Color = Color;
+            AK_Sim__Parallel_For(Context, AK_Sim__Solve_Cloth_Task, Solver, BatchCount);
+        }
+    }
+
+    AK_Sim__Parallel_For(Context, AK_Sim__Collide_Cloth_Task, Solver, Solver->ParticleBatchCount);
+}
+
+#define AK_SIM__SLEEP_LINEAR_SPEED 0.05f
+#define AK_SIM__SLEEP_ANGULAR_SPEED 0.05f
+#define AK_SIM__TIME_TO_SLEEP 0.5f
+
+static int AK_Sim__Is_Body_Still(const ak_sim_body* Body) {
+    return AK_Sim__V3_Dot(Body->LinearVelocity, Body->LinearVelocity) < AK_SIM__SLEEP_LINEAR_SPEED*AK_SIM__SLEEP_LINEAR_SPEED && 
+           AK_Sim__V3_Dot(Body->AngularVelocity, Body->AngularVelocity) < AK_SIM__SLEEP_ANGULAR_SPEED*AK_SIM__SLEEP_ANGULAR_SPEED;
+}
+
+/*Joins the islands of two linked dynamic bodies. Static and kinematic bodies don't join islands, 
+  but a moving kinematic body keeps the bodies it's linked to awake*/
+static void AK_Sim__Link_Sleep_Islands(ak_sim_context* Context, uint32_t* Parents, ak_sim_body_id BodyIDA, ak_sim_body_id BodyIDB) {
+    ak_sim_body* BodyA = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, BodyIDA);
+    ak_sim_body* BodyB = (ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, BodyIDB);
+    if(!BodyA || !BodyB) return;
+
+    int DynamicA = BodyA->Type == AK_SIM_BODY_TYPE_DYNAMIC;
+    int DynamicB = BodyB->Type == AK_SIM_BODY_TYPE_DYNAMIC;
+    if(DynamicA && DynamicB) {
+        ak_sim__pool_id IDA, IDB;
+        IDA.ID = BodyIDA;
+        IDB.ID = BodyIDB;
+        uint32_t RootA = AK_Sim__Find_Island_Root(Parents, IDA.Internal.Index);
+        uint32_t RootB = AK_Sim__Find_Island_Root(Parents, IDB.Internal.Index);
+        Parents[AK_Sim__Max(RootA, RootB)] = AK_Sim__Min(RootA, RootB);
+    } else if(DynamicA && BodyB->Type == AK_SIM_BODY_TYPE_KINEMATIC && !AK_Sim__Is_Body_Still(BodyB)) {
+        BodyA->SleepTime = 0.0f;
+    } else if(DynamicB && BodyA->Type == AK_SIM_BODY_TYPE_KINEMATIC && !AK_Sim__Is_Body_Still(BodyA)) {
+        BodyB->SleepTime = 0.0f;
+    }
+}
+
+/*Sleep islands are found again every step from the joints and last step's touching pairs with a 
+  union find over body slots. An island sleeps once each of its bodies has been still for 
+  AK_SIM__TIME_TO_SLEEP and wakes as soon as one of them isn't. This runs at the start of the 
+  step, so every phase after it sees each island either all asleep or all awake*/
+static void AK_Sim__Update_Sleep(ak_sim_context* Context, ak_sim__arena* TempArena) {
+    ak_sim__temp_arena TempStorage = AK_Sim__Arena_Begin_Temp(TempArena);
+    ak_sim__pool* BodyPool = &Context->BodyPool;
+    uint32_t BodySlotCount = BodyPool->MaxUsed;
+    uint32_t* Parents = AK_Sim__Arena_Push_Array(TempArena, BodySlotCount, uint32_t);
+    float* IslandSleepTimes = AK_Sim__Arena_Push_Array(TempArena, BodySlotCount, float);
+    uint32_t i;
+    for(i = 0; i < BodySlotCount; i++) {
+        Parents[i] = i;
+        IslandSleepTimes[i] = 1e30f;
+    }
+
+    /*Sleeping bodies that were given a velocity wake up*/
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        if(Body->Type != AK_SIM_BODY_TYPE_DYNAMIC) continue;
+
+        int IsStill = AK_Sim__Is_Body_Still(Body) && !(Body->Flags & AK_SIM_BODY_FLAG_NEVER_SLEEP);
+        if(Body->Flags & AK_SIM_BODY_FLAG_SLEEPING) {
+            if(!IsStill) AK_Sim__Wake_Body(Body);
+        } else {
+            Body->SleepTime = IsStill ? AK_Sim__Min(Body->SleepTime+Context->FixedTimeStep, AK_SIM__TIME_TO_SLEEP) : 0.0f;
+        }
+    }
+
+    ak_sim__pool_iter JointIter = AK_Sim__Pool_Begin_Iter(&Context->JointPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&JointIter)) {
+        ak_sim_joint* Joint = (ak_sim_joint*)AK_Sim__Pool_Iter_Next(&JointIter);
+        AK_Sim__Link_Sleep_Islands(Context, Parents, Joint->BodyA, Joint->BodyB);
+    }
+
+    ak_sim__pair_cache_table* Table = Context->PairCaches + Context->PairCacheIndex;
+    for(i = 0; i < Table->Pairs.ItemCount; i++) {
+        uint32_t Flags = Table->Caches[i].Flags;
+        if((Flags & AK_SIM__PAIR_FLAG_TOUCHING) && !(Flags & AK_SIM__PAIR_FLAG_SENSOR)) {
+            const ak_sim__body_id_pair* Pair = (const ak_sim__body_id_pair*)AK_Sim__Set_Get_Key(&Table->Pairs, i);
+            AK_Sim__Link_Sleep_Islands(Context, Parents, Pair->AID, Pair->BID);
+        }
+    }
+
+    BodyIter = AK_Sim__Pool_Begin_Iter(BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        if(Body->Type != AK_SIM_BODY_TYPE_DYNAMIC) continue;
+
+        ak_sim__pool_id ID;
+        ID.ID = Body->ID;
+        uint32_t Root = AK_Sim__Find_Island_Root(Parents, ID.Internal.Index);
+        IslandSleepTimes[Root] = AK_Sim__Min(IslandSleepTimes[Root], Body->SleepTime);
+    }
+
+    uint32_t SleepingCount = 0;
+    BodyIter = AK_Sim__Pool_Begin_Iter(BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        if(Body->Type != AK_SIM_BODY_TYPE_DYNAMIC) continue;
+
+        ak_sim__pool_id ID;
+        ID.ID = Body->ID;
+        int Sleep = IslandSleepTimes[AK_Sim__Find_Island_Root(Parents, ID.Internal.Index)] >= AK_SIM__TIME_TO_SLEEP;
+        if(Sleep && !(Body->Flags & AK_SIM_BODY_FLAG_SLEEPING)) {
+            Body->Flags |= AK_SIM_BODY_FLAG_SLEEPING;
+            Body->LinearVelocity = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+            Body->AngularVelocity = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+        } else if(!Sleep && (Body->Flags & AK_SIM_BODY_FLAG_SLEEPING)) {
+            AK_Sim__Wake_Body(Body);
+        }
+        SleepingCount += Sleep;
+    }
+    AK_Sim__Profile_Count(Context, SleepingBodyCount, SleepingCount);
+    AK_Sim__Arena_End_Temp(&TempStorage);
+}
+
+/*Arena alignment and the first buffers of arrays that start small*/
+#define AK_SIM__BUDGET_ARENA_SLACK (64*1024)
+
+/*Sizes everything a step uses for the budgets. Arrays that grow inside an arena leave their 
+  smaller buffers behind, so those count twice. Every worker gets the whole budget since any 
+  of them may end up running every task. Cloth scratch depends on the cloths, so creating a 
+  cloth reserves again*/
+static void AK_Sim__Reserve_Budgets(ak_sim_context* Context) {
+    size_t Bodies = Context->MaxBodies;
+    size_t Joints = Context->MaxJoints;
+    size_t Pairs = Context->MaxPairs;
+    size_t Contacts = Context->MaxContacts;
+    size_t Substeps = Context->SubstepCount;
+    size_t TaskCount = Pairs/AK_SIM__PAIR_TASK_SIZE + 1;
+    if(!Bodies && !Joints && !Pairs && !Contacts) return;
+
+    size_t Cloths = Context->ClothPool.ItemCount;
+    size_t ClothParticleBatches = 0;
+    size_t ClothConstraintBatches = 0;
+    ak_sim__pool_iter ClothIter = AK_Sim__Pool_Begin_Iter(&Context->ClothPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&ClothIter)) {
+        const ak_sim__cloth* Cloth = (const ak_sim__cloth*)AK_Sim__Pool_Iter_Next(&ClothIter);
+        ClothParticleBatches += Cloth->ParticleCount/AK_SIM__CLOTH_TASK_SIZE + 1;
+        ClothConstraintBatches += Cloth->ColorOffsets[AK_SIM__MAX_CLOTH_COLORS+1]/AK_SIM__CLOTH_TASK_SIZE + AK_SIM__MAX_CLOTH_COLORS+1;
+    }
+
+    AK_Sim__Reserve_Body_Bounds(Context, Context->MaxBodies);
+    AK_Sim__Reserve_Tree(Context, &Context->StaticTree, &Context->StaticTreeCapacity, Context->MaxBodies);
+    AK_Sim__Reserve_Tree(Context, &Context->MovingTree, &Context->MovingTreeCapacity, Context->MaxBodies);
+    AK_Sim__Array_Reserve(&Context->BroadphasePairs, Context->MaxPairs);
+    AK_Sim__Pair_Cache_Table_Reserve(&Context->PairCaches[0], Context->MaxPairs);
+    AK_Sim__Pair_Cache_Table_Reserve(&Context->PairCaches[1], Context->MaxPairs);
+
+    /*Broadphase items, regions and the stale tree, the island solver's per body arrays, the joint 
+      batches and constraints, the pair array and its sorts, and the narrowphase collectors*/
+    size_t TempSize = Bodies*(sizeof(ak_sim_body*) + 2*sizeof(ak_sim__bvh_item) + sizeof(uint8_t) + 2*sizeof(ak_sim__region_key) + 
+                              sizeof(ak_sim__region) + sizeof(ak_sim__bvh_item) + 2*sizeof(ak_sim__bvh_node) + sizeof(uint8_t) + 
+                              sizeof(ak_sim__island) + sizeof(ak_sim__joint_batch) + 4*sizeof(uint32_t)) + 
+                      Joints*(2*sizeof(ak_sim_joint*) + 2*sizeof(uint32_t) + sizeof(ak_sim__joint_batch) + sizeof(ak_sim__joint_constraint)) + 
+                      2*Pairs*sizeof(ak_sim__body_id_pair) + Pairs*(sizeof(uint8_t) + sizeof(uint32_t)) + 
+                      Substeps*TaskCount*sizeof(ak_sim_collision_collector);
+
+    /*The cloth solver's cloth tree and batches, and the bodies each cloth may collide with, which 
+      are found into growing arrays and then sorted by cloth. Those count against the pairs*/
+    size_t ClothColliders = AK_Sim__Min(Cloths*Bodies, Pairs);
+    TempSize += Cloths*(sizeof(ak_sim__cloth*) + sizeof(ak_sim__bvh_item) + 2*sizeof(ak_sim__bvh_node) + 2*sizeof(uint32_t)) + 
+                (ClothParticleBatches + ClothConstraintBatches)*sizeof(ak_sim__cloth_batch) + 
+                3*ClothColliders*sizeof(ak_sim__cloth_collider) + 2*Bodies*sizeof(ak_sim_body_id);
+    AK_Sim__Arena_Reserve(&Context->TempArena, TempSize + AK_SIM__BUDGET_ARENA_SLACK);
+
+    /*Region trees and pairs, then each substep's contacts and manifolds, for the pairs and for 
+      the cloth particle batches*/
+    size_t WorkerSize = 2*Bodies*sizeof(ak_sim__bvh_node) + 2*Pairs*sizeof(ak_sim__body_id_pair) + 
+                        Substeps*(2*Contacts*sizeof(ak_sim_contact) + 2*Pairs*sizeof(ak_sim__contact_manifold) + 
+                                  (TaskCount + ClothParticleBatches)*64*(sizeof(ak_sim_contact) + sizeof(ak_sim__contact_manifold)));
+    uint32_t i;
+    for(i = 0; i < Context->WorkerCount; i++) {
+        AK_Sim__Arena_Reserve(&Context->Workers[i].Arena, WorkerSize + AK_SIM__BUDGET_ARENA_SLACK);
+    }
+
+    /*Each pair can begin and end touching once per step*/
+    AK_Sim__Arena_Reserve(&Context->EventArena, 4*Pairs*(sizeof(ak_sim_contact_event) + sizeof(ak_sim_sensor_event)) + AK_SIM__BUDGET_ARENA_SLACK);
+}
+
+static void AK_Sim__Step_Internal(ak_sim_context* Context, ak_sim__temp_arena* TempStorage) {
+    ak_sim__arena* TempArena = TempStorage->Arena;
+
+#ifndef AK_SIM_NO_PROFILE
+    {
+        ak_sim_stats* Stats = &Context->Profiler.Stats;
+        size_t ArenaHighWaterMark = Stats->ArenaHighWaterMark;
+        AK_SIM_MEMSET(Stats, 0, sizeof(ak_sim_stats));
+        Stats->ProcessCPUTime = AK_SIM__PROCESS_CPU_TIME;
+        Stats->ArenaHighWaterMark = ArenaHighWaterMark;
+    }
+#endif
+
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(&Context->BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        Body->PrevTransform = Body->Transform;
+    }
+
+    /*The broadphase runs once per step on swept bounds. Substeps only rerun the narrowphase on the same pairs. 
+      Islands fall asleep or wake up first, since sleeping bodies are left out of the search*/
+    AK_Sim__Profile_Begin(Context, BROADPHASE);
+    AK_Sim__Update_Sleep(Context, TempArena);
+    ak_sim__array PairArray;
+    AK_Sim__Array_Init(&PairArray, &TempArena->BaseAllocator, sizeof(ak_sim__body_id_pair));
+    AK_Sim__Array_Reserve(&PairArray, Context->MaxPairs);
+    AK_Sim__Find_Pairs(Context, &PairArray, TempArena);
+
+#ifdef AK_SIM_DETERMINISTIC
+    /*Broadphase discovery order depends on slot reuse and hashing. Sorting makes it canonical*/
+    AK_Sim__Sort_Body_Pairs((ak_sim__body_id_pair*)PairArray.Data, PairArray.Count, TempArena);
+#endif
+    ak_sim__pair_cache* PairCaches = AK_Sim__Update_Pair_Caches(Context, &PairArray);
+    AK_Sim__Profile_End(Context, BROADPHASE);
+    AK_Sim__Profile_Count(Context, PairsFound, PairArray.Count);
+
+    /*Islands and colors only depend on which joints and bodies exist, so substeps share them*/
+    float SubstepTime = Context->FixedTimeStep / (float)Context->SubstepCount;
+    AK_Sim__Profile_Begin(Context, SOLVER);
+    ak_sim__joint_solver JointSolver;
+    int HasJoints = AK_Sim__Build_Joint_Solver(Context, &JointSolver, TempArena);
+    JointSolver.Softness = AK_Sim__Make_Softness(AK_SIM__JOINT_HERTZ, AK_SIM__JOINT_DAMPING_RATIO, SubstepTime);
+    AK_Sim__Profile_End(Context, SOLVER);
+
+    AK_Sim__Profile_Begin(Context, CLOTH);
+    ak_sim__cloth_solver ClothSolver;
+    int HasCloth = AK_Sim__Build_Cloth_Solver(Context, &ClothSolver, TempArena);
+    ClothSolver.DeltaTime = SubstepTime;
+    AK_Sim__Profile_End(Context, CLOTH);
+
+    AK_Sim__Profile_Begin(Context, NARROWPHASE);
+    ak_sim__narrowphase_task NarrowphaseTask;
+    uint32_t NarrowphaseTaskCount = (PairArray.Count+AK_SIM__PAIR_TASK_SIZE-1)/AK_SIM__PAIR_TASK_SIZE;
+    NarrowphaseTask.Context = Context;
+    NarrowphaseTask.PairArray = &PairArray;
+    NarrowphaseTask.PairCaches = PairCaches;
+    NarrowphaseTask.PairIndices = AK_Sim__Sort_Pairs_By_Kind(Context, &PairArray, NarrowphaseTask.KindOffsets, &NarrowphaseTask.PairBuckets, TempArena);
+    AK_Sim__Profile_End(Context, NARROWPHASE);
+
+    uint32_t Substep;
+    for(Substep = 0; Substep < Context->SubstepCount; Substep++) {
+        AK_Sim__Profile_Begin(Context, NARROWPHASE);
+        NarrowphaseTask.Collectors = AK_Sim__Arena_Push_Array(TempArena, NarrowphaseTaskCount, ak_sim_collision_collector);
+        AK_Sim__Parallel_For(Context, AK_Sim__Narrowphase_Task, &NarrowphaseTask, NarrowphaseTaskCount);
+        AK_Sim__Profile_End(Context, NARROWPHASE);
+
+        if(HasJoints) {
+            AK_Sim__Profile_Begin(Context, SOLVER);
+            AK_Sim__Solve_Joints(Context, &JointSolver);
+            AK_Sim__Profile_End(Context, SOLVER);
+        }
+
+        AK_Sim__Profile_Begin(Context, INTEGRATION);
+        AK_Sim__Integrate_Bodies(Context, SubstepTime);
+        AK_Sim__Profile_End(Context, INTEGRATION);
+
+        /*Cloth goes after the bodies moved, so particles are pushed out of where they are now*/
+        if(HasCloth) {
+            AK_Sim__Profile_Begin(Context, CLOTH);
+            AK_Sim__Step_Cloths(Context, &ClothSolver);
+            AK_Sim__Profile_End(Context, CLOTH);
+        }
+    }
+
+    AK_Sim__Generate_Touch_Events(Context);
+    AK_Sim__Merge_Worker_Stats(Context);
+
+#ifndef AK_SIM_NO_PROFILE
+    {
+        ak_sim_stats* Stats = &Context->Profiler.Stats;
+        Stats->ArenaBytesUsed = AK_Sim__Arena_Get_Used(TempArena);
+
+        uint32_t i;
+        for(i = 0; i < Context->WorkerCount; i++) {
+            Stats->ArenaBytesUsed += AK_Sim__Arena_Get_Used(&Context->Workers[i].Arena);
+        }
+        Stats->ArenaHighWaterMark = AK_Sim__Max(Stats->ArenaHighWaterMark, Stats->ArenaBytesUsed);
+    }
+#endif
+
+    Context->StepIndex++;
+}
+
+static void AK_Sim__Step(ak_sim_context* Context) {
+    AK_Sim__Profile_Begin(Context, STEP);
     ak_sim__temp_arena TempArena = AK_Sim__Arena_Begin_Temp(&Context->TempArena);
-    AK_Sim__Update_Internal(Context, DeltaTime, &TempArena);
+    AK_Sim__Step_Internal(Context, &TempArena);
     AK_Sim__Arena_End_Temp(&TempArena);
+
+    /*Worker arenas only hold memory for the step that just finished*/
+    uint32_t i;
+    for(i = 0; i < Context->WorkerCount; i++) {
+        AK_Sim__Arena_Clear(&Context->Workers[i].Arena);
+    }
+    AK_Sim__Profile_End(Context, STEP);
+}
+
+AKSIMDEF void AK_Sim_Step(ak_sim_context* Context) {
+    AK_Sim__Clear_Events(Context);
+    AK_Sim__Step(Context);
+}
+
+AKSIMDEF uint32_t AK_Sim_Update(ak_sim_context* Context, float DeltaTime) {
+    AK_Sim__Clear_Events(Context);
+    Context->Accumulator += DeltaTime;
+
+    uint32_t StepCount = 0;
+    while(Context->Accumulator >= Context->FixedTimeStep) {
+        if(StepCount == Context->MaxStepsPerUpdate) {
+            /*Drop the whole steps we could not catch up on instead of falling further behind next update. 
+              Keep the partial step so the render interpolation doesn't jump*/
+            Context->Accumulator = AK_SIM_FMOD(Context->Accumulator, Context->FixedTimeStep);
+            break;
+        }
+
+        AK_Sim__Step(Context);
+        Context->Accumulator -= Context->FixedTimeStep;
+        StepCount++;
+    }
+
+    return StepCount;
+}
+
+AKSIMDEF float AK_Sim_Get_Interpolation_Alpha(ak_sim_context* Context) {
+    float Alpha = Context->Accumulator / Context->FixedTimeStep;
+    return AK_Sim__Min(Alpha, 1.0f);
+}
+
+AKSIMDEF ak_sim_body_transform AK_Sim_Get_Body_Render_Transform(ak_sim_context* Context, ak_sim_body_id BodyID) {
+    ak_sim_body_transform Result;
+    ak_sim_body* Body = AK_Sim_Get_Body(Context, BodyID);
+    if(!Body) {
+        Result.Position = AK_Sim_Position(0.0, 0.0, 0.0);
+        Result.Orientation = AK_Sim_Quat_Identity();
+        return Result;
+    }
+
+    float Alpha = AK_Sim_Get_Interpolation_Alpha(Context);
+    Result.Position = AK_Sim__Position_Lerp(Body->PrevTransform.Position, Alpha, Body->Transform.Position);
+    Result.Orientation = AK_Sim__Quat_Nlerp(Body->PrevTransform.Orientation, Alpha, Body->Transform.Orientation);
+    return Result;
+}
+
+AKSIMDEF ak_sim_events AK_Sim_Get_Events(ak_sim_context* Context) {
+    ak_sim_events Result;
+    Result.ContactBegin = (const ak_sim_contact_event*)Context->ContactBeginEvents.Data;
+    Result.ContactEnd = (const ak_sim_contact_event*)Context->ContactEndEvents.Data;
+    Result.SensorBegin = (const ak_sim_sensor_event*)Context->SensorBeginEvents.Data;
+    Result.SensorEnd = (const ak_sim_sensor_event*)Context->SensorEndEvents.Data;
+    Result.ContactBeginCount = Context->ContactBeginEvents.Count;
+    Result.ContactEndCount = Context->ContactEndEvents.Count;
+    Result.SensorBeginCount = Context->SensorBeginEvents.Count;
+    Result.SensorEndCount = Context->SensorEndEvents.Count;
+    return Result;
+}
+
+#define AK_SIM__RAYCAST_TOLERANCE 1e-4f
+
+/*Conservative advancement. The ray jumps to the plane separating its current point from the 
+  convex, which it can't cross without hitting, until the point is on the surface*/
+static int AK_Sim__Raycast_Proxy(const ak_sim__convex_proxy* Proxy, ak_sim_v3 Origin, ak_sim_v3 Direction, float MaxT, float* T, ak_sim_v3* Normal) {
+    ak_sim__convex_proxy Point;
+    AK_SIM_MEMSET(&Point, 0, sizeof(ak_sim__convex_proxy));
+    Point.Transform.Cols[0] = AK_Sim_V3(1.0f, 0.0f, 0.0f);
+    Point.Transform.Cols[1] = AK_Sim_V3(0.0f, 1.0f, 0.0f);
+    Point.Transform.Cols[2] = AK_Sim_V3(0.0f, 0.0f, 1.0f);
+    Point.Scale = AK_Sim_V3(1.0f, 1.0f, 1.0f);
+    Point.Vertices = Point.CoreVertices;
+    Point.VtxCount = 1;
+
+    ak_sim__pair_cache Cache;
+    AK_SIM_MEMSET(&Cache, 0, sizeof(ak_sim__pair_cache));
+
+    float t = 0.0f;
+    ak_sim_v3 N = AK_Sim__V3_Mul_S(Direction, -1.0f);
+    uint32_t Iteration;
+    for(Iteration = 0; Iteration < AK_SIM__GJK_MAX_ITERATIONS; Iteration++) {
+        Point.Transform.Cols[3] = AK_Sim__V3_Add(Origin, AK_Sim__V3_Mul_S(Direction, t));
+        ak_sim__gjk_result GJK = AK_Sim__GJK(&Point, Proxy, &Cache);
+        if(GJK.Overlap || GJK.Distance < 1e-6f) break;
+
+        N = AK_Sim__V3_Mul_S(GJK.V, 1.0f/GJK.Distance);
+        float Distance = GJK.Distance - Proxy->Radius;
+        if(Distance < AK_SIM__RAYCAST_TOLERANCE) break;
+
+        float Approach = -AK_Sim__V3_Dot(Direction, N);
+        if(Approach <= 1e-6f) return 0;
+        t += Distance/Approach;
+        if(t > MaxT) return 0;
+    }
+
+    *T = t;
+    *Normal = N;
+    return 1;
+}
+
+static int AK_Sim__Raycast_Triangle(ak_sim_v3 Origin, ak_sim_v3 Direction, ak_sim_v3 A, ak_sim_v3 B, ak_sim_v3 C, float MaxT, float* T, ak_sim_v3* Normal) {
+    ak_sim_v3 AB = AK_Sim__V3_Sub(B, A);
+    ak_sim_v3 AC = AK_Sim__V3_Sub(C, A);
+    ak_sim_v3 P = AK_Sim__V3_Cross(Direction, AC);
+    float Det = AK_Sim__V3_Dot(AB, P);
+    if(AK_Sim__Abs(Det) < 1e-12f) return 0;
+
+    float InvDet = 1.0f/Det;
+    ak_sim_v3 AO = AK_Sim__V3_Sub(Origin, A);
+    float u = AK_Sim__V3_Dot(AO, P)*InvDet;
+    if(u < 0.0f || u > 1.0f) return 0;
+    ak_sim_v3 Q = AK_Sim__V3_Cross(AO, AB);
+    float v = AK_Sim__V3_Dot(Direction, Q)*InvDet;
+    if(v < 0.0f || u+v > 1.0f) return 0;
+    float t = AK_Sim__V3_Dot(AC, Q)*InvDet;
+    if(t < 0.0f || t > MaxT) return 0;
+
+    *T = t;
+    *Normal = AK_Sim__V3_Cross(AB, AC);
+    return 1;
+}
+
+/*Rays in unscaled shape space keep the same t, and normals go back through the inverse scale*/
+static void AK_Sim__Get_Local_Ray(const ak_sim_m4x3* Transform, ak_sim_v3 Scale, ak_sim_v3 Origin, ak_sim_v3 Direction, ak_sim_v3* LocalOrigin, ak_sim_v3* LocalDirection) {
+    ak_sim_v3 P = AK_Sim__M4x3_Inverse_Transform_Point(Transform, Origin);
+    ak_sim_v3 D = AK_Sim_V3(AK_Sim__V3_Dot(Transform->Cols[0], Direction), AK_Sim__V3_Dot(Transform->Cols[1], Direction), AK_Sim__V3_Dot(Transform->Cols[2], Direction));
+    *LocalOrigin = AK_Sim_V3(P.Data[0]/Scale.Data[0], P.Data[1]/Scale.Data[1], P.Data[2]/Scale.Data[2]);
+    *LocalDirection = AK_Sim_V3(D.Data[0]/Scale.Data[0], D.Data[1]/Scale.Data[1], D.Data[2]/Scale.Data[2]);
+}
+
+static ak_sim_v3 AK_Sim__Get_World_Normal(const ak_sim_m4x3* Transform, ak_sim_v3 Scale, ak_sim_v3 LocalNormal) {
+    ak_sim_v3 N = AK_Sim_V3(LocalNormal.Data[0]/Scale.Data[0], LocalNormal.Data[1]/Scale.Data[1], LocalNormal.Data[2]/Scale.Data[2]);
+    return AK_Sim__V3_Normalize(AK_Sim__M4x3_Mul_V3(Transform, N));
+}
+
+static int AK_Sim__Raycast_User(ak_sim_raycast_func* Raycast, const void* UserData, const ak_sim_m4x3* Transform, ak_sim_v3 Scale, 
+                                ak_sim_v3 Origin, ak_sim_v3 Direction, float MaxT, float* T, ak_sim_v3* Normal) {
+    ak_sim_v3 LocalOrigin, LocalDirection, LocalNormal;
+    AK_Sim__Get_Local_Ray(Transform, Scale, Origin, Direction, &LocalOrigin, &LocalDirection);
+    if(!Raycast(UserData, LocalOrigin, LocalDirection, MaxT, T, &LocalNormal)) return 0;
+    *Normal = AK_Sim__Get_World_Normal(Transform, Scale, LocalNormal);
+    return 1;
+}
+
+static int AK_Sim__Raycast_Heightfield(const ak_sim_heightfield* Heightfield, ak_sim_v3 Origin, ak_sim_v3 Direction, float MaxT, float* T, ak_sim_v3* Normal) {
+    if(Heightfield->SampleCountX < 2 || Heightfield->SampleCountZ < 2) return 0;
+
+    /*Only the cells under the ray's bounds can be hit*/
+    ak_sim_v3 End = AK_Sim__V3_Add(Origin, AK_Sim__V3_Mul_S(Direction, MaxT));
+    float InvCellSize = 1.0f/Heightfield->CellSize;
+    float MinX = AK_Sim__Max(AK_Sim__Min(Origin.Data[0], End.Data[0])*InvCellSize, 0.0f);
+    float MinZ = AK_Sim__Max(AK_Sim__Min(Origin.Data[2], End.Data[2])*InvCellSize, 0.0f);
+    float MaxX = AK_Sim__Min(AK_Sim__Max(Origin.Data[0], End.Data[0])*InvCellSize, (float)(Heightfield->SampleCountX-2));
+    float MaxZ = AK_Sim__Min(AK_Sim__Max(Origin.Data[2], End.Data[2])*InvCellSize, (float)(Heightfield->SampleCountZ-2));
+    if(MinX > MaxX || MinZ > MaxZ) return 0;
+
+    int Result = 0;
+    uint32_t x, z;
+    for(z = (uint32_t)MinZ; z <= (uint32_t)MaxZ; z++) {
+        for(x = (uint32_t)MinX; x <= (uint32_t)MaxX; x++) {
+            ak_sim_v3 P00 = AK_Sim__Heightfield_Point(Heightfield, x, z);
+            ak_sim_v3 P10 = AK_Sim__Heightfield_Point(Heightfield, x+1, z);
+            ak_sim_v3 P01 = AK_Sim__Heightfield_Point(Heightfield, x, z+1);
+            ak_sim_v3 P11 = AK_Sim__Heightfield_Point(Heightfield, x+1, z+1);
+            ak_sim_v3 Triangles[2][3];
+            Triangles[0][0] = P00; Triangles[0][1] = P01; Triangles[0][2] = P11;
+            Triangles[1][0] = P00; Triangles[1][1] = P11; Triangles[1][2] = P10;
+
+            uint32_t i;
+            for(i = 0; i < 2; i++) {
+                float t;
+                ak_sim_v3 N;
+                if(AK_Sim__Raycast_Triangle(Origin, Direction, Triangles[i][0], Triangles[i][1], Triangles[i][2], MaxT, &t, &N) && 
+                   AK_Sim__V3_Dot(N, Direction) < 0.0f) {
+                    MaxT = t;
+                    *T = t;
+                    *Normal = N;
+                    Result = 1;
+                }
+            }
+        }
+    }
+    return Result;
+}
+
+static int AK_Sim__Raycast_Shape(const ak_sim_shape* Shape, const ak_sim_m4x3* Transform, ak_sim_v3 Scale, 
+                                 ak_sim_v3 Origin, ak_sim_v3 Direction, float MaxT, float* T, ak_sim_v3* Normal) {
+    switch(Shape->Type) {
+        case AK_SIM_SHAPE_TYPE_CONVEX: {
+            const ak_sim_convex* Convex = &Shape->Internal.Convex;
+            if(Convex->Type >= AK_SIM_CONVEX_TYPE_USER && Convex->Internal.User.VTable && Convex->Internal.User.VTable->Raycast) {
+                return AK_Sim__Raycast_User(Convex->Internal.User.VTable->Raycast, Convex->Internal.User.UserData, Transform, Scale, Origin, Direction, MaxT, T, Normal);
+            }
+
+            ak_sim__convex_proxy Proxy;
+            if(!AK_Sim__Convex_Proxy_Init(&Proxy, Convex, Transform, Scale)) return 0;
+            return AK_Sim__Raycast_Proxy(&Proxy, Origin, Direction, MaxT, T, Normal);
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_MESH: {
+            const ak_sim_triangle_mesh* Mesh = Shape->Internal.TriangleMesh.Mesh;
+            ak_sim_v3 LocalOrigin, LocalDirection, LocalNormal;
+            AK_Sim__Get_Local_Ray(Transform, Scale, Origin, Direction, &LocalOrigin, &LocalDirection);
+
+            int Result = 0;
+            uint32_t i;
+            for(i = 0; i+2 < Mesh->IdxCount; i += 3) {
+                ak_sim_v3 A = Mesh->Vertices[Mesh->Indices[i]];
+                ak_sim_v3 B = Mesh->Vertices[Mesh->Indices[i+1]];
+                ak_sim_v3 C = Mesh->Vertices[Mesh->Indices[i+2]];
+                Result |= AK_Sim__Raycast_Triangle(LocalOrigin, LocalDirection, A, B, C, MaxT, &MaxT, &LocalNormal);
+            }
+            if(!Result) return 0;
+
+            /*Meshes are two sided, so the normal faces back along the ray*/
+            *T = MaxT;
+            *Normal = AK_Sim__Get_World_Normal(Transform, Scale, LocalNormal);
+            if(AK_Sim__V3_Dot(*Normal, Direction) > 0.0f) *Normal = AK_Sim__V3_Mul_S(*Normal, -1.0f);
+            return 1;
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_COMPOUND: {
+            const ak_sim_compound_shape* Compound = &Shape->Internal.Compound;
+            int Result = 0;
+            uint32_t i;
+            for(i = 0; i < Compound->ShapeCount; i++) {
+                const ak_sim_generic_shape* Child = Compound->Shapes + i;
+                ak_sim_m4x3 ChildTransform = AK_Sim__Get_Matrix_Transform(&Child->Transform);
+                ChildTransform.Cols[3] = AK_Sim__V3_Mul(ChildTransform.Cols[3], Scale);
+                ChildTransform = AK_Sim__M4x3_Mul(Transform, &ChildTransform);
+                if(AK_Sim__Raycast_Shape(&Child->Shape, &ChildTransform, Scale, Origin, Direction, MaxT, T, Normal)) {
+                    MaxT = *T;
+                    Result = 1;
+                }
+            }
+            return Result;
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_HEIGHTFIELD: {
+            ak_sim_v3 LocalOrigin, LocalDirection, LocalNormal;
+            AK_Sim__Get_Local_Ray(Transform, Scale, Origin, Direction, &LocalOrigin, &LocalDirection);
+            if(!AK_Sim__Raycast_Heightfield(Shape->Internal.Heightfield.Heightfield, LocalOrigin, LocalDirection, MaxT, T, &LocalNormal)) return 0;
+            *Normal = AK_Sim__Get_World_Normal(Transform, Scale, LocalNormal);
+            return 1;
+        } break;
+
+        default: {
+            const ak_sim_user_shape* User = &Shape->Internal.User;
+            if(!User->VTable || !User->VTable->Raycast) return 0;
+            return AK_Sim__Raycast_User(User->VTable->Raycast, User->UserData, Transform, Scale, Origin, Direction, MaxT, T, Normal);
+        } break;
+    }
+}
+
+static int AK_Sim__Raycast_AABB(const ak_sim__aabb* AABB, ak_sim_v3 Direction, float MaxT) {
+    float TMin = 0.0f;
+    float TMax = MaxT;
+    uint32_t i;
+    for(i = 0; i < 3; i++) {
+        if(AK_Sim__Abs(Direction.Data[i]) < 1e-12f) {
+            if(AABB->Min.Data[i] > 0.0f || AABB->Max.Data[i] < 0.0f) return 0;
+        } else {
+            float InvDirection = 1.0f/Direction.Data[i];
+            float T0 = AABB->Min.Data[i]*InvDirection;
+            float T1 = AABB->Max.Data[i]*InvDirection;
+            TMin = AK_Sim__Max(TMin, AK_Sim__Min(T0, T1));
+            TMax = AK_Sim__Min(TMax, AK_Sim__Max(T0, T1));
+            if(TMin > TMax) return 0;
+        }
+    }
+    return 1;
+}
+
+/*Whether the ray passes within Radius of Center before MaxT*/
+static int AK_Sim__Raycast_Sphere_Bounds(ak_sim_v3 Center, float Radius, ak_sim_v3 Direction, float MaxT) {
+    float T = AK_Sim__Min(AK_Sim__Max(AK_Sim__V3_Dot(Center, Direction), 0.0f), MaxT);
+    ak_sim_v3 Offset = AK_Sim__V3_Sub(Center, AK_Sim__V3_Mul_S(Direction, T));
+    return AK_Sim__V3_Dot(Offset, Offset) <= Radius*Radius;
+}
+
+/*Tests the body's shape and shortens MaxDistance on a hit*/
+static int AK_Sim__Raycast_Body(ak_sim_context* Context, const ak_sim_body* Body, ak_sim_position Origin, ak_sim_v3 Direction, 
+                                float* MaxDistance, ak_sim_raycast_hit* Hit) {
+    ak_sim__shape_entry* Entry = AK_Sim__Get_Shape_Entry(Context, Body->Shape);
+    ak_sim_m4x3 Transform = AK_Sim__Get_Body_Matrix_Transform(&Body->Transform, Origin);
+
+    float T;
+    ak_sim_v3 Normal;
+    if(!AK_Sim__Raycast_Shape(&Entry->Shape, &Transform, Body->Scale, AK_Sim_V3(0.0f, 0.0f, 0.0f), Direction, *MaxDistance, &T, &Normal)) return 0;
+    *MaxDistance = T;
+    Hit->Body = Body->ID;
+    Hit->Normal = Normal;
+    Hit->Distance = T;
+    return 1;
+}
+
+/*Bodies are placed relative to the ray's origin, so the ray itself starts at zero. Static bodies 
+  come from the static tree. Moving bodies are culled with the bounds the broadphase cached for 
+  them while they haven't moved since, which holds for resting and sleeping bodies, and with a 
+  sphere around their shape's bounds otherwise*/
+AKSIMDEF int AK_Sim_Raycast(ak_sim_context* Context, ak_sim_position Origin, ak_sim_v3 Direction, float MaxDistance, ak_sim_raycast_hit* Hit) {
+    float Length = AK_Sim__V3_Length(Direction);
+    if(Length < 1e-12f || MaxDistance < 0.0f) return 0;
+    Direction = AK_Sim__V3_Mul_S(Direction, 1.0f/Length);
+
+    AK_Sim__Reserve_Body_Bounds(Context, Context->BodyPool.MaxUsed);
+    if(Context->StaticTreeDirty) AK_Sim__Rebuild_Static_Tree(Context);
+
+    int Result = 0;
+    const ak_sim__bvh* Tree = &Context->StaticTree;
+    if(Tree->NodeCount) {
+        uint32_t Stack[AK_SIM__BVH_MAX_DEPTH];
+        uint32_t StackCount = 0;
+        Stack[StackCount++] = 0;
+        while(StackCount) {
+            const ak_sim__bvh_node* Node = Tree->Nodes + Stack[--StackCount];
+            ak_sim__aabb NodeAABB = AK_Sim__Get_Local_AABB(&Node->AABB, Origin);
+            if(!AK_Sim__Raycast_AABB(&NodeAABB, Direction, MaxDistance)) continue;
+
+            if(Node->Count) {
+                uint32_t i;
+                for(i = Node->First; i < Node->First+Node->Count; i++) {
+                    const ak_sim__bvh_item* Item = Tree->Items + i;
+                    if(Item->Flags & AK_SIM_BODY_FLAG_SENSOR) continue;
+
+                    ak_sim__aabb ItemAABB = AK_Sim__Get_Local_AABB(&Item->AABB, Origin);
+                    if(!AK_Sim__Raycast_AABB(&ItemAABB, Direction, MaxDistance)) continue;
+
+                    const ak_sim_body* Body = (const ak_sim_body*)AK_Sim__Pool_Get(&Context->BodyPool, Item->ID);
+                    Result |= AK_Sim__Raycast_Body(Context, Body, Origin, Direction, &MaxDistance, Hit);
+                }
+            } else {
+                AK_SIM_ASSERT(StackCount+2 <= AK_SIM__BVH_MAX_DEPTH);
+                Stack[StackCount++] = Node->First+1;
+                Stack[StackCount++] = Node->First;
+            }
+        }
+    }
+
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(&Context->BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        if(Body->Type == AK_SIM_BODY_TYPE_STATIC || (Body->Flags & AK_SIM_BODY_FLAG_SENSOR)) continue;
+
+        ak_sim__pool_id ID;
+        ID.ID = Body->ID;
+        const ak_sim__body_bounds* Bounds = Context->BodyBounds + ID.Internal.Index;
+        int HasBounds = Bounds->Item.ID == Body->ID && Bounds->Shape == Body->Shape && 
+                        !AK_SIM_MEMCMP(&Bounds->Scale, &Body->Scale, sizeof(ak_sim_v3)) && 
+                        !AK_SIM_MEMCMP(&Bounds->Transform, &Body->Transform, sizeof(ak_sim_body_transform));
+        if(HasBounds) {
+            ak_sim__aabb AABB = AK_Sim__Get_Local_AABB(&Bounds->AABB, Origin);
+            if(!AK_Sim__Raycast_AABB(&AABB, Direction, MaxDistance)) continue;
+        } else {
+            const ak_sim__aabb* LocalAABB = &AK_Sim__Get_Shape_Entry(Context, Body->Shape)->LocalAABB;
+            ak_sim_v3 Extents;
+            uint32_t i;
+            for(i = 0; i < 3; i++) {
+                float Extent = AK_Sim__Max(AK_Sim__Abs(LocalAABB->Min.Data[i]), AK_Sim__Abs(LocalAABB->Max.Data[i]));
+                Extents.Data[i] = Extent*AK_Sim__Abs(Body->Scale.Data[i]);
+            }
+            ak_sim_v3 Center = AK_Sim__Position_Sub(Body->Transform.Position, Origin);
+            if(!AK_Sim__Raycast_Sphere_Bounds(Center, AK_Sim__V3_Length(Extents), Direction, MaxDistance)) continue;
+        }
+        Result |= AK_Sim__Raycast_Body(Context, Body, Origin, Direction, &MaxDistance, Hit);
+    }
+
+    if(Result) Hit->Position = AK_Sim__Position_Add_V3(Origin, AK_Sim__V3_Mul_S(Direction, Hit->Distance));
+    return Result;
+}
+
+#define AK_SIM__CHARACTER_SKIN 0.01f
+#define AK_SIM__CHARACTER_MIN_APPROACH 1e-3f
+#define AK_SIM__CHARACTER_MAX_SLIDES 4
+#define AK_SIM__CHARACTER_TASK_SIZE 16
+
+/*A body near a character, with its transform and bounds around the character's start position*/
+typedef struct {
+    uint32_t            CharacterIndex;
+    const ak_sim_body*  Body;
+    const ak_sim_shape* Shape;
+    ak_sim_m4x3         Transform;
+    ak_sim__aabb        AABB;
+} ak_sim__character_collider;
+
+typedef struct {
+    ak_sim_character*           Characters;
+    ak_sim__character_collider* Colliders;      /*Sorted by character*/
+    uint32_t*                   FirstColliders; /*Character i collides with [FirstColliders[i], FirstColliders[i+1])*/
+    uint32_t                    CharacterCount;
+} ak_sim__character_task;
+
+typedef struct {
+    const ak_sim__character_collider* Colliders;
+    uint32_t                          ColliderCount;
+    float                             HalfHeight;
+    float                             Radius; /*Capsule radius plus the skin*/
+    float                             MaxSlopeCos;
+} ak_sim__character_move;
+
+/*One sweep of a character's capsule. T shrinks as closer hits are found. The capsule points into 
+  itself, so don't copy it*/
+typedef struct {
+    ak_sim__convex_proxy Capsule;
+    ak_sim_v3            Direction;
+    ak_sim__aabb         Bounds;
+    float                T;
+    ak_sim_v3            Normal;
+    const ak_sim_body*   Body;
+} ak_sim__character_sweep;
+
+typedef struct {
+    float              Distance;
+    ak_sim_v3          Normal; /*Away from the surface*/
+    const ak_sim_body* Body;
+} ak_sim__character_hit;
+
+static float AK_Sim__Get_Character_Max_Slope_Cos(const ak_sim_character* Character) {
+    return Character->MaxSlopeCos > 0.0f ? Character->MaxSlopeCos : AK_SIM_DEFAULT_MAX_SLOPE_COS;
+}
+
+/*Conservative advancement like AK_Sim__Raycast_Proxy. A capsule starting within its skin of the 
+  convex only hits it when moving into it, so it can slide along the surface and leave it. One 
+  starting inside the core can't be pushed out along any normal, so it never hits*/
+static void AK_Sim__Sweep_Character_Proxy(ak_sim__character_sweep* Sweep, const ak_sim__convex_proxy* Proxy, const ak_sim_body* Body) {
+    ak_sim__convex_proxy* Capsule = &Sweep->Capsule;
+    ak_sim_v3 Start = Capsule->Transform.Cols[3];
+    float Radius = Capsule->Radius + Proxy->Radius;
+
+    ak_sim__pair_cache Cache;
+    AK_SIM_MEMSET(&Cache, 0, sizeof(ak_sim__pair_cache));
+
+    float t = 0.0f;
+    ak_sim_v3 N = AK_Sim__V3_Mul_S(Sweep->Direction, -1.0f);
+    int Hit = 1;
+    uint32_t Iteration;
+    for(Iteration = 0; Iteration < AK_SIM__GJK_MAX_ITERATIONS; Iteration++) {
+        Capsule->Transform.Cols[3] = AK_Sim__V3_Add(Start, AK_Sim__V3_Mul_S(Sweep->Direction, t));
+        ak_sim__gjk_result GJK = AK_Sim__GJK(Capsule, Proxy, &Cache);
+        if(GJK.Overlap || GJK.Distance < 1e-6f) {
+            Hit = t > 0.0f;
+            break;
+        }
+
+        N = AK_Sim__V3_Mul_S(GJK.V, 1.0f/GJK.Distance);
+        float Distance = GJK.Distance - Radius;
+        float Approach = -AK_Sim__V3_Dot(Sweep->Direction, N);
+        if(Distance < AK_SIM__RAYCAST_TOLERANCE) {
+            Hit = t > 0.0f || Approach > AK_SIM__CHARACTER_MIN_APPROACH;
+            break;
+        }
+
+        if(Approach <= 1e-6f) {
+            Hit = 0;
+            break;
+        }
+        t += Distance/Approach;
+        if(t >= Sweep->T) {
+            Hit = 0;
+            break;
+        }
+    }
+    Capsule->Transform.Cols[3] = Start;
+
+    if(Hit) {
+        Sweep->T = t;
+        Sweep->Normal = N;
+        Sweep->Body = Body;
+    }
+}
+
+static void AK_Sim__Sweep_Character_Triangle(ak_sim__character_sweep* Sweep, ak_sim_v3 A, ak_sim_v3 B, ak_sim_v3 C, const ak_sim_body* Body) {
+    ak_sim__aabb AABB = AK_Sim__AABB_Empty();
+    AK_Sim__AABB_Add_Point(&AABB, A);
+    AK_Sim__AABB_Add_Point(&AABB, B);
+    AK_Sim__AABB_Add_Point(&AABB, C);
+    if(!AK_Sim__AABB_Overlap(&AABB, &Sweep->Bounds)) return;
+
+    ak_sim__triangle_proxy Triangle;
+    if(AK_Sim__Triangle_Proxy_Init(&Triangle, A, B, C)) {
+        AK_Sim__Sweep_Character_Proxy(Sweep, &Triangle.Proxy, Body);
+    }
+}
+
+/*Meshes and heightfields are swept triangle by triangle and compounds child by child. User shapes 
+  have no support function to sweep against*/
+static void AK_Sim__Sweep_Character_Shape(ak_sim__character_sweep* Sweep, const ak_sim_shape* Shape, const ak_sim_m4x3* Transform, ak_sim_v3 Scale, const ak_sim_body* Body) {
+    uint32_t i;
+    switch(Shape->Type) {
+        case AK_SIM_SHAPE_TYPE_CONVEX: {
+            ak_sim__convex_proxy Proxy;
+            if(AK_Sim__Convex_Proxy_Init(&Proxy, &Shape->Internal.Convex, Transform, Scale)) {
+                AK_Sim__Sweep_Character_Proxy(Sweep, &Proxy, Body);
+            }
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_MESH: {
+            const ak_sim_triangle_mesh* Mesh = Shape->Internal.TriangleMesh.Mesh;
+            for(i = 0; i+2 < Mesh->IdxCount; i += 3) {
+                ak_sim_v3 A = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(Mesh->Vertices[Mesh->Indices[i]], Scale));
+                ak_sim_v3 B = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(Mesh->Vertices[Mesh->Indices[i+1]], Scale));
+                ak_sim_v3 C = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(Mesh->Vertices[Mesh->Indices[i+2]], Scale));
+                AK_Sim__Sweep_Character_Triangle(Sweep, A, B, C, Body);
+            }
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_COMPOUND: {
+            const ak_sim_compound_shape* Compound = &Shape->Internal.Compound;
+            for(i = 0; i < Compound->ShapeCount; i++) {
+                const ak_sim_generic_shape* Child = Compound->Shapes + i;
+                ak_sim_m4x3 ChildTransform = AK_Sim__Get_Matrix_Transform(&Child->Transform);
+                ChildTransform.Cols[3] = AK_Sim__V3_Mul(ChildTransform.Cols[3], Scale);
+                ChildTransform = AK_Sim__M4x3_Mul(Transform, &ChildTransform);
+                AK_Sim__Sweep_Character_Shape(Sweep, &Child->Shape, &ChildTransform, Scale, Body);
+            }
+        } break;
+
+        case AK_SIM_SHAPE_TYPE_HEIGHTFIELD: {
+            const ak_sim_heightfield* Heightfield = Shape->Internal.Heightfield.Heightfield;
+            ak_sim__aabb LocalBounds;
+            uint32_t CellMin[2], CellMax[2];
+            if(!AK_Sim__Get_Heightfield_Cells(Heightfield, Transform, Scale, &Sweep->Bounds, &LocalBounds, CellMin, CellMax)) return;
+
+            uint32_t x, z;
+            for(z = CellMin[1]; z <= CellMax[1]; z++) {
+                for(x = CellMin[0]; x <= CellMax[0]; x++) {
+                    ak_sim_v3 P00 = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(AK_Sim__Heightfield_Point(Heightfield, x, z), Scale));
+                    ak_sim_v3 P10 = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(AK_Sim__Heightfield_Point(Heightfield, x+1, z), Scale));
+                    ak_sim_v3 P01 = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(AK_Sim__Heightfield_Point(Heightfield, x, z+1), Scale));
+                    ak_sim_v3 P11 = AK_Sim__M4x3_Transform_Point(Transform, AK_Sim__V3_Mul(AK_Sim__Heightfield_Point(Heightfield, x+1, z+1), Scale));
+                    AK_Sim__Sweep_Character_Triangle(Sweep, P00, P01, P11, Body);
+                    AK_Sim__Sweep_Character_Triangle(Sweep, P00, P11, P10, Body);
+                }
+            }
+        } break;
+
+        default: break;
+    }
+}
+
+/*Sweeps the capsule from Position along Motion through the character's colliders and finds where 
+  its skin first touches one. Only colliders whose bounds overlap the swept capsule are tested*/
+static int AK_Sim__Cast_Character(const ak_sim__character_move* Move, ak_sim_v3 Position, ak_sim_v3 Motion, ak_sim__character_hit* Hit) {
+    float Length = AK_Sim__V3_Length(Motion);
+    if(Length < 1e-6f) return 0;
+
+    ak_sim__character_sweep Sweep;
+    ak_sim__convex_proxy* Capsule = &Sweep.Capsule;
+    AK_SIM_MEMSET(Capsule, 0, sizeof(ak_sim__convex_proxy));
+    Capsule->CoreVertices[0] = AK_Sim_V3(0.0f, Move->HalfHeight, 0.0f);
+    Capsule->CoreVertices[1] = AK_Sim_V3(0.0f, -Move->HalfHeight, 0.0f);
+    Capsule->Vertices = Capsule->CoreVertices;
+    Capsule->VtxCount = 2;
+    Capsule->Radius = Move->Radius;
+    Capsule->Transform.Cols[0] = AK_Sim_V3(1.0f, 0.0f, 0.0f);
+    Capsule->Transform.Cols[1] = AK_Sim_V3(0.0f, 1.0f, 0.0f);
+    Capsule->Transform.Cols[2] = AK_Sim_V3(0.0f, 0.0f, 1.0f);
+    Capsule->Transform.Cols[3] = Position;
+    Capsule->Scale = AK_Sim_V3(1.0f, 1.0f, 1.0f);
+
+    ak_sim_v3 End = AK_Sim__V3_Add(Position, Motion);
+    ak_sim_v3 Extent = AK_Sim_V3(Move->Radius, Move->HalfHeight + Move->Radius, Move->Radius);
+    Sweep.Bounds.Min = AK_Sim__V3_Sub(AK_Sim__V3_Min(Position, End), Extent);
+    Sweep.Bounds.Max = AK_Sim__V3_Add(AK_Sim__V3_Max(Position, End), Extent);
+    Sweep.Direction = AK_Sim__V3_Mul_S(Motion, 1.0f/Length);
+    Sweep.T = Length;
+    Sweep.Body = NULL;
+
+    uint32_t i;
+    for(i = 0; i < Move->ColliderCount; i++) {
+        const ak_sim__character_collider* Collider = Move->Colliders + i;
+        if(AK_Sim__AABB_Overlap(&Collider->AABB, &Sweep.Bounds)) {
+            AK_Sim__Sweep_Character_Shape(&Sweep, Collider->Shape, &Collider->Transform, Collider->Body->Scale, Collider->Body);
+        }
+    }
+
+    if(!Sweep.Body) return 0;
+    Hit->Distance = Sweep.T;
+    Hit->Normal = Sweep.Normal;
+    Hit->Body = Sweep.Body;
+    return 1;
+}
+
+static ak_sim_v3 AK_Sim__Clip_Motion(ak_sim_v3 Motion, ak_sim_v3 Normal) {
+    float Into = AK_Sim__V3_Dot(Motion, Normal);
+    return Into < 0.0f ? AK_Sim__V3_Sub(Motion, AK_Sim__V3_Mul_S(Normal, Into)) : Motion;
+}
+
+/*Collide and slide. Walkable ground keeps the horizontal part of the rest of the motion and tilts 
+  it along the slope, which can lengthen it by up to 1/MaxSlopeCos, so the whole slide is capped at 
+  that. Steeper surfaces are walls that can be slid down but not climbed. Motion clipped back into 
+  the previous surface follows the crease between the two. Blocked is set when a wall was hit*/
+static ak_sim_v3 AK_Sim__Slide_Character(const ak_sim__character_move* Move, ak_sim_v3 Position, ak_sim_v3 Motion, int* Blocked) {
+    float Budget = AK_Sim__V3_Length(Motion)/Move->MaxSlopeCos;
+    ak_sim_v3 PrevNormal = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+
+    uint32_t Iteration;
+    for(Iteration = 0; Iteration < AK_SIM__CHARACTER_MAX_SLIDES; Iteration++) {
+        ak_sim__character_hit Hit;
+        if(!AK_Sim__Cast_Character(Move, Position, Motion, &Hit)) return AK_Sim__V3_Add(Position, Motion);
+
+        float Length = AK_Sim__V3_Length(Motion);
+        ak_sim_v3 Direction = AK_Sim__V3_Mul_S(Motion, 1.0f/Length);
+        Position = AK_Sim__V3_Add(Position, AK_Sim__V3_Mul_S(Direction, Hit.Distance));
+        Budget -= Hit.Distance;
+
+        ak_sim_v3 N = Hit.Normal;
+        ak_sim_v3 Rest = AK_Sim__V3_Mul_S(Direction, Length - Hit.Distance);
+        if(N.Data[1] >= Move->MaxSlopeCos) {
+            Rest.Data[1] -= AK_Sim__V3_Dot(Rest, N)/N.Data[1];
+        } else {
+            *Blocked = 1;
+            ak_sim_v3 Clipped = AK_Sim__Clip_Motion(Rest, N);
+            if(N.Data[1] > 0.0f && Clipped.Data[1] > 0.0f && Rest.Data[1] <= 0.0f) {
+                ak_sim_v3 Wall = AK_Sim__V3_Normalize(AK_Sim_V3(N.Data[0], 0.0f, N.Data[2]));
+                Clipped = AK_Sim__Clip_Motion(Rest, Wall);
+            }
+            Rest = Clipped;
+        }
+
+        if(Iteration && AK_Sim__V3_Dot(Rest, PrevNormal) < 0.0f) {
+            ak_sim_v3 Crease = AK_Sim__V3_Cross(PrevNormal, N);
+            float CreaseLength = AK_Sim__V3_Length(Crease);
+            if(CreaseLength < 1e-6f) return Position;
+            Crease = AK_Sim__V3_Mul_S(Crease, 1.0f/CreaseLength);
+            Rest = AK_Sim__V3_Mul_S(Crease, AK_Sim__V3_Dot(Rest, Crease));
+        }
+        PrevNormal = N;
+
+        float RestLength = AK_Sim__V3_Length(Rest);
+        if(Budget <= 0.0f) return Position;
+        if(RestLength > Budget) Rest = AK_Sim__V3_Mul_S(Rest, Budget/RestLength);
+        Motion = Rest;
+    }
+    return Position;
+}
+
+/*Casts down onto walkable ground. Standing on an edge gives a rounded normal that's too steep, so 
+  then the top is probed for a radius further across, starting a radius higher to clear the edge. 
+  The top can't be lower than the edge or more than MaxRise above the start. The hit keeps the 
+  distance down to the edge but takes the top's normal and body*/
+static int AK_Sim__Cast_Ground(const ak_sim__character_move* Move, ak_sim_v3 Position, ak_sim_v3 Across, float Distance, 
+                               float MaxRise, ak_sim__character_hit* Hit) {
+    if(!AK_Sim__Cast_Character(Move, Position, AK_Sim_V3(0.0f, -Distance, 0.0f), Hit)) return 0;
+    if(Hit->Normal.Data[1] >= Move->MaxSlopeCos) return 1;
+
+    float AcrossLength = AK_Sim__V3_Length(Across);
+    if(AcrossLength < 1e-6f) return 0;
+
+    ak_sim__character_hit TopHit;
+    float Lift = Move->Radius;
+    ak_sim_v3 Top = AK_Sim__V3_Add(Position, AK_Sim__V3_Mul_S(Across, Move->Radius/AcrossLength));
+    Top.Data[1] += Lift;
+    if(!AK_Sim__Cast_Character(Move, Top, AK_Sim_V3(0.0f, -(Distance+Lift), 0.0f), &TopHit)) return 0;
+    if(TopHit.Normal.Data[1] < Move->MaxSlopeCos) return 0;
+
+    float TopDistance = TopHit.Distance - Lift;
+    if(TopDistance > Hit->Distance + AK_SIM__CHARACTER_SKIN || TopDistance < -MaxRise - AK_SIM__CHARACTER_SKIN) return 0;
+    Hit->Normal = TopHit.Normal;
+    Hit->Body = TopHit.Body;
+    return 1;
+}
+
+/*The capsule first slides the whole displacement. When that hits a wall, a grounded character also 
+  tries stepping up by the step height, across, and back down onto walkable ground, and keeps 
+  whichever got further across. Grounded characters that aren't moving up then follow the ground 
+  down by up to the step height. The move is done around the character's start position*/
+static void AK_Sim__Move_Character(const ak_sim__character_task* Task, uint32_t CharacterIndex) {
+    ak_sim_character* Character = Task->Characters + CharacterIndex;
+    ak_sim__character_move Move;
+    Move.Colliders = Task->Colliders + Task->FirstColliders[CharacterIndex];
+    Move.ColliderCount = Task->FirstColliders[CharacterIndex+1]-Task->FirstColliders[CharacterIndex];
+    Move.HalfHeight = Character->Capsule.HalfHeight;
+    Move.Radius = Character->Capsule.Radius + AK_SIM__CHARACTER_SKIN;
+    Move.MaxSlopeCos = AK_Sim__Get_Character_Max_Slope_Cos(Character);
+
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim_v3 Displacement = Character->Displacement;
+    ak_sim_v3 Across = AK_Sim_V3(Displacement.Data[0], 0.0f, Displacement.Data[2]);
+    float StepHeight = Character->StepHeight;
+    int WasGrounded = (Character->Flags & AK_SIM_CHARACTER_FLAG_GROUNDED) != 0;
+    ak_sim__character_hit Hit;
+
+    int Blocked = 0;
+    ak_sim_v3 End = AK_Sim__Slide_Character(&Move, Zero, Displacement, &Blocked);
+
+    if(WasGrounded && Blocked && StepHeight > 0.0f && AK_Sim__V3_Length(Across) > 1e-6f) {
+        float Rise = AK_Sim__Cast_Character(&Move, Zero, AK_Sim_V3(0.0f, StepHeight, 0.0f), &Hit) ? Hit.Distance : StepHeight;
+        int StepBlocked = 0;
+        ak_sim_v3 Step = AK_Sim__Slide_Character(&Move, AK_Sim_V3(0.0f, Rise, 0.0f), Across, &StepBlocked);
+        if(AK_Sim__Cast_Ground(&Move, Step, Across, Rise, 0.0f, &Hit)) {
+            Step.Data[1] -= Hit.Distance;
+            float StepDistance = Step.Data[0]*Step.Data[0] + Step.Data[2]*Step.Data[2];
+            float SlideDistance = End.Data[0]*End.Data[0] + End.Data[2]*End.Data[2];
+            if(StepDistance > SlideDistance) End = Step;
+        }
+    }
+
+    if(WasGrounded && Displacement.Data[1] <= 0.0f && StepHeight > 0.0f) {
+        if(AK_Sim__Cast_Ground(&Move, End, Across, StepHeight, Move.Radius, &Hit)) {
+            End.Data[1] -= Hit.Distance;
+        }
+    }
+
+    Character->Flags &= ~AK_SIM_CHARACTER_FLAG_GROUNDED;
+    Character->Ground = 0;
+    Character->GroundNormal = Zero;
+    if(AK_Sim__Cast_Ground(&Move, End, Across, 2.0f*AK_SIM__CHARACTER_SKIN, Move.Radius, &Hit)) {
+        Character->Flags |= AK_SIM_CHARACTER_FLAG_GROUNDED;
+        Character->Ground = Hit.Body->ID;
+        Character->GroundNormal = Hit.Normal;
+    }
+
+    Character->Position = AK_Sim__Position_Add_V3(Character->Position, End);
+    Character->Motion = End;
+}
+
+static void AK_Sim__Move_Characters_Task(uint32_t TaskIndex, uint32_t WorkerIndex, void* TaskData) {
+    ak_sim__character_task* Task = (ak_sim__character_task*)TaskData;
+    uint32_t First = TaskIndex*AK_SIM__CHARACTER_TASK_SIZE;
+    uint32_t Last = AK_Sim__Min(First+AK_SIM__CHARACTER_TASK_SIZE, Task->CharacterCount);
+
+    uint32_t i;
+    for(i = First; i < Last; i++) {
+        AK_Sim__Move_Character(Task, i);
+    }
+}
+
+static void AK_Sim__Add_Character_Collider(ak_sim_context* Context, ak_sim__array* Colliders, uint32_t CharacterIndex, 
+                                           const ak_sim_body* Body, const ak_sim__aabb* AABB, ak_sim_position Origin) {
+    ak_sim__character_collider Collider;
+    Collider.CharacterIndex = CharacterIndex;
+    Collider.Body = Body;
+    Collider.Shape = &AK_Sim__Get_Shape_Entry(Context, Body->Shape)->Shape;
+    Collider.Transform = AK_Sim__Get_Body_Matrix_Transform(&Body->Transform, Origin);
+    Collider.AABB = AK_Sim__Get_Local_AABB(AABB, Origin);
+    AK_Sim__Array_Add(Colliders, &Collider);
+}
+
+/*Each character's query bounds cover everywhere its slides, steps and ground checks can reach. 
+  They're tested against the static tree and against the moving bodies through a tree of the 
+  characters, the same way cloth finds its colliders*/
+AKSIMDEF void AK_Sim_Move_Characters(ak_sim_context* Context, ak_sim_character* Characters, uint32_t CharacterCount) {
+    if(!CharacterCount) return;
+
+    AK_Sim__Reserve_Body_Bounds(Context, Context->BodyPool.MaxUsed);
+    if(Context->StaticTreeDirty) AK_Sim__Rebuild_Static_Tree(Context);
+
+    ak_sim__temp_arena Temp = AK_Sim__Arena_Begin_Temp(&Context->TempArena);
+    ak_sim__arena* TempArena = &Context->TempArena;
+    ak_sim__bvh_item* Items = AK_Sim__Arena_Push_Array(TempArena, CharacterCount, ak_sim__bvh_item);
+    uint32_t CharacterIndex, j;
+
+    for(CharacterIndex = 0; CharacterIndex < CharacterCount; CharacterIndex++) {
+        const ak_sim_character* Character = Characters + CharacterIndex;
+        float Reach = AK_Sim__V3_Length(Character->Displacement)/AK_Sim__Get_Character_Max_Slope_Cos(Character) + 
+                      Character->StepHeight + Character->Capsule.Radius + 4.0f*AK_SIM__CHARACTER_SKIN;
+        float Radius = Character->Capsule.Radius + Reach;
+        float HalfHeight = Character->Capsule.HalfHeight + Radius;
+        ak_sim__aabb AABB;
+        AABB.Min = AK_Sim_V3(-Radius, -HalfHeight, -Radius);
+        AABB.Max = AK_Sim_V3(Radius, HalfHeight, Radius);
+
+        /*Kinematic items would only find dynamic bodies*/
+        ak_sim__bvh_item* Item = Items + CharacterIndex;
+        Item->AABB = AK_Sim__Get_World_AABB(&AABB, Character->Position);
+        Item->ID = CharacterIndex;
+        Item->CollisionCategory = Character->CollisionCategory ? Character->CollisionCategory : AK_SIM_DEFAULT_COLLISION_CATEGORY;
+        Item->CollisionMask = Character->CollisionMask ? Character->CollisionMask : AK_SIM_DEFAULT_COLLISION_MASK;
+        Item->Type = AK_SIM_BODY_TYPE_DYNAMIC;
+        Item->Flags = 0;
+    }
+
+    ak_sim__pool* BodyPool = &Context->BodyPool;
+    ak_sim__array Colliders, IDs;
+    AK_Sim__Array_Init(&Colliders, &TempArena->BaseAllocator, sizeof(ak_sim__character_collider));
+    AK_Sim__Array_Init(&IDs, &TempArena->BaseAllocator, sizeof(ak_sim_body_id));
+    for(CharacterIndex = 0; CharacterIndex < CharacterCount; CharacterIndex++) {
+        IDs.Count = 0;
+        AK_Sim__BVH_Find_Overlaps(&Context->StaticTree, Items + CharacterIndex, &IDs);
+        for(j = 0; j < IDs.Count; j++) {
+            ak_sim__pool_id ID;
+            ID.ID = *(ak_sim_body_id*)AK_Sim__Array_Get(&IDs, j);
+            ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Get(BodyPool, ID.ID);
+            if(Body->Flags & AK_SIM_BODY_FLAG_SENSOR) continue;
+            AK_Sim__Add_Character_Collider(Context, &Colliders, CharacterIndex, Body, &Context->BodyBounds[ID.Internal.Index].SweptAABB, Characters[CharacterIndex].Position);
+        }
+    }
+
+    /*Building the tree reorders the items, which is why the static queries go first. Moving bodies 
+      have moved since their broadphase bounds were made, so their bounds are recomputed*/
+    ak_sim__bvh CharacterTree;
+    AK_Sim__BVH_Build(&CharacterTree, Items, CharacterCount, AK_Sim__Arena_Push_Array(TempArena, 2*CharacterCount, ak_sim__bvh_node));
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        if(Body->Type == AK_SIM_BODY_TYPE_STATIC || (Body->Flags & AK_SIM_BODY_FLAG_SENSOR)) continue;
+
+        ak_sim__aabb AABB = AK_Sim__Get_Body_AABB(Context, Body);
+        ak_sim__bvh_item Item;
+        AK_Sim__BVH_Item_From_Body(&Item, Body, &AABB);
+
+        IDs.Count = 0;
+        AK_Sim__BVH_Find_Overlaps(&CharacterTree, &Item, &IDs);
+        for(j = 0; j < IDs.Count; j++) {
+            CharacterIndex = (uint32_t)*(ak_sim_body_id*)AK_Sim__Array_Get(&IDs, j);
+            AK_Sim__Add_Character_Collider(Context, &Colliders, CharacterIndex, Body, &AABB, Characters[CharacterIndex].Position);
+        }
+    }
+
+    /*Stable counting sort by character, so each character sees its colliders in a deterministic order*/
+    uint32_t* FirstColliders = AK_Sim__Arena_Push_Array(TempArena, CharacterCount+1, uint32_t);
+    ak_sim__character_collider* SortedColliders = AK_Sim__Arena_Push_Array(TempArena, Colliders.Count, ak_sim__character_collider);
+    AK_SIM_MEMSET(FirstColliders, 0, (CharacterCount+1)*sizeof(uint32_t));
+    for(j = 0; j < Colliders.Count; j++) {
+        FirstColliders[((ak_sim__character_collider*)AK_Sim__Array_Get(&Colliders, j))->CharacterIndex+1]++;
+    }
+    for(CharacterIndex = 0; CharacterIndex < CharacterCount; CharacterIndex++) {
+        FirstColliders[CharacterIndex+1] += FirstColliders[CharacterIndex];
+    }
+    uint32_t* NextColliders = AK_Sim__Arena_Push_Array(TempArena, CharacterCount, uint32_t);
+    AK_SIM_MEMCPY(NextColliders, FirstColliders, CharacterCount*sizeof(uint32_t));
+    for(j = 0; j < Colliders.Count; j++) {
+        const ak_sim__character_collider* Collider = (const ak_sim__character_collider*)AK_Sim__Array_Get(&Colliders, j);
+        SortedColliders[NextColliders[Collider->CharacterIndex]++] = *Collider;
+    }
+
+    ak_sim__character_task Task;
+    Task.Characters = Characters;
+    Task.Colliders = SortedColliders;
+    Task.FirstColliders = FirstColliders;
+    Task.CharacterCount = CharacterCount;
+    AK_Sim__Parallel_For(Context, AK_Sim__Move_Characters_Task, &Task, (CharacterCount+AK_SIM__CHARACTER_TASK_SIZE-1)/AK_SIM__CHARACTER_TASK_SIZE);
+
+    AK_Sim__Arena_End_Temp(&Temp);
+}
+
+AKSIMDEF uint64_t AK_Sim_Get_Step_Index(ak_sim_context* Context) {
+    return Context->StepIndex;
+}
+
+AKSIMDEF void AK_Sim_Get_Stats(ak_sim_context* Context, ak_sim_stats* Stats) {
+#ifndef AK_SIM_NO_PROFILE
+    *Stats = Context->Profiler.Stats;
+#else
+    AK_SIM_MEMSET(Stats, 0, sizeof(ak_sim_stats));
+#endif
+}
+
+AKSIMDEF void AK_Sim_Get_Memory_Usage(ak_sim_context* Context, ak_sim_memory_usage* Usage) {
+    AK_SIM_MEMSET(Usage, 0, sizeof(ak_sim_memory_usage));
+    Usage->Bodies = AK_Sim__Pool_Item_Size(&Context->BodyPool)*Context->BodyPool.ItemCapacity;
+    Usage->Joints = AK_Sim__Pool_Item_Size(&Context->JointPool)*Context->JointPool.ItemCapacity;
+    Usage->Cloths = AK_Sim__Pool_Item_Size(&Context->ClothPool)*Context->ClothPool.ItemCapacity;
+
+    ak_sim__pool_iter ClothIter = AK_Sim__Pool_Begin_Iter(&Context->ClothPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&ClothIter)) {
+        ak_sim__cloth* Cloth = (ak_sim__cloth*)AK_Sim__Pool_Iter_Next(&ClothIter);
+        Usage->Cloths += Cloth->MemorySize;
+    }
+
+    Usage->Shapes = AK_Sim__Pool_Item_Size(&Context->ShapePool)*Context->ShapePool.ItemCapacity;
+
+    ak_sim__pool_iter ShapeIter = AK_Sim__Pool_Begin_Iter(&Context->ShapePool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&ShapeIter)) {
+        ak_sim__shape_entry* Entry = (ak_sim__shape_entry*)AK_Sim__Pool_Iter_Next(&ShapeIter);
+        Usage->Shapes += Entry->SupportDataSize;
+    }
+
+    Usage->Broadphase = (Context->StaticTreeCapacity+Context->MovingTreeCapacity)*(sizeof(ak_sim__bvh_item) + 2*sizeof(ak_sim__bvh_node)) + 
+                        Context->BodyBoundsCapacity*sizeof(ak_sim__body_bounds) + 
+                        Context->BroadphasePairs.Capacity*Context->BroadphasePairs.DataSize;
+
+    uint32_t i;
+    for(i = 0; i < 2; i++) {
+        const ak_sim__pair_cache_table* Table = Context->PairCaches + i;
+        Usage->PairCaches += AK_Sim__Set_Get_Size(&Table->Pairs) + Table->Capacity*sizeof(ak_sim__pair_cache);
+    }
+
+    Usage->Events = AK_Sim__Arena_Get_Size(&Context->EventArena);
+    Usage->StepMemory = AK_Sim__Arena_Get_Size(&Context->TempArena);
+    for(i = 0; i < Context->WorkerCount; i++) {
+        Usage->StepMemory += AK_Sim__Arena_Get_Size(&Context->Workers[i].Arena);
+    }
+    Usage->Context = sizeof(ak_sim_context) + AK_Sim__Arena_Get_Size(&Context->Arena);
+
+    Usage->Total = Usage->Bodies + Usage->Shapes + Usage->Joints + Usage->Cloths + Usage->Broadphase + Usage->PairCaches + 
+                   Usage->Events + Usage->StepMemory + Usage->Context;
+}
+
+typedef struct {
+    char*  Buffer;
+    size_t BufferSize;
+    size_t Length;
+} ak_sim__string_writer;
+
+static void AK_Sim__String_Write(ak_sim__string_writer* Writer, const char* String) {
+    while(*String) {
+        if(Writer->Length < Writer->BufferSize) Writer->Buffer[Writer->Length] = *String;
+        Writer->Length++;
+        String++;
+    }
+}
+
+static void AK_Sim__String_Write_U64(ak_sim__string_writer* Writer, uint64_t Value) {
+    char Digits[24];
+    char* At = Digits+AK_Sim__Array_Count(Digits)-1;
+    *At = 0;
+    do {
+        *--At = (char)('0' + Value % 10);
+        Value /= 10;
+    } while(Value);
+    AK_Sim__String_Write(Writer, At);
+}
+
+/*Trace timestamps are in microseconds. Keep the nanoseconds as three decimals*/
+static void AK_Sim__String_Write_NS_As_US(ak_sim__string_writer* Writer, uint64_t NS) {
+    char Fraction[5];
+    Fraction[0] = '.';
+    Fraction[1] = (char)('0' + (NS/100) % 10);
+    Fraction[2] = (char)('0' + (NS/10) % 10);
+    Fraction[3] = (char)('0' + NS % 10);
+    Fraction[4] = 0;
+    AK_Sim__String_Write_U64(Writer, NS/1000);
+    AK_Sim__String_Write(Writer, Fraction);
+}
+
+AKSIMDEF size_t AK_Sim_Write_Chrome_Trace(ak_sim_context* Context, char* Buffer, size_t BufferSize) {
+    ak_sim__string_writer Writer;
+    Writer.Buffer = Buffer;
+    Writer.BufferSize = Buffer ? BufferSize : 0;
+    Writer.Length = 0;
+
+    AK_Sim__String_Write(&Writer, "{\"traceEvents\":[");
+
+#ifndef AK_SIM_NO_PROFILE
+    static const char* PhaseNames[AK_SIM_PROFILE_PHASE_COUNT] = {
+        "Step", "Broadphase", "Narrowphase", "Solver", "Integration", "Cloth"
+    };
+
+    ak_sim__profiler* Profiler = &Context->Profiler;
+    uint32_t EventCount = AK_Sim__Min(Profiler->EventCount, (uint32_t)AK_SIM_PROFILE_MAX_EVENTS);
+    uint32_t FirstEvent = Profiler->EventCount - EventCount;
+
+    uint32_t i;
+    for(i = 0; i < EventCount; i++) {
+        ak_sim__profile_event* Event = Profiler->Events + ((FirstEvent+i) % AK_SIM_PROFILE_MAX_EVENTS);
+        if(i) AK_Sim__String_Write(&Writer, ",");
+        AK_Sim__String_Write(&Writer, "{\"name\":\"");
+        AK_Sim__String_Write(&Writer, PhaseNames[Event->Phase]);
+        AK_Sim__String_Write(&Writer, "\",\"cat\":\"ak_sim\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":");
+        AK_Sim__String_Write_NS_As_US(&Writer, Event->StartNS);
+        AK_Sim__String_Write(&Writer, ",\"dur\":");
+        AK_Sim__String_Write_NS_As_US(&Writer, Event->EndNS-Event->StartNS);
+        AK_Sim__String_Write(&Writer, "}");
+    }
+#endif
+
+    AK_Sim__String_Write(&Writer, "]}");
+    if(Buffer && BufferSize) {
+        Buffer[AK_Sim__Min(Writer.Length, BufferSize-1)] = 0;
+    }
+    return Writer.Length;
+}
+
+#define AK_SIM__FNV_OFFSET_BASIS 0xcbf29ce484222325
+#define AK_SIM__FNV_PRIME 0x100000001b3
+
+static uint64_t AK_Sim__Hash_Bytes(uint64_t Hash, const void* Data, size_t Size) {
+    const uint8_t* At = (const uint8_t*)Data;
+    while(Size--) {
+        Hash ^= *At++;
+        Hash *= AK_SIM__FNV_PRIME;
+    }
+    return Hash;
+}
+
+/*Only hash xyz so the padding lane can never cause a false desync*/
+static uint64_t AK_Sim__Hash_V3(uint64_t Hash, ak_sim_v3 V) {
+    return AK_Sim__Hash_Bytes(Hash, V.Data, sizeof(float)*3);
+}
+
+#ifdef AK_SIM_DOUBLE_PRECISION
+static uint64_t AK_Sim__Hash_Position(uint64_t Hash, ak_sim_position P) {
+    return AK_Sim__Hash_Bytes(Hash, P.Data, sizeof(P.Data));
+}
+#else
+#define AK_Sim__Hash_Position(hash, p) AK_Sim__Hash_V3(hash, p)
+#endif
+
+AKSIMDEF uint64_t AK_Sim_Get_State_Hash(ak_sim_context* Context) {
+    uint64_t Hash = AK_SIM__FNV_OFFSET_BASIS;
+    Hash = AK_Sim__Hash_Bytes(Hash, &Context->StepIndex, sizeof(uint64_t));
+
+    ak_sim__pool_iter BodyIter = AK_Sim__Pool_Begin_Iter(&Context->BodyPool);
+    while(AK_Sim__Pool_Iter_Is_Valid(&BodyIter)) {
+        ak_sim_body* Body = (ak_sim_body*)AK_Sim__Pool_Iter_Next(&BodyIter);
+        Hash = AK_Sim__Hash_Bytes(Hash, &Body->ID, sizeof(ak_sim_body_id));
+        Hash = AK_Sim__Hash_Position(Hash, Body->Transform.Position);
+        Hash = AK_Sim__Hash_Bytes(Hash, Body->Transform.Orientation.Data, sizeof(ak_sim_quat));
+        Hash = AK_Sim__Hash_V3(Hash, Body->LinearVelocity);
+        Hash = AK_Sim__Hash_V3(Hash, Body->AngularVelocity);
+        Hash = AK_Sim__Hash_Bytes(Hash, &Body->Flags, sizeof(uint32_t));
+        Hash = AK_Sim__Hash_Bytes(Hash, &Body->SleepTime, sizeof(float));
+    }
+
+    return Hash;
+}
+
+#define AK_SIM__STATE_MAGIC 0x53534b41 /*AKSS*/
+#define AK_SIM__STATE_VERSION 4
+#define AK_SIM__STATE_ALIGNMENT 8
+#define AK_SIM__STATE_NEW_PAIR ((uint32_t)-1)
+
+typedef enum {
+    AK_SIM__STATE_KIND_FULL,
+    AK_SIM__STATE_KIND_DELTA
+} ak_sim__state_kind;
+
+typedef struct {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t Kind;
+    uint32_t BodySize; /*Catches snapshots from builds with a different body layout*/
+    uint64_t StepIndex;
+    uint64_t Size;
+    float    Accumulator; /*AK_Sim_Update's partial step, so updates after a load take the same steps*/
+    uint32_t Padding;
+} ak_sim__state_header;
+
+typedef struct {
+    uint32_t FirstFreeIndex;
+    uint32_t ItemCount;
+    uint32_t MaxUsed;
+    uint32_t ItemSize;
+} ak_sim__state_pool_header;
+
+typedef struct {
+    uint32_t Count;
+    uint32_t CacheSize;
+} ak_sim__state_pair_cache_header;
+
+/*Full generation of a live shape. Shape IDs only carry the low generation bits*/
+typedef struct {
+    uint32_t Index;
+    uint32_t Generation;
+} ak_sim__state_shape;
+
+/*Writes into a caller buffer. With no buffer it only measures, so one code path handles sizing and saving*/
+typedef struct {
+    uint8_t* Start;
+    uint8_t* End;
+    size_t   Size;
+} ak_sim__state_writer;
+
+typedef struct {
+    const uint8_t* Start;
+    const uint8_t* At;
+    const uint8_t* End;
+} ak_sim__state_reader;
+
+/*A pool section of a snapshot. Full pools have MaxUsed slots in Data. Delta pools have ChangedCount 
+  ascending slot indices and their slots*/
+typedef struct {
+    const ak_sim__state_pool_header* Header;
+    const uint8_t*                   Data;
+    uint32_t                         ChangedCount;
+    const uint32_t*                  ChangedIndices;
+} ak_sim__state_pool;
+
+/*Full pair caches store every key and cache. Delta pair caches store the keys and caches that aren't 
+  in the base unchanged, then an index into the base or AK_SIM__STATE_NEW_PAIR for every pair*/
+typedef struct {
+    uint32_t                    Count;
+    uint32_t                    NewCount;
+    const ak_sim__body_id_pair* Keys;
+    const ak_sim__pair_cache*   Caches;
+    const uint32_t*             BaseIndices;
+} ak_sim__state_pair_caches;
+
+typedef struct {
+    uint32_t                   Count;
+    const ak_sim__state_shape* Shapes;
+} ak_sim__state_shapes;
+
+/*Everything a snapshot holds, checked but not applied yet*/
+typedef struct {
+    const ak_sim__state_header* Header;
+    ak_sim__state_pool          Bodies;
+    ak_sim__state_pool          Joints;
+    ak_sim__state_shapes        Shapes;
+    ak_sim__state_pair_caches   PairCaches;
+} ak_sim__state;
+
+static ak_sim__state_writer AK_Sim__State_Begin_Write(void* Buffer, size_t BufferSize) {
+    ak_sim__state_writer Result;
+    Result.Start = (uint8_t*)Buffer;
+    Result.End = Result.Start+BufferSize;
+    Result.Size = 0;
+    return Result;
+}
+
+static void AK_Sim__State_Write(ak_sim__state_writer* Writer, const void* Data, size_t Size) {
+    if(Writer->Start && Size && Writer->Size+Size <= (size_t)(Writer->End-Writer->Start)) {
+        AK_SIM_MEMCPY(Writer->Start+Writer->Size, Data, Size);
+    }
+    Writer->Size += Size;
 }
 
+/*Keeps every section aligned so it can be read in place*/
+static void AK_Sim__State_Write_Align(ak_sim__state_writer* Writer) {
+    static const uint8_t Zeros[AK_SIM__STATE_ALIGNMENT] = {0};
+    AK_Sim__State_Write(Writer, Zeros, AK_Sim__Align_Pow2(Writer->Size, AK_SIM__STATE_ALIGNMENT)-Writer->Size);
+}
+
+static size_t AK_Sim__State_End_Write(ak_sim__state_writer* Writer) {
+    if(!Writer->Start) return Writer->Size;
+    if(Writer->Size > (size_t)(Writer->End-Writer->Start)) return 0;
+    ((ak_sim__state_header*)Writer->Start)->Size = Writer->Size;
+    return Writer->Size;
+}
+
+static ak_sim__state_reader AK_Sim__State_Begin_Read(const void* Buffer, size_t BufferSize) {
+    ak_sim__state_reader Result;
+    Result.Start = Result.At = (const uint8_t*)Buffer;
+    Result.End = Result.At+BufferSize;
+    return Result;
+}
+
+static const void* AK_Sim__State_Read(ak_sim__state_reader* Reader, size_t Size) {
+    if(Size > (size_t)(Reader->End-Reader->At)) return NULL;
+    const void* Result = Reader->At;
+    Reader->At += Size;
+    return Result;
+}
+
+static int AK_Sim__State_Read_Align(ak_sim__state_reader* Reader) {
+    size_t Offset = (size_t)(Reader->At-Reader->Start);
+    return AK_Sim__State_Read(Reader, AK_Sim__Align_Pow2(Offset, AK_SIM__STATE_ALIGNMENT)-Offset) != NULL;
+}
+
+/*Reads Count items of Size bytes, failing instead of overflowing on corrupt counts*/
+static const void* AK_Sim__State_Read_Array(ak_sim__state_reader* Reader, uint32_t Count, size_t Size) {
+    if(Size && Count > (size_t)(Reader->End-Reader->At)/Size) return NULL;
+    return AK_Sim__State_Read(Reader, Count*Size);
+}
+
+static void AK_Sim__State_Write_Header(ak_sim__state_writer* Writer, ak_sim_context* Context, ak_sim__state_kind Kind) {
+    ak_sim__state_header Header;
+    AK_SIM_MEMSET(&Header, 0, sizeof(ak_sim__state_header));
+    Header.Magic = AK_SIM__STATE_MAGIC;
+    Header.Version = AK_SIM__STATE_VERSION;
+    Header.Kind = Kind;
+    Header.BodySize = sizeof(ak_sim_body);
+    Header.StepIndex = Context->StepIndex;
+    Header.Accumulator = Context->Accumulator;
+    AK_Sim__State_Write(Writer, &Header, sizeof(ak_sim__state_header));
+}
+
+static const ak_sim__state_header* AK_Sim__State_Read_Header(ak_sim__state_reader* Reader, ak_sim__state_kind Kind) {
+    const ak_sim__state_header* Header = (const ak_sim__state_header*)AK_Sim__State_Read(Reader, sizeof(ak_sim__state_header));
+    if(!Header || Header->Magic != AK_SIM__STATE_MAGIC || Header->Version != AK_SIM__STATE_VERSION || 
+       Header->Kind != (uint32_t)Kind || Header->BodySize != sizeof(ak_sim_body)) {
+        return NULL;
+    }
+    if(Header->Size > (uint64_t)(Reader->End-(const uint8_t*)Header)) return NULL;
+    return Header;
+}
+
+static void AK_Sim__State_Write_Pool_Header(ak_sim__state_writer* Writer, ak_sim__pool* Pool) {
+    ak_sim__state_pool_header Header;
+    Header.FirstFreeIndex = Pool->FirstFreeIndex;
+    Header.ItemCount = Pool->ItemCount;
+    Header.MaxUsed = Pool->MaxUsed;
+    Header.ItemSize = (uint32_t)Pool->ItemSize;
+    AK_Sim__State_Write(Writer, &Header, sizeof(ak_sim__state_pool_header));
+}
+
+static const ak_sim__state_pool_header* AK_Sim__State_Read_Pool_Header(ak_sim__state_reader* Reader, ak_sim__pool* Pool) {
+    const ak_sim__state_pool_header* Header = (const ak_sim__state_pool_header*)AK_Sim__State_Read(Reader, sizeof(ak_sim__state_pool_header));
+    if(!Header || Header->ItemSize != Pool->ItemSize || Header->ItemCount > Header->MaxUsed) return NULL;
+    if(Header->FirstFreeIndex != AK_SIM__POOL_FREE_INDEX && Header->FirstFreeIndex >= Header->MaxUsed) return NULL;
+    return Header;
+}
+
+static void AK_Sim__State_Apply_Pool_Header(ak_sim__pool* Pool, const ak_sim__state_pool_header* Header) {
+    AK_Sim__Pool_Reserve(Pool, Header->MaxUsed);
+
+    /*Slots past the restored range go back to fresh. Their generations restart, which is 
+      fine since no ID handed out after the snapshot may survive a rollback anyway*/
+    uint32_t i;
+    for(i = Header->MaxUsed; i < Pool->MaxUsed; i++) {
+        ak_sim__pool_id* ID = AK_Sim__Pool_Get_ID(Pool, i);
+        ID->Internal.Index = AK_SIM__POOL_FREE_INDEX;
+        ID->Internal.Generation = 1;
+    }
+
+    Pool->FirstFreeIndex = Header->FirstFreeIndex;
+    Pool->ItemCount = Header->ItemCount;
+    Pool->MaxUsed = Header->MaxUsed;
+}
+
+static void AK_Sim__State_Write_Pool(ak_sim__state_writer* Writer, ak_sim__pool* Pool) {
+    AK_Sim__State_Write_Pool_Header(Writer, Pool);
+    AK_Sim__State_Write(Writer, Pool->Data, AK_Sim__Pool_Item_Size(Pool)*Pool->MaxUsed);
+    AK_Sim__State_Write_Align(Writer);
+}
+
+static int AK_Sim__State_Read_Pool(ak_sim__state_reader* Reader, ak_sim__pool* Pool, ak_sim__state_pool* Result) {
+    AK_SIM_MEMSET(Result, 0, sizeof(ak_sim__state_pool));
+    Result->Header = AK_Sim__State_Read_Pool_Header(Reader, Pool);
+    if(!Result->Header) return 0;
+    Result->Data = (const uint8_t*)AK_Sim__State_Read_Array(Reader, Result->Header->MaxUsed, AK_Sim__Pool_Item_Size(Pool));
+    return Result->Data && AK_Sim__State_Read_Align(Reader);
+}
+
+static int AK_Sim__State_Pool_Slot_Changed(ak_sim__pool* Pool, uint32_t Index, const ak_sim__state_pool* Base) {
+    size_t SlotSize = AK_Sim__Pool_Item_Size(Pool);
+    if(Index >= Base->Header->MaxUsed) return 1;
+    return AK_SIM_MEMCMP(Pool->Data + Index*SlotSize, Base->Data + Index*SlotSize, SlotSize) != 0;
+}
+
+static void AK_Sim__State_Write_Pool_Delta(ak_sim__state_writer* Writer, ak_sim__pool* Pool, const ak_sim__state_pool* Base) {
+    AK_Sim__State_Write_Pool_Header(Writer, Pool);
+
+    uint32_t ChangedCount = 0;
+    uint32_t i;
+    for(i = 0; i < Pool->MaxUsed; i++) {
+        ChangedCount += AK_Sim__State_Pool_Slot_Changed(Pool, i, Base);
+    }
+
+    AK_Sim__State_Write(Writer, &ChangedCount, sizeof(uint32_t));
+    for(i = 0; i < Pool->MaxUsed; i++) {
+        if(AK_Sim__State_Pool_Slot_Changed(Pool, i, Base)) {
+            AK_Sim__State_Write(Writer, &i, sizeof(uint32_t));
+        }
+    }
+    AK_Sim__State_Write_Align(Writer);
+
+    for(i = 0; i < Pool->MaxUsed; i++) {
+        if(AK_Sim__State_Pool_Slot_Changed(Pool, i, Base)) {
+            AK_Sim__State_Write(Writer, AK_Sim__Pool_Get_ID(Pool, i), AK_Sim__Pool_Item_Size(Pool));
+        }
+    }
+    AK_Sim__State_Write_Align(Writer);
+}
+
+/*Changed indices must be ascending and in range, and every slot past the base's range must be 
+  among them since the base has nothing to fill it with*/
+static int AK_Sim__State_Read_Pool_Delta(ak_sim__state_reader* Reader, ak_sim__pool* Pool, const ak_sim__state_pool* Base, ak_sim__state_pool* Result) {
+    AK_SIM_MEMSET(Result, 0, sizeof(ak_sim__state_pool));
+    Result->Header = AK_Sim__State_Read_Pool_Header(Reader, Pool);
+    if(!Result->Header) return 0;
+
+    const uint32_t* ChangedCount = (const uint32_t*)AK_Sim__State_Read(Reader, sizeof(uint32_t));
+    if(!ChangedCount) return 0;
+    Result->ChangedCount = *ChangedCount;
+    Result->ChangedIndices = (const uint32_t*)AK_Sim__State_Read_Array(Reader, Result->ChangedCount, sizeof(uint32_t));
+    if(!Result->ChangedIndices || !AK_Sim__State_Read_Align(Reader)) return 0;
+    Result->Data = (const uint8_t*)AK_Sim__State_Read_Array(Reader, Result->ChangedCount, AK_Sim__Pool_Item_Size(Pool));
+    if(!Result->Data || !AK_Sim__State_Read_Align(Reader)) return 0;
+
+    uint32_t PastBaseCount = 0;
+    uint32_t i;
+    for(i = 0; i < Result->ChangedCount; i++) {
+        uint32_t Index = Result->ChangedIndices[i];
+        if(Index >= Result->Header->MaxUsed || (i && Index <= Result->ChangedIndices[i-1])) return 0;
+        PastBaseCount += Index >= Base->Header->MaxUsed;
+    }
+
+    uint32_t BaseMaxUsed = Base->Header->MaxUsed;
+    uint32_t MaxUsed = Result->Header->MaxUsed;
+    return PastBaseCount == (MaxUsed > BaseMaxUsed ? MaxUsed-BaseMaxUsed : 0);
+}
+
+/*Pair caches decide the narrowphase warm start, so a rollback without them would diverge. Only 
+  the current table is stored, the next step builds its table from that one*/
+static void AK_Sim__State_Write_Pair_Caches(ak_sim__state_writer* Writer, ak_sim__pair_cache_table* Table) {
+    ak_sim__state_pair_cache_header Header;
+    Header.Count = Table->Pairs.ItemCount;
+    Header.CacheSize = sizeof(ak_sim__pair_cache);
+    AK_Sim__State_Write(Writer, &Header, sizeof(ak_sim__state_pair_cache_header));
+    AK_Sim__State_Write(Writer, Table->Pairs.Keys, Header.Count*Table->Pairs.KeySize);
+    AK_Sim__State_Write(Writer, Table->Caches, Header.Count*sizeof(ak_sim__pair_cache));
+    AK_Sim__State_Write_Align(Writer);
+}
+
+static int AK_Sim__State_Read_Pair_Caches(ak_sim__state_reader* Reader, ak_sim__state_pair_caches* Result) {
+    AK_SIM_MEMSET(Result, 0, sizeof(ak_sim__state_pair_caches));
+    const ak_sim__state_pair_cache_header* Header = (const ak_sim__state_pair_cache_header*)AK_Sim__State_Read(Reader, sizeof(ak_sim__state_pair_cache_header));
+    if(!Header || Header->CacheSize != sizeof(ak_sim__pair_cache)) return 0;
+
+    Result->Count = Result->NewCount = Header->Count;
+    Result->Keys = (const ak_sim__body_id_pair*)AK_Sim__State_Read_Array(Reader, Header->Count, sizeof(ak_sim__body_id_pair));
+    Result->Caches = (const ak_sim__pair_cache*)AK_Sim__State_Read_Array(Reader, Header->Count, sizeof(ak_sim__pair_cache));
+    return Result->Keys && Result->Caches && AK_Sim__State_Read_Align(Reader);
+}
+
+/*Resting pairs keep the same cache from step to step, so deltas refer to the base's copy of any 
+  pair whose cache hasn't changed*/
+static void AK_Sim__State_Write_Pair_Caches_Delta(ak_sim__state_writer* Writer, ak_sim_context* Context, ak_sim__pair_cache_table* Table, 
+                                                  const ak_sim__state_pair_caches* Base) {
+    ak_sim__temp_arena Temp = AK_Sim__Arena_Begin_Temp(&Context->TempArena);
+    uint32_t Count = Table->Pairs.ItemCount;
+    uint32_t* BaseIndices = AK_Sim__Arena_Push_Array(&Context->TempArena, Count, uint32_t);
+
+    uint32_t i;
+    for(i = 0; i < Count; i++) BaseIndices[i] = AK_SIM__STATE_NEW_PAIR;
+    for(i = 0; i < Base->Count; i++) {
+        uint32_t Index = AK_Sim__Set_Find_Index(&Table->Pairs, Base->Keys+i);
+        if(Index != AK_SIM__HASH_INVALID_SLOT && AK_SIM_MEMCMP(Table->Caches+Index, Base->Caches+i, sizeof(ak_sim__pair_cache)) == 0) {
+            BaseIndices[Index] = i;
+        }
+    }
+
+    ak_sim__state_pair_cache_header Header;
+    Header.Count = 0;
+    Header.CacheSize = sizeof(ak_sim__pair_cache);
+    for(i = 0; i < Count; i++) Header.Count += BaseIndices[i] == AK_SIM__STATE_NEW_PAIR;
+    AK_Sim__State_Write(Writer, &Header, sizeof(ak_sim__state_pair_cache_header));
+
+    for(i = 0; i < Count; i++) {
+        if(BaseIndices[i] == AK_SIM__STATE_NEW_PAIR) AK_Sim__State_Write(Writer, AK_Sim__Set_Get_Key(&Table->Pairs, i), Table->Pairs.KeySize);
+    }
+    for(i = 0; i < Count; i++) {
+        if(BaseIndices[i] == AK_SIM__STATE_NEW_PAIR) AK_Sim__State_Write(Writer, Table->Caches+i, sizeof(ak_sim__pair_cache));
+    }
+    AK_Sim__State_Write_Align(Writer);
+    AK_Sim__State_Write(Writer, &Count, sizeof(uint32_t));
+    AK_Sim__State_Write(Writer, BaseIndices, Count*sizeof(uint32_t));
+    AK_Sim__State_Write_Align(Writer);
+
+    AK_Sim__Arena_End_Temp(&Temp);
+}
+
+static int AK_Sim__State_Read_Pair_Caches_Delta(ak_sim__state_reader* Reader, const ak_sim__state_pair_caches* Base, ak_sim__state_pair_caches* Result) {
+    if(!AK_Sim__State_Read_Pair_Caches(Reader, Result)) return 0;
+    const uint32_t* Count = (const uint32_t*)AK_Sim__State_Read(Reader, sizeof(uint32_t));
+    if(!Count) return 0;
+    Result->Count = *Count;
+    Result->BaseIndices = (const uint32_t*)AK_Sim__State_Read_Array(Reader, Result->Count, sizeof(uint32_t));
+    if(!Result->BaseIndices || !AK_Sim__State_Read_Align(Reader)) return 0;
+
+    uint32_t NewCount = 0;
+    uint32_t i;
+    for(i = 0; i < Result->Count; i++) {
+        uint32_t BaseIndex = Result->BaseIndices[i];
+        if(BaseIndex == AK_SIM__STATE_NEW_PAIR) NewCount++;
+        else if(BaseIndex >= Base->Count) return 0;
+    }
+    return NewCount == Result->NewCount;
+}
+
+static void AK_Sim__State_Apply_Pair_Caches(ak_sim__pair_cache_table* Table, const ak_sim__state_pair_caches* State, const ak_sim__state_pair_caches* Base) {
+    AK_Sim__Pair_Cache_Table_Reset(Table, State->Count);
+    uint32_t NewIndex = 0;
+    uint32_t i;
+    for(i = 0; i < State->Count; i++) {
+        const ak_sim__body_id_pair* Key;
+        const ak_sim__pair_cache* Cache;
+        if(!State->BaseIndices) {
+            Key = State->Keys+i;
+            Cache = State->Caches+i;
+        } else if(State->BaseIndices[i] == AK_SIM__STATE_NEW_PAIR) {
+            Key = State->Keys+NewIndex;
+            Cache = State->Caches+NewIndex;
+            NewIndex++;
+        } else {
+            Key = Base->Keys+State->BaseIndices[i];
+            Cache = Base->Caches+State->BaseIndices[i];
+        }
+        AK_Sim__Set_Add(&Table->Pairs, Key);
+        Table->Caches[i] = *Cache;
+    }
+}
+
+static void AK_Sim__State_Write_Shapes(ak_sim__state_writer* Writer, ak_sim_context* Context) {
+    uint32_t Count = Context->ShapePool.ItemCount;
+    AK_Sim__State_Write(Writer, &Count, sizeof(uint32_t));
+
+    uint32_t i;
+    for(i = 0; i < Context->ShapePool.MaxUsed; i++) {
+        ak_sim__pool_id* ID = AK_Sim__Pool_Get_ID(&Context->ShapePool, i);
+        if(ID->Internal.Index == i) {
+            ak_sim__state_shape Shape;
+            Shape.Index = i;
+            Shape.Generation = ID->Internal.Generation;
+            AK_Sim__State_Write(Writer, &Shape, sizeof(ak_sim__state_shape));
+        }
+    }
+    AK_Sim__State_Write_Align(Writer);
+}
+
+static int AK_Sim__State_Read_Shapes(ak_sim__state_reader* Reader, ak_sim__state_shapes* Result) {
+    const uint32_t* Count = (const uint32_t*)AK_Sim__State_Read(Reader, sizeof(uint32_t));
+    if(!Count) return 0;
+    Result->Count = *Count;
+    Result->Shapes = (const ak_sim__state_shape*)AK_Sim__State_Read_Array(Reader, Result->Count, sizeof(ak_sim__state_shape));
+    return Result->Shapes && AK_Sim__State_Read_Align(Reader);
+}
+
+/*Shape IDs only keep 8 generation bits, so a shape slot reused since the save could still match a 
+  body's ID. The full generation the snapshot saw must still be the live one*/
+static int AK_Sim__State_Shape_Is_Valid(ak_sim_context* Context, const ak_sim__state_shapes* Shapes, ak_sim_shape_id ShapeID) {
+    if(!AK_Sim__Get_Shape_Entry(Context, ShapeID)) return 0;
+    uint32_t Index = (ShapeID >> AK_SIM__SHAPE_ID_GENERATION_BITS)-1;
+    uint32_t Generation = AK_Sim__Pool_Get_ID(&Context->ShapePool, Index)->Internal.Generation;
+
+    /*Saved in slot order*/
+    uint32_t Low = 0;
+    uint32_t High = Shapes->Count;
+    while(Low < High) {
+        uint32_t Mid = Low + (High-Low)/2;
+        if(Shapes->Shapes[Mid].Index < Index) Low = Mid+1;
+        else High = Mid;
+    }
+    return Low < Shapes->Count && Shapes->Shapes[Low].Index == Index && Shapes->Shapes[Low].Generation == Generation;
+}
+
+static int AK_Sim__State_Body_Slot_Is_Valid(ak_sim_context* Context, const ak_sim__state_shapes* Shapes, const uint8_t* Slot, uint32_t Index) {
+    const ak_sim__pool_id* ID = (const ak_sim__pool_id*)Slot;
+    if(ID->Internal.Index != Index) return 1;
+    const ak_sim_body* Body = (const ak_sim_body*)(ID+1);
+    return AK_Sim__State_Shape_Is_Valid(Context, Shapes, Body->Shape);
+}
+
+static int AK_Sim__State_Bodies_Are_Valid(ak_sim_context* Context, const ak_sim__state_pool* Bodies, const ak_sim__state_pool* Base, 
+                                          const ak_sim__state_shapes* Shapes) {
+    size_t SlotSize = AK_Sim__Pool_Item_Size(&Context->BodyPool);
+    uint32_t ChangedIndex = 0;
+    uint32_t i;
+    for(i = 0; i < Bodies->Header->MaxUsed; i++) {
+        const uint8_t* Slot;
+        if(!Base) {
+            Slot = Bodies->Data + i*SlotSize;
+        } else if(ChangedIndex < Bodies->ChangedCount && Bodies->ChangedIndices[ChangedIndex] == i) {
+            Slot = Bodies->Data + ChangedIndex*SlotSize;
+            ChangedIndex++;
+        } else {
+            Slot = Base->Data + i*SlotSize;
+        }
+        if(!AK_Sim__State_Body_Slot_Is_Valid(Context, Shapes, Slot, i)) return 0;
+    }
+    return 1;
+}
+
+static int AK_Sim__State_Read_Full(ak_sim__state_reader* Reader, ak_sim_context* Context, ak_sim__state* Result) {
+    Result->Header = AK_Sim__State_Read_Header(Reader, AK_SIM__STATE_KIND_FULL);
+    if(!Result->Header) return 0;
+    if(!AK_Sim__State_Read_Pool(Reader, &Context->BodyPool, &Result->Bodies)) return 0;
+    if(!AK_Sim__State_Read_Pool(Reader, &Context->JointPool, &Result->Joints)) return 0;
+    if(!AK_Sim__State_Read_Shapes(Reader, &Result->Shapes)) return 0;
+    return AK_Sim__State_Read_Pair_Caches(Reader, &Result->PairCaches);
+}
+
+static int AK_Sim__State_Read_Delta(ak_sim__state_reader* Reader, ak_sim_context* Context, const ak_sim__state* Base, ak_sim__state* Result) {
+    Result->Header = AK_Sim__State_Read_Header(Reader, AK_SIM__STATE_KIND_DELTA);
+    if(!Result->Header) return 0;
+    if(!AK_Sim__State_Read_Pool_Delta(Reader, &Context->BodyPool, &Base->Bodies, &Result->Bodies)) return 0;
+    if(!AK_Sim__State_Read_Pool_Delta(Reader, &Context->JointPool, &Base->Joints, &Result->Joints)) return 0;
+    if(!AK_Sim__State_Read_Shapes(Reader, &Result->Shapes)) return 0;
+    return AK_Sim__State_Read_Pair_Caches_Delta(Reader, &Base->PairCaches, &Result->PairCaches);
+}
+
+/*Base slots the delta doesn't replace are copied too, since the context may have moved on from the base*/
+static void AK_Sim__State_Apply_Pool(ak_sim__pool* Pool, const ak_sim__state_pool* State, const ak_sim__state_pool* Base) {
+    AK_Sim__State_Apply_Pool_Header(Pool, State->Header);
+    size_t SlotSize = AK_Sim__Pool_Item_Size(Pool);
+    if(!Base) {
+        AK_SIM_MEMCPY(Pool->Data, State->Data, SlotSize*State->Header->MaxUsed);
+        return;
+    }
+
+    AK_SIM_MEMCPY(Pool->Data, Base->Data, SlotSize*AK_Sim__Min(Base->Header->MaxUsed, State->Header->MaxUsed));
+    uint32_t i;
+    for(i = 0; i < State->ChangedCount; i++) {
+        AK_SIM_MEMCPY(Pool->Data + State->ChangedIndices[i]*SlotSize, State->Data + i*SlotSize, SlotSize);
+    }
+}
+
+static void AK_Sim__State_Apply(ak_sim_context* Context, const ak_sim__state* State, const ak_sim__state* Base) {
+    AK_Sim__State_Apply_Pool(&Context->BodyPool, &State->Bodies, Base ? &Base->Bodies : NULL);
+    AK_Sim__State_Apply_Pool(&Context->JointPool, &State->Joints, Base ? &Base->Joints : NULL);
+    AK_Sim__State_Apply_Pair_Caches(Context->PairCaches + Context->PairCacheIndex, &State->PairCaches, Base ? &Base->PairCaches : NULL);
+    Context->StepIndex = State->Header->StepIndex;
+    Context->Accumulator = State->Header->Accumulator;
+
+    /*The static bodies and the shapes in use may differ in the snapshot. Cached bounds are dropped 
+      so a restored step builds its fat bounds the same way however the context got here*/
+    Context->StaticTreeDirty = 1;
+    Context->BroadphaseDirty = 1;
+    if(Context->BodyBounds) AK_SIM_MEMSET(Context->BodyBounds, 0, Context->BodyBoundsCapacity*sizeof(ak_sim__body_bounds));
+    AK_Sim__Recount_Shape_Bodies(Context);
+}
+
+AKSIMDEF size_t AK_Sim_Save_State(ak_sim_context* Context, void* Buffer, size_t BufferSize) {
+    if(Context->ClothPool.ItemCount) return 0;
+    ak_sim__state_writer Writer = AK_Sim__State_Begin_Write(Buffer, BufferSize);
+    AK_Sim__State_Write_Header(&Writer, Context, AK_SIM__STATE_KIND_FULL);
+    AK_Sim__State_Write_Pool(&Writer, &Context->BodyPool);
+    AK_Sim__State_Write_Pool(&Writer, &Context->JointPool);
+    AK_Sim__State_Write_Shapes(&Writer, Context);
+    AK_Sim__State_Write_Pair_Caches(&Writer, Context->PairCaches + Context->PairCacheIndex);
+    return AK_Sim__State_End_Write(&Writer);
+}
+
+/*The whole snapshot is checked before anything is applied, so a failed load leaves the context untouched*/
+AKSIMDEF int AK_Sim_Load_State(ak_sim_context* Context, const void* Buffer, size_t BufferSize) {
+    if(Context->ClothPool.ItemCount) return 0;
+    ak_sim__state_reader Reader = AK_Sim__State_Begin_Read(Buffer, BufferSize);
+    ak_sim__state State;
+    if(!AK_Sim__State_Read_Full(&Reader, Context, &State)) return 0;
+    if(!AK_Sim__State_Bodies_Are_Valid(Context, &State.Bodies, NULL, &State.Shapes)) return 0;
+
+    AK_Sim__State_Apply(Context, &State, NULL);
+    return 1;
+}
+
+AKSIMDEF size_t AK_Sim_Save_Delta_State(ak_sim_context* Context, const void* BaseState, size_t BaseStateSize, void* Buffer, size_t BufferSize) {
+    if(Context->ClothPool.ItemCount) return 0;
+    ak_sim__state_reader BaseReader = AK_Sim__State_Begin_Read(BaseState, BaseStateSize);
+    ak_sim__state Base;
+    if(!AK_Sim__State_Read_Full(&BaseReader, Context, &Base)) return 0;
+
+    ak_sim__state_writer Writer = AK_Sim__State_Begin_Write(Buffer, BufferSize);
+    AK_Sim__State_Write_Header(&Writer, Context, AK_SIM__STATE_KIND_DELTA);
+    AK_Sim__State_Write_Pool_Delta(&Writer, &Context->BodyPool, &Base.Bodies);
+    AK_Sim__State_Write_Pool_Delta(&Writer, &Context->JointPool, &Base.Joints);
+    AK_Sim__State_Write_Shapes(&Writer, Context);
+    AK_Sim__State_Write_Pair_Caches_Delta(&Writer, Context, Context->PairCaches + Context->PairCacheIndex, &Base.PairCaches);
+    return AK_Sim__State_End_Write(&Writer);
+}
+
+AKSIMDEF int AK_Sim_Load_Delta_State(ak_sim_context* Context, const void* BaseState, size_t BaseStateSize, const void* Buffer, size_t BufferSize) {
+    if(Context->ClothPool.ItemCount) return 0;
+    ak_sim__state_reader BaseReader = AK_Sim__State_Begin_Read(BaseState, BaseStateSize);
+    ak_sim__state Base;
+    if(!AK_Sim__State_Read_Full(&BaseReader, Context, &Base)) return 0;
+
+    ak_sim__state_reader Reader = AK_Sim__State_Begin_Read(Buffer, BufferSize);
+    ak_sim__state State;
+    if(!AK_Sim__State_Read_Delta(&Reader, Context, &Base, &State)) return 0;
+    if(!AK_Sim__State_Bodies_Are_Valid(Context, &State.Bodies, &Base.Bodies, &State.Shapes)) return 0;
+
+    AK_Sim__State_Apply(Context, &State, &Base);
+    return 1;
+}
+
+#ifdef AK_SIM_DETERMINISTIC
+# if defined(_MSC_VER)
+# pragma float_control(pop)
+# elif defined(__clang__)
+# pragma STDC FP_CONTRACT DEFAULT
+# elif defined(__GNUC__)
+# pragma GCC pop_options
+# else
+# pragma STDC FP_CONTRACT DEFAULT
+# endif
+#endif
+
 #endif
\ No newline at end of file
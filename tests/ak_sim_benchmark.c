@@ -0,0 +1,691 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "../ak_sim.h"
+
+/*Headless benchmark runner. Builds each canonical scene, steps it a fixed number of times and
+  reports ms/step percentiles, peak allocator usage and per phase stats from AK_Sim_Get_Stats.
+  Usage: ak_sim_benchmark [--steps N] [--threads N] [scene...]*/
+
+#define DEFAULT_STEP_COUNT 120
+#define MAX_THREAD_COUNT 64
+
+static double Get_Time_MS() {
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (double)Time.tv_sec*1000.0 + (double)Time.tv_nsec/1000000.0;
+}
+
+typedef struct {
+    pthread_mutex_t Lock; /*Worker arenas can grow from several threads at once*/
+    size_t          CurrentBytes;
+    size_t          PeakBytes;
+    size_t          AllocationCount;
+} tracking_allocator;
+
+/*Every allocation stores its size in front so frees can be tracked*/
+static void* Tracking_Allocate(size_t Size, void* UserData) {
+    tracking_allocator* Tracker = (tracking_allocator*)UserData;
+    size_t* Memory = (size_t*)malloc(Size+16);
+    Memory[0] = Size;
+    pthread_mutex_lock(&Tracker->Lock);
+    Tracker->CurrentBytes += Size;
+    Tracker->AllocationCount++;
+    if(Tracker->CurrentBytes > Tracker->PeakBytes) Tracker->PeakBytes = Tracker->CurrentBytes;
+    pthread_mutex_unlock(&Tracker->Lock);
+    return (uint8_t*)Memory + 16;
+}
+
+static void Tracking_Free(void* Memory, void* UserData) {
+    tracking_allocator* Tracker = (tracking_allocator*)UserData;
+    if(Memory) {
+        size_t* Header = (size_t*)((uint8_t*)Memory - 16);
+        pthread_mutex_lock(&Tracker->Lock);
+        Tracker->CurrentBytes -= Header[0];
+        pthread_mutex_unlock(&Tracker->Lock);
+        free(Header);
+    }
+}
+
+/*Minimal thread pool for the context's ParallelFor. The calling thread is worker 0 and every 
+  worker pulls task indices from a shared counter until they run out*/
+typedef struct thread_pool thread_pool;
+
+typedef struct {
+    thread_pool* Pool;
+    uint32_t     WorkerIndex;
+} thread_pool_worker;
+
+struct thread_pool {
+    pthread_t          Threads[MAX_THREAD_COUNT];
+    thread_pool_worker Workers[MAX_THREAD_COUNT];
+    uint32_t           ThreadCount;
+
+    pthread_mutex_t    Lock;
+    pthread_cond_t     WorkReady;
+    pthread_cond_t     WorkDone;
+    uint64_t           Generation;
+    uint32_t           FinishedCount;
+    int                Quit;
+
+    ak_sim_task_func*  Task;
+    void*              TaskData;
+    uint32_t           TaskCount;
+    uint32_t           NextTask;
+};
+
+static void Thread_Pool_Run_Tasks(thread_pool* Pool, uint32_t WorkerIndex) {
+    for(;;) {
+        uint32_t TaskIndex = __sync_fetch_and_add(&Pool->NextTask, 1);
+        if(TaskIndex >= Pool->TaskCount) break;
+        Pool->Task(TaskIndex, WorkerIndex, Pool->TaskData);
+    }
+}
+
+static void* Thread_Pool_Worker_Thread(void* Parameter) {
+    thread_pool_worker* Worker = (thread_pool_worker*)Parameter;
+    thread_pool* Pool = Worker->Pool;
+    uint64_t Generation = 0;
+    for(;;) {
+        pthread_mutex_lock(&Pool->Lock);
+        while(Pool->Generation == Generation && !Pool->Quit) pthread_cond_wait(&Pool->WorkReady, &Pool->Lock);
+        if(Pool->Quit) {
+            pthread_mutex_unlock(&Pool->Lock);
+            return NULL;
+        }
+        Generation = Pool->Generation;
+        pthread_mutex_unlock(&Pool->Lock);
+
+        Thread_Pool_Run_Tasks(Pool, Worker->WorkerIndex);
+
+        pthread_mutex_lock(&Pool->Lock);
+        Pool->FinishedCount++;
+        pthread_cond_signal(&Pool->WorkDone);
+        pthread_mutex_unlock(&Pool->Lock);
+    }
+}
+
+static void Thread_Pool_Parallel_For(ak_sim_task_func* Task, void* TaskData, uint32_t TaskCount, void* UserData) {
+    thread_pool* Pool = (thread_pool*)UserData;
+    pthread_mutex_lock(&Pool->Lock);
+    Pool->Task = Task;
+    Pool->TaskData = TaskData;
+    Pool->TaskCount = TaskCount;
+    Pool->NextTask = 0;
+    Pool->FinishedCount = 0;
+    Pool->Generation++;
+    pthread_cond_broadcast(&Pool->WorkReady);
+    pthread_mutex_unlock(&Pool->Lock);
+
+    Thread_Pool_Run_Tasks(Pool, 0);
+
+    pthread_mutex_lock(&Pool->Lock);
+    while(Pool->FinishedCount < Pool->ThreadCount-1) pthread_cond_wait(&Pool->WorkDone, &Pool->Lock);
+    pthread_mutex_unlock(&Pool->Lock);
+}
+
+static void Thread_Pool_Init(thread_pool* Pool, uint32_t ThreadCount) {
+    memset(Pool, 0, sizeof(thread_pool));
+    Pool->ThreadCount = ThreadCount;
+    pthread_mutex_init(&Pool->Lock, NULL);
+    pthread_cond_init(&Pool->WorkReady, NULL);
+    pthread_cond_init(&Pool->WorkDone, NULL);
+
+    uint32_t i;
+    for(i = 1; i < ThreadCount; i++) {
+        Pool->Workers[i].Pool = Pool;
+        Pool->Workers[i].WorkerIndex = i;
+        pthread_create(&Pool->Threads[i], NULL, Thread_Pool_Worker_Thread, &Pool->Workers[i]);
+    }
+}
+
+static void Thread_Pool_Delete(thread_pool* Pool) {
+    pthread_mutex_lock(&Pool->Lock);
+    Pool->Quit = 1;
+    pthread_cond_broadcast(&Pool->WorkReady);
+    pthread_mutex_unlock(&Pool->Lock);
+
+    uint32_t i;
+    for(i = 1; i < Pool->ThreadCount; i++) {
+        pthread_join(Pool->Threads[i], NULL);
+    }
+}
+
+static ak_sim_v3 G_BoxVertices[24];
+static ak_sim_face G_BoxFaces[6];
+static ak_sim_plane G_BoxPlanes[6];
+static ak_sim_hull G_BoxHull;
+
+/*Faces are ranges of the vertex array, so each face gets its own four corners, counter clockwise 
+  around its outward normal*/
+static void Init_Box_Hull() {
+    uint32_t i, j;
+    for(i = 0; i < 6; i++) {
+        uint32_t Axis = i/2;
+        float Side = (i & 1) ? -0.5f : 0.5f;
+        uint32_t U = (Axis+1)%3;
+        uint32_t V = (Axis+2)%3;
+        static const float Corners[4][2] = {{-0.5f, -0.5f}, {0.5f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f}};
+        for(j = 0; j < 4; j++) {
+            uint32_t Corner = (i & 1) ? 3-j : j;
+            ak_sim_v3* Vertex = &G_BoxVertices[i*4+j];
+            Vertex->Data[Axis] = Side;
+            Vertex->Data[U] = Corners[Corner][0];
+            Vertex->Data[V] = Corners[Corner][1];
+        }
+
+        G_BoxFaces[i].FirstVtx = i*4;
+        G_BoxFaces[i].VtxCount = 4;
+
+        memset(&G_BoxPlanes[i], 0, sizeof(ak_sim_plane));
+        G_BoxPlanes[i].NormalD.Data[Axis] = (i & 1) ? -1.0f : 1.0f;
+        G_BoxPlanes[i].NormalD.Data[3] = -0.5f;
+    }
+
+    G_BoxHull.Vertices = G_BoxVertices;
+    G_BoxHull.VtxCount = 24;
+    G_BoxHull.Faces = G_BoxFaces;
+    G_BoxHull.Planes = G_BoxPlanes;
+    G_BoxHull.FaceCount = 6;
+}
+
+static ak_sim_shape_id Sphere_Shape(ak_sim_context* Context, float Radius) {
+    ak_sim_shape_info ShapeInfo;
+    memset(&ShapeInfo, 0, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_CONVEX;
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = Radius;
+    return AK_Sim_Create_Shape(Context, &ShapeInfo);
+}
+
+static ak_sim_shape_id Capsule_Shape(ak_sim_context* Context, float Radius, float HalfHeight) {
+    ak_sim_shape_info ShapeInfo;
+    memset(&ShapeInfo, 0, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_CONVEX;
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_CAPSULE;
+    ShapeInfo.Capsule.Radius = Radius;
+    ShapeInfo.Capsule.HalfHeight = HalfHeight;
+    return AK_Sim_Create_Shape(Context, &ShapeInfo);
+}
+
+/*Unit box, sized per body through the scale*/
+static ak_sim_shape_id Box_Shape(ak_sim_context* Context) {
+    ak_sim_shape_info ShapeInfo;
+    memset(&ShapeInfo, 0, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_CONVEX;
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_HULL;
+    ShapeInfo.Hull = &G_BoxHull;
+    return AK_Sim_Create_Shape(Context, &ShapeInfo);
+}
+
+static ak_sim_body_create_info Shape_Body(ak_sim_shape_id Shape, ak_sim_position Position) {
+    ak_sim_body_create_info Result;
+    memset(&Result, 0, sizeof(ak_sim_body_create_info));
+    Result.Shape = Shape;
+    Result.Position = Position;
+    Result.Orientation = AK_Sim_Quat_Identity();
+    Result.Scale = AK_Sim_V3(1.0f, 1.0f, 1.0f);
+    return Result;
+}
+
+static ak_sim_body_create_info Box_Body(ak_sim_shape_id Shape, ak_sim_position Position, ak_sim_v3 Size) {
+    ak_sim_body_create_info Result = Shape_Body(Shape, Position);
+    Result.Scale = Size;
+    return Result;
+}
+
+static float Random_Float(uint32_t* Seed) {
+    *Seed = *Seed*1664525u + 1013904223u;
+    return (float)(*Seed >> 8) / (float)(1 << 24);
+}
+
+static uint32_t Create_Ground(ak_sim_context* Context, ak_sim_shape_id BoxShape) {
+    ak_sim_body_create_info Ground = Box_Body(BoxShape, AK_Sim_Position(0.0f, -0.5f, 0.0f), AK_Sim_V3(400.0f, 1.0f, 400.0f));
+    Ground.Type = AK_SIM_BODY_TYPE_STATIC;
+    AK_Sim_Create_Body(Context, &Ground);
+    return 1;
+}
+
+static uint32_t Scene_Pyramid(ak_sim_context* Context) {
+    ak_sim_shape_id BoxShape = Box_Shape(Context);
+    uint32_t BodyCount = Create_Ground(Context, BoxShape);
+    uint32_t BaseCount = 30;
+    uint32_t Row;
+    for(Row = 0; Row < BaseCount; Row++) {
+        uint32_t Column;
+        uint32_t RowCount = BaseCount-Row;
+        for(Column = 0; Column < RowCount; Column++) {
+            float x = (float)Column - (float)RowCount*0.5f + 0.5f;
+            ak_sim_body_create_info Box = Box_Body(BoxShape, AK_Sim_Position(x*1.05f, 0.5f + (float)Row, 0.0f), AK_Sim_V3(1.0f, 1.0f, 1.0f));
+            AK_Sim_Create_Body(Context, &Box);
+            BodyCount++;
+        }
+    }
+    AK_Sim_Release_Shape(Context, BoxShape);
+    return BodyCount;
+}
+
+static uint32_t Scene_Sphere_Pile(ak_sim_context* Context) {
+    ak_sim_shape_id BoxShape = Box_Shape(Context);
+    ak_sim_shape_id SphereShape = Sphere_Shape(Context, 0.5f);
+    uint32_t BodyCount = Create_Ground(Context, BoxShape);
+    uint32_t Seed = 1;
+    uint32_t i;
+    for(i = 0; i < 10000; i++) {
+        float x = (float)(i % 25) - 12.0f + Random_Float(&Seed)*0.1f;
+        float z = (float)((i / 25) % 25) - 12.0f + Random_Float(&Seed)*0.1f;
+        float y = 1.0f + (float)(i / 625)*1.1f;
+        ak_sim_body_create_info Sphere = Shape_Body(SphereShape, AK_Sim_Position(x, y, z));
+        Sphere.LinearVelocity = AK_Sim_V3(0.0f, -5.0f, 0.0f);
+        AK_Sim_Create_Body(Context, &Sphere);
+        BodyCount++;
+    }
+    AK_Sim_Release_Shape(Context, BoxShape);
+    AK_Sim_Release_Shape(Context, SphereShape);
+    return BodyCount;
+}
+
+#define TERRAIN_SIZE 256
+static ak_sim_v3 G_TerrainVertices[(TERRAIN_SIZE+1)*(TERRAIN_SIZE+1)];
+static uint32_t G_TerrainIndices[TERRAIN_SIZE*TERRAIN_SIZE*6];
+static ak_sim_triangle_mesh G_TerrainMesh;
+
+static uint32_t Create_Terrain_Debris(ak_sim_context* Context) {
+    ak_sim_shape_id SphereShape = Sphere_Shape(Context, 0.3f);
+    ak_sim_shape_id CapsuleShape = Capsule_Shape(Context, 0.2f, 0.4f);
+    ak_sim_shape_id BoxShape = Box_Shape(Context);
+    uint32_t BodyCount = 0;
+    uint32_t Seed = 7;
+    uint32_t i;
+    for(i = 0; i < 2000; i++) {
+        ak_sim_position Position = AK_Sim_Position((Random_Float(&Seed)-0.5f)*TERRAIN_SIZE*0.9f, 3.0f + Random_Float(&Seed)*10.0f,
+                                                   (Random_Float(&Seed)-0.5f)*TERRAIN_SIZE*0.9f);
+        ak_sim_body_create_info Debris;
+        switch(i % 3) {
+            case 0: Debris = Shape_Body(SphereShape, Position); break;
+            case 1: Debris = Shape_Body(CapsuleShape, Position); break;
+            default: Debris = Box_Body(BoxShape, Position, AK_Sim_V3(0.6f, 0.4f, 0.8f)); break;
+        }
+        Debris.LinearVelocity = AK_Sim_V3(0.0f, -4.0f, 0.0f);
+        Debris.AngularVelocity = AK_Sim_V3(Random_Float(&Seed), Random_Float(&Seed), Random_Float(&Seed));
+        AK_Sim_Create_Body(Context, &Debris);
+        BodyCount++;
+    }
+    AK_Sim_Release_Shape(Context, SphereShape);
+    AK_Sim_Release_Shape(Context, CapsuleShape);
+    AK_Sim_Release_Shape(Context, BoxShape);
+    return BodyCount;
+}
+
+/*Debris over a triangle mesh terrain. Convex vs mesh collision is still a stub, so this only 
+  measures the broadphase against the mesh*/
+static uint32_t Scene_Terrain(ak_sim_context* Context) {
+    uint32_t x, z;
+    for(z = 0; z <= TERRAIN_SIZE; z++) {
+        for(x = 0; x <= TERRAIN_SIZE; x++) {
+            float fx = (float)x - TERRAIN_SIZE*0.5f;
+            float fz = (float)z - TERRAIN_SIZE*0.5f;
+            float Height = 2.0f*(float)((x*7 + z*13) % 17)/17.0f;
+            G_TerrainVertices[z*(TERRAIN_SIZE+1)+x] = AK_Sim_V3(fx, Height, fz);
+        }
+    }
+
+    uint32_t* Index = G_TerrainIndices;
+    for(z = 0; z < TERRAIN_SIZE; z++) {
+        for(x = 0; x < TERRAIN_SIZE; x++) {
+            uint32_t i0 = z*(TERRAIN_SIZE+1)+x;
+            uint32_t i1 = i0+1;
+            uint32_t i2 = i0+TERRAIN_SIZE+1;
+            uint32_t i3 = i2+1;
+            *Index++ = i0; *Index++ = i2; *Index++ = i1;
+            *Index++ = i1; *Index++ = i2; *Index++ = i3;
+        }
+    }
+
+    G_TerrainMesh.Vertices = G_TerrainVertices;
+    G_TerrainMesh.VtxCount = (TERRAIN_SIZE+1)*(TERRAIN_SIZE+1);
+    G_TerrainMesh.Indices = G_TerrainIndices;
+    G_TerrainMesh.IdxCount = TERRAIN_SIZE*TERRAIN_SIZE*6;
+
+    ak_sim_shape_info ShapeInfo;
+    memset(&ShapeInfo, 0, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_MESH;
+    ShapeInfo.TriangleMesh = &G_TerrainMesh;
+    ak_sim_shape_id TerrainShape = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    ak_sim_body_create_info Terrain = Shape_Body(TerrainShape, AK_Sim_Position(0.0f, 0.0f, 0.0f));
+    Terrain.Type = AK_SIM_BODY_TYPE_STATIC;
+    AK_Sim_Create_Body(Context, &Terrain);
+    AK_Sim_Release_Shape(Context, TerrainShape);
+    return Create_Terrain_Debris(Context) + 1;
+}
+
+#define TERRAIN_SAMPLE_COUNT (TERRAIN_SIZE+1)
+static uint16_t G_TerrainHeights[TERRAIN_SAMPLE_COUNT*TERRAIN_SAMPLE_COUNT];
+static ak_sim_heightfield G_TerrainHeightfield;
+static void* G_TerrainRanges;
+
+/*The terrain scene with the same heights stored as a heightfield instead of a triangle mesh*/
+static uint32_t Scene_Heightfield(ak_sim_context* Context) {
+    uint32_t x, z;
+    for(z = 0; z < TERRAIN_SAMPLE_COUNT; z++) {
+        for(x = 0; x < TERRAIN_SAMPLE_COUNT; x++) {
+            G_TerrainHeights[z*TERRAIN_SAMPLE_COUNT+x] = (uint16_t)((x*7 + z*13) % 17);
+        }
+    }
+
+    G_TerrainHeightfield.Heights = G_TerrainHeights;
+    G_TerrainHeightfield.SampleCountX = TERRAIN_SAMPLE_COUNT;
+    G_TerrainHeightfield.SampleCountZ = TERRAIN_SAMPLE_COUNT;
+    G_TerrainHeightfield.CellSize = 1.0f;
+    G_TerrainHeightfield.HeightScale = 2.0f/17.0f;
+    G_TerrainHeightfield.HeightOffset = 0.0f;
+
+    size_t RangeSize = AK_Sim_Build_Heightfield_Ranges(&G_TerrainHeightfield, NULL, 0);
+    if(!G_TerrainRanges) G_TerrainRanges = malloc(RangeSize);
+    AK_Sim_Build_Heightfield_Ranges(&G_TerrainHeightfield, G_TerrainRanges, RangeSize);
+
+    ak_sim_shape_info ShapeInfo;
+    memset(&ShapeInfo, 0, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_HEIGHTFIELD;
+    ShapeInfo.Heightfield = &G_TerrainHeightfield;
+    ak_sim_shape_id TerrainShape = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    ak_sim_body_create_info Terrain = Shape_Body(TerrainShape, AK_Sim_Position(-TERRAIN_SIZE*0.5f, 0.0f, -TERRAIN_SIZE*0.5f));
+    Terrain.Type = AK_SIM_BODY_TYPE_STATIC;
+    AK_Sim_Create_Body(Context, &Terrain);
+    AK_Sim_Release_Shape(Context, TerrainShape);
+    return Create_Terrain_Debris(Context) + 1;
+}
+
+typedef enum {
+    RAGDOLL_SHAPE_TORSO,
+    RAGDOLL_SHAPE_HEAD,
+    RAGDOLL_SHAPE_UPPER_ARM,
+    RAGDOLL_SHAPE_LOWER_ARM,
+    RAGDOLL_SHAPE_UPPER_LEG,
+    RAGDOLL_SHAPE_LOWER_LEG,
+    RAGDOLL_SHAPE_COUNT
+} ragdoll_shape;
+
+static void Create_Ragdoll_Shapes(ak_sim_context* Context, ak_sim_shape_id* Shapes) {
+    Shapes[RAGDOLL_SHAPE_TORSO] = Capsule_Shape(Context, 0.2f, 0.25f);
+    Shapes[RAGDOLL_SHAPE_HEAD] = Sphere_Shape(Context, 0.15f);
+    Shapes[RAGDOLL_SHAPE_UPPER_ARM] = Capsule_Shape(Context, 0.07f, 0.15f);
+    Shapes[RAGDOLL_SHAPE_LOWER_ARM] = Capsule_Shape(Context, 0.06f, 0.15f);
+    Shapes[RAGDOLL_SHAPE_UPPER_LEG] = Capsule_Shape(Context, 0.09f, 0.18f);
+    Shapes[RAGDOLL_SHAPE_LOWER_LEG] = Capsule_Shape(Context, 0.08f, 0.18f);
+}
+
+typedef struct {
+    ak_sim_joint_type Type;
+    uint32_t          PartA;
+    uint32_t          PartB;
+    ak_sim_v3         Anchor;
+    ak_sim_v3         Axis;
+} ragdoll_joint;
+
+/*Neck, shoulders and hips are ball joints, elbows and knees are hinges*/
+static const ragdoll_joint G_RagdollJoints[] = {
+    {AK_SIM_JOINT_TYPE_BALL,  0, 1, {{0.0f, 1.72f, 0.0f}},    {{0.0f, 0.0f, 0.0f}}},
+    {AK_SIM_JOINT_TYPE_BALL,  0, 2, {{-0.25f, 1.55f, 0.0f}},  {{0.0f, 0.0f, 0.0f}}},
+    {AK_SIM_JOINT_TYPE_HINGE, 2, 3, {{-0.65f, 1.55f, 0.0f}},  {{0.0f, 0.0f, 1.0f}}},
+    {AK_SIM_JOINT_TYPE_BALL,  0, 4, {{0.25f, 1.55f, 0.0f}},   {{0.0f, 0.0f, 0.0f}}},
+    {AK_SIM_JOINT_TYPE_HINGE, 4, 5, {{0.65f, 1.55f, 0.0f}},   {{0.0f, 0.0f, 1.0f}}},
+    {AK_SIM_JOINT_TYPE_BALL,  0, 6, {{-0.12f, 0.98f, 0.0f}},  {{0.0f, 0.0f, 0.0f}}},
+    {AK_SIM_JOINT_TYPE_HINGE, 6, 7, {{-0.12f, 0.52f, 0.0f}},  {{1.0f, 0.0f, 0.0f}}},
+    {AK_SIM_JOINT_TYPE_BALL,  0, 8, {{0.12f, 0.98f, 0.0f}},   {{0.0f, 0.0f, 0.0f}}},
+    {AK_SIM_JOINT_TYPE_HINGE, 8, 9, {{0.12f, 0.52f, 0.0f}},   {{1.0f, 0.0f, 0.0f}}}
+};
+
+/*Ten bodies shaped like a humanoid: torso, head, upper and lower arms and legs, held together by nine joints*/
+static uint32_t Create_Ragdoll(ak_sim_context* Context, const ak_sim_shape_id* Shapes, ak_sim_v3 Position) {
+    /*Rotate capsules onto the X axis for the arms*/
+    ak_sim_quat Sideways = AK_Sim_Quat(0.0f, 0.0f, 0.70710678f, 0.70710678f);
+
+    ak_sim_body_create_info Parts[10];
+    Parts[0] = Shape_Body(Shapes[RAGDOLL_SHAPE_TORSO], AK_Sim_Position(0.0f, 1.3f, 0.0f));
+    Parts[1] = Shape_Body(Shapes[RAGDOLL_SHAPE_HEAD], AK_Sim_Position(0.0f, 1.85f, 0.0f));
+    Parts[2] = Shape_Body(Shapes[RAGDOLL_SHAPE_UPPER_ARM], AK_Sim_Position(-0.45f, 1.55f, 0.0f));
+    Parts[3] = Shape_Body(Shapes[RAGDOLL_SHAPE_LOWER_ARM], AK_Sim_Position(-0.85f, 1.55f, 0.0f));
+    Parts[4] = Shape_Body(Shapes[RAGDOLL_SHAPE_UPPER_ARM], AK_Sim_Position(0.45f, 1.55f, 0.0f));
+    Parts[5] = Shape_Body(Shapes[RAGDOLL_SHAPE_LOWER_ARM], AK_Sim_Position(0.85f, 1.55f, 0.0f));
+    Parts[6] = Shape_Body(Shapes[RAGDOLL_SHAPE_UPPER_LEG], AK_Sim_Position(-0.12f, 0.75f, 0.0f));
+    Parts[7] = Shape_Body(Shapes[RAGDOLL_SHAPE_LOWER_LEG], AK_Sim_Position(-0.12f, 0.3f, 0.0f));
+    Parts[8] = Shape_Body(Shapes[RAGDOLL_SHAPE_UPPER_LEG], AK_Sim_Position(0.12f, 0.75f, 0.0f));
+    Parts[9] = Shape_Body(Shapes[RAGDOLL_SHAPE_LOWER_LEG], AK_Sim_Position(0.12f, 0.3f, 0.0f));
+
+    uint32_t i;
+    for(i = 2; i < 6; i++) Parts[i].Orientation = Sideways;
+
+    ak_sim_body_id PartIDs[10];
+    for(i = 0; i < 10; i++) {
+        ak_sim_position Local = Parts[i].Position;
+        Parts[i].Position = AK_Sim_Position(Local.Data[0]+Position.Data[0], Local.Data[1]+Position.Data[1], Local.Data[2]+Position.Data[2]);
+        Parts[i].LinearVelocity = AK_Sim_V3(0.0f, -3.0f, 0.0f);
+        PartIDs[i] = AK_Sim_Create_Body(Context, &Parts[i]);
+    }
+
+    for(i = 0; i < sizeof(G_RagdollJoints)/sizeof(G_RagdollJoints[0]); i++) {
+        const ragdoll_joint* RagdollJoint = G_RagdollJoints + i;
+        ak_sim_v3 Anchor = RagdollJoint->Anchor;
+        ak_sim_joint_create_info Joint;
+        memset(&Joint, 0, sizeof(ak_sim_joint_create_info));
+        Joint.Type = RagdollJoint->Type;
+        Joint.BodyA = PartIDs[RagdollJoint->PartA];
+        Joint.BodyB = PartIDs[RagdollJoint->PartB];
+        Joint.AnchorA = AK_Sim_Position(Anchor.Data[0]+Position.Data[0], Anchor.Data[1]+Position.Data[1], Anchor.Data[2]+Position.Data[2]);
+        Joint.Axis = RagdollJoint->Axis;
+        AK_Sim_Create_Joint(Context, &Joint);
+    }
+    return 10;
+}
+
+static uint32_t Scene_Ragdoll_Pile(ak_sim_context* Context) {
+    ak_sim_shape_id BoxShape = Box_Shape(Context);
+    ak_sim_shape_id RagdollShapes[RAGDOLL_SHAPE_COUNT];
+    Create_Ragdoll_Shapes(Context, RagdollShapes);
+
+    uint32_t BodyCount = Create_Ground(Context, BoxShape);
+    uint32_t i;
+    for(i = 0; i < 200; i++) {
+        float x = (float)(i % 5)*2.0f - 4.0f;
+        float z = (float)((i / 5) % 5)*1.0f - 2.0f;
+        float y = (float)(i / 25)*2.2f + 0.5f;
+        BodyCount += Create_Ragdoll(Context, RagdollShapes, AK_Sim_V3(x, y, z));
+    }
+
+    AK_Sim_Release_Shape(Context, BoxShape);
+    for(i = 0; i < RAGDOLL_SHAPE_COUNT; i++) AK_Sim_Release_Shape(Context, RagdollShapes[i]);
+    return BodyCount;
+}
+
+/*Groups of bodies spread over a square kilometer, like players scattered over a large map. Most 
+  groups sit inside one broadphase region so the regions can be stepped in parallel*/
+static uint32_t Scene_Open_World(ak_sim_context* Context) {
+    ak_sim_shape_id BoxShape = Box_Shape(Context);
+    ak_sim_shape_id CapsuleShape = Capsule_Shape(Context, 0.4f, 0.5f);
+    ak_sim_body_create_info Ground = Box_Body(BoxShape, AK_Sim_Position(0.0f, -0.5f, 0.0f), AK_Sim_V3(1024.0f, 1.0f, 1024.0f));
+    Ground.Type = AK_SIM_BODY_TYPE_STATIC;
+    AK_Sim_Create_Body(Context, &Ground);
+
+    uint32_t BodyCount = 1;
+    uint32_t Seed = 11;
+    uint32_t Group;
+    for(Group = 0; Group < 256; Group++) {
+        float GroupX = (float)(Group % 16)*64.0f - 480.0f;
+        float GroupZ = (float)(Group / 16)*64.0f - 480.0f;
+        uint32_t i;
+        for(i = 0; i < 32; i++) {
+            ak_sim_position Position = AK_Sim_Position(GroupX + (Random_Float(&Seed)-0.5f)*24.0f, 0.9f + Random_Float(&Seed)*4.0f, 
+                                                       GroupZ + (Random_Float(&Seed)-0.5f)*24.0f);
+            ak_sim_body_create_info Body = (i & 1) ? Shape_Body(CapsuleShape, Position) : Box_Body(BoxShape, Position, AK_Sim_V3(1.0f, 1.0f, 1.0f));
+            Body.LinearVelocity = AK_Sim_V3((Random_Float(&Seed)-0.5f)*4.0f, -2.0f, (Random_Float(&Seed)-0.5f)*4.0f);
+            AK_Sim_Create_Body(Context, &Body);
+            BodyCount++;
+        }
+    }
+
+    AK_Sim_Release_Shape(Context, BoxShape);
+    AK_Sim_Release_Shape(Context, CapsuleShape);
+    return BodyCount;
+}
+
+/*A large world of resting bodies. Nothing moves, so once the islands fall asleep this measures the 
+  fixed per body cost of a step*/
+static uint32_t Scene_Sleeping_World(ak_sim_context* Context) {
+    ak_sim_shape_id BoxShape = Box_Shape(Context);
+    uint32_t BodyCount = Create_Ground(Context, BoxShape);
+    uint32_t i;
+    for(i = 0; i < 10000; i++) {
+        float x = (float)(i % 100)*3.0f - 150.0f;
+        float z = (float)(i / 100)*3.0f - 150.0f;
+        ak_sim_body_create_info Box = Box_Body(BoxShape, AK_Sim_Position(x, 0.5f, z), AK_Sim_V3(1.0f, 1.0f, 1.0f));
+        AK_Sim_Create_Body(Context, &Box);
+        BodyCount++;
+    }
+    AK_Sim_Release_Shape(Context, BoxShape);
+    return BodyCount;
+}
+
+typedef uint32_t scene_create_func(ak_sim_context* Context);
+
+typedef struct {
+    const char*        Name;
+    scene_create_func* Create;
+} scene;
+
+static scene G_Scenes[] = {
+    {"pyramid", Scene_Pyramid},
+    {"sphere_pile", Scene_Sphere_Pile},
+    {"terrain", Scene_Terrain},
+    {"heightfield", Scene_Heightfield},
+    {"ragdoll_pile", Scene_Ragdoll_Pile},
+    {"open_world", Scene_Open_World},
+    {"sleeping_world", Scene_Sleeping_World}
+};
+
+static int Compare_Double(const void* A, const void* B) {
+    double a = *(const double*)A;
+    double b = *(const double*)B;
+    return (a > b) - (a < b);
+}
+
+static double Percentile(const double* Sorted, uint32_t Count, double P) {
+    uint32_t Index = (uint32_t)(P*(double)(Count-1) + 0.5);
+    return Sorted[Index];
+}
+
+static void Run_Scene(const scene* Scene, uint32_t StepCount, thread_pool* ThreadPool) {
+    tracking_allocator Tracker;
+    memset(&Tracker, 0, sizeof(tracking_allocator));
+    pthread_mutex_init(&Tracker.Lock, NULL);
+
+    ak_sim_create_info CreateInfo;
+    memset(&CreateInfo, 0, sizeof(ak_sim_create_info));
+    CreateInfo.Allocator.AllocateMemory = Tracking_Allocate;
+    CreateInfo.Allocator.FreeMemory = Tracking_Free;
+    CreateInfo.Allocator.UserData = &Tracker;
+    if(ThreadPool->ThreadCount > 1) {
+        CreateInfo.ParallelFor = Thread_Pool_Parallel_For;
+        CreateInfo.ParallelForUserData = ThreadPool;
+        CreateInfo.WorkerCount = ThreadPool->ThreadCount;
+    }
+
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+    uint32_t BodyCount = Scene->Create(Context);
+
+    double* StepTimes = (double*)malloc(sizeof(double)*StepCount);
+    double PhaseTotals[AK_SIM_PROFILE_PHASE_COUNT] = {0};
+    double PairsFound = 0.0;
+    double BatchedPairs = 0.0;
+    ak_sim_stats Stats;
+
+    size_t AllocationsBeforeStep = Tracker.AllocationCount;
+    uint32_t i;
+    for(i = 0; i < StepCount; i++) {
+        double Start = Get_Time_MS();
+        AK_Sim_Step(Context);
+        StepTimes[i] = Get_Time_MS()-Start;
+
+        AK_Sim_Get_Stats(Context, &Stats);
+        uint32_t Phase;
+        for(Phase = 0; Phase < AK_SIM_PROFILE_PHASE_COUNT; Phase++) {
+            PhaseTotals[Phase] += (double)Stats.PhaseTimeNS[Phase]/1000000.0;
+        }
+        PairsFound += Stats.PairsFound;
+        BatchedPairs += Stats.BatchedPairs;
+    }
+    size_t StepAllocations = Tracker.AllocationCount-AllocationsBeforeStep;
+
+    double Total = 0.0;
+    for(i = 0; i < StepCount; i++) Total += StepTimes[i];
+    qsort(StepTimes, StepCount, sizeof(double), Compare_Double);
+
+    printf("%-16s %7u %8.3f %8.3f %8.3f %8.3f %8.3f %10zu %10zu %8.3f %8.3f %8.3f %10.0f %10.0f %8u\n", Scene->Name, BodyCount,
+           Total/StepCount, Percentile(StepTimes, StepCount, 0.5), Percentile(StepTimes, StepCount, 0.9),
+           Percentile(StepTimes, StepCount, 0.99), StepTimes[StepCount-1], Tracker.PeakBytes/1024, StepAllocations,
+           PhaseTotals[AK_SIM_PROFILE_PHASE_BROADPHASE]/StepCount, PhaseTotals[AK_SIM_PROFILE_PHASE_NARROWPHASE]/StepCount,
+           PhaseTotals[AK_SIM_PROFILE_PHASE_SOLVER]/StepCount, PairsFound/StepCount, BatchedPairs/StepCount, Stats.SleepingBodyCount);
+    fflush(stdout);
+
+    free(StepTimes);
+    AK_Sim_Delete_Context(Context);
+    pthread_mutex_destroy(&Tracker.Lock);
+}
+
+int main(int ArgCount, char** Args) {
+    uint32_t StepCount = DEFAULT_STEP_COUNT;
+    uint32_t ThreadCount = 1;
+    const char* Filters[64];
+    uint32_t FilterCount = 0;
+
+    int i;
+    for(i = 1; i < ArgCount; i++) {
+        if(strcmp(Args[i], "--steps") == 0 && i+1 < ArgCount) {
+            StepCount = (uint32_t)atoi(Args[++i]);
+        } else if(strcmp(Args[i], "--threads") == 0 && i+1 < ArgCount) {
+            ThreadCount = (uint32_t)atoi(Args[++i]);
+        } else if(FilterCount < 64) {
+            Filters[FilterCount++] = Args[i];
+        }
+    }
+
+    if(!StepCount) StepCount = 1;
+    if(!ThreadCount) ThreadCount = 1;
+    if(ThreadCount > MAX_THREAD_COUNT) ThreadCount = MAX_THREAD_COUNT;
+    Init_Box_Hull();
+
+    thread_pool ThreadPool;
+    Thread_Pool_Init(&ThreadPool, ThreadCount);
+
+    printf("bodies have no gravity and contacts have no solver yet, so piles and pyramids drift at their start velocities instead of settling\n");
+    printf("terrain is a triangle mesh, and convex vs mesh collision is still a stub, so its np ms times no real collision. "
+           "heightfield has the same heights with real collision\n");
+    printf("joint ms is the solver phase, which only solves joints since contacts have no solver yet\n");
+    printf("batched is the pair tests per step run through the batch kernels, summed over the substeps\n");
+    printf("asleep is the number of sleeping bodies after the last step\n");
+    printf("%-16s %7s %8s %8s %8s %8s %8s %10s %10s %8s %8s %8s %10s %10s %8s\n", "scene", "bodies", "mean ms", "p50", "p90", "p99", "max",
+           "peak KB", "step allocs", "bp ms", "np ms", "joint ms", "pairs", "batched", "asleep");
+
+    uint32_t SceneIndex;
+    for(SceneIndex = 0; SceneIndex < sizeof(G_Scenes)/sizeof(G_Scenes[0]); SceneIndex++) {
+        const scene* Scene = G_Scenes + SceneIndex;
+        int Run = FilterCount == 0;
+        uint32_t j;
+        for(j = 0; j < FilterCount; j++) {
+            if(strcmp(Filters[j], Scene->Name) == 0) Run = 1;
+        }
+
+        if(Run) Run_Scene(Scene, StepCount, &ThreadPool);
+    }
+
+    Thread_Pool_Delete(&ThreadPool);
+    return 0;
+}
+
+#define AK_SIM_IMPLEMENTATION
+#include "../ak_sim.h"
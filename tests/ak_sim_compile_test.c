@@ -3,16 +3,1269 @@
 void Memory_Clear(void* Data, size_t DataSize) {
     uint8_t* DataAt = (uint8_t*)Data;
     while(DataSize--) {
-        *DataAt = 0;
+        *DataAt++ = 0;
     } 
 }
 
+static int Test_GJK_Distances(void);
+static int Test_Fixed_Steps(void);
+static int Test_Hull_Adjacency(void);
+static int Test_State_Round_Trip(void);
+static int Test_Sleeping(void);
+static int Test_Contact_Events(void);
+static int Test_Raycast(void);
+static int Test_User_Convex(void);
+static int Test_Raycast_Shapes(void);
+static int Test_Broadphase_Updates(void);
+static int Test_Budget_Allocations(void);
+static int Test_Character_Slopes(void);
+static int Test_Parallel_Determinism(void);
+static int Test_Stats_And_Trace(void);
+static int Test_Batch_Kernels(void);
+#ifdef AK_SIM_DOUBLE_PRECISION
+static int Test_Far_From_Origin(void);
+#endif
+
 int main() {
     ak_sim_create_info CreateInfo;
     Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
     ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
     AK_Sim_Delete_Context(Context);
+
+    if(!Test_GJK_Distances()) return 1;
+    if(!Test_Fixed_Steps()) return 1;
+    if(!Test_Hull_Adjacency()) return 1;
+    if(!Test_State_Round_Trip()) return 1;
+    if(!Test_Sleeping()) return 1;
+    if(!Test_Contact_Events()) return 1;
+    if(!Test_Raycast()) return 1;
+    if(!Test_User_Convex()) return 1;
+    if(!Test_Raycast_Shapes()) return 1;
+    if(!Test_Broadphase_Updates()) return 1;
+    if(!Test_Budget_Allocations()) return 1;
+    if(!Test_Character_Slopes()) return 1;
+    if(!Test_Parallel_Determinism()) return 1;
+    if(!Test_Stats_And_Trace()) return 1;
+    if(!Test_Batch_Kernels()) return 1;
+#ifdef AK_SIM_DOUBLE_PRECISION
+    if(!Test_Far_From_Origin()) return 1;
+#endif
+    return 0;
 }
 
 #define AK_SIM_IMPLEMENTATION
-#include "../ak_sim.h"
\ No newline at end of file
+#include "../ak_sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static ak_sim_v3 G_Box_Vertices[8];
+static ak_sim_plane G_Box_Planes[6];
+static ak_sim_hull G_Box_Hull;
+
+static ak_sim_convex Test_Box_Convex(void) {
+    uint32_t i;
+    for(i = 0; i < 8; i++) {
+        G_Box_Vertices[i] = AK_Sim_V3((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+    }
+    for(i = 0; i < 6; i++) {
+        Memory_Clear(&G_Box_Planes[i], sizeof(ak_sim_plane));
+        G_Box_Planes[i].NormalD.Data[i/2] = (i & 1) ? -1.0f : 1.0f;
+        G_Box_Planes[i].NormalD.Data[3] = -0.5f;
+    }
+    Memory_Clear(&G_Box_Hull, sizeof(ak_sim_hull));
+    G_Box_Hull.Vertices = G_Box_Vertices;
+    G_Box_Hull.VtxCount = 8;
+    G_Box_Hull.Planes = G_Box_Planes;
+    G_Box_Hull.FaceCount = 6;
+
+    ak_sim_convex Result;
+    Memory_Clear(&Result, sizeof(ak_sim_convex));
+    Result.Type = AK_SIM_CONVEX_TYPE_HULL;
+    Result.Internal.Hull.Hull = &G_Box_Hull;
+    return Result;
+}
+
+/*Rotation about Z by Angle placing the local point P at Origin + R*P*/
+static ak_sim_m4x3 Test_Transform(float Angle, ak_sim_v3 Origin, ak_sim_v3 P) {
+    float c = (float)cos(Angle);
+    float s = (float)sin(Angle);
+    ak_sim_m4x3 Result;
+    Result.Cols[0] = AK_Sim_V3(c, s, 0.0f);
+    Result.Cols[1] = AK_Sim_V3(-s, c, 0.0f);
+    Result.Cols[2] = AK_Sim_V3(0.0f, 0.0f, 1.0f);
+    Result.Cols[3] = AK_Sim__V3_Add(Origin, AK_Sim__M4x3_Mul_V3(&Result, P));
+    return Result;
+}
+
+/*A unit box and a sphere held above the top face of a thin rotated plate, so the core distance is 
+  known exactly. Plate faces parallel to the box's bring up triangle and tetrahedron regions that 
+  aren't prefixes of the simplex*/
+static int Test_GJK_Distances(void) {
+    static const float Angles[] = {0.0f, 0.3f, -0.5236f, 1.0472f};
+    static const float Offsets[] = {0.0f, 0.05f, -1.7f, 4.2f};
+    static const float Gaps[] = {0.31f, 0.05f, 1.0f};
+    ak_sim_v3 Origin = AK_Sim_V3(-17.45f, -1.31f, 13.0f);
+    ak_sim_v3 PlateScale = AK_Sim_V3(12.0f, 0.2f, 4.0f);
+
+    ak_sim_convex Box = Test_Box_Convex();
+    ak_sim_convex Sphere;
+    Memory_Clear(&Sphere, sizeof(ak_sim_convex));
+    Sphere.Type = AK_SIM_CONVEX_TYPE_SPHERE;
+    Sphere.Internal.Sphere.Radius = 0.25f;
+
+    int Result = 1;
+    uint32_t a, o, g;
+    for(a = 0; a < sizeof(Angles)/sizeof(Angles[0]); a++) {
+        for(o = 0; o < sizeof(Offsets)/sizeof(Offsets[0]); o++) {
+            for(g = 0; g < sizeof(Gaps)/sizeof(Gaps[0]); g++) {
+                ak_sim_m4x3 PlateTransform = Test_Transform(Angles[a], Origin, AK_Sim_V3(0.0f, 0.0f, 0.0f));
+                ak_sim_m4x3 BoxTransform = Test_Transform(Angles[a], Origin, AK_Sim_V3(Offsets[o], 0.6f+Gaps[g], 0.3f));
+                ak_sim_m4x3 SphereTransform = Test_Transform(Angles[a], Origin, AK_Sim_V3(Offsets[o], 0.1f+Gaps[g], -1.0f));
+
+                ak_sim__convex_proxy Plate, BoxProxy, SphereProxy;
+                AK_Sim__Convex_Proxy_Init(&Plate, &Box, &PlateTransform, PlateScale);
+                AK_Sim__Convex_Proxy_Init(&BoxProxy, &Box, &BoxTransform, AK_Sim_V3(1.0f, 1.0f, 1.0f));
+                AK_Sim__Convex_Proxy_Init(&SphereProxy, &Sphere, &SphereTransform, AK_Sim_V3(1.0f, 1.0f, 1.0f));
+
+                ak_sim__pair_cache Cache;
+                Memory_Clear(&Cache, sizeof(ak_sim__pair_cache));
+                ak_sim__gjk_result BoxBox = AK_Sim__GJK(&BoxProxy, &Plate, &Cache);
+                Memory_Clear(&Cache, sizeof(ak_sim__pair_cache));
+                ak_sim__gjk_result SphereHull = AK_Sim__GJK(&SphereProxy, &Plate, &Cache);
+
+                if(AK_Sim__Abs(BoxBox.Distance - Gaps[g]) > 1e-3f || AK_Sim__Abs(SphereHull.Distance - Gaps[g]) > 1e-3f) {
+                    printf("GJK distance mismatch: angle %g offset %g gap %g box %g sphere %g\n", Angles[a], Offsets[o], Gaps[g], 
+                           BoxBox.Distance, SphereHull.Distance);
+                    Result = 0;
+                }
+            }
+        }
+    }
+    return Result;
+}
+
+/*Updates take a step for every whole fixed step accumulated and keep the rest for the render 
+  interpolation. Past the step cap the whole steps are dropped and the partial step is kept*/
+static int Test_Fixed_Steps(void) {
+    float Step = 0.02f;
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    CreateInfo.FixedTimeStep = Step;
+    CreateInfo.MaxStepsPerUpdate = 3;
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    uint32_t StepCounts[4];
+    float Alphas[4];
+    StepCounts[0] = AK_Sim_Update(Context, Step*0.5f);
+    Alphas[0] = AK_Sim_Get_Interpolation_Alpha(Context);
+    StepCounts[1] = AK_Sim_Update(Context, Step*0.75f);
+    Alphas[1] = AK_Sim_Get_Interpolation_Alpha(Context);
+    StepCounts[2] = AK_Sim_Update(Context, Step*10.5f);
+    Alphas[2] = AK_Sim_Get_Interpolation_Alpha(Context);
+    StepCounts[3] = AK_Sim_Update(Context, 1.0e9f);
+    Alphas[3] = AK_Sim_Get_Interpolation_Alpha(Context);
+    uint64_t StepIndex = AK_Sim_Get_Step_Index(Context);
+    AK_Sim_Delete_Context(Context);
+
+    uint32_t ExpectedCounts[4] = {0, 1, 3, 3};
+    float ExpectedAlphas[4] = {0.5f, 0.25f, 0.75f, -1.0f};
+    int Result = StepIndex == 7;
+    uint32_t i;
+    for(i = 0; i < 4; i++) {
+        if(StepCounts[i] != ExpectedCounts[i] || Alphas[i] < 0.0f || Alphas[i] >= 1.0f) Result = 0;
+        if(ExpectedAlphas[i] >= 0.0f && AK_Sim__Abs(Alphas[i] - ExpectedAlphas[i]) > 1e-3f) Result = 0;
+    }
+    if(!Result) {
+        printf("Fixed steps failed: steps %u %u %u %u alphas %g %g %g %g step index %u\n", StepCounts[0], StepCounts[1], StepCounts[2], 
+               StepCounts[3], Alphas[0], Alphas[1], Alphas[2], Alphas[3], (uint32_t)StepIndex);
+    }
+    return Result;
+}
+
+#define TEST_SPHERE_RINGS 12
+#define TEST_SPHERE_SEGMENTS 24
+#define TEST_SPHERE_FACE_COUNT (TEST_SPHERE_RINGS*TEST_SPHERE_SEGMENTS)
+
+/*Pole caps of triangles and bands of quads between rings. Faces are ranges of the vertex array, 
+  so every face gets its own copy of its corners*/
+static ak_sim_v3 G_Sphere_Vertices[TEST_SPHERE_FACE_COUNT*4];
+static ak_sim_face G_Sphere_Faces[TEST_SPHERE_FACE_COUNT];
+static ak_sim_plane G_Sphere_Planes[TEST_SPHERE_FACE_COUNT];
+
+static ak_sim_v3 Test_Sphere_Point(uint32_t Ring, uint32_t Segment) {
+    if(Ring == 0 || Ring == TEST_SPHERE_RINGS) return AK_Sim_V3(0.0f, Ring ? -1.0f : 1.0f, 0.0f);
+    float Theta = AK_SIM__PI*(float)Ring/(float)TEST_SPHERE_RINGS;
+    float Phi = 2.0f*AK_SIM__PI*(float)(Segment % TEST_SPHERE_SEGMENTS)/(float)TEST_SPHERE_SEGMENTS;
+    return AK_Sim_V3((float)(sin(Theta)*cos(Phi)), (float)cos(Theta), (float)(sin(Theta)*sin(Phi)));
+}
+
+static ak_sim_hull Test_Sphere_Hull(void) {
+    uint32_t VtxCount = 0;
+    uint32_t Ring, Segment, i;
+    for(Ring = 0; Ring < TEST_SPHERE_RINGS; Ring++) {
+        for(Segment = 0; Segment < TEST_SPHERE_SEGMENTS; Segment++) {
+            ak_sim_face* Face = G_Sphere_Faces + Ring*TEST_SPHERE_SEGMENTS + Segment;
+            Face->FirstVtx = VtxCount;
+            if(Ring) G_Sphere_Vertices[VtxCount++] = Test_Sphere_Point(Ring, Segment);
+            G_Sphere_Vertices[VtxCount++] = Test_Sphere_Point(Ring+1, Segment);
+            if(Ring < TEST_SPHERE_RINGS-1) G_Sphere_Vertices[VtxCount++] = Test_Sphere_Point(Ring+1, Segment+1);
+            G_Sphere_Vertices[VtxCount++] = Test_Sphere_Point(Ring, Segment+1);
+            Face->VtxCount = VtxCount - Face->FirstVtx;
+
+            ak_sim_v3* Corners = G_Sphere_Vertices + Face->FirstVtx;
+            ak_sim_v3 Normal = AK_Sim__V3_Normalize(AK_Sim__V3_Cross(AK_Sim__V3_Sub(Corners[1], Corners[0]), AK_Sim__V3_Sub(Corners[2], Corners[0])));
+            if(AK_Sim__V3_Dot(Normal, Corners[0]) < 0.0f) Normal = AK_Sim__V3_Mul_S(Normal, -1.0f);
+            for(i = 0; i < 3; i++) G_Sphere_Planes[Face - G_Sphere_Faces].NormalD.Data[i] = Normal.Data[i];
+            G_Sphere_Planes[Face - G_Sphere_Faces].NormalD.Data[3] = -AK_Sim__V3_Dot(Normal, Corners[0]);
+        }
+    }
+
+    ak_sim_hull Hull;
+    Memory_Clear(&Hull, sizeof(ak_sim_hull));
+    Hull.Vertices = G_Sphere_Vertices;
+    Hull.VtxCount = VtxCount;
+    Hull.Faces = G_Sphere_Faces;
+    Hull.Planes = G_Sphere_Planes;
+    Hull.FaceCount = TEST_SPHERE_FACE_COUNT;
+    return Hull;
+}
+
+/*Adjacency built from the face loops of a sphere whose faces each copy their corners. Hill 
+  climbing from any vertex, including copies, must find the same support as scanning every vertex*/
+static int Test_Hull_Adjacency(void) {
+    ak_sim_hull Hull = Test_Sphere_Hull();
+    size_t Size = AK_Sim_Build_Hull_Adjacency(&Hull, NULL, 0);
+    void* Buffer = malloc(Size);
+    int Result = Size && AK_Sim_Build_Hull_Adjacency(&Hull, Buffer, Size) == Size && Hull.AdjacencyOffsets;
+
+    uint32_t Seed = 1;
+    uint32_t i, j;
+    for(i = 0; i < 500 && Result; i++) {
+        ak_sim_v3 Direction;
+        for(j = 0; j < 3; j++) {
+            Seed = Seed*1664525 + 1013904223;
+            Direction.Data[j] = (float)(Seed >> 8)/(float)(1 << 24) - 0.5f;
+        }
+        uint32_t Best = 0;
+        for(j = 1; j < Hull.VtxCount; j++) {
+            if(AK_Sim__V3_Dot(Hull.Vertices[j], Direction) > AK_Sim__V3_Dot(Hull.Vertices[Best], Direction)) Best = j;
+        }
+        uint32_t Climbed = AK_Sim__Support_Index_Hill_Climb(Hull.Vertices, Hull.AdjacencyOffsets, Hull.AdjacentVertices, Direction, 
+                                                            (i*97) % Hull.VtxCount);
+        if(AK_Sim__V3_Dot(Hull.Vertices[Climbed], Direction) < AK_Sim__V3_Dot(Hull.Vertices[Best], Direction)) {
+            printf("Hull adjacency failed: direction %u climbed to %u instead of %u\n", i, Climbed, Best);
+            Result = 0;
+        }
+    }
+
+    free(Buffer);
+    if(!Size) printf("Hull adjacency failed: nothing built\n");
+    return Result;
+}
+
+static ak_sim_shape_id Test_Create_Box_Shape(ak_sim_context* Context) {
+    Test_Box_Convex();
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_HULL;
+    ShapeInfo.Hull = &G_Box_Hull;
+    return AK_Sim_Create_Shape(Context, &ShapeInfo);
+}
+
+static ak_sim_body_id Test_Create_Body(ak_sim_context* Context, ak_sim_shape_id Shape, ak_sim_body_type Type, ak_sim_position Position, 
+                                       ak_sim_v3 Scale, ak_sim_v3 Velocity) {
+    ak_sim_body_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_body_create_info));
+    CreateInfo.Shape = Shape;
+    CreateInfo.Type = Type;
+    CreateInfo.Position = Position;
+    CreateInfo.Orientation = AK_Sim_Quat_Identity();
+    CreateInfo.Scale = Scale;
+    CreateInfo.LinearVelocity = Velocity;
+    CreateInfo.AngularVelocity = AK_Sim_V3(0.0f, Velocity.Data[0], 0.3f);
+    return AK_Sim_Create_Body(Context, &CreateInfo);
+}
+
+/*Boxes thrown at each other over a floor. Stepping on from a loaded snapshot, full or delta, must 
+  reach the same state hash as stepping on from where it was saved. Snapshots fail while cloth exists*/
+static int Test_State_Round_Trip(void) {
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+    Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(0.0, -0.5, 0.0), AK_Sim_V3(50.0f, 1.0f, 50.0f), AK_Sim_V3(0.0f, 0.0f, 0.0f));
+    uint32_t i;
+    for(i = 0; i < 40; i++) {
+        ak_sim_v3 Velocity = AK_Sim_V3((float)(i%3)-1.0f, -0.5f, (float)(i%5)*0.3f-0.6f);
+        Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position((i%8)*1.2, 0.6+(i/8)*1.1, 0.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), Velocity);
+    }
+
+    for(i = 0; i < 31; i++) AK_Sim_Update(Context, 1.0f/60.0f*0.45f);
+
+    static uint8_t BaseState[1 << 16];
+    static uint8_t DeltaState[1 << 16];
+    size_t BaseSize = AK_Sim_Save_State(Context, BaseState, sizeof(BaseState));
+    for(i = 0; i < 10; i++) AK_Sim_Update(Context, 1.0f/60.0f*1.25f);
+    size_t DeltaSize = AK_Sim_Save_Delta_State(Context, BaseState, BaseSize, DeltaState, sizeof(DeltaState));
+    for(i = 0; i < 20; i++) AK_Sim_Update(Context, 1.0f/60.0f*0.7f);
+    uint64_t Hash = AK_Sim_Get_State_Hash(Context);
+
+    int Result = BaseSize && DeltaSize && AK_Sim_Load_State(Context, BaseState, BaseSize);
+    for(i = 0; i < 10; i++) AK_Sim_Update(Context, 1.0f/60.0f*1.25f);
+    for(i = 0; i < 20; i++) AK_Sim_Update(Context, 1.0f/60.0f*0.7f);
+    int FullMatches = Result && AK_Sim_Get_State_Hash(Context) == Hash;
+
+    Result = Result && AK_Sim_Load_Delta_State(Context, BaseState, BaseSize, DeltaState, DeltaSize);
+    for(i = 0; i < 20; i++) AK_Sim_Update(Context, 1.0f/60.0f*0.7f);
+    int DeltaMatches = Result && AK_Sim_Get_State_Hash(Context) == Hash;
+
+    /*Cloth isn't stored, so snapshots refuse to save or load while it exists*/
+    ak_sim_position RopePositions[2];
+    uint32_t RopeEdge[2] = {0, 1};
+    RopePositions[0] = AK_Sim_Position(0.0, 5.0, 0.0);
+    RopePositions[1] = AK_Sim_Position(0.0, 4.0, 0.0);
+    ak_sim_cloth_create_info ClothInfo;
+    Memory_Clear(&ClothInfo, sizeof(ak_sim_cloth_create_info));
+    ClothInfo.Positions = RopePositions;
+    ClothInfo.ParticleCount = 2;
+    ClothInfo.Edges = RopeEdge;
+    ClothInfo.EdgeCount = 1;
+    ak_sim_cloth_id ClothID = AK_Sim_Create_Cloth(Context, &ClothInfo);
+    Hash = AK_Sim_Get_State_Hash(Context);
+    int ClothRefused = !AK_Sim_Save_State(Context, NULL, 0) && 
+                       !AK_Sim_Save_Delta_State(Context, BaseState, BaseSize, NULL, 0) && 
+                       !AK_Sim_Load_State(Context, BaseState, BaseSize) && 
+                       !AK_Sim_Load_Delta_State(Context, BaseState, BaseSize, DeltaState, DeltaSize) && 
+                       AK_Sim_Get_State_Hash(Context) == Hash;
+    AK_Sim_Delete_Cloth(Context, ClothID);
+    ClothRefused = ClothRefused && AK_Sim_Save_State(Context, NULL, 0);
+
+    AK_Sim_Delete_Context(Context);
+    if(!FullMatches || !DeltaMatches || !ClothRefused) {
+        printf("State round trip mismatch: full %d delta %d cloth refused %d\n", FullMatches, DeltaMatches, ClothRefused);
+        return 0;
+    }
+    return 1;
+}
+
+/*A ball resting on the floor falls asleep without ending its floor contact, and a ball rolling 
+  into it wakes it up again*/
+static int Test_Sleeping(void) {
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(0.0, -0.5, 0.0), AK_Sim_V3(50.0f, 1.0f, 50.0f), Zero);
+    ak_sim_body_id RestingID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(0.0, 0.49, 0.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), Zero);
+    AK_Sim_Get_Body(Context, RestingID)->AngularVelocity = Zero;
+
+    uint32_t ContactEndCount = 0;
+    uint32_t i;
+    for(i = 0; i < 60; i++) {
+        AK_Sim_Step(Context);
+        ContactEndCount += AK_Sim_Get_Events(Context).ContactEndCount;
+    }
+    int FellAsleep = (AK_Sim_Get_Body(Context, RestingID)->Flags & AK_SIM_BODY_FLAG_SLEEPING) != 0;
+
+    ak_sim_body_id MovingID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(3.0, 0.49, 0.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), 
+                                               AK_Sim_V3(-3.0f, 0.0f, 0.0f));
+    AK_Sim_Get_Body(Context, MovingID)->AngularVelocity = Zero;
+    int WokeUp = 0;
+    for(i = 0; i < 60 && !WokeUp; i++) {
+        AK_Sim_Step(Context);
+        WokeUp = !(AK_Sim_Get_Body(Context, RestingID)->Flags & AK_SIM_BODY_FLAG_SLEEPING);
+    }
+
+    AK_Sim_Delete_Context(Context);
+    if(!FellAsleep || ContactEndCount || !WokeUp) {
+        printf("Sleeping failed: asleep %d contact ends %u woke %d\n", FellAsleep, ContactEndCount, WokeUp);
+        return 0;
+    }
+    return 1;
+}
+
+/*A ball flies through a wall and then a sensor while another ball rests on the floor. Each pair 
+  begins on the step it first overlaps, sends nothing while it keeps overlapping and ends on the 
+  step it separates. Deleting the resting ball ends its floor contact on the next step*/
+static int Test_Contact_Events(void) {
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim_body_id FloorID = Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(0.0, -0.5, 0.0), AK_Sim_V3(50.0f, 1.0f, 50.0f), Zero);
+    ak_sim_body_id RestingID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(0.0, 0.49, -5.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), Zero);
+    AK_Sim_Get_Body(Context, RestingID)->AngularVelocity = Zero;
+    ak_sim_body_id WallID = Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(3.0, 3.0, 0.0), AK_Sim_V3(2.0f, 2.0f, 2.0f), Zero);
+    ak_sim_body_id SensorID = Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(7.0, 3.0, 0.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), Zero);
+    AK_Sim_Get_Body(Context, SensorID)->Flags |= AK_SIM_BODY_FLAG_SENSOR;
+    ak_sim_body_id MovingID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(0.0, 3.0, 0.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), 
+                                               AK_Sim_V3(3.0f, 0.0f, 0.0f));
+    ak_sim_body* Moving = AK_Sim_Get_Body(Context, MovingID);
+    Moving->AngularVelocity = Zero;
+    Moving->Flags |= AK_SIM_BODY_FLAG_NEVER_SLEEP;
+
+    /*The ball overlaps the wall while its center is within 1.5 to 4.5 and the sensor while it is 
+      within 6 to 8. It moves 5 cm a step and surfaces that just touch may go either way, so each 
+      event must come within two steps of the crossing*/
+    int FloorBegan = 0, WallBegan = 0, WallEnded = 0, SensorBegan = 0, SensorEnded = 0, Unexpected = 0;
+    uint32_t i, j;
+    for(i = 0; i < 240; i++) {
+        AK_Sim_Step(Context);
+        ak_sim_events Events = AK_Sim_Get_Events(Context);
+        double X = AK_Sim_Get_Body(Context, MovingID)->Transform.Position.Data[0];
+        for(j = 0; j < Events.ContactBeginCount; j++) {
+            ak_sim_contact_event Event = Events.ContactBegin[j];
+            if(Event.BodyA > Event.BodyB) Unexpected++;
+            else if(Event.BodyA == AK_Sim__Min(FloorID, RestingID) && Event.BodyB == AK_Sim__Max(FloorID, RestingID) && i == 0) FloorBegan++;
+            else if(Event.BodyA == AK_Sim__Min(WallID, MovingID) && Event.BodyB == AK_Sim__Max(WallID, MovingID) && X >= 1.5 && X < 1.61) WallBegan++;
+            else Unexpected++;
+        }
+        for(j = 0; j < Events.ContactEndCount; j++) {
+            ak_sim_contact_event Event = Events.ContactEnd[j];
+            if(Event.BodyA == AK_Sim__Min(WallID, MovingID) && Event.BodyB == AK_Sim__Max(WallID, MovingID) && X > 4.5 && X < 4.61) WallEnded++;
+            else Unexpected++;
+        }
+        for(j = 0; j < Events.SensorBeginCount; j++) {
+            if(Events.SensorBegin[j].Sensor == SensorID && Events.SensorBegin[j].Visitor == MovingID && X >= 6.0 && X < 6.11) SensorBegan++;
+            else Unexpected++;
+        }
+        for(j = 0; j < Events.SensorEndCount; j++) {
+            if(Events.SensorEnd[j].Sensor == SensorID && Events.SensorEnd[j].Visitor == MovingID && X > 8.0 && X < 8.11) SensorEnded++;
+            else Unexpected++;
+        }
+    }
+
+    AK_Sim_Delete_Body(Context, RestingID);
+    AK_Sim_Step(Context);
+    ak_sim_events Events = AK_Sim_Get_Events(Context);
+    int FloorEnded = Events.ContactBeginCount == 0 && Events.ContactEndCount == 1 && 
+                     Events.ContactEnd[0].BodyA == AK_Sim__Min(FloorID, RestingID) && Events.ContactEnd[0].BodyB == AK_Sim__Max(FloorID, RestingID);
+
+    AK_Sim_Delete_Context(Context);
+    if(FloorBegan != 1 || WallBegan != 1 || WallEnded != 1 || SensorBegan != 1 || SensorEnded != 1 || Unexpected || !FloorEnded) {
+        printf("Contact events failed: floor %d/%d wall %d/%d sensor %d/%d unexpected %d\n", FloorBegan, FloorEnded, WallBegan, WallEnded, 
+               SensorBegan, SensorEnded, Unexpected);
+        return 0;
+    }
+    return 1;
+}
+
+static int Test_Raycast_Distance(ak_sim_context* Context, ak_sim_position Origin, ak_sim_v3 Direction, float MaxDistance, 
+                                 ak_sim_body_id ExpectedBody, float ExpectedDistance) {
+    ak_sim_raycast_hit Hit;
+    Memory_Clear(&Hit, sizeof(ak_sim_raycast_hit));
+    int IsHit = AK_Sim_Raycast(Context, Origin, Direction, MaxDistance, &Hit);
+    if(!ExpectedBody) return !IsHit;
+    return IsHit && Hit.Body == ExpectedBody && AK_Sim__Abs(Hit.Distance-ExpectedDistance) < 1e-3f;
+}
+
+/*Rays down onto a floor with a moving ball over it and a sensor in the way. The ball is hit 
+  where it is now, after it was stepped and after it was moved by hand*/
+static int Test_Raycast(void) {
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim_v3 Down = AK_Sim_V3(0.0f, -2.0f, 0.0f);
+    ak_sim_body_id FloorID = Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(0.0, -0.5, 0.0), AK_Sim_V3(50.0f, 1.0f, 50.0f), Zero);
+    ak_sim_body_id BallID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(0.0, 2.0, 0.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), 
+                                             AK_Sim_V3(3.0f, 0.0f, 0.0f));
+    ak_sim_body_id SensorID = Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(-5.0, 4.0, 0.0), AK_Sim_V3(2.0f, 2.0f, 2.0f), Zero);
+    AK_Sim_Get_Body(Context, SensorID)->Flags |= AK_SIM_BODY_FLAG_SENSOR;
+
+    int Result = Test_Raycast_Distance(Context, AK_Sim_Position(0.0, 10.0, 0.0), Down, 100.0f, BallID, 7.5f) && 
+                 Test_Raycast_Distance(Context, AK_Sim_Position(0.0, 10.0, 0.0), Down, 5.0f, 0, 0.0f) && 
+                 Test_Raycast_Distance(Context, AK_Sim_Position(-5.0, 10.0, 0.0), Down, 100.0f, FloorID, 10.0f);
+
+    uint32_t i;
+    for(i = 0; i < 60; i++) AK_Sim_Step(Context);
+    Result = Result && Test_Raycast_Distance(Context, AK_Sim_Position(3.0, 10.0, 0.0), Down, 100.0f, BallID, 7.5f) && 
+                       Test_Raycast_Distance(Context, AK_Sim_Position(0.0, 10.0, 0.0), Down, 100.0f, FloorID, 10.0f);
+
+    AK_Sim_Get_Body(Context, BallID)->Transform.Position = AK_Sim_Position(10.0, 2.0, 0.0);
+    Result = Result && Test_Raycast_Distance(Context, AK_Sim_Position(10.0, 10.0, 0.0), Down, 100.0f, BallID, 7.5f);
+
+    AK_Sim_Delete_Context(Context);
+    if(!Result) printf("Raycast failed\n");
+    return Result;
+}
+
+static ak_sim_contact G_Recorded_Contacts[16];
+static uint32_t G_Recorded_Contact_Count;
+
+/*The built in convex collision, keeping a copy of the contacts it reports*/
+static void Test_Record_Convex_Collision(ak_sim_collision_collector* Collector, ak_sim_shape* ShapeA, const ak_sim_m4x3* TransformA, ak_sim_v3 ScaleA, 
+                                         ak_sim_shape* ShapeB, const ak_sim_m4x3* TransformB, ak_sim_v3 ScaleB) {
+    uint32_t FirstContact = Collector->Contacts.Count;
+    AK_Sim__Convex_Collision(Collector, ShapeA, TransformA, ScaleA, ShapeB, TransformB, ScaleB);
+    uint32_t i;
+    for(i = FirstContact; i < Collector->Contacts.Count && G_Recorded_Contact_Count < AK_Sim__Array_Count(G_Recorded_Contacts); i++) {
+        G_Recorded_Contacts[G_Recorded_Contact_Count++] = *(ak_sim_contact*)AK_Sim__Array_Get(&Collector->Contacts, i);
+    }
+}
+
+/*User convex box. UserData points at its half extent*/
+static ak_sim_v3 Test_User_Box_Support(const void* UserData, ak_sim_v3 Direction) {
+    const ak_sim_v3* HalfExtent = (const ak_sim_v3*)UserData;
+    uint32_t i;
+    for(i = 0; i < 3; i++) Direction.Data[i] = Direction.Data[i] < 0.0f ? -HalfExtent->Data[i] : HalfExtent->Data[i];
+    return Direction;
+}
+
+/*User shape square of side two on its local XZ plane*/
+static void Test_User_Square_Bounds(const void* UserData, ak_sim_v3* Min, ak_sim_v3* Max) {
+    *Min = AK_Sim_V3(-1.0f, 0.0f, -1.0f);
+    *Max = AK_Sim_V3(1.0f, 0.0f, 1.0f);
+}
+
+static int Test_User_Square_Raycast(const void* UserData, ak_sim_v3 Origin, ak_sim_v3 Direction, float MaxT, float* T, ak_sim_v3* Normal) {
+    if(Direction.Data[1] == 0.0f) return 0;
+    float t = -Origin.Data[1]/Direction.Data[1];
+    float X = Origin.Data[0] + Direction.Data[0]*t;
+    float Z = Origin.Data[2] + Direction.Data[2]*t;
+    if(t < 0.0f || t > MaxT || X < -1.0f || X > 1.0f || Z < -1.0f || Z > 1.0f) return 0;
+    *T = t;
+    *Normal = AK_Sim_V3(0.0f, Direction.Data[1] < 0.0f ? 1.0f : -1.0f, 0.0f);
+    return 1;
+}
+
+static ak_sim_context* Test_Create_User_Context(void) {
+    static ak_sim_collision_registration Collision;
+    static ak_sim_shape_registration Registrations[2];
+    static ak_sim_convex_registration ConvexRegistration;
+    Collision.Type = AK_SIM_SHAPE_TYPE_CONVEX;
+    Collision.CollisionFunc = Test_Record_Convex_Collision;
+    Memory_Clear(Registrations, sizeof(Registrations));
+    Registrations[0].Type = AK_SIM_SHAPE_TYPE_CONVEX;
+    Registrations[0].CollisionFuncCount = 1;
+    Registrations[0].Collisions = &Collision;
+    Registrations[1].Type = AK_SIM_SHAPE_TYPE_USER;
+    Registrations[1].VTable.Bounds = Test_User_Square_Bounds;
+    Registrations[1].VTable.Raycast = Test_User_Square_Raycast;
+    Memory_Clear(&ConvexRegistration, sizeof(ak_sim_convex_registration));
+    ConvexRegistration.Type = AK_SIM_CONVEX_TYPE_USER;
+    ConvexRegistration.VTable.Support = Test_User_Box_Support;
+
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    CreateInfo.ShapeRegistrations = Registrations;
+    CreateInfo.ShapeRegistrationCount = 2;
+    CreateInfo.ConvexRegistrations = &ConvexRegistration;
+    CreateInfo.ConvexRegistrationCount = 1;
+    return AK_Sim_Create_Context(&CreateInfo);
+}
+
+/*A ball sunk 1 cm into the top of a user convex box that only gives a support function. The 
+  pair goes through the convex collision like any built in convex, with a contact under the 
+  ball's center midway between the surfaces*/
+static int Test_User_Convex(void) {
+    ak_sim_context* Context = Test_Create_User_Context();
+
+    ak_sim_v3 HalfExtent = AK_Sim_V3(0.5f, 0.5f, 0.5f);
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_USER;
+    ShapeInfo.ConvexUserData = &HalfExtent;
+    ak_sim_shape_id UserBox = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim_body_id BoxID = Test_Create_Body(Context, UserBox, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(0.0, 0.0, 0.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), Zero);
+    ak_sim_body_id BallID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(0.1, 0.99, -0.2), AK_Sim_V3(1.0f, 1.0f, 1.0f), Zero);
+    AK_Sim_Get_Body(Context, BallID)->AngularVelocity = Zero;
+
+    G_Recorded_Contact_Count = 0;
+    AK_Sim_Step(Context);
+    ak_sim_events Events = AK_Sim_Get_Events(Context);
+    int Began = Events.ContactBeginCount == 1 && Events.ContactBegin[0].BodyA == AK_Sim__Min(BoxID, BallID) && 
+                Events.ContactBegin[0].BodyB == AK_Sim__Max(BoxID, BallID);
+
+    /*The narrowphase runs once per substep*/
+    int ContactsAccurate = G_Recorded_Contact_Count == AK_SIM_DEFAULT_SUBSTEP_COUNT;
+    uint32_t i;
+    for(i = 0; i < G_Recorded_Contact_Count; i++) {
+        const ak_sim_contact* Contact = G_Recorded_Contacts + i;
+        ContactsAccurate = ContactsAccurate && AK_Sim__Abs(Contact->Position.Data[0] - 0.1f) < 1e-4f && AK_Sim__Abs(Contact->Position.Data[1] - 0.495f) < 1e-4f && 
+                           AK_Sim__Abs(Contact->Position.Data[2] + 0.2f) < 1e-4f && AK_Sim__Abs(AK_Sim__Abs(Contact->Normal.Data[1]) - 1.0f) < 1e-4f && 
+                           AK_Sim__Abs(Contact->Depth - 0.01f) < 1e-4f;
+    }
+
+    AK_Sim_Delete_Context(Context);
+    if(!Began || !ContactsAccurate) {
+        printf("User convex failed: began %d contacts %u accurate %d\n", Began, G_Recorded_Contact_Count, ContactsAccurate);
+        return 0;
+    }
+    return 1;
+}
+
+/*One body of every shape type in a row, each under a ray straight down onto its top and a ray 
+  just beside it. The mesh is hit from either side and the heightfield only from above*/
+static int Test_Raycast_Shapes(void) {
+    ak_sim_context* Context = Test_Create_User_Context();
+
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_CAPSULE;
+    ShapeInfo.Capsule.Radius = 0.5f;
+    ShapeInfo.Capsule.HalfHeight = 1.0f;
+    ak_sim_shape_id Capsule = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+
+    ak_sim_v3 MeshVertices[4];
+    uint32_t MeshIndices[6] = {0, 1, 2, 0, 2, 3};
+    MeshVertices[0] = AK_Sim_V3(-1.0f, 0.0f, -1.0f);
+    MeshVertices[1] = AK_Sim_V3(-1.0f, 0.0f, 1.0f);
+    MeshVertices[2] = AK_Sim_V3(1.0f, 0.0f, 1.0f);
+    MeshVertices[3] = AK_Sim_V3(1.0f, 0.0f, -1.0f);
+    ak_sim_triangle_mesh Mesh;
+    Mesh.Vertices = MeshVertices;
+    Mesh.Indices = MeshIndices;
+    Mesh.VtxCount = 4;
+    Mesh.IdxCount = 6;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_MESH;
+    ShapeInfo.TriangleMesh = &Mesh;
+    ak_sim_shape_id MeshShape = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    uint16_t Heights[4*4];
+    uint32_t i;
+    for(i = 0; i < 4*4; i++) Heights[i] = 1000;
+    ak_sim_heightfield Heightfield;
+    Memory_Clear(&Heightfield, sizeof(ak_sim_heightfield));
+    Heightfield.Heights = Heights;
+    Heightfield.SampleCountX = 4;
+    Heightfield.SampleCountZ = 4;
+    Heightfield.CellSize = 1.0f;
+    Heightfield.HeightScale = 0.001f;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_HEIGHTFIELD;
+    ShapeInfo.Heightfield = &Heightfield;
+    ak_sim_shape_id Terrain = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    /*Two balls with a gap between them*/
+    ak_sim_generic_shape Children[2];
+    Memory_Clear(Children, sizeof(Children));
+    for(i = 0; i < 2; i++) {
+        Children[i].Transform.Position = AK_Sim_V3(i ? 1.0f : -1.0f, 0.0f, 0.0f);
+        Children[i].Transform.Orientation = AK_Sim_Quat_Identity();
+        Children[i].Shape.Type = AK_SIM_SHAPE_TYPE_CONVEX;
+        Children[i].Shape.Internal.Convex.Type = AK_SIM_CONVEX_TYPE_SPHERE;
+        Children[i].Shape.Internal.Convex.Internal.Sphere.Radius = 0.5f;
+    }
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_COMPOUND;
+    ShapeInfo.CompoundShape.ShapeCount = 2;
+    ShapeInfo.CompoundShape.Shapes = Children;
+    ak_sim_shape_id Compound = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    ak_sim_v3 HalfExtent = AK_Sim_V3(0.5f, 0.5f, 0.5f);
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_USER;
+    ShapeInfo.ConvexUserData = &HalfExtent;
+    ak_sim_shape_id UserBox = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_USER;
+    ak_sim_shape_id UserSquare = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    /*Rays hit at (X + HitX, 10, HitZ) and miss at (X + MissX, 10, HitZ)*/
+    ak_sim_shape_id Shapes[8];
+    float HitXs[8], HitZs[8], MissXs[8], Distances[8];
+    Shapes[0] = Ball;       HitXs[0] = 0.0f; HitZs[0] = 0.0f; MissXs[0] = 0.6f;  Distances[0] = 9.5f;
+    Shapes[1] = Capsule;    HitXs[1] = 0.0f; HitZs[1] = 0.0f; MissXs[1] = 0.6f;  Distances[1] = 8.5f;
+    Shapes[2] = Box;        HitXs[2] = 0.3f; HitZs[2] = 0.2f; MissXs[2] = 0.6f;  Distances[2] = 9.5f;
+    Shapes[3] = MeshShape;  HitXs[3] = 0.5f; HitZs[3] = 0.5f; MissXs[3] = 1.1f;  Distances[3] = 10.0f;
+    Shapes[4] = Terrain;    HitXs[4] = 1.5f; HitZs[4] = 1.5f; MissXs[4] = -0.1f; Distances[4] = 9.0f;
+    Shapes[5] = Compound;   HitXs[5] = 1.0f; HitZs[5] = 0.0f; MissXs[5] = 0.0f;  Distances[5] = 9.5f;
+    Shapes[6] = UserBox;    HitXs[6] = 0.3f; HitZs[6] = 0.2f; MissXs[6] = 0.6f;  Distances[6] = 9.5f;
+    Shapes[7] = UserSquare; HitXs[7] = 0.5f; HitZs[7] = 0.5f; MissXs[7] = 1.1f;  Distances[7] = 10.0f;
+
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim_v3 Down = AK_Sim_V3(0.0f, -2.0f, 0.0f);
+    ak_sim_v3 Up = AK_Sim_V3(0.0f, 2.0f, 0.0f);
+    ak_sim_body_id BodyIDs[8];
+    for(i = 0; i < 8; i++) {
+        BodyIDs[i] = Test_Create_Body(Context, Shapes[i], AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(10.0*i, 0.0, 0.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), Zero);
+    }
+
+    int Result = 1;
+    for(i = 0; i < 8; i++) {
+        double X = 10.0*i;
+        int Hit = Test_Raycast_Distance(Context, AK_Sim_Position(X + HitXs[i], 10.0, HitZs[i]), Down, 100.0f, BodyIDs[i], Distances[i]);
+        int Missed = Test_Raycast_Distance(Context, AK_Sim_Position(X + MissXs[i], 10.0, HitZs[i]), Down, 100.0f, 0, 0.0f) && 
+                     Test_Raycast_Distance(Context, AK_Sim_Position(X + HitXs[i], 10.0, HitZs[i]), Down, Distances[i]-0.1f, 0, 0.0f);
+        if(!Hit || !Missed) {
+            printf("Raycast shapes failed: shape %u hit %d missed %d\n", i, Hit, Missed);
+            Result = 0;
+        }
+    }
+
+    int Sided = Test_Raycast_Distance(Context, AK_Sim_Position(30.5, -10.0, 0.5), Up, 100.0f, BodyIDs[3], 10.0f) && 
+                Test_Raycast_Distance(Context, AK_Sim_Position(41.5, -10.0, 1.5), Up, 100.0f, 0, 0.0f);
+
+    AK_Sim_Delete_Context(Context);
+    if(!Sided) printf("Raycast shapes failed: mesh from below or heightfield from below\n");
+    return Result && Sided;
+}
+
+/*A ball rolls through a row of still sensor balls, so only the ball leaves its fat bounds and the 
+  broadphase only searches it again. One sensor starts off to the side and is moved by hand into 
+  the ball's way, and is found although it stopped moving long before the ball gets there*/
+static int Test_Broadphase_Updates(void) {
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim_v3 One = AK_Sim_V3(1.0f, 1.0f, 1.0f);
+    ak_sim_body_id SensorIDs[20];
+    uint32_t i;
+    for(i = 0; i < 20; i++) {
+        SensorIDs[i] = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(3.0+i*3.0, 0.0, i == 17 ? 5.0 : 0.0), One, Zero);
+        ak_sim_body* Sensor = AK_Sim_Get_Body(Context, SensorIDs[i]);
+        Sensor->AngularVelocity = Zero;
+        Sensor->Flags |= AK_SIM_BODY_FLAG_SENSOR|AK_SIM_BODY_FLAG_NEVER_SLEEP;
+    }
+    ak_sim_body_id MovingID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(0.0, 0.0, 0.0), One, AK_Sim_V3(6.0f, 0.0f, 0.0f));
+    AK_Sim_Get_Body(Context, MovingID)->AngularVelocity = Zero;
+
+    uint32_t SensorBeginCount = 0;
+    for(i = 0; i < 660; i++) {
+        if(i == 300) AK_Sim_Get_Body(Context, SensorIDs[17])->Transform.Position = AK_Sim_Position(54.0, 0.0, 0.5);
+        AK_Sim_Step(Context);
+        SensorBeginCount += AK_Sim_Get_Events(Context).SensorBeginCount;
+    }
+
+    AK_Sim_Delete_Context(Context);
+    if(SensorBeginCount != 20) {
+        printf("Broadphase updates failed: %u sensor begins\n", SensorBeginCount);
+        return 0;
+    }
+    return 1;
+}
+
+static uint32_t G_Allocation_Count;
+
+static void* Test_Allocate(size_t Size, void* UserData) {
+    G_Allocation_Count++;
+    return malloc(Size);
+}
+
+static void Test_Free(void* Memory, void* UserData) {
+    free(Memory);
+}
+
+/*Runs the tasks in order but hands out several worker indices, so every worker's memory is used*/
+static void Test_Parallel_For(ak_sim_task_func* Task, void* TaskData, uint32_t TaskCount, void* UserData) {
+    uint32_t i;
+    for(i = 0; i < TaskCount; i++) Task(i, i%4, TaskData);
+}
+
+/*Jointed balls thrown at each other over a floor with cloth falling on them, with budgets that 
+  cover the scene. Once the first steps are done, stepping never calls the allocator*/
+static int Test_Budget_Allocations(void) {
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    CreateInfo.Allocator.AllocateMemory = Test_Allocate;
+    CreateInfo.Allocator.FreeMemory = Test_Free;
+    CreateInfo.ParallelFor = Test_Parallel_For;
+    CreateInfo.WorkerCount = 4;
+    CreateInfo.MaxBodies = 256;
+    CreateInfo.MaxJoints = 128;
+    CreateInfo.MaxPairs = 4096;
+    CreateInfo.MaxContacts = 4096;
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(0.0, -0.5, 0.0), AK_Sim_V3(50.0f, 1.0f, 50.0f), AK_Sim_V3(0.0f, 0.0f, 0.0f));
+
+    ak_sim_body_id PrevID = 0;
+    uint32_t i;
+    for(i = 0; i < 200; i++) {
+        ak_sim_position Position = AK_Sim_Position((i%10)*1.1-5.0, 0.5+(i/100)*1.1, ((i/10)%10)*1.1-5.0);
+        ak_sim_v3 Velocity = AK_Sim_V3((float)(i%3)-1.0f, -0.5f, (float)(i%5)*0.5f-1.0f);
+        ak_sim_body_id BodyID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, Position, AK_Sim_V3(1.0f, 1.0f, 1.0f), Velocity);
+        if(i%2) {
+            ak_sim_joint_create_info JointInfo;
+            Memory_Clear(&JointInfo, sizeof(ak_sim_joint_create_info));
+            JointInfo.Type = AK_SIM_JOINT_TYPE_BALL;
+            JointInfo.BodyA = PrevID;
+            JointInfo.BodyB = BodyID;
+            JointInfo.AnchorA = Position;
+            AK_Sim_Create_Joint(Context, &JointInfo);
+        }
+        PrevID = BodyID;
+    }
+
+    /*A sheet of cloth falling onto the balls*/
+    static ak_sim_position ClothPositions[32*32];
+    static uint32_t ClothEdges[2*2*32*31];
+    uint32_t EdgeCount = 0;
+    for(i = 0; i < 32*32; i++) {
+        ClothPositions[i] = AK_Sim_Position((i%32)*0.3-4.65, 3.0, (i/32)*0.3-4.65);
+        if(i%32 < 31) {
+            ClothEdges[2*EdgeCount] = i;
+            ClothEdges[2*EdgeCount+1] = i+1;
+            EdgeCount++;
+        }
+        if(i/32 < 31) {
+            ClothEdges[2*EdgeCount] = i;
+            ClothEdges[2*EdgeCount+1] = i+32;
+            EdgeCount++;
+        }
+    }
+    ak_sim_cloth_create_info ClothInfo;
+    Memory_Clear(&ClothInfo, sizeof(ak_sim_cloth_create_info));
+    ClothInfo.Positions = ClothPositions;
+    ClothInfo.ParticleCount = 32*32;
+    ClothInfo.Edges = ClothEdges;
+    ClothInfo.EdgeCount = EdgeCount;
+    ClothInfo.Radius = 0.1f;
+    ClothInfo.Friction = 0.5f;
+    ClothInfo.Gravity = AK_Sim_V3(0.0f, -9.8f, 0.0f);
+    AK_Sim_Create_Cloth(Context, &ClothInfo);
+
+    for(i = 0; i < 10; i++) AK_Sim_Update(Context, 1.0f/60.0f);
+    G_Allocation_Count = 0;
+    for(i = 0; i < 120; i++) AK_Sim_Update(Context, 1.0f/60.0f*1.5f);
+    uint32_t AllocationCount = G_Allocation_Count;
+
+    AK_Sim_Delete_Context(Context);
+    if(AllocationCount) {
+        printf("Budget allocations failed: %u allocations after warm up\n", AllocationCount);
+        return 0;
+    }
+    return 1;
+}
+
+static void Test_Walk_Character(ak_sim_context* Context, ak_sim_character* Character, float VelocityX, uint32_t FrameCount) {
+    uint32_t i;
+    for(i = 0; i < FrameCount; i++) {
+        Character->Displacement = AK_Sim_V3(VelocityX/60.0f, -9.8f/600.0f, 0.0f);
+        AK_Sim_Move_Characters(Context, Character, 1);
+    }
+}
+
+/*Characters walk up a 30 degree ramp, into a 60 degree one, and up and back down a 20 degree 
+  heightfield. They climb the walkable slopes and stay grounded on them, following the ground on 
+  the way down, and can't climb the steep one*/
+static int Test_Character_Slopes(void) {
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(0.0, -0.5, 0.0), AK_Sim_V3(100.0f, 1.0f, 100.0f), Zero);
+
+    /*Slabs rotated 30 and 60 degrees about -Z so they rise toward -X from the floor*/
+    ak_sim_quat Tilts[2];
+    Tilts[0] = AK_Sim_Quat(0.0f, 0.0f, -0.258819f, 0.965926f);
+    Tilts[1] = AK_Sim_Quat(0.0f, 0.0f, -0.5f, 0.866025f);
+    ak_sim_body_create_info RampInfo;
+    Memory_Clear(&RampInfo, sizeof(ak_sim_body_create_info));
+    RampInfo.Shape = Box;
+    RampInfo.Type = AK_SIM_BODY_TYPE_STATIC;
+    RampInfo.Scale = AK_Sim_V3(12.0f, 0.2f, 4.0f);
+    uint32_t i;
+    for(i = 0; i < 2; i++) {
+        RampInfo.Position = AK_Sim_Position(5.0, 0.0, 20.0*i);
+        RampInfo.Orientation = Tilts[i];
+        AK_Sim_Create_Body(Context, &RampInfo);
+    }
+
+    uint16_t Heights[32*32];
+    uint32_t x, z;
+    for(z = 0; z < 32; z++) {
+        for(x = 0; x < 32; x++) Heights[z*32+x] = (uint16_t)(x*364);
+    }
+    ak_sim_heightfield Heightfield;
+    Memory_Clear(&Heightfield, sizeof(ak_sim_heightfield));
+    Heightfield.Heights = Heights;
+    Heightfield.SampleCountX = 32;
+    Heightfield.SampleCountZ = 32;
+    Heightfield.CellSize = 1.0f;
+    Heightfield.HeightScale = 0.001f;
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ShapeType = AK_SIM_SHAPE_TYPE_HEIGHTFIELD;
+    ShapeInfo.Heightfield = &Heightfield;
+    ak_sim_shape_id Terrain = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    Test_Create_Body(Context, Terrain, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(100.0, 0.0, 100.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), Zero);
+
+    ak_sim_character Characters[3];
+    Memory_Clear(Characters, sizeof(Characters));
+    for(i = 0; i < 3; i++) {
+        Characters[i].Capsule.Radius = 0.3f;
+        Characters[i].Capsule.HalfHeight = 0.5f;
+        Characters[i].StepHeight = 0.3f;
+        Characters[i].Flags = AK_SIM_CHARACTER_FLAG_GROUNDED;
+    }
+    Characters[0].Position = AK_Sim_Position(7.0, 0.81, 0.0);
+    Characters[1].Position = AK_Sim_Position(7.0, 0.81, 20.0);
+    Characters[2].Position = AK_Sim_Position(102.0, 1.6, 110.0);
+    Test_Walk_Character(Context, &Characters[0], -2.0f, 120);
+    Test_Walk_Character(Context, &Characters[1], -2.0f, 120);
+    Test_Walk_Character(Context, &Characters[2], 0.0f, 30);
+    Test_Walk_Character(Context, &Characters[2], 3.0f, 120);
+    double UphillX = (double)Characters[2].Position.Data[0];
+    int UphillGrounded = (Characters[2].Flags & AK_SIM_CHARACTER_FLAG_GROUNDED) != 0;
+    Test_Walk_Character(Context, &Characters[2], -3.0f, 100);
+
+    /*On the heightfield the capsule's bottom sphere touches the slope a little above its center line*/
+    double SurfaceY = (Characters[2].Position.Data[0]-100.0)*0.364 + 0.8/0.94;
+    int Climbed = Characters[0].Position.Data[1] > 1.5 && Characters[0].GroundNormal.Data[1] > 0.8f && 
+                  (Characters[0].Flags & AK_SIM_CHARACTER_FLAG_GROUNDED);
+    int Blocked = Characters[1].Position.Data[1] < 1.0;
+    int Followed = UphillGrounded && UphillX > 107.5 && Characters[2].Position.Data[0] < 103.5 && 
+                   (Characters[2].Flags & AK_SIM_CHARACTER_FLAG_GROUNDED) && 
+                   AK_Sim__Abs((float)(Characters[2].Position.Data[1]-SurfaceY)) < 0.1f;
+
+    AK_Sim_Delete_Context(Context);
+    if(!Climbed || !Blocked || !Followed) {
+        printf("Character slopes failed: climbed %d blocked %d followed %d\n", Climbed, Blocked, Followed);
+        return 0;
+    }
+    return 1;
+}
+
+/*Runs the tasks last to first, so any result depending on the task order shows up*/
+static void Test_Parallel_For_Reversed(ak_sim_task_func* Task, void* TaskData, uint32_t TaskCount, void* UserData) {
+    uint32_t i;
+    for(i = TaskCount; i > 0; i--) Task(i-1, (i-1)%4, TaskData);
+}
+
+static uint64_t Test_Step_Thrown_Bodies(ak_sim_parallel_for_func* ParallelFor) {
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    if(ParallelFor) {
+        CreateInfo.ParallelFor = ParallelFor;
+        CreateInfo.WorkerCount = 4;
+        CreateInfo.RegionSize = 4.0f;
+    }
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(0.0, -0.5, 0.0), AK_Sim_V3(50.0f, 1.0f, 50.0f), AK_Sim_V3(0.0f, 0.0f, 0.0f));
+
+    ak_sim_body_id PrevID = 0;
+    uint32_t i;
+    for(i = 0; i < 120; i++) {
+        ak_sim_position Position = AK_Sim_Position((i%10)*1.1-5.0, 0.6+(i/100)*1.1, ((i/10)%10)*1.1-5.0);
+        ak_sim_v3 Velocity = AK_Sim_V3((float)(i%3)-1.0f, -0.5f, (float)(i%5)*0.5f-1.0f);
+        ak_sim_body_id BodyID = Test_Create_Body(Context, i%3 ? Ball : Box, AK_SIM_BODY_TYPE_DYNAMIC, Position, AK_Sim_V3(1.0f, 1.0f, 1.0f), Velocity);
+        if(i%4 == 3) {
+            ak_sim_joint_create_info JointInfo;
+            Memory_Clear(&JointInfo, sizeof(ak_sim_joint_create_info));
+            JointInfo.Type = AK_SIM_JOINT_TYPE_BALL;
+            JointInfo.BodyA = PrevID;
+            JointInfo.BodyB = BodyID;
+            JointInfo.AnchorA = Position;
+            AK_Sim_Create_Joint(Context, &JointInfo);
+        }
+        PrevID = BodyID;
+    }
+
+    /*A chain too long for one task, solved as batches of one color*/
+    PrevID = 0;
+    for(i = 0; i < 300; i++) {
+        ak_sim_position Position = AK_Sim_Position(i*1.1-165.0, 10.0, 0.0);
+        ak_sim_v3 Velocity = AK_Sim_V3(0.0f, (float)(i%7)-3.0f, (float)(i%3)-1.0f);
+        ak_sim_body_id BodyID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, Position, AK_Sim_V3(1.0f, 1.0f, 1.0f), Velocity);
+        if(PrevID) {
+            ak_sim_joint_create_info JointInfo;
+            Memory_Clear(&JointInfo, sizeof(ak_sim_joint_create_info));
+            JointInfo.Type = AK_SIM_JOINT_TYPE_BALL;
+            JointInfo.BodyA = PrevID;
+            JointInfo.BodyB = BodyID;
+            JointInfo.AnchorA = AK_Sim_Position(i*1.1-165.55, 10.0, 0.0);
+            AK_Sim_Create_Joint(Context, &JointInfo);
+        }
+        PrevID = BodyID;
+    }
+
+    for(i = 0; i < 120; i++) AK_Sim_Step(Context);
+    uint64_t Hash = AK_Sim_Get_State_Hash(Context);
+    AK_Sim_Delete_Context(Context);
+    return Hash;
+}
+
+/*Jointed balls and boxes thrown at each other reach the same state stepped on the calling thread 
+  and split into region and batch tasks run in reverse*/
+static int Test_Parallel_Determinism(void) {
+    uint64_t SerialHash = Test_Step_Thrown_Bodies(NULL);
+    uint64_t ParallelHash = Test_Step_Thrown_Bodies(Test_Parallel_For_Reversed);
+    if(SerialHash != ParallelHash) {
+        printf("Parallel determinism failed: serial %08x%08x parallel %08x%08x\n", (uint32_t)(SerialHash >> 32), (uint32_t)SerialHash, 
+               (uint32_t)(ParallelHash >> 32), (uint32_t)ParallelHash);
+        return 0;
+    }
+    return 1;
+}
+
+#ifdef AK_SIM__SSE2
+static uint32_t G_Test_Random = 12345;
+
+/*Uniform in [Min, Max) from a fixed linear congruential sequence*/
+static float Test_Random(float Min, float Max) {
+    G_Test_Random = G_Test_Random*1664525u + 1013904223u;
+    return Min + (Max-Min)*(float)(G_Test_Random >> 8)/16777216.0f;
+}
+
+/*Runs PairCount pairs of a sphere against TypeB through both batch kernels, gathered four lanes 
+  at a time like AK_Sim__Collide_Pair_Batches, and compares every output field bit for bit. Some 
+  pairs share their core positions, so the kernels' degenerate lanes are compared too*/
+static int Test_Batch_Kernel_Lanes(ak_sim_convex_type TypeB, uint32_t PairCount) {
+    int Result = 1;
+    uint32_t First;
+    for(First = 0; First < PairCount; First += AK_SIM__PAIR_BATCH_SIZE) {
+        uint32_t LaneCount = AK_Sim__Min(PairCount-First, (uint32_t)AK_SIM__PAIR_BATCH_SIZE);
+        ak_sim__pair_batch ScalarBatch;
+        Memory_Clear(&ScalarBatch, sizeof(ak_sim__pair_batch));
+
+        uint32_t Lane;
+        for(Lane = 0; Lane < LaneCount; Lane++) {
+            ak_sim_convex ConvexA, ConvexB;
+            Memory_Clear(&ConvexA, sizeof(ak_sim_convex));
+            Memory_Clear(&ConvexB, sizeof(ak_sim_convex));
+            ConvexA.Type = AK_SIM_CONVEX_TYPE_SPHERE;
+            ConvexA.Internal.Sphere.Radius = Test_Random(0.1f, 1.0f);
+            ConvexB.Type = TypeB;
+            if(TypeB == AK_SIM_CONVEX_TYPE_CAPSULE) {
+                ConvexB.Internal.Capsule.Radius = Test_Random(0.1f, 1.0f);
+                ConvexB.Internal.Capsule.HalfHeight = Test_Random(0.0f, 1.0f);
+            } else {
+                ConvexB.Internal.Sphere.Radius = Test_Random(0.1f, 1.0f);
+            }
+
+            ak_sim_transform TransformA, TransformB;
+            TransformA.Position = AK_Sim_V3(Test_Random(-1.0f, 1.0f), Test_Random(-1.0f, 1.0f), Test_Random(-1.0f, 1.0f));
+            TransformA.Orientation = AK_Sim_Quat_Identity();
+            TransformB.Position = (First+Lane) % 5 == 2 ? TransformA.Position : AK_Sim_V3(Test_Random(-1.0f, 1.0f), Test_Random(-1.0f, 1.0f), Test_Random(-1.0f, 1.0f));
+            TransformB.Orientation = AK_Sim__Quat_Normalize(AK_Sim_Quat(Test_Random(-1.0f, 1.0f), Test_Random(-1.0f, 1.0f), Test_Random(-1.0f, 1.0f), 
+                                                                        Test_Random(-1.0f, 1.0f)));
+            ak_sim_m4x3 MatrixA = AK_Sim__Get_Matrix_Transform(&TransformA);
+            ak_sim_m4x3 MatrixB = AK_Sim__Get_Matrix_Transform(&TransformB);
+            ak_sim_v3 ScaleB = Lane & 1 ? AK_Sim_V3(1.0f, 1.0f, 1.0f) : AK_Sim_V3(Test_Random(0.5f, 2.0f), Test_Random(0.5f, 2.0f), Test_Random(0.5f, 2.0f));
+            AK_Sim__Set_Pair_Batch_Side(ScalarBatch.StartA, ScalarBatch.DeltaA, ScalarBatch.RadiusA, Lane, &ConvexA, &MatrixA, AK_Sim_V3(1.0f, 1.0f, 1.0f));
+            AK_Sim__Set_Pair_Batch_Side(ScalarBatch.StartB, ScalarBatch.DeltaB, ScalarBatch.RadiusB, Lane, &ConvexB, &MatrixB, ScaleB);
+        }
+
+        ak_sim__pair_batch SIMDBatch = ScalarBatch;
+        AK_Sim__Collide_Pair_Batch_Scalar(&ScalarBatch);
+        AK_Sim__Collide_Pair_Batch_SSE2(&SIMDBatch);
+
+        for(Lane = 0; Lane < LaneCount; Lane++) {
+            uint32_t k;
+            int Matches = !memcmp(&ScalarBatch.Depth[Lane], &SIMDBatch.Depth[Lane], sizeof(float)) && 
+                          !memcmp(&ScalarBatch.Distance[Lane], &SIMDBatch.Distance[Lane], sizeof(float));
+            for(k = 0; k < 3; k++) {
+                Matches = Matches && !memcmp(&ScalarBatch.Position[k][Lane], &SIMDBatch.Position[k][Lane], sizeof(float)) && 
+                                     !memcmp(&ScalarBatch.Normal[k][Lane], &SIMDBatch.Normal[k][Lane], sizeof(float));
+            }
+            if(!Matches) {
+                printf("Batch kernels differ: type %d pair %u depth %g/%g distance %g/%g\n", TypeB, First+Lane, ScalarBatch.Depth[Lane], 
+                       SIMDBatch.Depth[Lane], ScalarBatch.Distance[Lane], SIMDBatch.Distance[Lane]);
+                Result = 0;
+            }
+        }
+    }
+    return Result;
+}
+
+#endif
+
+/*The SSE2 kernel must give the scalar kernel's contacts for sphere/sphere and sphere/capsule 
+  pairs, including the last partly filled batch. Builds without SSE2 only have the scalar kernel*/
+static int Test_Batch_Kernels(void) {
+#ifdef AK_SIM__SSE2
+    int SphereMatches = Test_Batch_Kernel_Lanes(AK_SIM_CONVEX_TYPE_SPHERE, 4*50+3);
+    int CapsuleMatches = Test_Batch_Kernel_Lanes(AK_SIM_CONVEX_TYPE_CAPSULE, 4*50+2);
+    return SphereMatches && CapsuleMatches;
+#else
+    return 1;
+#endif
+}
+
+/*Balls dropped on a floor fill in the step's counters and timings, and the trace holds one event 
+  per phase timed. The trace query reports the full length like snprintf and a short buffer is 
+  cut off but still terminated. With AK_SIM_NO_PROFILE the stats are zero and the trace is empty*/
+static int Test_Stats_And_Trace(void) {
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(0.0, -0.5, 0.0), AK_Sim_V3(50.0f, 1.0f, 50.0f), Zero);
+    uint32_t i;
+    for(i = 0; i < 10; i++) {
+        Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(i*1.1, 0.45, 0.0), AK_Sim_V3(1.0f, 1.0f, 1.0f), AK_Sim_V3(0.0f, -1.0f, 0.0f));
+    }
+    for(i = 0; i < 3; i++) AK_Sim_Step(Context);
+
+    ak_sim_stats Stats;
+    AK_Sim_Get_Stats(Context, &Stats);
+    size_t TraceLength = AK_Sim_Write_Chrome_Trace(Context, NULL, 0);
+    static char Trace[1 << 16];
+    size_t WrittenLength = AK_Sim_Write_Chrome_Trace(Context, Trace, sizeof(Trace));
+    char ShortTrace[8];
+    size_t ShortLength = AK_Sim_Write_Chrome_Trace(Context, ShortTrace, sizeof(ShortTrace));
+    AK_Sim_Delete_Context(Context);
+
+    int TraceWritten = WrittenLength == TraceLength && ShortLength == TraceLength && strlen(Trace) == TraceLength && 
+                       !memcmp(ShortTrace, Trace, sizeof(ShortTrace)-1) && !ShortTrace[sizeof(ShortTrace)-1] && 
+                       !strncmp(Trace, "{\"traceEvents\":[", 16) && !strcmp(Trace+TraceLength-2, "]}");
+#ifndef AK_SIM_NO_PROFILE
+    uint32_t StepEventCount = 0;
+    const char* At = Trace;
+    while((At = strstr(At, "\"name\":\"Step\"")) != NULL) {
+        StepEventCount++;
+        At++;
+    }
+    uint64_t PhaseSum = Stats.PhaseTimeNS[AK_SIM_PROFILE_PHASE_BROADPHASE] + Stats.PhaseTimeNS[AK_SIM_PROFILE_PHASE_NARROWPHASE] + 
+                        Stats.PhaseTimeNS[AK_SIM_PROFILE_PHASE_SOLVER] + Stats.PhaseTimeNS[AK_SIM_PROFILE_PHASE_INTEGRATION];
+    int StatsFilled = Stats.PairsFound == 10 && Stats.ContactsProduced >= 10 && Stats.BoundsUpdated == 10 && 
+                      Stats.ArenaHighWaterMark >= Stats.ArenaBytesUsed && Stats.ArenaBytesUsed && 
+                      PhaseSum <= Stats.PhaseTimeNS[AK_SIM_PROFILE_PHASE_STEP];
+    TraceWritten = TraceWritten && StepEventCount == 3 && strstr(Trace, "\"name\":\"Narrowphase\"");
+#else
+    ak_sim_stats ZeroStats;
+    Memory_Clear(&ZeroStats, sizeof(ak_sim_stats));
+    int StatsFilled = !memcmp(&Stats, &ZeroStats, sizeof(ak_sim_stats));
+    TraceWritten = TraceWritten && !strcmp(Trace, "{\"traceEvents\":[]}");
+#endif
+
+    if(!StatsFilled || !TraceWritten) {
+        printf("Stats and trace failed: stats %d trace %d pairs %u contacts %u\n", StatsFilled, TraceWritten, Stats.PairsFound, 
+               Stats.ContactsProduced);
+        return 0;
+    }
+    return 1;
+}
+
+#ifdef AK_SIM_DOUBLE_PRECISION
+/*A ball sunk 1 cm into a floor a million units from the origin, where floats only resolve 6 cm. 
+  Its contact must sit under its center, midway between the surfaces, and rays must hit its top 
+  and the floor beside it, all to a tenth of a millimeter*/
+static int Test_Far_From_Origin(void) {
+    ak_sim_collision_registration Collision;
+    Collision.Type = AK_SIM_SHAPE_TYPE_CONVEX;
+    Collision.CollisionFunc = Test_Record_Convex_Collision;
+    ak_sim_shape_registration Registration;
+    Memory_Clear(&Registration, sizeof(ak_sim_shape_registration));
+    Registration.Type = AK_SIM_SHAPE_TYPE_CONVEX;
+    Registration.CollisionFuncCount = 1;
+    Registration.Collisions = &Collision;
+
+    ak_sim_create_info CreateInfo;
+    Memory_Clear(&CreateInfo, sizeof(ak_sim_create_info));
+    CreateInfo.ShapeRegistrations = &Registration;
+    CreateInfo.ShapeRegistrationCount = 1;
+    ak_sim_context* Context = AK_Sim_Create_Context(&CreateInfo);
+
+    double X = 1000000.3;
+    double Z = -1000000.7;
+    ak_sim_v3 Zero = AK_Sim_V3(0.0f, 0.0f, 0.0f);
+    ak_sim_shape_id Box = Test_Create_Box_Shape(Context);
+    ak_sim_body_id FloorID = Test_Create_Body(Context, Box, AK_SIM_BODY_TYPE_STATIC, AK_Sim_Position(X, -0.5, Z), AK_Sim_V3(50.0f, 1.0f, 50.0f), Zero);
+    ak_sim_shape_info ShapeInfo;
+    Memory_Clear(&ShapeInfo, sizeof(ak_sim_shape_info));
+    ShapeInfo.ConvexType = AK_SIM_CONVEX_TYPE_SPHERE;
+    ShapeInfo.Sphere.Radius = 0.5f;
+    ak_sim_shape_id Ball = AK_Sim_Create_Shape(Context, &ShapeInfo);
+    ak_sim_body_id BallID = Test_Create_Body(Context, Ball, AK_SIM_BODY_TYPE_DYNAMIC, AK_Sim_Position(X+0.25, 0.49, Z-0.25), AK_Sim_V3(1.0f, 1.0f, 1.0f), Zero);
+    AK_Sim_Get_Body(Context, BallID)->AngularVelocity = Zero;
+
+    G_Recorded_Contact_Count = 0;
+    AK_Sim_Step(Context);
+    ak_sim_position Origin = AK_Sim_Get_Body(Context, FloorID)->Transform.Position;
+    ak_sim_position Center = AK_Sim_Get_Body(Context, BallID)->Transform.Position;
+
+    int ContactsAccurate = G_Recorded_Contact_Count > 0;
+    uint32_t i;
+    for(i = 0; i < G_Recorded_Contact_Count; i++) {
+        const ak_sim_contact* Contact = G_Recorded_Contacts + i;
+        double OffsetX = Origin.Data[0] + Contact->Position.Data[0] - Center.Data[0];
+        double OffsetZ = Origin.Data[2] + Contact->Position.Data[2] - Center.Data[2];
+        double Y = Origin.Data[1] + Contact->Position.Data[1];
+        if(AK_Sim__Abs(OffsetX) > 1e-4 || AK_Sim__Abs(OffsetZ) > 1e-4 || 
+           AK_Sim__Abs(Y + 0.005) > 1e-4 || AK_Sim__Abs(Contact->Depth - 0.01f) > 1e-4f) {
+            printf("Far from origin contact %u off: x %g z %g y %g depth %g\n", i, OffsetX, OffsetZ, Y, Contact->Depth);
+            ContactsAccurate = 0;
+        }
+    }
+
+    ak_sim_v3 Down = AK_Sim_V3(0.0f, -1.0f, 0.0f);
+    ak_sim_raycast_hit BallHit, FloorHit;
+    int BallHitFound = AK_Sim_Raycast(Context, AK_Sim_Position(X+0.25, 10.0, Z-0.25), Down, 100.0f, &BallHit);
+    int FloorHitFound = AK_Sim_Raycast(Context, AK_Sim_Position(X-1.125, 10.0, Z+2.0625), Down, 100.0f, &FloorHit);
+    int RaysAccurate = BallHitFound && BallHit.Body == BallID && AK_Sim__Abs(BallHit.Distance - 9.01f) < 1e-4f && 
+                       AK_Sim__Abs(BallHit.Position.Data[0] - (X+0.25)) < 1e-4 && AK_Sim__Abs(BallHit.Position.Data[1] - 0.99) < 1e-4 && 
+                       AK_Sim__Abs(BallHit.Position.Data[2] - (Z-0.25)) < 1e-4 && 
+                       FloorHitFound && FloorHit.Body == FloorID && AK_Sim__Abs(FloorHit.Distance - 10.0f) < 1e-4f && 
+                       AK_Sim__Abs(FloorHit.Position.Data[0] - (X-1.125)) < 1e-4 && AK_Sim__Abs(FloorHit.Position.Data[1]) < 1e-4 && 
+                       AK_Sim__Abs(FloorHit.Position.Data[2] - (Z+2.0625)) < 1e-4;
+
+    AK_Sim_Delete_Context(Context);
+    if(!ContactsAccurate || !RaysAccurate) {
+        printf("Far from origin failed: %u contacts accurate %d rays accurate %d ball hit %g floor hit %g\n", G_Recorded_Contact_Count, 
+               ContactsAccurate, RaysAccurate, BallHit.Distance, FloorHit.Distance);
+        return 0;
+    }
+    return 1;
+}
+#endif
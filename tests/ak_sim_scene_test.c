@@ -10,12 +10,11 @@ int main() {
     InitWindow(1920, 1080, "AK Sim");
 
     ak_sim_create_info CreateInfo = {0};
+    CreateInfo.FixedTimeStep = 1.0f/60.0f;
+    CreateInfo.MaxStepsPerUpdate = 20;
     ak_sim_context* SimContext = AK_Sim_Create_Context(&CreateInfo);
 
-    const double TargetTime = 1.0/60.0;
-    const double MaxTime = 1.0/3.0;
     double LastTime = GetTime();
-    double Accumulator = 0.0;
 
     while (!WindowShouldClose())
     {
@@ -23,14 +22,7 @@ int main() {
         double DeltaTime = Time-LastTime;
         LastTime = Time;
 
-        if(DeltaTime > MaxTime) {
-            DeltaTime = MaxTime;
-        }
-
-        Accumulator += DeltaTime;
-        while(Accumulator >= TargetTime) {
-            Accumulator -= TargetTime;
-        }
+        AK_Sim_Update(SimContext, (float)DeltaTime);
 
         BeginDrawing();
         ClearBackground(RAYWHITE);
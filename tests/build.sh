@@ -6,11 +6,27 @@ if [ ! -d $bin_path ]; then
     mkdir -p $bin_path
 fi
 
-#todo: remove no-unused-function, 
+#todo: remove no-unused-function,
 warnings="-Wall -Werror -Wno-unused-function"
 flags="-g -O0"
+benchmark_flags="-g -O2"
+
+if [ "$(uname)" = "Darwin" ]; then
+    compiler=clang
+    platform_libs=""
+else
+    compiler=${CC:-cc}
+    platform_libs="-lm"
+fi
 
 pushd $bin_path
-    clang $flags $warnings -I$dependencies_path/raylib-quickstart/build/external/raylib-master/src -framework AppKit -framework IOKit $test_path/ak_sim_scene_test.c -l raylib -L $dependencies_path/raylib-quickstart/bin/Debug -o ak_sim_scene_test
-    clang $flags $warnings -std=c89 -fPIC $test_path/ak_sim_compile_test.c -o ak_sim_compile_test
-popd
\ No newline at end of file
+    if [ "$(uname)" = "Darwin" ]; then
+        clang $flags $warnings -I$dependencies_path/raylib-quickstart/build/external/raylib-master/src -framework AppKit -framework IOKit $test_path/ak_sim_scene_test.c -l raylib -L $dependencies_path/raylib-quickstart/bin/Debug -o ak_sim_scene_test
+    fi
+    $compiler $flags $warnings -std=c89 -fPIC $test_path/ak_sim_compile_test.c $platform_libs -o ak_sim_compile_test
+    $compiler $flags $warnings -std=c89 -fPIC -DAK_SIM_DETERMINISTIC $test_path/ak_sim_compile_test.c $platform_libs -o ak_sim_compile_test_deterministic
+    $compiler $flags $warnings -std=c89 -fPIC -DAK_SIM_NO_SIMD $test_path/ak_sim_compile_test.c $platform_libs -o ak_sim_compile_test_no_simd
+    $compiler $flags $warnings -std=c89 -fPIC -DAK_SIM_DOUBLE_PRECISION $test_path/ak_sim_compile_test.c $platform_libs -o ak_sim_compile_test_double
+    $compiler $benchmark_flags $warnings $test_path/ak_sim_benchmark.c $platform_libs -lpthread -o ak_sim_benchmark
+    $compiler $benchmark_flags $warnings -DAK_SIM_DOUBLE_PRECISION $test_path/ak_sim_benchmark.c $platform_libs -lpthread -o ak_sim_benchmark_double
+popd